@@ -5,15 +5,27 @@
 #include "SceneGraph/shape.h"
 #include "SceneGraph/material.h"
 #include "SceneGraph/texture.h"
+#include "SceneGraph/volume.h"
 #include "SceneGraph/Collector/collector.h"
 #include "SceneGraph/iterator.h"
+#include "Utils/bxdf_lut.h"
 #include "Utils/distribution1d.h"
+#include "Utils/half_convert.h"
 #include "Utils/log.h"
+#include "Utils/sh.h"
+#include "Utils/shproject.h"
+#include "Utils/sparse_grid.h"
+#include "Utils/texture_atlas.h"
+#include "Utils/clw_class.h"
 
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <memory>
 #include <stack>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <array>
 
@@ -31,6 +43,7 @@ namespace Baikal
     : m_default_material(new SingleBxdf(SingleBxdf::BxdfType::kLambert))
     , m_context(context)
     , m_api(api)
+    , m_sh_projector(new ClwShProjector(context))
     {
         auto acc_type = "fatbvh";
         auto builder_type = "sah";
@@ -93,7 +106,138 @@ namespace Baikal
             }
         }
     }
+
+    static int GetVolumeIndex(std::map<Volume const*, int> const& volume_indices, Volume const* volume)
+    {
+        auto iter = volume_indices.find(volume);
+        return iter != volume_indices.cend() ? iter->second : -1;
+    }
+    
+    // Identical materials are merged, so collector index is mapped to a material record
+    static int GetMaterialRecord(ClwScene const& scene, std::uint32_t material_idx)
+    {
+        return material_idx < scene.material_slots.size() ? scene.material_slots[material_idx] : static_cast<int>(material_idx);
+    }
     
+    // Host mirror of GetOrthoVector from utils.cl, tangent angles
+    // are measured against it so it should stay bit-compatible.
+    static float3 GetOrthoVector(float3 const& n)
+    {
+        float3 p;
+
+        if (std::fabs(n.z) > 0.f)
+        {
+            float k = std::sqrt(n.y * n.y + n.z * n.z);
+            p.x = 0; p.y = -n.z / k; p.z = n.y / k;
+        }
+        else
+        {
+            float k = std::sqrt(n.x * n.x + n.y * n.y);
+            p.x = n.y / k; p.y = -n.x / k; p.z = 0;
+        }
+
+        return normalize(p);
+    }
+
+    // Calculate per-vertex tangents (angle weighted per corner, orthogonalized against
+    // vertex normal, handedness from bitangent) and pack them into w component of the normals.
+    // Note these are NOT MikkTSpace compatible: vertices are never split on handedness or
+    // welded by MikkTSpace rules, as one tangent is stored per mesh vertex. Normal maps baked
+    // against MikkTSpace tangents may shade slightly off around uv seams and mirrored uvs.
+    // w == 0 means no tangent (degenerate uvs), otherwise
+    // w = sign * (angle + 4), where angle is measured in the plane orthogonal to the normal
+    // starting from GetOrthoVector(n). See Scene_GetVertexTangent in scene.cl.
+    void ClwSceneController::EncodeVertexTangents(Mesh const* mesh, float3* normals)
+    {
+        auto num_vertices = mesh->GetNumVertices();
+
+        for (std::size_t i = 0; i < mesh->GetNumNormals(); ++i)
+        {
+            normals[i].w = 0.f;
+        }
+
+        if (mesh->GetNumNormals() != num_vertices || mesh->GetNumUVs() != num_vertices)
+        {
+            return;
+        }
+
+        auto vertices = mesh->GetVertices();
+        auto uvs = mesh->GetUVs();
+        auto indices = mesh->GetIndices();
+        auto num_indices = mesh->GetNumIndices();
+
+        std::vector<float3> tangents(num_vertices);
+        std::vector<float3> bitangents(num_vertices);
+
+        for (std::size_t i = 0; i + 2 < num_indices; i += 3)
+        {
+            std::uint32_t idx[3] = { indices[i], indices[i + 1], indices[i + 2] };
+
+            auto dp1 = vertices[idx[1]] - vertices[idx[0]];
+            auto dp2 = vertices[idx[2]] - vertices[idx[0]];
+            auto du1 = uvs[idx[1]].x - uvs[idx[0]].x;
+            auto du2 = uvs[idx[2]].x - uvs[idx[0]].x;
+            auto dv1 = uvs[idx[1]].y - uvs[idx[0]].y;
+            auto dv2 = uvs[idx[2]].y - uvs[idx[0]].y;
+
+            auto det = du1 * dv2 - du2 * dv1;
+
+            if (std::fabs(det) < 1e-12f)
+            {
+                continue;
+            }
+
+            auto sdir = (dp1 * dv2 - dp2 * dv1) * (1.f / det);
+            auto tdir = (dp2 * du1 - dp1 * du2) * (1.f / det);
+
+            for (int c = 0; c < 3; ++c)
+            {
+                auto e0 = vertices[idx[(c + 1) % 3]] - vertices[idx[c]];
+                auto e1 = vertices[idx[(c + 2) % 3]] - vertices[idx[c]];
+
+                auto l = std::sqrt(e0.sqnorm() * e1.sqnorm());
+
+                if (l == 0.f)
+                {
+                    continue;
+                }
+
+                auto angle = std::acos(std::min(std::max(dot(e0, e1) / l, -1.f), 1.f));
+
+                auto n = normals[idx[c]];
+                n.w = 0.f;
+                auto t = sdir - n * (dot(n, sdir) / n.sqnorm());
+
+                if (t.sqnorm() > 0.f)
+                {
+                    tangents[idx[c]] += normalize(t) * angle;
+                    bitangents[idx[c]] += tdir * angle;
+                }
+            }
+        }
+
+        for (std::size_t i = 0; i < num_vertices; ++i)
+        {
+            auto n = normals[i];
+            n.w = 0.f;
+
+            if (tangents[i].sqnorm() == 0.f || n.sqnorm() == 0.f)
+            {
+                continue;
+            }
+
+            n = normalize(n);
+            auto t = normalize(tangents[i]);
+            auto o = GetOrthoVector(n);
+            auto b = cross(n, o);
+
+            auto angle = std::atan2(dot(t, b), dot(t, o));
+            auto sign = dot(cross(n, t), bitangents[i]) < 0.f ? -1.f : 1.f;
+
+            normals[i].w = sign * (angle + 4.f);
+        }
+    }
+
     static std::size_t GetShapeIdx(Iterator* shape_iter, Shape const* shape)
     {
         std::set<Mesh const*> meshes;
@@ -309,8 +453,18 @@ namespace Baikal
             out.camera = m_context.CreateBuffer<ClwScene::Camera>(1, CL_MEM_READ_ONLY);
         }
         
-        // TODO: remove this
-        out.camera_type = camera->GetAperture() > 0.f ? CameraType::kPhysical : CameraType::kDefault;
+        switch (camera->GetProjection())
+        {
+            case PerspectiveCamera::Projection::kSpherical:
+                out.camera_type = CameraType::kSpherical;
+                break;
+            case PerspectiveCamera::Projection::kFisheye:
+                out.camera_type = CameraType::kFisheye;
+                break;
+            default:
+                out.camera_type = camera->GetAperture() > 0.f ? CameraType::kPhysical : CameraType::kDefault;
+                break;
+        }
         
         // Update camera data
         ClwScene::Camera* data = nullptr;
@@ -361,6 +515,10 @@ namespace Baikal
         std::set<Mesh const*> excluded_meshes;
         std::set<Instance const*> instances;
         SplitMeshesAndInstances(shape_iter.get(), meshes, instances, excluded_meshes);
+
+        // Volumes enclosed by shapes
+        std::map<Volume const*, int> volume_indices;
+        UpdateVolumes(meshes, instances, volume_indices, out);
         
         // Calculate GPU array sizes. Do that only for meshes,
         // since instances do not occupy space in vertex buffers.
@@ -459,6 +617,7 @@ namespace Baikal
             shape.startvtx = static_cast<int>(num_vertices_written);
             shape.startidx = static_cast<int>(num_indices_written);
             shape.start_material_idx = static_cast<int>(num_matids_written);
+            shape.volume_idx = GetVolumeIndex(volume_indices, mesh->GetVolume());
             
             auto transform = mesh->GetTransform();
             shape.transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
@@ -475,6 +634,7 @@ namespace Baikal
             num_vertices_written += mesh_num_vertices;
             
             std::copy(mesh_normal_array, mesh_normal_array + mesh_num_normals, normals + num_normals_written);
+            EncodeVertexTangents(mesh, normals + num_normals_written);
             num_normals_written += mesh_num_normals;
             
             std::copy(mesh_uv_array, mesh_uv_array + mesh_num_uvs, uvs + num_uvs_written);
@@ -492,7 +652,7 @@ namespace Baikal
                 material = m_default_material.get();
             }
             
-            auto matidx = mat_collector.GetItemIndex(material);
+            auto matidx = GetMaterialRecord(out, mat_collector.GetItemIndex(material));
             std::fill(matids + num_matids_written, matids + num_matids_written + mesh_num_indices / 3, matidx);
             
             num_matids_written += mesh_num_indices / 3;
@@ -526,6 +686,7 @@ namespace Baikal
             shape.startvtx = static_cast<int>(num_vertices_written);
             shape.startidx = static_cast<int>(num_indices_written);
             shape.start_material_idx = static_cast<int>(num_matids_written);
+            shape.volume_idx = -1;
 
             auto transform = mesh->GetTransform();
             shape.transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
@@ -542,6 +703,7 @@ namespace Baikal
             num_vertices_written += mesh_num_vertices;
             
             std::copy(mesh_normal_array, mesh_normal_array + mesh_num_normals, normals + num_normals_written);
+            EncodeVertexTangents(mesh, normals + num_normals_written);
             num_normals_written += mesh_num_normals;
             
             std::copy(mesh_uv_array, mesh_uv_array + mesh_num_uvs, uvs + num_uvs_written);
@@ -576,6 +738,8 @@ namespace Baikal
             ClwScene::Shape shape = shape_data[base_shape];
             // Instance has its own material part.
             shape.start_material_idx = static_cast<int>(num_matids_written);
+            // And its own volume.
+            shape.volume_idx = GetVolumeIndex(volume_indices, instance->GetVolume());
             
             // Instance has its own transform.
             shape.transform.m0 = { transform.m00, transform.m01, transform.m02, transform.m03 };
@@ -594,7 +758,7 @@ namespace Baikal
                 material = m_default_material.get();
             }
             
-            auto mat_idx = mat_collector.GetItemIndex(material);
+            auto mat_idx = GetMaterialRecord(out, mat_collector.GetItemIndex(material));
             std::fill(matids + num_matids_written, matids + num_matids_written + mesh_num_indices / 3, mat_idx);
             
             num_matids_written += mesh_num_indices / 3;
@@ -611,6 +775,8 @@ namespace Baikal
         m_context.UnmapBuffer(0, out.materialids, matids);
         m_context.UnmapBuffer(0, out.shapes, shapes).Wait();
 
+        out.bounds = scene.GetWorldAABB();
+
         LogInfo("Updating intersector...\n");
         UpdateIntersector(scene, out);
 
@@ -631,6 +797,10 @@ namespace Baikal
         std::set<Instance const*> instances;
         SplitMeshesAndInstances(shape_iter.get(), meshes, instances, excluded_meshes);
 
+        // Volumes enclosed by shapes
+        std::map<Volume const*, int> volume_indices;
+        UpdateVolumes(meshes, instances, volume_indices, out);
+
         // Calculate GPU array sizes. Do that only for meshes,
         // since instances do not occupy space in vertex buffers.
         // However instances still have their own material ids.
@@ -674,6 +844,7 @@ namespace Baikal
             current_shape->transform.m1 = { transform.m10, transform.m11, transform.m12, transform.m13 };
             current_shape->transform.m2 = { transform.m20, transform.m21, transform.m22, transform.m23 };
             current_shape->transform.m3 = { transform.m30, transform.m31, transform.m32, transform.m33 };
+            current_shape->volume_idx = GetVolumeIndex(volume_indices, mesh->GetVolume());
 
             // Check if mesh has a material and use default if not
             auto material = mesh->GetMaterial();
@@ -682,7 +853,7 @@ namespace Baikal
                 material = m_default_material.get();
             }
 
-            auto matidx = mat_collector.GetItemIndex(material);
+            auto matidx = GetMaterialRecord(out, mat_collector.GetItemIndex(material));
             std::fill(matids + current_shape->start_material_idx, 
                 matids + current_shape->start_material_idx + mesh_num_indices / 3, 
                 matidx);
@@ -713,7 +884,7 @@ namespace Baikal
                 material = m_default_material.get();
             }
 
-            auto matidx = mat_collector.GetItemIndex(material);
+            auto matidx = GetMaterialRecord(out, mat_collector.GetItemIndex(material));
             std::fill(matids + current_shape->start_material_idx,
                 matids + current_shape->start_material_idx + mesh_num_indices / 3,
                 matidx);
@@ -736,6 +907,7 @@ namespace Baikal
             current_shape->transform.m1 = { transform.m10, transform.m11, transform.m12, transform.m13 };
             current_shape->transform.m2 = { transform.m20, transform.m21, transform.m22, transform.m23 };
             current_shape->transform.m3 = { transform.m30, transform.m31, transform.m32, transform.m33 };
+            current_shape->volume_idx = GetVolumeIndex(volume_indices, instance->GetVolume());
 
             // Check if mesh has a material and use default if not
             if (!material)
@@ -743,7 +915,7 @@ namespace Baikal
                 material = m_default_material.get();
             }
 
-            auto matidx = mat_collector.GetItemIndex(material);
+            auto matidx = GetMaterialRecord(out, mat_collector.GetItemIndex(material));
             std::fill(matids + current_shape->start_material_idx,
                 matids + current_shape->start_material_idx + mesh_num_indices / 3,
                 matidx);
@@ -756,205 +928,1065 @@ namespace Baikal
         m_context.UnmapBuffer(0, out.materialids, matids);
         m_context.UnmapBuffer(0, out.shapes, shapes).Wait();
 
-
+        out.bounds = scene.GetWorldAABB();
     }
     
-    void ClwSceneController::UpdateCurrentScene(Scene1 const& scene, ClwScene& out) const
+    void ClwSceneController::UpdateVolumes(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const
     {
-        ReloadIntersector(scene, out);
+        auto shape_iter = scene.CreateShapeIterator();
+
+        std::set<Mesh const*> meshes;
+        std::set<Mesh const*> excluded_meshes;
+        std::set<Instance const*> instances;
+        SplitMeshesAndInstances(shape_iter.get(), meshes, instances, excluded_meshes);
+
+        // Shapes are unchanged, so volumes keep the indices stored in shape records
+        std::map<Volume const*, int> volume_indices;
+        UpdateVolumes(meshes, instances, volume_indices, out);
     }
-    
-    void ClwSceneController::UpdateMaterials(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const
+
+    void ClwSceneController::UpdateVolumes(std::set<Mesh const*> const& meshes, std::set<Instance const*> const& instances, std::map<Volume const*, int>& volume_indices, ClwScene& out) const
     {
-        // Get new buffer size
-        std::size_t mat_buffer_size = mat_collector.GetNumItems();
-        
-        // Recreate material buffer if it needs resize
-        if (mat_buffer_size > out.materials.GetElementCount())
-        {
-            // Create material buffer
-            out.materials = m_context.CreateBuffer<ClwScene::Material>(mat_buffer_size, CL_MEM_READ_ONLY);
-        }
-        
-        ClwScene::Material* materials = nullptr;
-        std::size_t num_materials_written = 0;
-        
-        // Map GPU materials buffer
-        m_context.MapBuffer(0, out.materials, CL_MAP_WRITE, &materials).Wait();
-        
-        // Serialize
+        // Collect unique volumes in shape order
+        std::vector<Volume const*> volumes;
+        volume_indices.clear();
+
+        auto add_volume = [&volumes, &volume_indices](Shape const* shape)
         {
-            // Update material bundle first to be able to track differences
-            out.material_bundle.reset(mat_collector.CreateBundle());
-            
-            // Create material iterator
-            std::unique_ptr<Iterator> mat_iter(mat_collector.CreateIterator());
-            
-            // Iterate and serialize
-            for (; mat_iter->IsValid(); mat_iter->Next())
+            auto volume = shape->GetVolume();
+            if (volume && volume_indices.emplace(volume, static_cast<int>(volumes.size())).second)
             {
-                WriteMaterial(mat_iter->ItemAs<Material const>(), mat_collector, tex_collector, materials + num_materials_written);
-                ++num_materials_written;
+                volumes.push_back(volume);
             }
+        };
+
+        for (auto& iter : meshes)
+        {
+            add_volume(iter);
         }
-        
-        // Unmap material buffer
-        m_context.UnmapBuffer(0, out.materials, materials);
-    }
-    
-    void ClwSceneController::ReloadIntersector(Scene1 const& scene, ClwScene& inout) const
-    {
-        m_api->DetachAll();
-        
-        for (auto& s : inout.visible_shapes)
+
+        for (auto& iter : instances)
         {
-            m_api->AttachShape(s);
+            add_volume(iter);
         }
-        
-        m_api->Commit();
-    }
-    
-    void ClwSceneController::UpdateTextures(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const
-    {
-        // Get new buffer size
-        std::size_t tex_buffer_size = tex_collector.GetNumItems();
-        std::size_t tex_data_buffer_size = 0;
 
-        if (tex_buffer_size == 0)
+        // Grids might be large, so only upload if anything has changed
+        bool dirty = out.volumes.GetElementCount() == 0 || volumes != out.volume_list;
+        for (auto& volume : volumes)
+        {
+            dirty = dirty || volume->IsDirty();
+        }
+
+        if (!dirty)
         {
-            out.textures = m_context.CreateBuffer<ClwScene::Texture>(1, CL_MEM_READ_ONLY);
-            out.texturedata = m_context.CreateBuffer<char>(1, CL_MEM_READ_ONLY);
             return;
         }
-        
-        // Recreate material buffer if it needs resize
-        if (tex_buffer_size > out.textures.GetElementCount())
+
+        std::size_t num_grids = 0;
+        std::size_t num_brick_indices = 0;
+        std::size_t num_bricks = 0;
+        for (auto& volume : volumes)
         {
-            // Create material buffer
-            out.textures = m_context.CreateBuffer<ClwScene::Texture>(tex_buffer_size, CL_MEM_READ_ONLY);
+            if (auto grid_volume = dynamic_cast<GridVolume const*>(volume))
+            {
+                auto& grid = grid_volume->GetGrid();
+                ++num_grids;
+                num_brick_indices += grid.GetBrickIndices().size();
+                num_bricks += grid.GetNumBricks();
+            }
         }
-        
-        ClwScene::Texture* textures = nullptr;
-        std::size_t num_textures_written = 0;
-        
-        // Map GPU materials buffer
-        m_context.MapBuffer(0, out.textures, CL_MAP_WRITE, &textures).Wait();
-        
-        // Update material bundle first to be able to track differences
-        out.texture_bundle.reset(tex_collector.CreateBundle());
-        
-        // Create material iterator
-        std::unique_ptr<Iterator> tex_iter(tex_collector.CreateIterator());
-        
-        // Iterate and serialize
-        for (; tex_iter->IsValid(); tex_iter->Next())
+
+        // Kernels take these buffers as arguments, so never leave them empty
+        out.volumes = m_context.CreateBuffer<ClwScene::Volume>(std::max<std::size_t>(volumes.size(), 1), CL_MEM_READ_ONLY);
+        out.volume_grids = m_context.CreateBuffer<ClwScene::VolumeGrid>(std::max<std::size_t>(num_grids, 1), CL_MEM_READ_ONLY);
+        out.volume_brick_indices = m_context.CreateBuffer<int>(std::max<std::size_t>(num_brick_indices, 1), CL_MEM_READ_ONLY);
+        out.volume_bricks = m_context.CreateBuffer<float>(std::max<std::size_t>(num_bricks * SparseGrid::kBrickVoxels, 1), CL_MEM_READ_ONLY);
+
+        ClwScene::Volume* volume_data = nullptr;
+        ClwScene::VolumeGrid* grids = nullptr;
+        int* brick_indices = nullptr;
+        float* bricks = nullptr;
+
+        m_context.MapBuffer(0, out.volumes, CL_MAP_WRITE, &volume_data);
+        m_context.MapBuffer(0, out.volume_grids, CL_MAP_WRITE, &grids);
+        m_context.MapBuffer(0, out.volume_brick_indices, CL_MAP_WRITE, &brick_indices);
+        m_context.MapBuffer(0, out.volume_bricks, CL_MAP_WRITE, &bricks).Wait();
+
+        int num_grids_written = 0;
+        std::size_t num_brick_indices_written = 0;
+        std::size_t num_bricks_written = 0;
+        for (std::size_t i = 0; i < volumes.size(); ++i)
         {
-            auto tex = tex_iter->ItemAs<Texture const>();
+            auto volume = volumes[i];
 
-            WriteTexture(tex, tex_data_buffer_size, textures + num_textures_written);
+            ClwScene::Volume& clw_volume = volume_data[i];
+            clw_volume.phase_func = ClwScene::kUniform;
+            clw_volume.extra = 0;
+            clw_volume.sigma_a = volume->GetAbsorption();
+            clw_volume.sigma_s = volume->GetScattering();
+            clw_volume.sigma_e = volume->GetEmission();
 
-            ++num_textures_written;
+            if (auto grid_volume = dynamic_cast<GridVolume const*>(volume))
+            {
+                auto& grid = grid_volume->GetGrid();
+                auto bounds = grid_volume->GetBounds();
+
+                ClwScene::VolumeGrid& clw_grid = grids[num_grids_written];
+                clw_grid.pmin = bounds.pmin;
+                clw_grid.pmax = bounds.pmax;
+                clw_grid.resx = grid.GetResX();
+                clw_grid.resy = grid.GetResY();
+                clw_grid.resz = grid.GetResZ();
+                clw_grid.index_offset = static_cast<int>(num_brick_indices_written);
+                clw_grid.bricksx = grid.GetBricksX();
+                clw_grid.bricksy = grid.GetBricksY();
+                clw_grid.bricksz = grid.GetBricksZ();
+                clw_grid.max_density = grid.GetMaxValue();
+
+                // Bricks of all grids share the same pool, so make indices absolute
+                auto brick_offset = static_cast<int>(num_bricks_written);
+                auto& grid_brick_indices = grid.GetBrickIndices();
+                std::transform(grid_brick_indices.cbegin(), grid_brick_indices.cend(), brick_indices + num_brick_indices_written,
+                    [brick_offset](int idx) { return idx < 0 ? -1 : idx + brick_offset; });
+                num_brick_indices_written += grid_brick_indices.size();
+
+                auto& grid_bricks = grid.GetBricks();
+                std::copy(grid_bricks.cbegin(), grid_bricks.cend(), bricks + num_bricks_written * SparseGrid::kBrickVoxels);
+                num_bricks_written += grid.GetNumBricks();
+
+                clw_volume.type = ClwScene::kHeterogeneous;
+                clw_volume.data = num_grids_written++;
+            }
+            else
+            {
+                clw_volume.type = ClwScene::kHomogeneous;
+                clw_volume.data = -1;
+            }
 
-            tex_data_buffer_size += align16(tex->GetSizeInBytes());
+            volume->SetDirty(false);
         }
 
-        // Unmap material buffer
-        m_context.UnmapBuffer(0, out.textures, textures);
+        m_context.UnmapBuffer(0, out.volumes, volume_data);
+        m_context.UnmapBuffer(0, out.volume_grids, grids);
+        m_context.UnmapBuffer(0, out.volume_brick_indices, brick_indices);
+        m_context.UnmapBuffer(0, out.volume_bricks, bricks).Wait();
 
-        // Recreate material buffer if it needs resize
-        if (tex_data_buffer_size > out.texturedata.GetElementCount())
-        {
-            // Create material buffer
-            out.texturedata = m_context.CreateBuffer<char>(tex_data_buffer_size, CL_MEM_READ_ONLY);
-        }
-        
-        char* data = nullptr;
-        std::size_t num_bytes_written = 0;
-        
-        tex_iter->Reset();
-        
-        // Map GPU materials buffer
-        m_context.MapBuffer(0, out.texturedata, CL_MAP_WRITE, &data).Wait();
-        
-        // Write texture data for all textures
-        for (; tex_iter->IsValid(); tex_iter->Next())
-        {
-            auto tex = tex_iter->ItemAs<Texture const>();
+        out.volume_list = std::move(volumes);
+    }
 
-            WriteTextureData(tex, data + num_bytes_written);
+    void ClwSceneController::UpdateCurrentScene(Scene1 const& scene, ClwScene& out) const
+    {
+        ReloadIntersector(scene, out);
+    }
+    
+    static ClwScene::Bxdf GetMaterialType(Material const* material);
+    static bool GetConstantTextureValue(Texture const* texture, RadeonRays::float4& value);
 
-            num_bytes_written += align16(tex->GetSizeInBytes());
+    static std::size_t GetTexelSize(Texture::Format format)
+    {
+        switch (format)
+        {
+            case Texture::Format::kRgba8: return 4;
+            case Texture::Format::kRgba16: return 8;
+            case Texture::Format::kRgba32: return 16;
         }
 
-        // Unmap material buffer
-        m_context.UnmapBuffer(0, out.texturedata, data);
+        return 4;
     }
-    
-    // Convert Material:: types to ClwScene:: types
-    static ClwScene::Bxdf GetMaterialType(Material const* material)
+
+    // Read count texels starting at idx converted to float RGBA
+    static void LoadTexels(char const* data, Texture::Format format, std::size_t idx, std::size_t count, float* values)
     {
-        // Distinguish between single bxdf materials and compound ones
-        if (auto bxdf = dynamic_cast<SingleBxdf const*>(material))
+        switch (format)
         {
-            switch (bxdf->GetBxdfType())
+            case Texture::Format::kRgba8:
             {
-                case SingleBxdf::BxdfType::kZero: return ClwScene::Bxdf::kZero;
-                case SingleBxdf::BxdfType::kLambert: return ClwScene::Bxdf::kLambert;
-                case SingleBxdf::BxdfType::kEmissive: return ClwScene::Bxdf::kEmissive;
-                case SingleBxdf::BxdfType::kPassthrough: return ClwScene::Bxdf::kPassthrough;
-                case SingleBxdf::BxdfType::kTranslucent: return ClwScene::Bxdf::kTranslucent;
-                case SingleBxdf::BxdfType::kIdealReflect: return ClwScene::Bxdf::kIdealReflect;
-                case SingleBxdf::BxdfType::kIdealRefract: return ClwScene::Bxdf::kIdealRefract;
-                case SingleBxdf::BxdfType::kMicrofacetGGX: return ClwScene::Bxdf::kMicrofacetGGX;
-                case SingleBxdf::BxdfType::kMicrofacetBeckmann: return ClwScene::Bxdf::kMicrofacetBeckmann;
-                case SingleBxdf::BxdfType::kMicrofacetRefractionGGX: return ClwScene::Bxdf::kMicrofacetRefractionGGX;
-                case SingleBxdf::BxdfType::kMicrofacetRefractionBeckmann: return ClwScene::Bxdf::kMicrofacetRefractionBeckmann;
+                auto texels = reinterpret_cast<unsigned char const*>(data) + 4 * idx;
+                for (std::size_t i = 0; i < 4 * count; ++i)
+                {
+                    values[i] = texels[i] / 255.f;
+                }
+                break;
             }
-        }
-        else if (auto mat = dynamic_cast<MultiBxdf const*>(material))
-        {
-            switch (mat->GetType())
+
+            case Texture::Format::kRgba16:
             {
-                case MultiBxdf::Type::kMix: return ClwScene::Bxdf::kMix;
-                case MultiBxdf::Type::kLayered: return ClwScene::Bxdf::kLayered;
-                case MultiBxdf::Type::kFresnelBlend: return ClwScene::Bxdf::kFresnelBlend;
+                HalfToFloat(reinterpret_cast<std::uint16_t const*>(data) + 4 * idx, values, 4 * count);
+                break;
+            }
+
+            case Texture::Format::kRgba32:
+            {
+                auto texels = reinterpret_cast<float const*>(data) + 4 * idx;
+                std::copy(texels, texels + 4 * count, values);
+                break;
             }
         }
-        else if (auto mat = dynamic_cast<DisneyBxdf const*>(material))
-        {
-            return ClwScene::Bxdf::kDisney;
-        }
-        
-        return ClwScene::Bxdf::kZero;
     }
-    
-    void ClwSceneController::WriteMaterial(Material const* material, Collector& mat_collector, Collector& tex_collector, void* data) const
+
+    // Write count float RGBA texels starting at idx converting them to texture format
+    static void StoreTexels(char* data, Texture::Format format, std::size_t idx, std::size_t count, float const* values)
     {
-        auto clw_material = reinterpret_cast<ClwScene::Material*>(data);
-        
-        // Convert material type and sidedness
-        auto type = GetMaterialType(material);
-        
-        clw_material->type = type;
-        clw_material->thin = material->IsThin() ? 1 : 0;
-        
-        switch (type)
+        switch (format)
         {
-            case ClwScene::Bxdf::kZero:
-            clw_material->simple.kx = RadeonRays::float4();
-            break;
-            
-            // We need to convert roughness for the following materials
-            case ClwScene::Bxdf::kMicrofacetGGX:
-            case ClwScene::Bxdf::kMicrofacetBeckmann:
-            case ClwScene::Bxdf::kMicrofacetRefractionGGX:
-            case ClwScene::Bxdf::kMicrofacetRefractionBeckmann:
+            case Texture::Format::kRgba8:
             {
-                Material::InputValue value = material->GetInputValue("roughness");
-                
-                if (value.type == Material::InputType::kFloat4)
+                auto texels = reinterpret_cast<unsigned char*>(data) + 4 * idx;
+                for (std::size_t i = 0; i < 4 * count; ++i)
                 {
-                    clw_material->simple.ns = value.float_value.x;
+                    texels[i] = static_cast<unsigned char>(std::lround(std::min(std::max(values[i], 0.f), 1.f) * 255.f));
+                }
+                break;
+            }
+
+            case Texture::Format::kRgba16:
+            {
+                FloatToHalf(values, reinterpret_cast<std::uint16_t*>(data) + 4 * idx, 4 * count);
+                break;
+            }
+
+            case Texture::Format::kRgba32:
+            {
+                std::copy(values, values + 4 * count, reinterpret_cast<float*>(data) + 4 * idx);
+                break;
+            }
+        }
+    }
+
+    // Read texel converted to float
+    static RadeonRays::float4 LoadTexel(char const* data, Texture::Format format, std::size_t idx)
+    {
+        float v[4];
+        LoadTexels(data, format, idx, 1, v);
+        return RadeonRays::float4(v[0], v[1], v[2], v[3]);
+    }
+
+    // Write float texel converting it to texture format
+    static void StoreTexel(char* data, Texture::Format format, std::size_t idx, RadeonRays::float4 const& value)
+    {
+        float v[4] = { value.x, value.y, value.z, value.w };
+        StoreTexels(data, format, idx, 1, v);
+    }
+
+    // Read a single texel of a texture
+    static RadeonRays::float4 GetTexel(Texture const* texture, int x, int y)
+    {
+        auto idx = static_cast<std::size_t>(y) * texture->GetSize().x + x;
+        return LoadTexel(texture->GetData(), texture->GetFormat(), idx);
+    }
+
+    // Number of mip levels down to 1x1
+    static int GetMipCount(RadeonRays::int2 size)
+    {
+        int count = 1;
+
+        while (size.x > 1 || size.y > 1)
+        {
+            size.x = std::max(size.x / 2, 1);
+            size.y = std::max(size.y / 2, 1);
+            ++count;
+        }
+
+        return count;
+    }
+
+    // Size of texture data with all its mip levels, levels are tightly packed
+    static std::size_t GetMipChainSize(RadeonRays::int2 size, Texture::Format format, int mip_count)
+    {
+        std::size_t num_texels = 0;
+
+        for (int level = 0; level < mip_count; ++level)
+        {
+            num_texels += static_cast<std::size_t>(size.x) * size.y;
+            size.x = std::max(size.x / 2, 1);
+            size.y = std::max(size.y / 2, 1);
+        }
+
+        return num_texels * GetTexelSize(format);
+    }
+
+    // Box filter level 0 texels at data down to the rest of mip levels,
+    // they are written right after the level 0. See Texture_SampleLod in texture.cl.
+    static void GenerateMips(char* data, RadeonRays::int2 size, Texture::Format format, int mip_count)
+    {
+        auto texel_size = GetTexelSize(format);
+
+        for (int level = 1; level < mip_count; ++level)
+        {
+            auto src = data;
+            auto src_size = size;
+
+            data += static_cast<std::size_t>(size.x) * size.y * texel_size;
+            size.x = std::max(size.x / 2, 1);
+            size.y = std::max(size.y / 2, 1);
+
+            // Rows are converted to float in bulk
+            std::vector<float> row0(4 * src_size.x);
+            std::vector<float> row1(4 * src_size.x);
+            std::vector<float> dst_row(4 * size.x);
+
+            for (int y = 0; y < size.y; ++y)
+            {
+                auto y0 = std::min(2 * y, src_size.y - 1);
+                auto y1 = std::min(2 * y + 1, src_size.y - 1);
+
+                LoadTexels(src, format, static_cast<std::size_t>(y0) * src_size.x, src_size.x, &row0[0]);
+                LoadTexels(src, format, static_cast<std::size_t>(y1) * src_size.x, src_size.x, &row1[0]);
+
+                for (int x = 0; x < size.x; ++x)
+                {
+                    auto x0 = std::min(2 * x, src_size.x - 1);
+                    auto x1 = std::min(2 * x + 1, src_size.x - 1);
+
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        dst_row[4 * x + c] = 0.25f * (row0[4 * x0 + c] + row0[4 * x1 + c] +
+                            row1[4 * x0 + c] + row1[4 * x1 + c]);
+                    }
+                }
+
+                StoreTexels(data, format, static_cast<std::size_t>(y) * size.x, size.x, &dst_row[0]);
+            }
+        }
+    }
+
+    // Largest texture atlas image, limited to keep its allocation reasonable
+    static int2 GetTextureAtlasMaxSize(CLWContext const& context)
+    {
+        std::size_t const max_size = 8192;
+        std::size_t width = 0;
+        std::size_t height = 0;
+
+        auto device = context.GetDevice(0).GetID();
+        clGetDeviceInfo(device, CL_DEVICE_IMAGE2D_MAX_WIDTH, sizeof(width), &width, nullptr);
+        clGetDeviceInfo(device, CL_DEVICE_IMAGE2D_MAX_HEIGHT, sizeof(height), &height, nullptr);
+
+        return int2(static_cast<int>(std::min(width, max_size)), static_cast<int>(std::min(height, max_size)));
+    }
+
+    // Collect textures referenced by the materials, these are sampled with ray cone footprints
+    // and need mip levels. Light textures (environment maps) are always sampled at the top level.
+    static std::set<Texture const*> CollectMaterialTextures(Collector& mat_collector)
+    {
+        std::set<Texture const*> textures;
+        std::unique_ptr<Iterator> mat_iter(mat_collector.CreateIterator());
+
+        for (; mat_iter->IsValid(); mat_iter->Next())
+        {
+            auto tex_iter = mat_iter->ItemAs<Material const>()->CreateTextureIterator();
+
+            for (; tex_iter->IsValid(); tex_iter->Next())
+            {
+                textures.insert(tex_iter->ItemAs<Texture const>());
+            }
+        }
+
+        return textures;
+    }
+
+    // Collect constant material textures, their values are folded into material records
+    static std::set<Texture const*> CollectFoldedTextures(Collector& mat_collector)
+    {
+        std::set<Texture const*> textures;
+        RadeonRays::float4 value;
+
+        for (auto tex : CollectMaterialTextures(mat_collector))
+        {
+            if (GetConstantTextureValue(tex, value))
+            {
+                textures.insert(tex);
+            }
+        }
+
+        return textures;
+    }
+
+    // Get bump texture of a material unless it is overridden by a normal map
+    static Texture const* GetBumpMap(Material const* material)
+    {
+        switch (GetMaterialType(material))
+        {
+            case ClwScene::Bxdf::kZero:
+            case ClwScene::Bxdf::kMix:
+            case ClwScene::Bxdf::kLayered:
+            case ClwScene::Bxdf::kFresnelBlend:
+                return nullptr;
+            default:
+                break;
+        }
+
+        auto value = material->GetInputValue("normal");
+
+        if (value.type == Material::InputType::kTexture && value.tex_value)
+        {
+            return nullptr;
+        }
+
+        value = material->GetInputValue("bump");
+        return value.type == Material::InputType::kTexture ? value.tex_value : nullptr;
+    }
+
+    // Collect textures used as bump maps by the materials
+    static std::set<Texture const*> CollectBumpMaps(Collector& mat_collector)
+    {
+        std::set<Texture const*> bump_maps;
+        std::unique_ptr<Iterator> mat_iter(mat_collector.CreateIterator());
+
+        for (; mat_iter->IsValid(); mat_iter->Next())
+        {
+            if (auto bump_map = GetBumpMap(mat_iter->ItemAs<Material const>()))
+            {
+                bump_maps.insert(bump_map);
+            }
+        }
+
+        return bump_maps;
+    }
+
+    // 8 bit heights convert to RGBA8 normals, finer ones keep half precision
+    static Texture::Format GetBumpNormalMapFormat(Texture const* texture)
+    {
+        return texture->GetFormat() == Texture::Format::kRgba8 ? Texture::Format::kRgba8 : Texture::Format::kRgba16;
+    }
+
+    // Convert height texture into tangent space normal map using Sobel filter,
+    // so shading takes a single bilinear fetch instead of 36.
+    void ClwSceneController::ConvertBumpToNormalMap(Texture const* texture, char* data)
+    {
+        auto dim = texture->GetSize();
+        auto format = GetBumpNormalMapFormat(texture);
+
+        std::vector<float> heights(static_cast<std::size_t>(dim.x) * dim.y);
+        for (int y = 0; y < dim.y; ++y)
+        {
+            for (int x = 0; x < dim.x; ++x)
+            {
+                heights[y * dim.x + x] = GetTexel(texture, x, y).x;
+            }
+        }
+
+        auto height = [&heights, &dim](int x, int y)
+        {
+            x = std::min(std::max(x, 0), dim.x - 1);
+            y = std::min(std::max(y, 0), dim.y - 1);
+            return heights[y * dim.x + x];
+        };
+
+        for (int y = 0; y < dim.y; ++y)
+        {
+            for (int x = 0; x < dim.x; ++x)
+            {
+                auto gx = height(x - 1, y - 1) - height(x + 1, y - 1) +
+                    2.f * height(x - 1, y) - 2.f * height(x + 1, y) +
+                    height(x - 1, y + 1) - height(x + 1, y + 1);
+                auto gy = height(x - 1, y - 1) + 2.f * height(x, y - 1) + height(x + 1, y - 1) -
+                    height(x - 1, y + 1) - 2.f * height(x, y + 1) - height(x + 1, y + 1);
+
+                auto n = normalize(float3(gx, gy, 1.f));
+
+                StoreTexel(data, format, y * dim.x + x, RadeonRays::float4(0.5f * n.x + 0.5f, 0.5f * n.y + 0.5f, 0.5f * n.z + 0.5f, 1.f));
+            }
+        }
+    }
+
+    void ClwSceneController::UpdateMaterials(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const
+    {
+        static_assert(sizeof(ClwScene::Material) % sizeof(ClwScene::MaterialOp) == 0, "Material ops should pack into material records");
+        std::size_t const ops_per_material = sizeof(ClwScene::Material) / sizeof(ClwScene::MaterialOp);
+
+        // Serialize materials, identical ones share a single record
+        std::size_t num_materials = mat_collector.GetNumItems();
+        std::vector<ClwScene::Material> records;
+        std::vector<int> slots(num_materials, -1);
+        std::unordered_map<std::string, int> record_cache;
+
+        {
+            // Update material bundle first to be able to track differences
+            out.material_bundle.reset(mat_collector.CreateBundle());
+
+            std::unique_ptr<Iterator> mat_iter(mat_collector.CreateIterator());
+
+            for (; mat_iter->IsValid(); mat_iter->Next())
+            {
+                WriteMaterialRecord(mat_iter->ItemAs<Material const>(), mat_collector, tex_collector, records, slots, record_cache);
+            }
+        }
+
+        // Compile compound materials, ops are placed after material records
+        std::vector<ClwScene::MaterialOp> ops;
+        std::vector<bool> compiled(records.size(), false);
+
+        {
+            std::unique_ptr<Iterator> mat_iter(mat_collector.CreateIterator());
+
+            for (std::size_t i = 0; mat_iter->IsValid(); mat_iter->Next(), ++i)
+            {
+                auto& record = records[slots[i]];
+
+                if ((record.type == ClwScene::Bxdf::kMix || record.type == ClwScene::Bxdf::kFresnelBlend) && !compiled[slots[i]])
+                {
+                    record.compound.program = static_cast<int>(records.size() * ops_per_material + ops.size());
+                    CompileMaterial(mat_iter->ItemAs<Material const>(), mat_collector, tex_collector, slots, ops);
+                    compiled[slots[i]] = true;
+                }
+            }
+        }
+
+        // Get new buffer size
+        std::size_t mat_buffer_size = records.size() + (ops.size() + ops_per_material - 1) / ops_per_material;
+        
+        // Recreate material buffer if it needs resize
+        if (mat_buffer_size > out.materials.GetElementCount())
+        {
+            // Create material buffer
+            out.materials = m_context.CreateBuffer<ClwScene::Material>(mat_buffer_size, CL_MEM_READ_ONLY);
+        }
+        
+        ClwScene::Material* materials = nullptr;
+        
+        // Map GPU materials buffer
+        m_context.MapBuffer(0, out.materials, CL_MAP_WRITE, &materials).Wait();
+
+        std::copy(records.cbegin(), records.cend(), materials);
+        std::copy(ops.cbegin(), ops.cend(), reinterpret_cast<ClwScene::MaterialOp*>(materials + records.size()));
+        
+        // Unmap material buffer
+        m_context.UnmapBuffer(0, out.materials, materials);
+
+        // Material IDs of shapes reference records, so rewrite them if merging has changed
+        bool slots_changed = false;
+        for (std::size_t i = 0; i < num_materials; ++i)
+        {
+            slots_changed = slots_changed || slots[i] != GetMaterialRecord(out, static_cast<std::uint32_t>(i));
+        }
+
+        out.material_slots = std::move(slots);
+
+        // Remember folded textures to rewrite the records once they change
+        out.folded_textures = CollectFoldedTextures(mat_collector);
+
+        if (slots_changed)
+        {
+            UpdateShapeProperties(scene, mat_collector, tex_collector, out);
+        }
+
+        // Bump maps are uploaded converted to normal maps,
+        // so textures need to be rewritten if materials use other ones now
+        if (out.texture_bundle && CollectBumpMaps(mat_collector) != out.bump_maps)
+        {
+            UpdateTextures(scene, mat_collector, tex_collector, out);
+        }
+    }
+
+    int ClwSceneController::WriteMaterialRecord(Material const* material, Collector& mat_collector, Collector& tex_collector,
+        std::vector<ClwScene::Material>& records, std::vector<int>& slots, std::unordered_map<std::string, int>& record_cache) const
+    {
+        auto idx = mat_collector.GetItemIndex(material);
+
+        if (slots[idx] >= 0)
+        {
+            return slots[idx];
+        }
+
+        // Unused fields are zeroed to make records comparable
+        alignas(ClwScene::Material) char data[sizeof(ClwScene::Material)] = {};
+        auto record = reinterpret_cast<ClwScene::Material*>(data);
+        WriteMaterial(material, mat_collector, tex_collector, record);
+
+        // Compound materials are identical if they reference identical records
+        if (record->type == ClwScene::Bxdf::kMix || record->type == ClwScene::Bxdf::kFresnelBlend)
+        {
+            record->compound.top_brdf_idx = WriteMaterialRecord(material->GetInputValue("top_material").mat_value, mat_collector, tex_collector, records, slots, record_cache);
+            record->compound.base_brdf_idx = WriteMaterialRecord(material->GetInputValue("base_material").mat_value, mat_collector, tex_collector, records, slots, record_cache);
+        }
+
+        std::string key(data, sizeof(data));
+        auto iter = record_cache.find(key);
+
+        if (iter == record_cache.cend())
+        {
+            iter = record_cache.emplace(std::move(key), static_cast<int>(records.size())).first;
+            records.push_back(*record);
+        }
+
+        slots[idx] = iter->second;
+        return iter->second;
+    }
+    
+    void ClwSceneController::ReloadIntersector(Scene1 const& scene, ClwScene& inout) const
+    {
+        m_api->DetachAll();
+        
+        for (auto& s : inout.visible_shapes)
+        {
+            m_api->AttachShape(s);
+        }
+        
+        m_api->Commit();
+    }
+    
+    void ClwSceneController::UpdateTextures(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const
+    {
+        // BxDF lookup tables are placed at the beginning of texture data,
+        // so they are accessible by the kernels without separate arguments
+        auto const& bxdf_lut = GetBxdfLut();
+        std::size_t bxdf_lut_size = align16(bxdf_lut.size() * sizeof(RadeonRays::float3));
+
+        // Bump maps get an additional normal map record
+        // placed at the texture index offset by the number of textures
+        out.bump_maps = CollectBumpMaps(mat_collector);
+
+        // Material textures are sampled at ray cone footprints, so they get mip levels
+        auto material_textures = CollectMaterialTextures(mat_collector);
+
+        // Values of folded textures are baked into material records, so they are stale now
+        bool folded_changed = std::any_of(material_textures.cbegin(), material_textures.cend(), [&out](Texture const* tex)
+        {
+            return tex->IsDirty() && out.folded_textures.find(tex) != out.folded_textures.cend();
+        });
+
+        if (folded_changed)
+        {
+            UpdateMaterials(scene, mat_collector, tex_collector, out);
+        }
+
+        auto get_mip_count = [&material_textures](Texture const* tex)
+        {
+            return material_textures.find(tex) != material_textures.cend() ? GetMipCount(tex->GetSize()) : 1;
+        };
+
+        // RGBA8 textures are placed to the atlas image if the device supports images,
+        // the rest of textures and those not fitting into the atlas stay in texture data
+        std::map<Texture const*, int2> atlas_regions;
+        auto has_texture_atlas = HasTextureAtlas(m_context);
+        auto atlas_max_size = has_texture_atlas ? GetTextureAtlasMaxSize(m_context) : int2(0, 0);
+        TextureAtlas atlas(atlas_max_size.x, atlas_max_size.y);
+
+        if (has_texture_atlas)
+        {
+            std::vector<Texture const*> atlas_textures;
+            std::unique_ptr<Iterator> tex_iter(tex_collector.CreateIterator());
+
+            for (; tex_iter->IsValid(); tex_iter->Next())
+            {
+                auto tex = tex_iter->ItemAs<Texture const>();
+
+                if (tex->GetFormat() == Texture::Format::kRgba8)
+                {
+                    atlas_textures.push_back(tex);
+                }
+            }
+
+            // Taller textures first, so shelves are filled tightly
+            std::stable_sort(atlas_textures.begin(), atlas_textures.end(), [](Texture const* lhs, Texture const* rhs)
+            {
+                return lhs->GetSize().y > rhs->GetSize().y;
+            });
+
+            for (auto tex : atlas_textures)
+            {
+                int2 origin;
+
+                if (atlas.Add(tex->GetSize(), get_mip_count(tex), origin))
+                {
+                    atlas_regions.emplace(tex, origin);
+                }
+            }
+        }
+
+        auto get_data_size = [&get_mip_count, &atlas_regions](Texture const* tex) -> std::size_t
+        {
+            if (atlas_regions.find(tex) != atlas_regions.cend())
+            {
+                return 0;
+            }
+
+            auto mip_count = get_mip_count(tex);
+            return mip_count > 1 ? GetMipChainSize(tex->GetSize(), tex->GetFormat(), mip_count) : tex->GetSizeInBytes();
+        };
+
+        // Get new buffer size
+        std::size_t num_textures = tex_collector.GetNumItems();
+        std::size_t tex_buffer_size = out.bump_maps.empty() ? num_textures : 2 * num_textures;
+        std::size_t tex_data_buffer_size = bxdf_lut_size;
+
+        if (num_textures == 0)
+        {
+            out.textures = m_context.CreateBuffer<ClwScene::Texture>(1, CL_MEM_READ_ONLY);
+            out.texturedata = m_context.CreateBuffer<char>(bxdf_lut_size, CL_MEM_READ_ONLY, (void*)&bxdf_lut[0]);
+            WriteTextureAtlas(int2(1, 1), nullptr, out);
+            return;
+        }
+        
+        // Recreate material buffer if it needs resize
+        if (tex_buffer_size > out.textures.GetElementCount())
+        {
+            // Create material buffer
+            out.textures = m_context.CreateBuffer<ClwScene::Texture>(tex_buffer_size, CL_MEM_READ_ONLY);
+        }
+        
+        ClwScene::Texture* textures = nullptr;
+        std::size_t num_textures_written = 0;
+        
+        // Map GPU materials buffer
+        m_context.MapBuffer(0, out.textures, CL_MAP_WRITE, &textures).Wait();
+        
+        // Update material bundle first to be able to track differences
+        out.texture_bundle.reset(tex_collector.CreateBundle());
+        
+        // Create material iterator
+        std::unique_ptr<Iterator> tex_iter(tex_collector.CreateIterator());
+        
+        // Iterate and serialize
+        for (; tex_iter->IsValid(); tex_iter->Next())
+        {
+            auto tex = tex_iter->ItemAs<Texture const>();
+
+            WriteTexture(tex, tex_data_buffer_size, get_mip_count(tex), textures + num_textures_written);
+
+            auto region = atlas_regions.find(tex);
+
+            if (region != atlas_regions.cend())
+            {
+                textures[num_textures_written].atlasx = region->second.x;
+                textures[num_textures_written].atlasy = region->second.y;
+            }
+
+            ++num_textures_written;
+
+            tex_data_buffer_size += align16(get_data_size(tex));
+        }
+
+        // Converted normal maps follow regular texture data
+        if (!out.bump_maps.empty())
+        {
+            std::copy(textures, textures + num_textures, textures + num_textures);
+
+            for (auto tex : out.bump_maps)
+            {
+                auto clw_texture = textures + num_textures + tex_collector.GetItemIndex(tex);
+                auto format = GetBumpNormalMapFormat(tex);
+                clw_texture->fmt = format == Texture::Format::kRgba8 ? ClwScene::TextureFormat::RGBA8 : ClwScene::TextureFormat::RGBA16;
+                clw_texture->dataoffset = static_cast<int>(tex_data_buffer_size);
+                clw_texture->mipcount = GetMipCount(tex->GetSize());
+                clw_texture->atlasx = -1;
+                clw_texture->atlasy = -1;
+
+                tex_data_buffer_size += align16(GetMipChainSize(tex->GetSize(), format, clw_texture->mipcount));
+            }
+        }
+
+        // Unmap material buffer
+        m_context.UnmapBuffer(0, out.textures, textures);
+
+        // Recreate material buffer if it needs resize
+        if (tex_data_buffer_size > out.texturedata.GetElementCount())
+        {
+            // Create material buffer
+            out.texturedata = m_context.CreateBuffer<char>(tex_data_buffer_size, CL_MEM_READ_ONLY);
+        }
+        
+        char* data = nullptr;
+        std::size_t num_bytes_written = 0;
+        
+        tex_iter->Reset();
+        
+        // Map GPU materials buffer
+        m_context.MapBuffer(0, out.texturedata, CL_MAP_WRITE, &data).Wait();
+
+        // Write lookup tables
+        std::copy(bxdf_lut.cbegin(), bxdf_lut.cend(), reinterpret_cast<RadeonRays::float3*>(data));
+        num_bytes_written += bxdf_lut_size;
+        
+        auto atlas_size = atlas.GetSize();
+        std::vector<std::uint8_t> atlas_data(4 * static_cast<std::size_t>(atlas_size.x) * atlas_size.y);
+        std::vector<char> mip_chain;
+
+        // Environment SH is projected again from the new data below
+        if (out.envmap_texture && out.envmap_texture->IsDirty())
+        {
+            out.envmap_sh_texture = nullptr;
+        }
+
+        // Write texture data for all textures
+        for (; tex_iter->IsValid(); tex_iter->Next())
+        {
+            auto tex = tex_iter->ItemAs<Texture const>();
+            auto region = atlas_regions.find(tex);
+
+            if (region != atlas_regions.cend())
+            {
+                auto mip_count = get_mip_count(tex);
+                mip_chain.resize(GetMipChainSize(tex->GetSize(), tex->GetFormat(), mip_count));
+
+                WriteTextureData(tex, &mip_chain[0]);
+                GenerateMips(&mip_chain[0], tex->GetSize(), tex->GetFormat(), mip_count);
+                TextureAtlas::WriteMipChain(reinterpret_cast<std::uint8_t const*>(&mip_chain[0]), tex->GetSize(), mip_count,
+                    tex->GetWrapMode(), region->second, &atlas_data[0], atlas_size.x);
+            }
+            else
+            {
+                WriteTextureData(tex, data + num_bytes_written);
+                GenerateMips(data + num_bytes_written, tex->GetSize(), tex->GetFormat(), get_mip_count(tex));
+
+                num_bytes_written += align16(get_data_size(tex));
+            }
+
+            // Texture is on the device now
+            tex->SetDirty(false);
+        }
+
+        for (auto tex : out.bump_maps)
+        {
+            auto mip_count = GetMipCount(tex->GetSize());
+            auto format = GetBumpNormalMapFormat(tex);
+
+            ConvertBumpToNormalMap(tex, data + num_bytes_written);
+            GenerateMips(data + num_bytes_written, tex->GetSize(), format, mip_count);
+
+            num_bytes_written += align16(GetMipChainSize(tex->GetSize(), format, mip_count));
+        }
+
+        // Unmap material buffer
+        m_context.UnmapBuffer(0, out.texturedata, data);
+
+        WriteTextureAtlas(atlas_size, atlas_data.empty() ? nullptr : &atlas_data[0], out);
+
+        UpdateEnvironmentSh(tex_collector, out);
+    }
+
+    void ClwSceneController::WriteTextureAtlas(int2 size, std::uint8_t const* data, ClwScene& out) const
+    {
+        if (!HasTextureAtlas(m_context))
+        {
+            return;
+        }
+
+        // Kernels need a valid image even if no texture is placed there
+        size = int2(std::max(size.x, 1), std::max(size.y, 1));
+
+        cl_image_format format = { CL_RGBA, CL_UNORM_INT8 };
+        out.texture_atlas = CLWImage2D::Create(m_context, &format, size.x, size.y, 0);
+
+        if (data)
+        {
+            std::size_t origin[3] = { 0, 0, 0 };
+            std::size_t region[3] = { static_cast<std::size_t>(size.x), static_cast<std::size_t>(size.y), 1 };
+            clEnqueueWriteImage(m_context.GetCommandQueue(0), out.texture_atlas, CL_TRUE, origin, region, 0, 0, data, 0, nullptr, nullptr);
+        }
+    }
+    
+    // Convert Material:: types to ClwScene:: types
+    static ClwScene::Bxdf GetMaterialType(Material const* material)
+    {
+        // Distinguish between single bxdf materials and compound ones
+        if (auto bxdf = dynamic_cast<SingleBxdf const*>(material))
+        {
+            switch (bxdf->GetBxdfType())
+            {
+                case SingleBxdf::BxdfType::kZero: return ClwScene::Bxdf::kZero;
+                case SingleBxdf::BxdfType::kLambert: return ClwScene::Bxdf::kLambert;
+                case SingleBxdf::BxdfType::kEmissive: return ClwScene::Bxdf::kEmissive;
+                case SingleBxdf::BxdfType::kPassthrough: return ClwScene::Bxdf::kPassthrough;
+                case SingleBxdf::BxdfType::kTranslucent: return ClwScene::Bxdf::kTranslucent;
+                case SingleBxdf::BxdfType::kIdealReflect: return ClwScene::Bxdf::kIdealReflect;
+                case SingleBxdf::BxdfType::kIdealRefract: return ClwScene::Bxdf::kIdealRefract;
+                case SingleBxdf::BxdfType::kMicrofacetGGX: return ClwScene::Bxdf::kMicrofacetGGX;
+                case SingleBxdf::BxdfType::kMicrofacetBeckmann: return ClwScene::Bxdf::kMicrofacetBeckmann;
+                case SingleBxdf::BxdfType::kMicrofacetRefractionGGX: return ClwScene::Bxdf::kMicrofacetRefractionGGX;
+                case SingleBxdf::BxdfType::kMicrofacetRefractionBeckmann: return ClwScene::Bxdf::kMicrofacetRefractionBeckmann;
+            }
+        }
+        else if (auto mat = dynamic_cast<MultiBxdf const*>(material))
+        {
+            switch (mat->GetType())
+            {
+                case MultiBxdf::Type::kMix: return ClwScene::Bxdf::kMix;
+                case MultiBxdf::Type::kLayered: return ClwScene::Bxdf::kLayered;
+                case MultiBxdf::Type::kFresnelBlend: return ClwScene::Bxdf::kFresnelBlend;
+            }
+        }
+        else if (auto mat = dynamic_cast<DisneyBxdf const*>(material))
+        {
+            return ClwScene::Bxdf::kDisney;
+        }
+        
+        return ClwScene::Bxdf::kZero;
+    }
+    
+    // Get value of a texture which is constant over the surface (1x1 texture)
+    static bool GetConstantTextureValue(Texture const* texture, RadeonRays::float4& value)
+    {
+        // Border is black, so clamped textures are not constant
+        if (!texture || texture->GetSize().x != 1 || texture->GetSize().y != 1 ||
+            texture->GetWrapMode() == Texture::WrapMode::kClampToBorder)
+        {
+            return false;
+        }
+
+        value = GetTexel(texture, 0, 0);
+        return true;
+    }
+
+    // Replace constant texture input with its value, so kernels do not fetch it.
+    // Color textures are gamma corrected when sampled, so do the same for them.
+    static Material::InputValue FoldInputValue(Material::InputValue value, bool color = false)
+    {
+        RadeonRays::float4 constant;
+
+        if (value.type == Material::InputType::kTexture && GetConstantTextureValue(value.tex_value, constant))
+        {
+            if (color)
+            {
+                constant = RadeonRays::float4(std::pow(constant.x, 2.2f), std::pow(constant.y, 2.2f), std::pow(constant.z, 2.2f), std::pow(constant.w, 2.2f));
+            }
+
+            value.type = Material::InputType::kFloat4;
+            value.float_value = constant;
+        }
+
+        return value;
+    }
+
+    // Accumulate BxDFs reachable from material through mixes with constant weights
+    static void CollectConstantMixLobes(Material const* material, float probability, std::vector<std::pair<Material const*, float>>& lobes)
+    {
+        if (GetMaterialType(material) == ClwScene::Bxdf::kMix)
+        {
+            Material::InputValue weight = FoldInputValue(material->GetInputValue("weight"));
+
+            if (weight.type == Material::InputType::kFloat4)
+            {
+                // Top is taken with probability of weight
+                float w = std::min(std::max(weight.float_value.x, 0.f), 1.f);
+                CollectConstantMixLobes(material->GetInputValue("top_material").mat_value, probability * w, lobes);
+                CollectConstantMixLobes(material->GetInputValue("base_material").mat_value, probability * (1.f - w), lobes);
+                return;
+            }
+        }
+
+        if (probability > 0.f)
+        {
+            lobes.emplace_back(material, probability);
+        }
+    }
+
+    void ClwSceneController::CompileMaterial(Material const* material, Collector& mat_collector, Collector& tex_collector, std::vector<int> const& slots, std::vector<ClwScene::MaterialOp>& ops)
+    {
+        auto type = GetMaterialType(material);
+        auto op_idx = ops.size();
+
+        ClwScene::MaterialOp op;
+        op.type = ClwScene::kMaterialOpBxdf;
+        op.arg = slots[mat_collector.GetItemIndex(material)];
+        op.weight = 0.f;
+        op.weight_map_idx = -1;
+
+        if (type == ClwScene::Bxdf::kMix)
+        {
+            Material::InputValue weight = FoldInputValue(material->GetInputValue("weight"));
+
+            // Fold trees of constant mixes into a single choice among their lobes
+            if (weight.type == Material::InputType::kFloat4)
+            {
+                std::vector<std::pair<Material const*, float>> lobes;
+                CollectConstantMixLobes(material, 1.f, lobes);
+
+                op.type = ClwScene::kMaterialOpSelect;
+                op.arg = static_cast<int>(lobes.size());
+                ops.push_back(op);
+                ops.resize(ops.size() + lobes.size());
+
+                float cdf = 0.f;
+                for (std::size_t i = 0; i < lobes.size(); ++i)
+                {
+                    auto entry_idx = op_idx + 1 + i;
+                    auto lobe_type = GetMaterialType(lobes[i].first);
+                    cdf += lobes[i].second;
+
+                    ClwScene::MaterialOp entry;
+                    entry.weight = i + 1 < lobes.size() ? cdf : 1.f;
+                    entry.weight_map_idx = -1;
+
+                    if (lobe_type == ClwScene::Bxdf::kMix || lobe_type == ClwScene::Bxdf::kFresnelBlend)
+                    {
+                        entry.type = ClwScene::kMaterialOpJump;
+                        entry.arg = static_cast<int>(ops.size() - entry_idx);
+                        ops[entry_idx] = entry;
+                        CompileMaterial(lobes[i].first, mat_collector, tex_collector, slots, ops);
+                    }
+                    else
+                    {
+                        entry.type = ClwScene::kMaterialOpBxdf;
+                        entry.arg = slots[mat_collector.GetItemIndex(lobes[i].first)];
+                        ops[entry_idx] = entry;
+                    }
+                }
+
+                return;
+            }
+
+            op.type = ClwScene::kMaterialOpMix;
+            op.weight_map_idx = weight.type == Material::InputType::kTexture ? tex_collector.GetItemIndex(weight.tex_value) : -1;
+        }
+        else if (type == ClwScene::Bxdf::kFresnelBlend)
+        {
+            auto top = material->GetInputValue("top_material").mat_value;
+            auto top_type = GetMaterialType(top);
+
+            // Fresnel weight is looked up against roughness of the top layer
+            op.type = top_type == ClwScene::Bxdf::kMicrofacetBeckmann ? ClwScene::kMaterialOpFresnelBlendBeckmann : ClwScene::kMaterialOpFresnelBlend;
+            op.weight = material->GetInputValue("ior").float_value.x;
+            op.roughness = 0.f;
+
+            if (top_type == ClwScene::Bxdf::kMicrofacetGGX || top_type == ClwScene::Bxdf::kMicrofacetBeckmann)
+            {
+                // Textured roughness is marked negative, kernel samples it from the top record
+                // which immediately follows the op
+                Material::InputValue roughness = FoldInputValue(top->GetInputValue("roughness"));
+                op.roughness = roughness.type == Material::InputType::kFloat4 ? roughness.float_value.x : -1.f;
+            }
+        }
+        else
+        {
+            ops.push_back(op);
+            return;
+        }
+
+        // Top branch follows the op, base one is referenced by offset
+        ops.push_back(op);
+        CompileMaterial(material->GetInputValue("top_material").mat_value, mat_collector, tex_collector, slots, ops);
+        ops[op_idx].arg = static_cast<int>(ops.size() - op_idx);
+        CompileMaterial(material->GetInputValue("base_material").mat_value, mat_collector, tex_collector, slots, ops);
+    }
+
+    void ClwSceneController::WriteMaterial(Material const* material, Collector& mat_collector, Collector& tex_collector, void* data) const
+    {
+        auto clw_material = reinterpret_cast<ClwScene::Material*>(data);
+        
+        // Convert material type and sidedness
+        auto type = GetMaterialType(material);
+        
+        clw_material->type = type;
+        clw_material->thin = material->IsThin() ? 1 : 0;
+        
+        switch (type)
+        {
+            case ClwScene::Bxdf::kZero:
+            clw_material->simple.kx = RadeonRays::float4();
+            break;
+            
+            // We need to convert roughness for the following materials
+            case ClwScene::Bxdf::kMicrofacetGGX:
+            case ClwScene::Bxdf::kMicrofacetBeckmann:
+            case ClwScene::Bxdf::kMicrofacetRefractionGGX:
+            case ClwScene::Bxdf::kMicrofacetRefractionBeckmann:
+            {
+                Material::InputValue value = FoldInputValue(material->GetInputValue("roughness"));
+                
+                if (value.type == Material::InputType::kFloat4)
+                {
+                    clw_material->simple.ns = value.float_value.x;
                     clw_material->simple.nsmapidx = -1;
                 }
                 else if (value.type == Material::InputType::kTexture)
@@ -978,7 +2010,7 @@ namespace Baikal
             case ClwScene::Bxdf::kIdealRefract:
             case ClwScene::Bxdf::kIdealReflect:
             {
-                Material::InputValue value = material->GetInputValue("albedo");
+                Material::InputValue value = FoldInputValue(material->GetInputValue("albedo"), true);
                 
                 if (value.type == Material::InputType::kFloat4)
                 {
@@ -1000,7 +2032,6 @@ namespace Baikal
                 if (value.type == Material::InputType::kTexture && value.tex_value)
                 {
                     clw_material->nmapidx = tex_collector.GetItemIndex(value.tex_value);
-                    clw_material->bump_flag = 0;
                 }
                 else
                 {
@@ -1008,14 +2039,14 @@ namespace Baikal
                     
                     if (value.type == Material::InputType::kTexture && value.tex_value)
                     {
-                        clw_material->nmapidx = tex_collector.GetItemIndex(value.tex_value);
-                        clw_material->bump_flag = 1;
-                    }
+                        // Bump maps are converted to normal maps on upload,
+                        // converted ones are placed after the regular textures
+                        clw_material->nmapidx = static_cast<int>(tex_collector.GetNumItems() + tex_collector.GetItemIndex(value.tex_value));
+                        }
                     else
                     {
                         clw_material->nmapidx = -1;
-                        clw_material->bump_flag = 0;
-                    }
+                        }
                 }
                 
                 value = material->GetInputValue("fresnel");
@@ -1040,7 +2071,7 @@ namespace Baikal
                     clw_material->simple.ni = 1.f;
                 }
                 
-                value = material->GetInputValue("roughness");
+                value = FoldInputValue(material->GetInputValue("roughness"));
                 
                 if (value.type == Material::InputType::kFloat4)
                 {
@@ -1078,7 +2109,7 @@ namespace Baikal
                 {
                     clw_material->simple.fresnel = 0.f;
                     
-                    Material::InputValue value = material->GetInputValue("weight");
+                    Material::InputValue value = FoldInputValue(material->GetInputValue("weight"));
                     
                     if (value.type == Material::InputType::kTexture)
                     {
@@ -1112,7 +2143,7 @@ namespace Baikal
             
             case ClwScene::Bxdf::kDisney:
             {
-                Material::InputValue value = material->GetInputValue("albedo");
+                Material::InputValue value = FoldInputValue(material->GetInputValue("albedo"), true);
                 
                 if (value.type == Material::InputType::kFloat4)
                 {
@@ -1129,7 +2160,7 @@ namespace Baikal
                     assert(false);
                 }
                 
-                value = material->GetInputValue("metallic");
+                value = FoldInputValue(material->GetInputValue("metallic"));
                 if (value.type == Material::InputType::kFloat4)
                 {
                     clw_material->disney.metallic = value.float_value.x;
@@ -1145,7 +2176,7 @@ namespace Baikal
                     assert(false);
                 }
                 
-                value = material->GetInputValue("subsurface");
+                value = FoldInputValue(material->GetInputValue("subsurface"));
                 if (value.type == Material::InputType::kFloat4)
                 {
                     clw_material->disney.subsurface = value.float_value.x;
@@ -1156,7 +2187,7 @@ namespace Baikal
                     assert(false);
                 }
                 
-                value = material->GetInputValue("specular");
+                value = FoldInputValue(material->GetInputValue("specular"));
                 if (value.type == Material::InputType::kFloat4)
                 {
                     clw_material->disney.specular = value.float_value.x;
@@ -1172,7 +2203,7 @@ namespace Baikal
                     assert(false);
                 }
                 
-                value = material->GetInputValue("specular_tint");
+                value = FoldInputValue(material->GetInputValue("specular_tint"));
                 if (value.type == Material::InputType::kFloat4)
                 {
                     clw_material->disney.specular_tint = value.float_value.x;
@@ -1188,7 +2219,7 @@ namespace Baikal
                     assert(false);
                 }
                 
-                value = material->GetInputValue("anisotropy");
+                value = FoldInputValue(material->GetInputValue("anisotropy"));
                 if (value.type == Material::InputType::kFloat4)
                 {
                     clw_material->disney.anisotropy = value.float_value.x;
@@ -1204,7 +2235,7 @@ namespace Baikal
                     assert(false);
                 }
                 
-                value = material->GetInputValue("sheen");
+                value = FoldInputValue(material->GetInputValue("sheen"));
                 if (value.type == Material::InputType::kFloat4)
                 {
                     clw_material->disney.sheen = value.float_value.x;
@@ -1220,7 +2251,7 @@ namespace Baikal
                     assert(false);
                 }
                 
-                value = material->GetInputValue("sheen_tint");
+                value = FoldInputValue(material->GetInputValue("sheen_tint"));
                 if (value.type == Material::InputType::kFloat4)
                 {
                     clw_material->disney.sheen_tint = value.float_value.x;
@@ -1236,7 +2267,7 @@ namespace Baikal
                     assert(false);
                 }
                 
-                value = material->GetInputValue("clearcoat");
+                value = FoldInputValue(material->GetInputValue("clearcoat"));
                 if (value.type == Material::InputType::kFloat4)
                 {
                     clw_material->disney.clearcoat = value.float_value.x;
@@ -1252,7 +2283,7 @@ namespace Baikal
                     assert(false);
                 }
                 
-                value = material->GetInputValue("clearcoat_gloss");
+                value = FoldInputValue(material->GetInputValue("clearcoat_gloss"));
                 if (value.type == Material::InputType::kFloat4)
                 {
                     clw_material->disney.clearcoat_gloss = value.float_value.x;
@@ -1268,7 +2299,7 @@ namespace Baikal
                     assert(false);
                 }
                 
-                value = material->GetInputValue("roughness");
+                value = FoldInputValue(material->GetInputValue("roughness"));
                 if (value.type == Material::InputType::kFloat4)
                 {
                     clw_material->disney.roughness = value.float_value.x;
@@ -1289,7 +2320,6 @@ namespace Baikal
                 if (value.type == Material::InputType::kTexture && value.tex_value)
                 {
                     clw_material->nmapidx = tex_collector.GetItemIndex(value.tex_value);
-                    clw_material->bump_flag = 0;
                 }
                 else
                 {
@@ -1297,14 +2327,14 @@ namespace Baikal
                     
                     if (value.type == Material::InputType::kTexture && value.tex_value)
                     {
-                        clw_material->nmapidx = tex_collector.GetItemIndex(value.tex_value);
-                        clw_material->bump_flag = 1;
-                    }
+                        // Bump maps are converted to normal maps on upload,
+                        // converted ones are placed after the regular textures
+                        clw_material->nmapidx = static_cast<int>(tex_collector.GetNumItems() + tex_collector.GetItemIndex(value.tex_value));
+                        }
                     else
                     {
                         clw_material->nmapidx = -1;
-                        clw_material->bump_flag = 0;
-                    }
+                        }
                 }
                 
                 // Intentionally missing break here
@@ -1412,18 +2442,113 @@ namespace Baikal
         }
     }
 
+    // Number of SH terms used for environment irradiance (bands 0..2)
+    static int const kNumEnvironmentShTerms = 9;
+
+    // Environment maps with at least this many texels are projected to SH on the device
+    static std::size_t const kDeviceShProjectionTexels = 1 << 20;
+
+    // Project lat-long texture to SH and convolve with cosine lobe to get irradiance coefficients
+    static void ComputeEnvironmentShIrradiance(Texture const* texture, float3* coeffs)
+    {
+        auto size = texture->GetSize();
+        auto num_texels = static_cast<std::size_t>(size.x) * size.y;
+
+        // Convert texels to float
+        std::vector<float3> texels(num_texels);
+
+        switch (texture->GetFormat())
+        {
+            case Texture::Format::kRgba8:
+            {
+                auto data = reinterpret_cast<std::uint8_t const*>(texture->GetData());
+                for (std::size_t i = 0; i < num_texels; ++i)
+                {
+                    texels[i] = float3(data[4 * i] / 255.f, data[4 * i + 1] / 255.f, data[4 * i + 2] / 255.f);
+                }
+                break;
+            }
+            case Texture::Format::kRgba16:
+            {
+                auto data = reinterpret_cast<std::uint16_t const*>(texture->GetData());
+                std::vector<float> row(4 * size.x);
+                for (int y = 0; y < size.y; ++y)
+                {
+                    auto offset = static_cast<std::size_t>(y) * size.x;
+                    HalfToFloat(data + 4 * offset, &row[0], 4 * size.x);
+                    for (int x = 0; x < size.x; ++x)
+                    {
+                        texels[offset + x] = float3(row[4 * x], row[4 * x + 1], row[4 * x + 2]);
+                    }
+                }
+                break;
+            }
+            case Texture::Format::kRgba32:
+            {
+                auto data = reinterpret_cast<float const*>(texture->GetData());
+                for (std::size_t i = 0; i < num_texels; ++i)
+                {
+                    texels[i] = float3(data[4 * i], data[4 * i + 1], data[4 * i + 2]);
+                }
+                break;
+            }
+        }
+
+        std::array<float3, kNumEnvironmentShTerms> radiance;
+        ShProjectEnvironmentMap(&texels[0], size.x, size.y, 2, &radiance[0]);
+        ShConvolveCosTheta(2, &radiance[0], coeffs);
+    }
+
+    void ClwSceneController::UpdateEnvironmentSh(Collector& tex_collector, ClwScene& out) const
+    {
+        if (out.envmap_sh.GetElementCount() == 0)
+        {
+            out.envmap_sh = m_context.CreateBuffer<float3>(kNumEnvironmentShTerms, CL_MEM_READ_WRITE);
+        }
+
+        auto texture = out.envmap_texture;
+
+        // Projection is expensive for large maps, only redo it when the texture changes.
+        // Dirty textures are projected once UpdateTextures has uploaded them.
+        if (!texture || texture == out.envmap_sh_texture || texture->IsDirty())
+        {
+            return;
+        }
+
+        auto size = texture->GetSize();
+        auto num_texels = static_cast<std::size_t>(size.x) * size.y;
+        std::array<float3, kNumEnvironmentShTerms> irradiance;
+
+        // RGBA8 textures may be in the texture atlas, the projector only reads texture data
+        if (num_texels >= kDeviceShProjectionTexels && texture->GetFormat() != Texture::Format::kRgba8)
+        {
+            std::array<float3, kNumEnvironmentShTerms> radiance;
+            auto texidx = static_cast<int>(tex_collector.GetItemIndex(texture));
+
+            m_sh_projector->Project(out, texidx, size.x, size.y, out.envmap_sh);
+            m_context.ReadBuffer(0, out.envmap_sh, &radiance[0], kNumEnvironmentShTerms).Wait();
+            ShConvolveCosTheta(2, &radiance[0], &irradiance[0]);
+        }
+        else
+        {
+            ComputeEnvironmentShIrradiance(texture, &irradiance[0]);
+        }
+
+        m_context.WriteBuffer(0, out.envmap_sh, &irradiance[0], kNumEnvironmentShTerms).Wait();
+
+        out.envmap_sh_texture = texture;
+    }
+
     void ClwSceneController::UpdateLights(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const
     {
         std::size_t num_lights_written = 0;
         
         auto num_lights = scene.GetNumLights();
-        auto distribution_buffer_size = (1 + 1 + num_lights + num_lights);
 
         // Create light buffer if needed
         if (num_lights > out.lights.GetElementCount())
         {
             out.lights = m_context.CreateBuffer<ClwScene::Light>(num_lights, CL_MEM_READ_ONLY);
-            out.light_distributions = m_context.CreateBuffer<int>(distribution_buffer_size, CL_MEM_READ_ONLY);
         }
 
         ClwScene::Light* lights = nullptr;
@@ -1437,6 +2562,7 @@ namespace Baikal
         // Allocate intermediate storage for lights power distribution
         std::vector<float> light_power(num_lights);
         std::uint32_t k = 0;
+        ImageBasedLight const* env_light = nullptr;
 
         // Serialize
         {
@@ -1451,6 +2577,7 @@ namespace Baikal
                 if (ibl)
                 {
                     out.envmapidx = static_cast<int>(num_lights_written);
+                    env_light = ibl;
                 }
 
                 ++num_lights_written;
@@ -1465,32 +2592,22 @@ namespace Baikal
 
         m_context.UnmapBuffer(0, out.lights, lights);
 
+        // Keep SH irradiance of the environment in sync for preview shading
+        out.envmap_texture = env_light ? env_light->GetTexture() : nullptr;
+        UpdateEnvironmentSh(tex_collector, out);
+
         // Create distribution over light sources based on their power
         Distribution1D light_distribution(&light_power[0], (std::uint32_t)light_power.size());
 
         // Write distribution data
-        int* distribution_ptr = nullptr;
-        m_context.MapBuffer(0, out.light_distributions, CL_MAP_WRITE, &distribution_ptr).Wait();
-        auto current = distribution_ptr;
-
-        // Write the number of segments first
-        *current++ = (int)light_distribution.m_num_segments;
-
-        // Then write num_segments  + 1 CDF values
-        auto values = reinterpret_cast<float*>(current);
-        for (auto i = 0u; i < light_distribution.m_num_segments + 1; ++i)
-        {
-            values[i] = light_distribution.m_cdf[i];
-        }
-
-        // Then write num_segments PDF values
-        values += light_distribution.m_num_segments + 1;
-
-        for (auto i = 0u; i < light_distribution.m_num_segments; ++i)
+        if (light_distribution.GetSerializedSize() > out.light_distributions.GetElementCount())
         {
-            values[i] = light_distribution.m_func_values[i] / light_distribution.m_func_sum;
+            out.light_distributions = m_context.CreateBuffer<int>(light_distribution.GetSerializedSize(), CL_MEM_READ_ONLY);
         }
 
+        int* distribution_ptr = nullptr;
+        m_context.MapBuffer(0, out.light_distributions, CL_MAP_WRITE, &distribution_ptr).Wait();
+        light_distribution.Serialize(distribution_ptr);
         m_context.UnmapBuffer(0, out.light_distributions, distribution_ptr);
 
         out.num_lights = static_cast<int>(num_lights_written);
@@ -1508,8 +2625,20 @@ namespace Baikal
             default: return ClwScene::TextureFormat::RGBA8;
         }
     }
+
+    static ClwScene::TextureWrap GetTextureWrap(Texture const* texture)
+    {
+        switch (texture->GetWrapMode())
+        {
+            case Texture::WrapMode::kRepeat: return ClwScene::TextureWrap::WRAP_REPEAT;
+            case Texture::WrapMode::kMirroredRepeat: return ClwScene::TextureWrap::WRAP_MIRRORED_REPEAT;
+            case Texture::WrapMode::kClampToEdge: return ClwScene::TextureWrap::WRAP_CLAMP_TO_EDGE;
+            case Texture::WrapMode::kClampToBorder: return ClwScene::TextureWrap::WRAP_CLAMP_TO_BORDER;
+            default: return ClwScene::TextureWrap::WRAP_REPEAT;
+        }
+    }
     
-    void ClwSceneController::WriteTexture(Texture const* texture, std::size_t data_offset, void* data) const
+    void ClwSceneController::WriteTexture(Texture const* texture, std::size_t data_offset, int mip_count, void* data) const
     {
         auto clw_texture = reinterpret_cast<ClwScene::Texture*>(data);
         
@@ -1518,7 +2647,11 @@ namespace Baikal
         clw_texture->w = dim.x;
         clw_texture->h = dim.y;
         clw_texture->fmt = GetTextureFormat(texture);
+        clw_texture->wrap = GetTextureWrap(texture);
         clw_texture->dataoffset = static_cast<int>(data_offset);
+        clw_texture->mipcount = mip_count;
+        clw_texture->atlasx = -1;
+        clw_texture->atlasy = -1;
     }
     
     void ClwSceneController::WriteTextureData(Texture const* texture, void* data) const
@@ -32,9 +32,16 @@
 #include "CLW.h"
 
 #include "SceneGraph/clwscene.h"
+#include "Utils/clw_shproject.h"
 
 #include "radeon_rays_cl.h"
 
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 namespace Baikal
 {
     class Scene1;
@@ -42,7 +49,11 @@ namespace Baikal
     class Bundle;
     class Material;
     class Light;
+    class ImageBasedLight;
     class Texture;
+    class Mesh;
+    class Instance;
+    class Volume;
 
 
     /**
@@ -75,6 +86,8 @@ namespace Baikal
         void UpdateShapes(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const override;
         // Update transform data only
         void UpdateShapeProperties(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const override;
+        // Update volume data only.
+        void UpdateVolumes(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const override;
         // Update lights data only.
         void UpdateLights(Scene1 const& scene, Collector& mat_collector, Collector& tex_collector, ClwScene& out) const override;
         // Update material data.
@@ -92,14 +105,33 @@ namespace Baikal
         // Write out single material at data pointer.
         // Collectors are required to convert texture and material pointers into indices.
         void WriteMaterial(Material const* material, Collector& mat_collector, Collector& tex_collector, void* data) const;
+        // Serialize material and its dependencies merging identical records.
+        // Returns index of material record.
+        int WriteMaterialRecord(Material const* material, Collector& mat_collector, Collector& tex_collector,
+            std::vector<ClwScene::Material>& records, std::vector<int>& slots, std::unordered_map<std::string, int>& record_cache) const;
+        // Compile compound material graph into a flat sequence of ops appended to ops.
+        // Slots map collected materials to their records. Does not touch device state.
+        static void CompileMaterial(Material const* material, Collector& mat_collector, Collector& tex_collector, std::vector<int> const& slots, std::vector<ClwScene::MaterialOp>& ops);
         // Write out single light at data pointer.
         // Collector is required to convert texture pointers into indices.
         void WriteLight(Scene1 const& scene, Light const* light, Collector& tex_collector, void* data) const;
         // Write out single texture header at data pointer.
-        // Header requires texture data offset, so it is passed in.
-        void WriteTexture(Texture const* texture, std::size_t data_offset, void* data) const;
+        // Header requires texture data offset and number of mip levels, so they are passed in.
+        void WriteTexture(Texture const* texture, std::size_t data_offset, int mip_count, void* data) const;
         // Write out texture data at data pointer.
         void WriteTextureData(Texture const* texture, void* data) const;
+        // Create texture atlas image and upload its data if the device supports images.
+        void WriteTextureAtlas(RadeonRays::int2 size, std::uint8_t const* data, ClwScene& out) const;
+        // Project environment light texture to SH irradiance if it has changed.
+        // Large maps are projected on the device, so their data has to be uploaded already.
+        void UpdateEnvironmentSh(Collector& tex_collector, ClwScene& out) const;
+        // Write out volumes enclosed by shapes if they have changed and return their indices.
+        void UpdateVolumes(std::set<Mesh const*> const& meshes, std::set<Instance const*> const& instances, std::map<Volume const*, int>& volume_indices, ClwScene& out) const;
+        // Pack per-vertex tangents into w component of the normals, see Scene_GetVertexTangent in scene.cl.
+        // Tangents are angle weighted per vertex and are not MikkTSpace compatible.
+        static void EncodeVertexTangents(Mesh const* mesh, RadeonRays::float3* normals);
+        // Convert bump texture into tangent space normal map, RGBA8 for 8 bit heights and RGBA16 otherwise.
+        static void ConvertBumpToNormalMap(Texture const* texture, char* data);
 
     private:
         // Context
@@ -108,5 +140,7 @@ namespace Baikal
         RadeonRays::IntersectionApi* m_api;
         // Default material
         std::unique_ptr<Material> m_default_material;
+        // Device SH projector for large environment maps
+        std::unique_ptr<ClwShProjector> m_sh_projector;
     };
 }
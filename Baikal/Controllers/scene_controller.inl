@@ -4,6 +4,7 @@
 #include "SceneGraph/shape.h"
 #include "SceneGraph/material.h"
 #include "SceneGraph/texture.h"
+#include "SceneGraph/volume.h"
 #include "SceneGraph/Collector/collector.h"
 #include "SceneGraph/iterator.h"
 
@@ -201,6 +202,9 @@ namespace Baikal
             // Exctract cached scene entry
             auto& out = iter->second;
             auto dirty = scene.GetDirtyFlags();
+            bool updated = false;
+            // Anything but the camera has been updated
+            bool content_updated = false;
 
             bool should_update_materials = !out.material_bundle ||
                 m_material_collector.NeedsUpdate(out.material_bundle.get(),
@@ -231,6 +235,7 @@ namespace Baikal
             if (dirty & Scene1::kCamera || camera_changed)
             {
                 UpdateCamera(scene, m_material_collector, m_texture_collector, out);
+                updated = true;
             }
             
             {
@@ -263,6 +268,7 @@ namespace Baikal
                     should_update_textures || should_update_materials)
                 {
                     UpdateLights(scene, m_material_collector, m_texture_collector, out);
+                    updated = content_updated = true;
                 }
             }
             
@@ -277,6 +283,8 @@ namespace Baikal
                 
                 // Check if shape parameters have been changed
                 bool shapes_changed = false;
+                // Volume setters only dirty the volume itself
+                bool volumes_changed = false;
                 
                 for (; shape_iter->IsValid(); shape_iter->Next())
                 {
@@ -287,16 +295,30 @@ namespace Baikal
                         shapes_changed = true;
                         break;
                     }
+
+                    auto volume = shape->GetVolume();
+
+                    if (volume && volume->IsDirty())
+                    {
+                        volumes_changed = true;
+                    }
                 }
 
                 // Update shapes if needed
                 if (dirty & Scene1::kShapes)
                 {
                     UpdateShapes(scene, m_material_collector, m_texture_collector, out);
+                    updated = content_updated = true;
                 }
                 else if (shapes_changed)
                 {
                     UpdateShapeProperties(scene, m_material_collector, m_texture_collector, out);
+                    updated = content_updated = true;
+                }
+                else if (volumes_changed)
+                {
+                    UpdateVolumes(scene, m_material_collector, m_texture_collector, out);
+                    updated = content_updated = true;
                 }
             }
             
@@ -305,12 +327,14 @@ namespace Baikal
             if (should_update_materials)
             {
                 UpdateMaterials(scene, m_material_collector, m_texture_collector, out);
+                updated = content_updated = true;
             }
 
             // If textures need an update, do it.
             if (should_update_textures)
             {
                 UpdateTextures(scene, m_material_collector, m_texture_collector, out);
+                updated = content_updated = true;
             }
 
             // Set current scene
@@ -321,6 +345,17 @@ namespace Baikal
                 UpdateCurrentScene(scene, out);
             }
 
+            // Let the consumers know they need to rebind scene data
+            if (updated)
+            {
+                ++out.revision;
+            }
+
+            if (content_updated)
+            {
+                ++out.content_revision;
+            }
+
             // Make sure to clear dirty flags
             scene.ClearDirtyFlags();
             
@@ -0,0 +1,840 @@
+#include "bidirectional_estimator.h"
+
+#include <numeric>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <random>
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "Utils/sobol.h"
+
+#ifdef RR_EMBED_KERNELS
+#include "./Kernels/CL/cache/kernels.h"
+#endif
+
+namespace Baikal
+{
+    struct BidirectionalEstimator::PathState
+    {
+        float4 throughput;
+        int volume;
+        int flags;
+        int extra0;
+        int extra1;
+        int extra2;
+        int extra3;
+        int extra4;
+        int extra5;
+    };
+
+    struct BidirectionalEstimator::PathVertex
+    {
+        float3 position;
+        float3 shading_normal;
+        float3 geometric_normal;
+        float2 uv;
+        float pdf_forward;
+        float pdf_backward;
+        float3 flow;
+        float3 unused;
+        int type;
+        int material_index;
+        int flags;
+        int padding;
+    };
+
+    struct BidirectionalEstimator::SubpathData
+    {
+        // BDPT_MAX_SUBPATH_LEN vertices per subpath
+        CLWBuffer<PathVertex> vertices;
+        CLWBuffer<int> lengths;
+        CLWBuffer<PathState> paths;
+        CLWBuffer<std::uint32_t> random;
+    };
+
+    // Kernels of a single program variant. Static arguments are scene data
+    // and work buffers, which do not change between passes.
+    struct BidirectionalEstimator::KernelSet
+    {
+        ClwBoundKernel init_eye_subpath;
+        ClwBoundKernel generate_light_vertices;
+        ClwBoundKernel sample_surface;
+        ClwBoundKernel shade_background;
+        ClwBoundKernel connect_direct;
+        ClwBoundKernel connect;
+        ClwBoundKernel gather_contributions;
+        ClwBoundKernel restore_pixel_indices;
+        ClwBoundKernel filter_path_stream;
+
+        void Invalidate()
+        {
+            init_eye_subpath.Invalidate();
+            generate_light_vertices.Invalidate();
+            sample_surface.Invalidate();
+            shade_background.Invalidate();
+            connect_direct.Invalidate();
+            connect.Invalidate();
+            gather_contributions.Invalidate();
+            restore_pixel_indices.Invalidate();
+            filter_path_stream.Invalidate();
+        }
+    };
+
+    struct BidirectionalEstimator::RenderData
+    {
+        // OpenCL stuff
+        CLWBuffer<ray> rays[2];
+        CLWBuffer<int> hits;
+
+        CLWBuffer<ray> shadowrays;
+        CLWBuffer<int> shadowhits;
+
+        CLWBuffer<Intersection> intersections;
+        CLWBuffer<int> compacted_indices;
+        CLWBuffer<int> pixelindices[2];
+        CLWBuffer<int> output_indices;
+        CLWBuffer<int> iota;
+
+        CLWBuffer<float3> contributions;
+        CLWBuffer<std::uint32_t> sobolmat;
+        CLWBuffer<int> hitcount;
+        CLWBuffer<int> raycount;
+        CLWParallelPrimitives pp;
+
+        SubpathData eye;
+        SubpathData light;
+        // Vertices per subpath the kernels are built for, BDPT_MAX_SUBPATH_LEN
+        std::uint32_t subpath_length;
+
+        // Kernels per program build options
+        std::map<std::string, KernelSet> kernel_sets;
+        KernelSet* kernels;
+
+        // RadeonRays stuff
+        Buffer* fr_rays[2];
+        Buffer* fr_shadowrays;
+        Buffer* fr_shadowhits;
+        Buffer* fr_intersections;
+        Buffer* fr_hitcount;
+        Buffer* fr_raycount;
+
+        RenderData()
+            : fr_shadowrays(nullptr)
+            , fr_shadowhits(nullptr)
+            , fr_intersections(nullptr)
+            , fr_hitcount(nullptr)
+            , fr_raycount(nullptr)
+            , subpath_length(0)
+            , kernels(nullptr)
+        {
+            fr_rays[0] = nullptr;
+            fr_rays[1] = nullptr;
+        }
+    };
+
+    BidirectionalEstimator::BidirectionalEstimator(
+        CLWContext context,
+        RadeonRays::IntersectionApi* api
+    ) :
+        ClwClass(context, "../Baikal/Kernels/CL/integrator_bdpt.cl")
+        , Estimator(api)
+        , m_render_data(new RenderData)
+        , m_sample_counter(0)
+    {
+        // Create parallel primitives
+        m_render_data->pp = CLWParallelPrimitives(context, GetBuildOpts().c_str());
+        m_render_data->sobolmat = context.CreateBuffer<unsigned int>(1024 * 52, CL_MEM_READ_ONLY, &g_SobolMatrices[0]);
+    }
+
+    // For std::unique_ptr to work;
+    BidirectionalEstimator::~BidirectionalEstimator() = default;
+
+    std::size_t BidirectionalEstimator::GetWorkBufferSize() const
+    {
+        return m_render_data->rays[0].GetElementCount();
+    }
+
+    void BidirectionalEstimator::SetWorkBufferSize(std::size_t size)
+    {
+        m_render_data->rays[0] = GetContext().CreateBuffer<ray>(size, CL_MEM_READ_WRITE);
+        m_render_data->rays[1] = GetContext().CreateBuffer<ray>(size, CL_MEM_READ_WRITE);
+        m_render_data->hits = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+        m_render_data->intersections = GetContext().CreateBuffer<Intersection>(size, CL_MEM_READ_WRITE);
+        m_render_data->shadowrays = GetContext().CreateBuffer<ray>(size, CL_MEM_READ_WRITE);
+        m_render_data->shadowhits = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+        m_render_data->contributions = GetContext().CreateBuffer<float3>(size, CL_MEM_READ_WRITE);
+
+        // Subpath vertices are allocated once subpath length is known
+        for (auto subpath : { &m_render_data->eye, &m_render_data->light })
+        {
+            subpath->vertices = CLWBuffer<PathVertex>();
+            subpath->lengths = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+            subpath->paths = GetContext().CreateBuffer<PathState>(size, CL_MEM_READ_WRITE);
+
+            // Eye and light subpaths of the same index have to be decorrelated
+            std::vector<std::uint32_t> random_buffer(size);
+            std::generate(random_buffer.begin(), random_buffer.end(), std::rand);
+
+            subpath->random = GetContext().CreateBuffer<std::uint32_t>(size, CL_MEM_READ_WRITE, &random_buffer[0]);
+        }
+
+        std::vector<int> initdata(size);
+        std::iota(initdata.begin(), initdata.end(), 0);
+
+        m_render_data->iota = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, &initdata[0]);
+        m_render_data->compacted_indices = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+        m_render_data->pixelindices[0] = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+        m_render_data->pixelindices[1] = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+        m_render_data->output_indices = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+        m_render_data->hitcount = GetContext().CreateBuffer<int>(1, CL_MEM_READ_WRITE);
+        m_render_data->raycount = GetContext().CreateBuffer<int>(1, CL_MEM_READ_WRITE);
+        m_render_data->subpath_length = 0;
+
+        // Work buffers bound to the kernels are not valid anymore
+        for (auto& kernels : m_render_data->kernel_sets)
+        {
+            kernels.second.Invalidate();
+        }
+
+        // Recreate FR buffers
+        GetIntersector()->DeleteBuffer(m_render_data->fr_rays[0]);
+        GetIntersector()->DeleteBuffer(m_render_data->fr_rays[1]);
+        GetIntersector()->DeleteBuffer(m_render_data->fr_shadowrays);
+        GetIntersector()->DeleteBuffer(m_render_data->fr_shadowhits);
+        GetIntersector()->DeleteBuffer(m_render_data->fr_intersections);
+        GetIntersector()->DeleteBuffer(m_render_data->fr_hitcount);
+        GetIntersector()->DeleteBuffer(m_render_data->fr_raycount);
+
+        m_render_data->fr_rays[0] = CreateFromOpenClBuffer(GetIntersector(), m_render_data->rays[0]);
+        m_render_data->fr_rays[1] = CreateFromOpenClBuffer(GetIntersector(), m_render_data->rays[1]);
+        m_render_data->fr_shadowrays = CreateFromOpenClBuffer(GetIntersector(), m_render_data->shadowrays);
+        m_render_data->fr_shadowhits = CreateFromOpenClBuffer(GetIntersector(), m_render_data->shadowhits);
+        m_render_data->fr_intersections = CreateFromOpenClBuffer(GetIntersector(), m_render_data->intersections);
+        m_render_data->fr_hitcount = CreateFromOpenClBuffer(GetIntersector(), m_render_data->hitcount);
+        m_render_data->fr_raycount = CreateFromOpenClBuffer(GetIntersector(), m_render_data->raycount);
+    }
+
+    CLWBuffer<ray> BidirectionalEstimator::GetRayBuffer() const
+    {
+        return m_render_data->rays[0];
+    }
+
+    CLWBuffer<int> BidirectionalEstimator::GetOutputIndexBuffer() const
+    {
+        return m_render_data->output_indices;
+    }
+
+    CLWBuffer<int> BidirectionalEstimator::GetRayCountBuffer() const
+    {
+        return m_render_data->hitcount;
+    }
+
+    BidirectionalEstimator::SubpathData& BidirectionalEstimator::GetSubpathData(TransferMode mode)
+    {
+        return mode == TransferMode::kRadiance ? m_render_data->eye : m_render_data->light;
+    }
+
+    void BidirectionalEstimator::SelectKernels(bool atomic_update)
+    {
+        // Vertex 0 is on the camera or on the light, each bounce adds one more
+        auto subpath_length = GetMaxBounces() + 1;
+
+        std::string opts;
+
+        if (atomic_update)
+        {
+            opts.append(" -D BAIKAL_ATOMIC_RESOLVE ");
+        }
+
+        // Private arrays of the connection kernels are sized by subpath length
+        opts.append(" -D BDPT_MAX_SUBPATH_LEN=" + std::to_string(subpath_length) + " ");
+
+        Rebuild(opts);
+
+        auto iter = m_render_data->kernel_sets.find(GetProgramOpts());
+
+        if (iter == m_render_data->kernel_sets.cend())
+        {
+            // First time we see this program, fetch its kernels
+            KernelSet kernels;
+            kernels.init_eye_subpath.kernel = GetKernel("InitEyeSubpath");
+            kernels.generate_light_vertices.kernel = GetKernel("GenerateLightVertices");
+            kernels.sample_surface.kernel = GetKernel("SampleSurface");
+            kernels.shade_background.kernel = GetKernel("ShadeBackgroundEnvMap");
+            kernels.connect_direct.kernel = GetKernel("ConnectDirect");
+            kernels.connect.kernel = GetKernel("Connect");
+            kernels.gather_contributions.kernel = GetKernel("GatherContributions");
+            kernels.restore_pixel_indices.kernel = GetKernel("RestorePixelIndices");
+            kernels.filter_path_stream.kernel = GetKernel("FilterPathStream");
+
+            iter = m_render_data->kernel_sets.emplace(GetProgramOpts(), kernels).first;
+        }
+
+        m_render_data->kernels = &iter->second;
+
+        // Resize subpath vertex buffers if max bounces has changed
+        if (m_render_data->subpath_length != subpath_length)
+        {
+            auto size = GetWorkBufferSize();
+
+            for (auto subpath : { &m_render_data->eye, &m_render_data->light })
+            {
+                subpath->vertices = GetContext().CreateBuffer<PathVertex>(size * subpath_length, CL_MEM_READ_WRITE);
+            }
+
+            m_render_data->subpath_length = subpath_length;
+
+            for (auto& kernels : m_render_data->kernel_sets)
+            {
+                kernels.second.Invalidate();
+            }
+        }
+    }
+
+    void BidirectionalEstimator::Estimate(
+        ClwScene const& scene,
+        std::size_t num_estimates,
+        QualityLevel quality,
+        CLWBuffer<RadeonRays::float3> output,
+        bool use_output_indices,
+        bool atomic_update
+    )
+    {
+        SelectKernels(atomic_update);
+
+        auto output_indices = use_output_indices ? m_render_data->output_indices : m_render_data->iota;
+
+        // Connections are done for all the rays, compaction only affects subpath tracing
+        int num_rays = static_cast<int>(num_estimates);
+        GetContext().FillBuffer(0, m_render_data->raycount, num_rays, 1);
+
+        // Camera rays are provided by the client
+        InitEyeSubpath(num_estimates);
+        TraceSubpath(scene, TransferMode::kRadiance, num_estimates, output, output_indices);
+
+        // Light subpaths go through the same ray buffers
+        GenerateLightVertices(scene, num_estimates);
+        TraceSubpath(scene, TransferMode::kImportance, num_estimates, output, output_indices);
+
+        auto max_vertex_index = static_cast<int>(m_render_data->subpath_length - 1);
+
+        for (auto eye_vertex_index = 1; eye_vertex_index <= max_vertex_index; ++eye_vertex_index)
+        {
+            // Eye subpath vertex to light
+            ConnectDirect(scene, eye_vertex_index, max_vertex_index, num_estimates);
+            GatherContributions(num_estimates, output, output_indices);
+
+            // Eye subpath vertex to light subpath vertices
+            for (auto light_vertex_index = 1; light_vertex_index <= max_vertex_index; ++light_vertex_index)
+            {
+                Connect(scene, eye_vertex_index, light_vertex_index, max_vertex_index, num_estimates);
+                GatherContributions(num_estimates, output, output_indices);
+            }
+
+            GetContext().Flush(0);
+        }
+
+        ++m_sample_counter;
+    }
+
+    void BidirectionalEstimator::TraceSubpath(
+        ClwScene const& scene,
+        TransferMode mode,
+        std::size_t size,
+        CLWBuffer<RadeonRays::float3> output,
+        CLWBuffer<int> output_indices
+    )
+    {
+        auto num_passes = m_render_data->subpath_length - 1;
+
+        for (auto pass = 0u; pass < num_passes; ++pass)
+        {
+            // Clear ray hits buffer
+            GetContext().FillBuffer(
+                0,
+                m_render_data->hits,
+                0,
+                m_render_data->hits.GetElementCount()
+            );
+
+            // Intersect ray batch
+            GetIntersector()->QueryIntersection(
+                m_render_data->fr_rays[pass & 0x1],
+                m_render_data->fr_hitcount, (std::uint32_t)size,
+                m_render_data->fr_intersections,
+                nullptr,
+                nullptr
+            );
+
+            // Shade missing camera rays and count the sample
+            if (mode == TransferMode::kRadiance && pass == 0)
+            {
+                ShadeBackground(scene, size, output, output_indices);
+            }
+
+            // Convert intersections to predicates
+            FilterPathStream(mode, pass, size);
+
+            // Compact batch
+            m_render_data->pp.Compact(
+                0,
+                m_render_data->hits,
+                m_render_data->iota,
+                m_render_data->compacted_indices,
+                (std::uint32_t)size,
+                m_render_data->hitcount
+            );
+
+            // Advance indices to keep pixel indices up to date
+            RestorePixelIndices(pass, size);
+
+            // Add subpath vertices and generate extension rays
+            SampleSurface(scene, mode, pass, size, output, output_indices);
+
+            GetContext().Flush(0);
+        }
+    }
+
+    void BidirectionalEstimator::InitEyeSubpath(std::size_t size)
+    {
+        auto& bound = m_render_data->kernels->init_eye_subpath;
+        auto& init_kernel = bound.kernel;
+
+        // All the arguments are work buffers
+        if (bound.NeedsBinding(m_render_data.get(), 0))
+        {
+            int argc = 0;
+            init_kernel.SetArg(argc++, m_render_data->hitcount);
+            init_kernel.SetArg(argc++, m_render_data->rays[0]);
+            init_kernel.SetArg(argc++, m_render_data->pixelindices[0]);
+            init_kernel.SetArg(argc++, m_render_data->pixelindices[1]);
+            init_kernel.SetArg(argc++, m_render_data->eye.vertices);
+            init_kernel.SetArg(argc++, m_render_data->eye.lengths);
+            init_kernel.SetArg(argc++, m_render_data->eye.paths);
+        }
+
+        {
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, init_kernel);
+        }
+    }
+
+    void BidirectionalEstimator::GenerateLightVertices(ClwScene const& scene, std::size_t size)
+    {
+        // Every ray gets a light subpath
+        GetContext().CopyBuffer(0u, m_render_data->raycount, m_render_data->hitcount, 0, 0, 1);
+        GetContext().CopyBuffer(0u, m_render_data->iota, m_render_data->pixelindices[0], 0, 0, size);
+        GetContext().CopyBuffer(0u, m_render_data->iota, m_render_data->pixelindices[1], 0, 0, size);
+
+        auto& bound = m_render_data->kernels->generate_light_vertices;
+        auto& genkernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
+
+        int argc = 0;
+        genkernel.SetArg(argc++, (cl_int)size);
+        SetStaticArg(genkernel, argc, bind, scene.vertices);
+        SetStaticArg(genkernel, argc, bind, scene.normals);
+        SetStaticArg(genkernel, argc, bind, scene.uvs);
+        SetStaticArg(genkernel, argc, bind, scene.indices);
+        SetStaticArg(genkernel, argc, bind, scene.shapes);
+        SetStaticArg(genkernel, argc, bind, scene.materialids);
+        SetStaticArg(genkernel, argc, bind, scene.materials);
+        SetTextureArgs(genkernel, argc, bind, scene);
+        SetStaticArg(genkernel, argc, bind, scene.envmapidx);
+        SetStaticArg(genkernel, argc, bind, scene.lights);
+        SetStaticArg(genkernel, argc, bind, scene.light_distributions);
+        SetStaticArg(genkernel, argc, bind, scene.num_lights);
+        genkernel.SetArg(argc++, rand_uint());
+        genkernel.SetArg(argc++, m_sample_counter);
+        SetStaticArg(genkernel, argc, bind, m_render_data->light.random);
+        SetStaticArg(genkernel, argc, bind, m_render_data->sobolmat);
+        SetStaticArg(genkernel, argc, bind, m_render_data->rays[0]);
+        SetStaticArg(genkernel, argc, bind, m_render_data->light.vertices);
+        SetStaticArg(genkernel, argc, bind, m_render_data->light.lengths);
+        SetStaticArg(genkernel, argc, bind, m_render_data->light.paths);
+
+        {
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, genkernel);
+        }
+    }
+
+    void BidirectionalEstimator::SampleSurface(
+        ClwScene const& scene,
+        TransferMode mode,
+        int pass,
+        std::size_t size,
+        CLWBuffer<RadeonRays::float3> output,
+        CLWBuffer<int> output_indices
+    )
+    {
+        auto& subpath = GetSubpathData(mode);
+
+        // Fetch kernel
+        auto& bound = m_render_data->kernels->sample_surface;
+        auto& samplekernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
+
+        // Set kernel parameters, subpath buffers depend on the mode
+        int argc = 0;
+        samplekernel.SetArg(argc++, m_render_data->rays[pass & 0x1]);
+        SetStaticArg(samplekernel, argc, bind, m_render_data->intersections);
+        SetStaticArg(samplekernel, argc, bind, m_render_data->compacted_indices);
+        samplekernel.SetArg(argc++, m_render_data->pixelindices[pass & 0x1]);
+        SetStaticArg(samplekernel, argc, bind, m_render_data->hitcount);
+        SetStaticArg(samplekernel, argc, bind, scene.vertices);
+        SetStaticArg(samplekernel, argc, bind, scene.normals);
+        SetStaticArg(samplekernel, argc, bind, scene.uvs);
+        SetStaticArg(samplekernel, argc, bind, scene.indices);
+        SetStaticArg(samplekernel, argc, bind, scene.shapes);
+        SetStaticArg(samplekernel, argc, bind, scene.materialids);
+        SetStaticArg(samplekernel, argc, bind, scene.materials);
+        SetTextureArgs(samplekernel, argc, bind, scene);
+        SetStaticArg(samplekernel, argc, bind, scene.envmapidx);
+        SetStaticArg(samplekernel, argc, bind, scene.lights);
+        SetStaticArg(samplekernel, argc, bind, scene.light_distributions);
+        SetStaticArg(samplekernel, argc, bind, scene.num_lights);
+        samplekernel.SetArg(argc++, rand_uint());
+        samplekernel.SetArg(argc++, subpath.random);
+        SetStaticArg(samplekernel, argc, bind, m_render_data->sobolmat);
+        samplekernel.SetArg(argc++, pass);
+        samplekernel.SetArg(argc++, m_sample_counter);
+        samplekernel.SetArg(argc++, static_cast<int>(mode));
+        samplekernel.SetArg(argc++, subpath.paths);
+        samplekernel.SetArg(argc++, m_render_data->rays[(pass + 1) & 0x1]);
+        samplekernel.SetArg(argc++, subpath.vertices);
+        samplekernel.SetArg(argc++, subpath.lengths);
+        samplekernel.SetArg(argc++, output_indices);
+        samplekernel.SetArg(argc++, output);
+
+        // Run shading kernel
+        {
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, samplekernel);
+        }
+    }
+
+    void BidirectionalEstimator::ShadeBackground(
+        ClwScene const& scene,
+        std::size_t size,
+        CLWBuffer<RadeonRays::float3> output,
+        CLWBuffer<int> output_indices
+    )
+    {
+        // Fetch kernel
+        auto& bound = m_render_data->kernels->shade_background;
+        auto& misskernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
+
+        // Set kernel parameters
+        int argc = 0;
+        SetStaticArg(misskernel, argc, bind, m_render_data->rays[0]);
+        SetStaticArg(misskernel, argc, bind, m_render_data->intersections);
+        misskernel.SetArg(argc++, output_indices);
+        misskernel.SetArg(argc++, (cl_int)size);
+        SetStaticArg(misskernel, argc, bind, scene.lights);
+        SetStaticArg(misskernel, argc, bind, scene.envmapidx);
+        SetTextureArgs(misskernel, argc, bind, scene);
+        misskernel.SetArg(argc++, output);
+
+        {
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, misskernel);
+        }
+    }
+
+    void BidirectionalEstimator::ConnectDirect(ClwScene const& scene, int eye_vertex_index, int max_vertex_index, std::size_t size)
+    {
+        // Fetch kernel
+        auto& bound = m_render_data->kernels->connect_direct;
+        auto& connectkernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
+
+        // Set kernel parameters
+        int argc = 0;
+        connectkernel.SetArg(argc++, eye_vertex_index);
+        connectkernel.SetArg(argc++, max_vertex_index);
+        connectkernel.SetArg(argc++, (cl_int)size);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->iota);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->eye.vertices);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->eye.lengths);
+        SetStaticArg(connectkernel, argc, bind, scene.vertices);
+        SetStaticArg(connectkernel, argc, bind, scene.normals);
+        SetStaticArg(connectkernel, argc, bind, scene.uvs);
+        SetStaticArg(connectkernel, argc, bind, scene.indices);
+        SetStaticArg(connectkernel, argc, bind, scene.shapes);
+        SetStaticArg(connectkernel, argc, bind, scene.materialids);
+        SetStaticArg(connectkernel, argc, bind, scene.materials);
+        SetTextureArgs(connectkernel, argc, bind, scene);
+        SetStaticArg(connectkernel, argc, bind, scene.envmapidx);
+        SetStaticArg(connectkernel, argc, bind, scene.lights);
+        SetStaticArg(connectkernel, argc, bind, scene.light_distributions);
+        SetStaticArg(connectkernel, argc, bind, scene.num_lights);
+        connectkernel.SetArg(argc++, rand_uint());
+        SetStaticArg(connectkernel, argc, bind, m_render_data->eye.random);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->sobolmat);
+        connectkernel.SetArg(argc++, m_sample_counter);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->shadowrays);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->contributions);
+
+        {
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, connectkernel);
+        }
+    }
+
+    void BidirectionalEstimator::Connect(ClwScene const& scene, int eye_vertex_index, int light_vertex_index, int max_vertex_index, std::size_t size)
+    {
+        // Fetch kernel
+        auto& bound = m_render_data->kernels->connect;
+        auto& connectkernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
+
+        // Set kernel parameters
+        int argc = 0;
+        connectkernel.SetArg(argc++, (cl_int)size);
+        connectkernel.SetArg(argc++, eye_vertex_index);
+        connectkernel.SetArg(argc++, light_vertex_index);
+        connectkernel.SetArg(argc++, max_vertex_index);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->iota);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->eye.vertices);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->eye.lengths);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->light.vertices);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->light.lengths);
+        SetStaticArg(connectkernel, argc, bind, scene.materials);
+        SetTextureArgs(connectkernel, argc, bind, scene);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->shadowrays);
+        SetStaticArg(connectkernel, argc, bind, m_render_data->contributions);
+
+        {
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, connectkernel);
+        }
+    }
+
+    void BidirectionalEstimator::GatherContributions(
+        std::size_t size,
+        CLWBuffer<RadeonRays::float3> output,
+        CLWBuffer<int> output_indices
+    )
+    {
+        // Intersect connection rays
+        GetIntersector()->QueryOcclusion(
+            m_render_data->fr_shadowrays,
+            m_render_data->fr_raycount,
+            (std::uint32_t)size,
+            m_render_data->fr_shadowhits,
+            nullptr,
+            nullptr
+        );
+
+        // Fetch kernel
+        auto& bound = m_render_data->kernels->gather_contributions;
+        auto& gatherkernel = bound.kernel;
+        auto bind = bound.NeedsBinding(m_render_data.get(), 0);
+
+        // Set kernel parameters
+        int argc = 0;
+        gatherkernel.SetArg(argc++, (cl_int)size);
+        SetStaticArg(gatherkernel, argc, bind, m_render_data->iota);
+        gatherkernel.SetArg(argc++, output_indices);
+        SetStaticArg(gatherkernel, argc, bind, m_render_data->shadowhits);
+        SetStaticArg(gatherkernel, argc, bind, m_render_data->contributions);
+        gatherkernel.SetArg(argc++, output);
+
+        {
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, gatherkernel);
+        }
+    }
+
+    void BidirectionalEstimator::RestorePixelIndices(int pass, std::size_t size)
+    {
+        // Fetch kernel
+        auto& bound = m_render_data->kernels->restore_pixel_indices;
+        auto& restorekernel = bound.kernel;
+        auto bind = bound.NeedsBinding(m_render_data.get(), 0);
+
+        // Set kernel parameters
+        int argc = 0;
+        SetStaticArg(restorekernel, argc, bind, m_render_data->compacted_indices);
+        SetStaticArg(restorekernel, argc, bind, m_render_data->hitcount);
+        restorekernel.SetArg(argc++, m_render_data->pixelindices[(pass + 1) & 0x1]);
+        restorekernel.SetArg(argc++, m_render_data->pixelindices[pass & 0x1]);
+
+        // Run shading kernel
+        {
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, restorekernel);
+        }
+    }
+
+    void BidirectionalEstimator::FilterPathStream(TransferMode mode, int pass, std::size_t size)
+    {
+        auto& bound = m_render_data->kernels->filter_path_stream;
+        auto& filterkernel = bound.kernel;
+        auto bind = bound.NeedsBinding(m_render_data.get(), 0);
+
+        int argc = 0;
+        SetStaticArg(filterkernel, argc, bind, m_render_data->intersections);
+        SetStaticArg(filterkernel, argc, bind, m_render_data->hitcount);
+        filterkernel.SetArg(argc++, m_render_data->pixelindices[(pass + 1) & 0x1]);
+        filterkernel.SetArg(argc++, GetSubpathData(mode).paths);
+        SetStaticArg(filterkernel, argc, bind, m_render_data->hits);
+
+        {
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, filterkernel);
+        }
+    }
+
+    void BidirectionalEstimator::SetRandomSeed(std::uint32_t seed)
+    {
+        std::srand(seed);
+    }
+
+    bool BidirectionalEstimator::HasRandomBuffer(RandomBufferType buffer) const
+    {
+        switch (buffer)
+        {
+        case RandomBufferType::kRandomSeed:
+        case RandomBufferType::kSobolLUT:
+            return true;
+        }
+
+        return false;
+    }
+
+    CLWBuffer<std::uint32_t> BidirectionalEstimator::GetRandomBuffer(RandomBufferType buffer) const
+    {
+        switch (buffer)
+        {
+        case RandomBufferType::kRandomSeed:
+            return m_render_data->eye.random;
+        case RandomBufferType::kSobolLUT:
+            return m_render_data->sobolmat;
+        }
+
+        return CLWBuffer<std::uint32_t>();
+    }
+
+    CLWBuffer<RadeonRays::Intersection> BidirectionalEstimator::GetFirstHitBuffer() const
+    {
+        return m_render_data->intersections;
+    }
+
+    void BidirectionalEstimator::TraceFirstHit(
+        ClwScene const& scene,
+        std::size_t num_estimates
+    )
+    {
+        // Intersect ray batch
+        GetIntersector()->QueryIntersection(
+            m_render_data->fr_rays[0],
+            m_render_data->fr_hitcount,
+            (std::uint32_t)num_estimates,
+            m_render_data->fr_intersections,
+            nullptr,
+            nullptr
+        );
+    }
+
+    void BidirectionalEstimator::Benchmark(
+        ClwScene const& scene,
+        std::size_t num_estimates,
+        RayTracingStats& stats
+    )
+    {
+        auto temporary = GetContext().CreateBuffer<float3>(num_estimates, CL_MEM_WRITE_ONLY);
+
+        auto num_passes = 100u;
+        GetContext().FillBuffer(0, m_render_data->raycount, static_cast<int>(num_estimates), 1);
+        GetContext().FillBuffer(0, m_render_data->hits, 0, num_estimates);
+
+        SelectKernels(false);
+        InitEyeSubpath(num_estimates);
+
+        // Intersect camera rays
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (auto i = 0u; i < num_passes; ++i)
+        {
+            GetIntersector()->QueryIntersection(
+                m_render_data->fr_rays[0],
+                m_render_data->fr_hitcount,
+                (std::uint32_t)num_estimates,
+                m_render_data->fr_intersections,
+                nullptr,
+                nullptr
+            );
+        }
+
+        GetContext().Finish(0);
+
+        auto delta = std::chrono::high_resolution_clock::now() - start;
+
+        stats.primary_throughput =
+            num_estimates / (((float)std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
+                / num_passes)
+                / 1000.f);
+
+        // Add first eye subpath vertex
+        FilterPathStream(TransferMode::kRadiance, 0, num_estimates);
+
+        m_render_data->pp.Compact(
+            0,
+            m_render_data->hits,
+            m_render_data->iota,
+            m_render_data->compacted_indices,
+            (std::uint32_t)num_estimates,
+            m_render_data->hitcount);
+
+        RestorePixelIndices(0, num_estimates);
+
+        SampleSurface(scene, TransferMode::kRadiance, 0, num_estimates, temporary, m_render_data->iota);
+
+        // Intersect connection rays
+        ConnectDirect(scene, 1, 1, num_estimates);
+
+        start = std::chrono::high_resolution_clock::now();
+
+        for (auto i = 0U; i < num_passes; ++i)
+        {
+            GetIntersector()->QueryOcclusion(
+                m_render_data->fr_shadowrays,
+                m_render_data->fr_raycount,
+                (std::uint32_t)num_estimates,
+                m_render_data->fr_shadowhits,
+                nullptr,
+                nullptr);
+        }
+
+        GetContext().Finish(0);
+
+        delta = std::chrono::high_resolution_clock::now() - start;
+
+        stats.shadow_throughput =
+            num_estimates / (((float)std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
+                / num_passes)
+                / 1000.f);
+
+        // Intersect extension rays
+        start = std::chrono::high_resolution_clock::now();
+
+        for (auto i = 0U; i < num_passes; ++i)
+        {
+            GetIntersector()->QueryIntersection(
+                m_render_data->fr_rays[1],
+                m_render_data->fr_hitcount,
+                (std::uint32_t)num_estimates,
+                m_render_data->fr_intersections,
+                nullptr,
+                nullptr
+            );
+        }
+
+        GetContext().Finish(0);
+
+        delta = std::chrono::high_resolution_clock::now() - start;
+
+        stats.secondary_throughput =
+            num_estimates / (((float)std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
+                / num_passes)
+                / 1000.f);
+    }
+}
@@ -0,0 +1,246 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "estimator.h"
+#include "radeon_rays_cl.h"
+
+#include <memory>
+
+namespace Baikal
+{
+    /**
+    \brief Bidirectional path tracing estimator.
+
+    Traces eye subpaths from the rays provided by the client and light subpaths from
+    sampled emitters in a wavefront fashion, then connects every pair of subpath vertices
+    with batched shadow rays. Converges considerably faster than PathTracingEstimator
+    in scenes where emitters are hard to reach from the camera side.
+
+    Each subpath bounces up to max bounces times. Kernels are built with BDPT_MAX_SUBPATH_LEN
+    set to max bounces + 1 and subpath vertex buffers are sized to match, so memory and
+    the number of connection passes grow with max bounces.
+    */
+    class BidirectionalEstimator : public Estimator, protected ClwClass
+    {
+    public:
+        BidirectionalEstimator(
+            CLWContext context,
+            RadeonRays::IntersectionApi* api
+        );
+
+        ~BidirectionalEstimator() override;
+
+        /**
+        \brief Tells estimator about memory requirements (max number of entries in ray buffer).
+
+        Estimators allocate internal buffers to store rays and output index mappings. Clients
+        set the size of internal buffers and then query them and fill them up with the data.
+        */
+        void SetWorkBufferSize(std::size_t size) override;
+
+        /**
+        \brief Returns internal ray buffer size in elements.
+        */
+        std::size_t GetWorkBufferSize() const override;
+
+        /**
+        \brief Set random seed value for the estimator. Renders
+        with the same random seed are guaranteed to be the same.
+
+        \param seed Seed value
+        */
+        void SetRandomSeed(std::uint32_t seed) override;
+
+        /**
+        \brief Get ray buffer handle.
+
+        Camera rays written into this buffer start eye subpaths.
+
+        IMPORTANT: SetWorkBufferSize should be called prior to calling this method.
+        Returned buffer size is exacly the size set via SetWorkBufferSize.
+        */
+        CLWBuffer<ray> GetRayBuffer() const override;
+
+        /**
+        \brief Get output index buffer handle.
+
+        Output index establishes ray index -> output index mapping.
+        Output data for ray index i is scattered into output[output_index[i]].
+
+        IMPORTANT: SetWorkBufferSize should be called prior to calling this method.
+        Returned buffer size is exacly the size set via SetWorkBufferSize.
+        */
+        CLWBuffer<int> GetOutputIndexBuffer() const override;
+
+        /**
+        \brief Get ray count buffer handle.
+
+        This buffer is used by the clients to tell how many rays are in ray buffer.
+
+        IMPORTANT: SetWorkBufferSize should be called prior to calling this method.
+        */
+        CLWBuffer<int> GetRayCountBuffer() const override;
+
+        /**
+        \brief Returns first hit buffer
+
+        IMPORTANT: SetWorkBufferSize should be called prior to calling this method.
+        Returned buffer size is exacly the size set via SetWorkBufferSize.
+        */
+        CLWBuffer<RadeonRays::Intersection> GetFirstHitBuffer() const override;
+
+        /**
+        \brief Evaluate single sample radiance estimate for a given direction.
+
+        Traces one eye and one light subpath per ray and adds the contributions of all
+        their connections into the output buffer.
+
+        \param scene Scene description.
+        \param num_estimates Number of items in ray buffer.
+        \param quality Quality of the estimate.
+        \param output Output buffer.
+        \param use_output_indices If set to false assumes 1 to 1 correspondence between the ray and the output
+        \param atomic_update Tells an estimator that indices might contain duplicate elements and
+        hence atomic update is required while updating output buffer.
+        */
+        void Estimate(
+            ClwScene const& scene,
+            std::size_t num_estimates,
+            QualityLevel quality,
+            CLWBuffer<RadeonRays::float3> output,
+            bool use_output_indices = true,
+            bool atomic_update = false
+        ) override;
+
+        /**
+        \brief Find intersection points for the rays in ray buffer.
+
+        Intersection are calculated and written to intersection buffer.
+
+        \param scene Scene description.
+        \param num_estimates Number of items in ray buffer.
+        */
+        void TraceFirstHit(
+            ClwScene const& scene,
+            std::size_t num_estimates
+        ) override;
+
+        /**
+        \brief Run internal ray tracing benchmark.
+
+        \param scene Scene description.
+        \param num_estimates Number of items in ray buffer.
+        */
+        void Benchmark(
+            ClwScene const& scene,
+            std::size_t num_estimates,
+            RayTracingStats& stats
+        ) override;
+
+        /**
+        \brief General buffer access function (hack to avoid vidmem duplication).
+        */
+        bool HasRandomBuffer(RandomBufferType buffer) const override;
+
+        /**
+        \brief General buffer access function (hack to avoid vidmem duplication).
+
+        Returns random buffer used by eye subpaths.
+        */
+        CLWBuffer<std::uint32_t> GetRandomBuffer(RandomBufferType buffer) const override;
+
+    private:
+        // Subpaths started from the camera carry radiance, subpaths
+        // started from the lights carry importance
+        enum class TransferMode
+        {
+            kRadiance,
+            kImportance
+        };
+
+        struct PathState;
+        struct PathVertex;
+        struct SubpathData;
+        struct KernelSet;
+        struct RenderData;
+
+        SubpathData& GetSubpathData(TransferMode mode);
+
+        // Build the program for current max bounces, fetch its kernels and size subpath buffers to match
+        void SelectKernels(bool atomic_update);
+
+        // Start eye subpaths from client camera rays
+        void InitEyeSubpath(std::size_t size);
+
+        // Sample emitters and start light subpaths
+        void GenerateLightVertices(ClwScene const& scene, std::size_t size);
+
+        // Extend subpaths until they leave the scene or reach max length
+        void TraceSubpath(
+            ClwScene const& scene,
+            TransferMode mode,
+            std::size_t size,
+            CLWBuffer<RadeonRays::float3> output,
+            CLWBuffer<int> output_indices
+        );
+
+        void SampleSurface(
+            ClwScene const& scene,
+            TransferMode mode,
+            int pass,
+            std::size_t size,
+            CLWBuffer<RadeonRays::float3> output,
+            CLWBuffer<int> output_indices
+        );
+
+        void ShadeBackground(
+            ClwScene const& scene,
+            std::size_t size,
+            CLWBuffer<RadeonRays::float3> output,
+            CLWBuffer<int> output_indices
+        );
+
+        // Connect eye subpath vertex to a sampled light point
+        // (max vertex index is needed to know which strategies MIS weights account for)
+        void ConnectDirect(ClwScene const& scene, int eye_vertex_index, int max_vertex_index, std::size_t size);
+
+        // Connect eye subpath vertex to light subpath vertex
+        void Connect(ClwScene const& scene, int eye_vertex_index, int light_vertex_index, int max_vertex_index, std::size_t size);
+
+        // Trace connection rays and add unoccluded contributions to the output
+        void GatherContributions(
+            std::size_t size,
+            CLWBuffer<RadeonRays::float3> output,
+            CLWBuffer<int> output_indices
+        );
+
+        // Restore pixel indices after compaction
+        void RestorePixelIndices(int pass, std::size_t size);
+
+        // Convert intersection info to compaction predicate
+        void FilterPathStream(TransferMode mode, int pass, std::size_t size);
+
+        std::unique_ptr<RenderData> m_render_data;
+        mutable std::uint32_t m_sample_counter;
+    };
+}
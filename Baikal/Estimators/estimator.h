@@ -27,6 +27,8 @@ THE SOFTWARE.
 
 #include "CLW.h"
 
+#include <vector>
+
 namespace Baikal
 {
     /**
@@ -57,11 +59,19 @@ namespace Baikal
             float primary_throughput;
             float secondary_throughput;
             float shadow_throughput;
+            // Secondary ray throughput per bounce (starting from the first one)
+            // in generation order and after coherence sorting
+            std::vector<float> bounce_throughput;
+            std::vector<float> bounce_sorted_throughput;
+            // Time to shade each of those bounces in milliseconds
+            std::vector<float> bounce_shading_time;
         };
 
         Estimator(RadeonRays::IntersectionApi* api)
             : m_intersector(api)
             , m_max_bounces(5u)
+            , m_path_guiding(false)
+            , m_ray_sorting(false)
         {
         }
 
@@ -224,11 +234,51 @@ namespace Baikal
             return m_max_bounces;
         }
 
+        /**
+        \brief Enable path guiding.
+
+        Estimators supporting it learn incident radiance distribution of the scene
+        while rendering and sample it along with BxDFs. Ignored by other estimators.
+
+        \param enable
+        */
+        void SetPathGuiding(bool enable) {
+            m_path_guiding = enable;
+        }
+
+        /**
+        \brief Check if path guiding is enabled.
+        */
+        bool IsPathGuidingEnabled() const {
+            return m_path_guiding;
+        }
+
+        /**
+        \brief Enable coherence sorting of secondary rays.
+
+        Rays are reordered by origin and direction before intersection
+        to make traversal more coherent. Ignored by estimators not supporting it.
+
+        \param enable
+        */
+        void SetRaySorting(bool enable) {
+            m_ray_sorting = enable;
+        }
+
+        /**
+        \brief Check if ray sorting is enabled.
+        */
+        bool IsRaySortingEnabled() const {
+            return m_ray_sorting;
+        }
+
         Estimator(Estimator const&) = delete;
         Estimator& operator = (Estimator const&) = delete;
 
     private:
         RadeonRays::IntersectionApi* m_intersector;
         std::uint32_t m_max_bounces;
+        bool m_path_guiding;
+        bool m_ray_sorting;
     };
 }
\ No newline at end of file
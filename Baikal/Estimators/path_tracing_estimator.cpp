@@ -7,8 +7,10 @@
 #include <cstdint>
 #include <random>
 #include <algorithm>
+#include <map>
 
 #include "Utils/sobol.h"
+#include "Utils/path_guiding.h"
 
 #ifdef RR_EMBED_KERNELS
 #include "./Kernels/CL/cache/kernels.h"
@@ -22,7 +24,45 @@ namespace Baikal
         int volume;
         int flags;
         int extra0;
-        int extra1;
+        float cone_width;
+        int guide_count;
+        int light_guide_record;
+        float light_guide_value;
+        int light_guide_count;
+    };
+
+    // Kernels of a single program variant. Static arguments are scene data
+    // and work buffers, which do not change between passes.
+    struct PathTracingEstimator::KernelSet
+    {
+        ClwBoundKernel init_path_data;
+        ClwBoundKernel shade_surface;
+        ClwBoundKernel shade_volume;
+        ClwBoundKernel evaluate_volume;
+        ClwBoundKernel shade_background;
+        ClwBoundKernel gather_light_samples;
+        ClwBoundKernel restore_pixel_indices;
+        ClwBoundKernel filter_path_stream;
+        ClwBoundKernel shade_miss;
+        ClwBoundKernel update_path_guiding;
+        ClwBoundKernel generate_ray_sort_keys;
+        ClwBoundKernel reorder_rays;
+
+        void Invalidate()
+        {
+            init_path_data.Invalidate();
+            shade_surface.Invalidate();
+            shade_volume.Invalidate();
+            evaluate_volume.Invalidate();
+            shade_background.Invalidate();
+            gather_light_samples.Invalidate();
+            restore_pixel_indices.Invalidate();
+            filter_path_stream.Invalidate();
+            shade_miss.Invalidate();
+            update_path_guiding.Invalidate();
+            generate_ray_sort_keys.Invalidate();
+            reorder_rays.Invalidate();
+        }
     };
 
     struct PathTracingEstimator::RenderData
@@ -47,6 +87,30 @@ namespace Baikal
         CLWBuffer<int> hitcount;
         CLWParallelPrimitives pp;
 
+        // Path guiding cache: radiance gathered during the last sample,
+        // accumulated radiance and sampling distributions per cell and bin
+        CLWBuffer<float> guiding_train;
+        CLWBuffer<float> guiding_radiance;
+        CLWBuffer<float> guiding_cdf;
+        // Guided vertices of the paths being traced, only allocated while guiding is enabled
+        CLWBuffer<float4> guiding_vertices;
+        // Scene the cache has been trained for
+        ClwScene const* guiding_scene;
+        std::uint32_t guiding_revision;
+
+        // Scene bounds (min, max) for path guiding grid and ray sort keys
+        CLWBuffer<float3> scene_bounds;
+        // Scene the bounds have been written for
+        ClwScene const* bounds_scene;
+        std::uint32_t bounds_revision;
+
+        // Ray sorting: keys and ray indices before and after sorting
+        CLWBuffer<int> sort_keys[2];
+        CLWBuffer<int> sort_values[2];
+        // Rays and pixel indices in the order they were generated
+        CLWBuffer<ray> unsorted_rays;
+        CLWBuffer<int> unsorted_pixelindices;
+
         // RadeonRays stuff
         Buffer* fr_rays[2];
         Buffer* fr_shadowrays;
@@ -58,12 +122,21 @@ namespace Baikal
         Collector mat_collector;
         Collector tex_collector;
 
+        // Kernels per program build options
+        std::map<std::string, KernelSet> kernel_sets;
+        KernelSet* kernels;
+
         RenderData()
             : fr_shadowrays(nullptr)
             , fr_shadowhits(nullptr)
             , fr_hits(nullptr)
             , fr_intersections(nullptr)
             , fr_hitcount(nullptr)
+            , guiding_scene(nullptr)
+            , guiding_revision(0)
+            , bounds_scene(nullptr)
+            , bounds_revision(0)
+            , kernels(nullptr)
         {
             fr_rays[0] = nullptr;
             fr_rays[1] = nullptr;
@@ -82,6 +155,13 @@ namespace Baikal
         // Create parallel primitives
         m_render_data->pp = CLWParallelPrimitives(context, GetBuildOpts().c_str());
         m_render_data->sobolmat = context.CreateBuffer<unsigned int>(1024 * 52, CL_MEM_READ_ONLY, &g_SobolMatrices[0]);
+
+        // Guiding cache is bound to the kernels even if guiding is disabled
+        m_render_data->guiding_train = context.CreateBuffer<float>(GUIDING_NUM_CELLS * GUIDING_NUM_BINS, CL_MEM_READ_WRITE);
+        m_render_data->guiding_radiance = context.CreateBuffer<float>(GUIDING_NUM_CELLS * GUIDING_NUM_BINS, CL_MEM_READ_WRITE);
+        m_render_data->guiding_cdf = context.CreateBuffer<float>(GUIDING_NUM_CELLS * GUIDING_NUM_BINS, CL_MEM_READ_WRITE);
+        m_render_data->guiding_vertices = context.CreateBuffer<float4>(1, CL_MEM_READ_WRITE);
+        m_render_data->scene_bounds = context.CreateBuffer<float3>(2, CL_MEM_READ_ONLY);
     }
     
     // For std::unique_ptr to work;
@@ -117,6 +197,18 @@ namespace Baikal
         m_render_data->pixelindices[1] = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
         m_render_data->output_indices = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
         m_render_data->hitcount = GetContext().CreateBuffer<int>(1, CL_MEM_READ_WRITE);
+        m_render_data->sort_keys[0] = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+        m_render_data->sort_keys[1] = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+        m_render_data->sort_values[0] = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+        m_render_data->sort_values[1] = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+        m_render_data->unsorted_rays = GetContext().CreateBuffer<ray>(size, CL_MEM_READ_WRITE);
+        m_render_data->unsorted_pixelindices = GetContext().CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+
+        // Work buffers bound to the kernels are not valid anymore
+        for (auto& kernels : m_render_data->kernel_sets)
+        {
+            kernels.second.Invalidate();
+        }
 
         // Recreate FR buffers
         GetIntersector()->DeleteBuffer(m_render_data->fr_rays[0]);
@@ -160,26 +252,49 @@ namespace Baikal
         bool atomic_update
     )
     {
+        std::string opts;
+
         if (atomic_update)
         {
-            Rebuild(" -D BAIKAL_ATOMIC_RESOLVE ");
+            opts.append(" -D BAIKAL_ATOMIC_RESOLVE ");
         }
 
+        // Rough quality approximates diffuse environment lighting with SH irradiance
+        if (quality == QualityLevel::kRough)
+        {
+            opts.append(" -D BAIKAL_SH_IBL_PREVIEW ");
+        }
+
+        if (IsPathGuidingEnabled())
+        {
+            opts.append(" -D BAIKAL_PATH_GUIDING ");
+        }
+
+        Rebuild(opts);
+        SelectKernels();
+        UpdateSceneBounds(scene);
+
+        // Fold radiance learned during the previous sample into the guiding cache
+        if (IsPathGuidingEnabled())
+        {
+            UpdatePathGuiding(scene);
+        }
+
+        // Paths and pixel indices are initialized by a single kernel
         InitPathData(num_estimates);
 
-        GetContext().CopyBuffer(0u, m_render_data->iota, m_render_data->pixelindices[0], 0, 0, num_estimates); 
-        GetContext().CopyBuffer(0u, m_render_data->iota, m_render_data->pixelindices[1], 0, 0, num_estimates);
+        // Volume kernels have nothing to do if there are no volumes
+        bool has_volumes = !scene.volume_list.empty();
 
-        // Initialize first pass
+        // The whole sample is enqueued without any host synchronization
+        // and submitted once, per-pass values are the only arguments set
         for (auto pass = 0u; pass < GetMaxBounces(); ++pass)
         {
-            // Clear ray hits buffer
-            GetContext().FillBuffer(
-                0, 
-                m_render_data->hits, 
-                0, 
-                m_render_data->hits.GetElementCount()
-            );
+            // Secondary rays are incoherent, reorder them to reduce traversal divergence
+            if (pass > 0 && IsRaySortingEnabled())
+            {
+                SortRays(pass, num_estimates);
+            }
 
             // Intersect ray batch
             GetIntersector()->QueryIntersection(
@@ -191,7 +306,10 @@ namespace Baikal
             );
 
             // Apply scattering
-            EvaluateVolume(scene, pass, num_estimates, output, use_output_indices);
+            if (has_volumes)
+            {
+                EvaluateVolume(scene, pass, num_estimates, output, use_output_indices);
+            }
 
             if (pass > 0 && scene.envmapidx > -1)
             {
@@ -215,7 +333,10 @@ namespace Baikal
             RestorePixelIndices(pass, num_estimates);
 
             // Shade hits
-            ShadeVolume(scene, pass, num_estimates, output, use_output_indices);
+            if (has_volumes)
+            {
+                ShadeVolume(scene, pass, num_estimates, output, use_output_indices);
+            }
 
             // Shade hits
             ShadeSurface(scene, pass, num_estimates, output, use_output_indices);
@@ -236,22 +357,54 @@ namespace Baikal
 
             // Gather light samples and account for visibility
             GatherLightSamples(scene, pass, num_estimates, output, use_output_indices);
-
-            GetContext().Flush(0);
         }
 
+        GetContext().Flush(0);
+
         ++m_sample_counter;
     }
 
+    void PathTracingEstimator::SelectKernels()
+    {
+        auto iter = m_render_data->kernel_sets.find(GetProgramOpts());
+
+        if (iter == m_render_data->kernel_sets.cend())
+        {
+            // First time we see this program, fetch its kernels
+            KernelSet kernels;
+            kernels.init_path_data.kernel = GetKernel("InitPathData");
+            kernels.shade_surface.kernel = GetKernel("ShadeSurface");
+            kernels.shade_volume.kernel = GetKernel("ShadeVolume");
+            kernels.evaluate_volume.kernel = GetKernel("EvaluateVolume");
+            kernels.shade_background.kernel = GetKernel("ShadeBackgroundEnvMap");
+            kernels.gather_light_samples.kernel = GetKernel("GatherLightSamples");
+            kernels.restore_pixel_indices.kernel = GetKernel("RestorePixelIndices");
+            kernels.filter_path_stream.kernel = GetKernel("FilterPathStream");
+            kernels.shade_miss.kernel = GetKernel("ShadeMiss");
+            kernels.update_path_guiding.kernel = GetKernel("UpdatePathGuiding");
+            kernels.generate_ray_sort_keys.kernel = GetKernel("GenerateRaySortKeys");
+            kernels.reorder_rays.kernel = GetKernel("ReorderRays");
+
+            iter = m_render_data->kernel_sets.emplace(GetProgramOpts(), kernels).first;
+        }
+
+        m_render_data->kernels = &iter->second;
+    }
+
     void PathTracingEstimator::InitPathData(std::size_t size)
     {
-        auto init_kernel = GetKernel("InitPathData");
+        auto& bound = m_render_data->kernels->init_path_data;
+        auto& init_kernel = bound.kernel;
 
-        int argc = 0;
-        init_kernel.SetArg(argc++, m_render_data->pixelindices[0]);
-        init_kernel.SetArg(argc++, m_render_data->pixelindices[1]);
-        init_kernel.SetArg(argc++, m_render_data->hitcount);
-        init_kernel.SetArg(argc++, m_render_data->paths);
+        // All the arguments are work buffers
+        if (bound.NeedsBinding(m_render_data.get(), 0))
+        {
+            int argc = 0;
+            init_kernel.SetArg(argc++, m_render_data->pixelindices[0]);
+            init_kernel.SetArg(argc++, m_render_data->pixelindices[1]);
+            init_kernel.SetArg(argc++, m_render_data->hitcount);
+            init_kernel.SetArg(argc++, m_render_data->paths);
+        }
 
         {
             GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, init_kernel);
@@ -267,42 +420,51 @@ namespace Baikal
     )
     {
         // Fetch kernel
-        auto shadekernel = GetKernel("ShadeSurface");
+        auto& bound = m_render_data->kernels->shade_surface;
+        auto& shadekernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
 
         auto output_indices = use_output_indices ? m_render_data->output_indices : m_render_data->iota;
 
         // Set kernel parameters
         int argc = 0;
         shadekernel.SetArg(argc++, m_render_data->rays[pass & 0x1]);
-        shadekernel.SetArg(argc++, m_render_data->intersections);
-        shadekernel.SetArg(argc++, m_render_data->compacted_indices);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->intersections);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->compacted_indices);
         shadekernel.SetArg(argc++, m_render_data->pixelindices[pass & 0x1]);
         shadekernel.SetArg(argc++, output_indices);
-        shadekernel.SetArg(argc++, m_render_data->hitcount);
-        shadekernel.SetArg(argc++, scene.vertices);
-        shadekernel.SetArg(argc++, scene.normals);
-        shadekernel.SetArg(argc++, scene.uvs);
-        shadekernel.SetArg(argc++, scene.indices);
-        shadekernel.SetArg(argc++, scene.shapes);
-        shadekernel.SetArg(argc++, scene.materialids);
-        shadekernel.SetArg(argc++, scene.materials);
-        shadekernel.SetArg(argc++, scene.textures);
-        shadekernel.SetArg(argc++, scene.texturedata);
-        shadekernel.SetArg(argc++, scene.envmapidx);
-        shadekernel.SetArg(argc++, scene.lights);
-        shadekernel.SetArg(argc++, scene.light_distributions);
-        shadekernel.SetArg(argc++, scene.num_lights);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->hitcount);
+        SetStaticArg(shadekernel, argc, bind, scene.vertices);
+        SetStaticArg(shadekernel, argc, bind, scene.normals);
+        SetStaticArg(shadekernel, argc, bind, scene.uvs);
+        SetStaticArg(shadekernel, argc, bind, scene.indices);
+        SetStaticArg(shadekernel, argc, bind, scene.shapes);
+        SetStaticArg(shadekernel, argc, bind, scene.materialids);
+        SetStaticArg(shadekernel, argc, bind, scene.materials);
+        SetTextureArgs(shadekernel, argc, bind, scene);
+        SetStaticArg(shadekernel, argc, bind, scene.envmapidx);
+        SetStaticArg(shadekernel, argc, bind, scene.envmap_sh);
+        SetStaticArg(shadekernel, argc, bind, scene.lights);
+        SetStaticArg(shadekernel, argc, bind, scene.light_distributions);
+        SetStaticArg(shadekernel, argc, bind, scene.num_lights);
         shadekernel.SetArg(argc++, rand_uint());
-        shadekernel.SetArg(argc++, m_render_data->random);
-        shadekernel.SetArg(argc++, m_render_data->sobolmat);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->random);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->sobolmat);
         shadekernel.SetArg(argc++, pass);
         shadekernel.SetArg(argc++, m_sample_counter);
-        shadekernel.SetArg(argc++, scene.volumes);
-        shadekernel.SetArg(argc++, m_render_data->shadowrays);
-        shadekernel.SetArg(argc++, m_render_data->lightsamples);
-        shadekernel.SetArg(argc++, m_render_data->paths);
+        SetStaticArg(shadekernel, argc, bind, scene.volumes);
+        SetStaticArg(shadekernel, argc, bind, scene.volume_grids);
+        SetStaticArg(shadekernel, argc, bind, scene.volume_brick_indices);
+        SetStaticArg(shadekernel, argc, bind, scene.volume_bricks);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->shadowrays);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->lightsamples);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->paths);
         shadekernel.SetArg(argc++, m_render_data->rays[(pass + 1) & 0x1]);
         shadekernel.SetArg(argc++, output);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->guiding_cdf);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->guiding_train);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->scene_bounds);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->guiding_vertices);
 
         // Run shading kernel
         {
@@ -319,40 +481,44 @@ namespace Baikal
     )
     {
         // Fetch kernel
-        auto shadekernel = GetKernel("ShadeVolume");
+        auto& bound = m_render_data->kernels->shade_volume;
+        auto& shadekernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
 
         auto output_indices = use_output_indices ? m_render_data->output_indices : m_render_data->iota;
 
         // Set kernel parameters
         int argc = 0;
         shadekernel.SetArg(argc++, m_render_data->rays[pass & 0x1]);
-        shadekernel.SetArg(argc++, m_render_data->intersections);
-        shadekernel.SetArg(argc++, m_render_data->compacted_indices);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->intersections);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->compacted_indices);
         shadekernel.SetArg(argc++, m_render_data->pixelindices[pass & 0x1]);
         shadekernel.SetArg(argc++, output_indices);
-        shadekernel.SetArg(argc++, m_render_data->hitcount);
-        shadekernel.SetArg(argc++, scene.vertices);
-        shadekernel.SetArg(argc++, scene.normals);
-        shadekernel.SetArg(argc++, scene.uvs);
-        shadekernel.SetArg(argc++, scene.indices);
-        shadekernel.SetArg(argc++, scene.shapes);
-        shadekernel.SetArg(argc++, scene.materialids);
-        shadekernel.SetArg(argc++, scene.materials);
-        shadekernel.SetArg(argc++, scene.textures);
-        shadekernel.SetArg(argc++, scene.texturedata);
-        shadekernel.SetArg(argc++, scene.envmapidx);
-        shadekernel.SetArg(argc++, scene.lights);
-        shadekernel.SetArg(argc++, scene.light_distributions);
-        shadekernel.SetArg(argc++, scene.num_lights);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->hitcount);
+        SetStaticArg(shadekernel, argc, bind, scene.vertices);
+        SetStaticArg(shadekernel, argc, bind, scene.normals);
+        SetStaticArg(shadekernel, argc, bind, scene.uvs);
+        SetStaticArg(shadekernel, argc, bind, scene.indices);
+        SetStaticArg(shadekernel, argc, bind, scene.shapes);
+        SetStaticArg(shadekernel, argc, bind, scene.materialids);
+        SetStaticArg(shadekernel, argc, bind, scene.materials);
+        SetTextureArgs(shadekernel, argc, bind, scene);
+        SetStaticArg(shadekernel, argc, bind, scene.envmapidx);
+        SetStaticArg(shadekernel, argc, bind, scene.lights);
+        SetStaticArg(shadekernel, argc, bind, scene.light_distributions);
+        SetStaticArg(shadekernel, argc, bind, scene.num_lights);
         shadekernel.SetArg(argc++, rand_uint());
-        shadekernel.SetArg(argc++, m_render_data->random);
-        shadekernel.SetArg(argc++, m_render_data->sobolmat);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->random);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->sobolmat);
         shadekernel.SetArg(argc++, pass);
         shadekernel.SetArg(argc++, m_sample_counter);
-        shadekernel.SetArg(argc++, scene.volumes);
-        shadekernel.SetArg(argc++, m_render_data->shadowrays);
-        shadekernel.SetArg(argc++, m_render_data->lightsamples);
-        shadekernel.SetArg(argc++, m_render_data->paths);
+        SetStaticArg(shadekernel, argc, bind, scene.volumes);
+        SetStaticArg(shadekernel, argc, bind, scene.volume_grids);
+        SetStaticArg(shadekernel, argc, bind, scene.volume_brick_indices);
+        SetStaticArg(shadekernel, argc, bind, scene.volume_bricks);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->shadowrays);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->lightsamples);
+        SetStaticArg(shadekernel, argc, bind, m_render_data->paths);
         shadekernel.SetArg(argc++, m_render_data->rays[(pass + 1) & 0x1]);
         shadekernel.SetArg(argc++, output);
 
@@ -371,7 +537,9 @@ namespace Baikal
     )
     {
         // Fetch kernel
-        auto evalkernel = GetKernel("EvaluateVolume");
+        auto& bound = m_render_data->kernels->evaluate_volume;
+        auto& evalkernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
 
         auto output_indices = use_output_indices ? m_render_data->output_indices : m_render_data->iota;
 
@@ -380,17 +548,19 @@ namespace Baikal
         evalkernel.SetArg(argc++, m_render_data->rays[pass & 0x1]);
         evalkernel.SetArg(argc++, m_render_data->pixelindices[(pass + 1) & 0x1]);
         evalkernel.SetArg(argc++, output_indices);
-        evalkernel.SetArg(argc++, m_render_data->hitcount);
-        evalkernel.SetArg(argc++, scene.volumes);
-        evalkernel.SetArg(argc++, scene.textures);
-        evalkernel.SetArg(argc++, scene.texturedata);
+        SetStaticArg(evalkernel, argc, bind, m_render_data->hitcount);
+        SetStaticArg(evalkernel, argc, bind, scene.volumes);
+        SetStaticArg(evalkernel, argc, bind, scene.volume_grids);
+        SetStaticArg(evalkernel, argc, bind, scene.volume_brick_indices);
+        SetStaticArg(evalkernel, argc, bind, scene.volume_bricks);
+        SetTextureArgs(evalkernel, argc, bind, scene);
         evalkernel.SetArg(argc++, rand_uint());
-        evalkernel.SetArg(argc++, m_render_data->random);
-        evalkernel.SetArg(argc++, m_render_data->sobolmat);
+        SetStaticArg(evalkernel, argc, bind, m_render_data->random);
+        SetStaticArg(evalkernel, argc, bind, m_render_data->sobolmat);
         evalkernel.SetArg(argc++, pass);
         evalkernel.SetArg(argc++, m_sample_counter);
-        evalkernel.SetArg(argc++, m_render_data->intersections);
-        evalkernel.SetArg(argc++, m_render_data->paths);
+        SetStaticArg(evalkernel, argc, bind, m_render_data->intersections);
+        SetStaticArg(evalkernel, argc, bind, m_render_data->paths);
         evalkernel.SetArg(argc++, output);
 
         // Run shading kernel
@@ -408,23 +578,28 @@ namespace Baikal
     )
     {
         // Fetch kernel
-        auto misskernel = GetKernel("ShadeBackgroundEnvMap");
+        auto& bound = m_render_data->kernels->shade_background;
+        auto& misskernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
 
         auto output_indices = use_output_indices ? m_render_data->output_indices : m_render_data->iota;
 
         // Set kernel parameters
         int argc = 0;
         misskernel.SetArg(argc++, m_render_data->rays[pass & 0x1]);
-        misskernel.SetArg(argc++, m_render_data->intersections);
+        SetStaticArg(misskernel, argc, bind, m_render_data->intersections);
         misskernel.SetArg(argc++, m_render_data->pixelindices[(pass + 1) & 0x1]);
         misskernel.SetArg(argc++, output_indices);
         misskernel.SetArg(argc++, (cl_int)size);
-        misskernel.SetArg(argc++, scene.lights);
-        misskernel.SetArg(argc++, scene.envmapidx);
-        misskernel.SetArg(argc++, scene.textures);
-        misskernel.SetArg(argc++, scene.texturedata);
-        misskernel.SetArg(argc++, m_render_data->paths);
-        misskernel.SetArg(argc++, scene.volumes);
+        SetStaticArg(misskernel, argc, bind, scene.lights);
+        SetStaticArg(misskernel, argc, bind, scene.envmapidx);
+        SetTextureArgs(misskernel, argc, bind, scene);
+        SetStaticArg(misskernel, argc, bind, m_render_data->paths);
+        SetStaticArg(misskernel, argc, bind, scene.volumes);
+        SetStaticArg(misskernel, argc, bind, scene.volume_grids);
+        SetStaticArg(misskernel, argc, bind, scene.volume_brick_indices);
+        SetStaticArg(misskernel, argc, bind, scene.volume_bricks);
+        misskernel.SetArg(argc++, rand_uint());
         misskernel.SetArg(argc++, output);
 
         {
@@ -441,7 +616,9 @@ namespace Baikal
     )
     {
         // Fetch kernel
-        auto gatherkernel = GetKernel("GatherLightSamples");
+        auto& bound = m_render_data->kernels->gather_light_samples;
+        auto& gatherkernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
 
         auto output_indices = use_output_indices ? m_render_data->output_indices : m_render_data->iota;
 
@@ -449,11 +626,13 @@ namespace Baikal
         int argc = 0;
         gatherkernel.SetArg(argc++, m_render_data->pixelindices[pass & 0x1]);
         gatherkernel.SetArg(argc++, output_indices);
-        gatherkernel.SetArg(argc++, m_render_data->hitcount);
-        gatherkernel.SetArg(argc++, m_render_data->shadowhits);
-        gatherkernel.SetArg(argc++, m_render_data->lightsamples);
-        gatherkernel.SetArg(argc++, m_render_data->paths);
+        SetStaticArg(gatherkernel, argc, bind, m_render_data->hitcount);
+        SetStaticArg(gatherkernel, argc, bind, m_render_data->shadowhits);
+        SetStaticArg(gatherkernel, argc, bind, m_render_data->lightsamples);
+        SetStaticArg(gatherkernel, argc, bind, m_render_data->paths);
         gatherkernel.SetArg(argc++, output);
+        SetStaticArg(gatherkernel, argc, bind, m_render_data->guiding_train);
+        SetStaticArg(gatherkernel, argc, bind, m_render_data->guiding_vertices);
 
         // Run shading kernel
         {
@@ -465,12 +644,14 @@ namespace Baikal
     void PathTracingEstimator::RestorePixelIndices(int pass, std::size_t size)
     {
         // Fetch kernel
-        CLWKernel restorekernel = GetKernel("RestorePixelIndices");
+        auto& bound = m_render_data->kernels->restore_pixel_indices;
+        auto& restorekernel = bound.kernel;
+        auto bind = bound.NeedsBinding(m_render_data.get(), 0);
 
         // Set kernel parameters
         int argc = 0;
-        restorekernel.SetArg(argc++, m_render_data->compacted_indices);
-        restorekernel.SetArg(argc++, m_render_data->hitcount);
+        SetStaticArg(restorekernel, argc, bind, m_render_data->compacted_indices);
+        SetStaticArg(restorekernel, argc, bind, m_render_data->hitcount);
         restorekernel.SetArg(argc++, m_render_data->pixelindices[(pass + 1) & 0x1]);
         restorekernel.SetArg(argc++, m_render_data->pixelindices[pass & 0x1]);
 
@@ -482,14 +663,18 @@ namespace Baikal
 
     void PathTracingEstimator::FilterPathStream(int pass, std::size_t size)
     {
-        auto restorekernel = GetKernel("FilterPathStream");
+        // Fetch kernel
+        auto& bound = m_render_data->kernels->filter_path_stream;
+        auto& restorekernel = bound.kernel;
+        auto bind = bound.NeedsBinding(m_render_data.get(), 0);
 
         int argc = 0;
-        restorekernel.SetArg(argc++, m_render_data->intersections);
-        restorekernel.SetArg(argc++, m_render_data->hitcount);
+        SetStaticArg(restorekernel, argc, bind, m_render_data->intersections);
+        SetStaticArg(restorekernel, argc, bind, m_render_data->hitcount);
         restorekernel.SetArg(argc++, m_render_data->pixelindices[(pass + 1) & 0x1]);
-        restorekernel.SetArg(argc++, m_render_data->paths);
-        restorekernel.SetArg(argc++, m_render_data->hits);
+        SetStaticArg(restorekernel, argc, bind, m_render_data->paths);
+        SetStaticArg(restorekernel, argc, bind, m_render_data->hits);
+        restorekernel.SetArg(argc++, (cl_int)size);
 
         {
             GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, restorekernel);
@@ -504,31 +689,154 @@ namespace Baikal
         bool use_output_indices
     )
     {
-        auto misskernel = GetKernel("ShadeMiss");
+        // Fetch kernel
+        auto& bound = m_render_data->kernels->shade_miss;
+        auto& misskernel = bound.kernel;
+        auto bind = bound.NeedsBinding(&scene, scene.revision);
 
         auto output_indices = use_output_indices ? m_render_data->output_indices : m_render_data->iota;
 
         int argc = 0;
         misskernel.SetArg(argc++, m_render_data->rays[pass & 0x1]);
-        misskernel.SetArg(argc++, m_render_data->intersections);
+        SetStaticArg(misskernel, argc, bind, m_render_data->intersections);
         misskernel.SetArg(argc++, m_render_data->pixelindices[(pass + 1) & 0x1]);
         misskernel.SetArg(argc++, output_indices);
-        misskernel.SetArg(argc++, m_render_data->hitcount);
-        misskernel.SetArg(argc++, scene.lights);
-        misskernel.SetArg(argc++, scene.light_distributions);
-        misskernel.SetArg(argc++, scene.num_lights);
-        misskernel.SetArg(argc++, scene.envmapidx);
-        misskernel.SetArg(argc++, scene.textures);
-        misskernel.SetArg(argc++, scene.texturedata);
-        misskernel.SetArg(argc++, m_render_data->paths);
-        misskernel.SetArg(argc++, scene.volumes);
+        SetStaticArg(misskernel, argc, bind, m_render_data->hitcount);
+        SetStaticArg(misskernel, argc, bind, scene.lights);
+        SetStaticArg(misskernel, argc, bind, scene.light_distributions);
+        SetStaticArg(misskernel, argc, bind, scene.num_lights);
+        SetStaticArg(misskernel, argc, bind, scene.envmapidx);
+        SetTextureArgs(misskernel, argc, bind, scene);
+        SetStaticArg(misskernel, argc, bind, m_render_data->paths);
+        SetStaticArg(misskernel, argc, bind, scene.volumes);
+        SetStaticArg(misskernel, argc, bind, scene.volume_grids);
+        SetStaticArg(misskernel, argc, bind, scene.volume_brick_indices);
+        SetStaticArg(misskernel, argc, bind, scene.volume_bricks);
+        misskernel.SetArg(argc++, rand_uint());
         misskernel.SetArg(argc++, output);
+        SetStaticArg(misskernel, argc, bind, m_render_data->guiding_train);
+        SetStaticArg(misskernel, argc, bind, m_render_data->guiding_vertices);
 
         {
             GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, misskernel);
         }
     }
 
+    void PathTracingEstimator::UpdatePathGuiding(ClwScene const& scene)
+    {
+        auto& data = *m_render_data;
+
+        // Start learning from scratch if the scene has changed, radiance does not depend on the camera
+        if (data.guiding_scene != &scene || data.guiding_revision != scene.content_revision)
+        {
+            auto size = GUIDING_NUM_CELLS * GUIDING_NUM_BINS;
+            GetContext().FillBuffer(0, data.guiding_train, 0.f, size);
+            GetContext().FillBuffer(0, data.guiding_radiance, 0.f, size);
+            GetContext().FillBuffer(0, data.guiding_cdf, 0.f, size);
+
+            data.guiding_scene = &scene;
+            data.guiding_revision = scene.content_revision;
+        }
+
+        // Every path keeps a ring of its latest guided vertices
+        auto num_vertices = GetWorkBufferSize() * GUIDING_PATH_VERTICES;
+        if (data.guiding_vertices.GetElementCount() < num_vertices)
+        {
+            data.guiding_vertices = GetContext().CreateBuffer<float4>(num_vertices, CL_MEM_READ_WRITE);
+
+            for (auto& kernels : data.kernel_sets)
+            {
+                kernels.second.Invalidate();
+            }
+        }
+
+        auto& bound = data.kernels->update_path_guiding;
+        auto& updatekernel = bound.kernel;
+
+        // All the arguments are guiding cache buffers
+        if (bound.NeedsBinding(m_render_data.get(), 0))
+        {
+            int argc = 0;
+            updatekernel.SetArg(argc++, data.guiding_train);
+            updatekernel.SetArg(argc++, data.guiding_radiance);
+            updatekernel.SetArg(argc++, data.guiding_cdf);
+        }
+
+        {
+            GetContext().Launch1D(0, ((GUIDING_NUM_CELLS + 63) / 64) * 64, 64, updatekernel);
+        }
+    }
+
+    void PathTracingEstimator::UpdateSceneBounds(ClwScene const& scene)
+    {
+        auto& data = *m_render_data;
+
+        if (data.bounds_scene != &scene || data.bounds_revision != scene.revision)
+        {
+            float3* bounds = nullptr;
+            GetContext().MapBuffer(0, data.scene_bounds, CL_MAP_WRITE, &bounds).Wait();
+            bounds[0] = scene.bounds.pmin;
+            bounds[1] = scene.bounds.pmax;
+            GetContext().UnmapBuffer(0, data.scene_bounds, bounds);
+
+            data.bounds_scene = &scene;
+            data.bounds_revision = scene.revision;
+        }
+    }
+
+    void PathTracingEstimator::SortRays(int pass, std::size_t size)
+    {
+        auto& data = *m_render_data;
+
+        // Generate keys
+        {
+            auto& bound = data.kernels->generate_ray_sort_keys;
+            auto& keykernel = bound.kernel;
+            auto bind = bound.NeedsBinding(m_render_data.get(), 0);
+
+            int argc = 0;
+            keykernel.SetArg(argc++, data.rays[pass & 0x1]);
+            SetStaticArg(keykernel, argc, bind, data.hitcount);
+            SetStaticArg(keykernel, argc, bind, data.scene_bounds);
+            keykernel.SetArg(argc++, (cl_int)size);
+            SetStaticArg(keykernel, argc, bind, data.sort_keys[0]);
+            SetStaticArg(keykernel, argc, bind, data.sort_values[0]);
+
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, keykernel);
+        }
+
+        // Ray count is only known on the device, so the whole buffer is sorted,
+        // unused entries have the largest key and end up after the rays
+        data.pp.SortRadix(
+            0,
+            data.sort_keys[0],
+            data.sort_keys[1],
+            data.sort_values[0],
+            data.sort_values[1],
+            (int)size
+        );
+
+        // Gather rays and pixel indices (carried along with rays) in sorted order
+        GetContext().CopyBuffer(0, data.rays[pass & 0x1], data.unsorted_rays, 0, 0, size);
+        GetContext().CopyBuffer(0, data.pixelindices[(pass + 1) & 0x1], data.unsorted_pixelindices, 0, 0, size);
+
+        {
+            auto& bound = data.kernels->reorder_rays;
+            auto& reorderkernel = bound.kernel;
+            auto bind = bound.NeedsBinding(m_render_data.get(), 0);
+
+            int argc = 0;
+            SetStaticArg(reorderkernel, argc, bind, data.sort_values[1]);
+            SetStaticArg(reorderkernel, argc, bind, data.hitcount);
+            SetStaticArg(reorderkernel, argc, bind, data.unsorted_rays);
+            SetStaticArg(reorderkernel, argc, bind, data.unsorted_pixelindices);
+            reorderkernel.SetArg(argc++, data.rays[pass & 0x1]);
+            reorderkernel.SetArg(argc++, data.pixelindices[(pass + 1) & 0x1]);
+
+            GetContext().Launch1D(0, ((size + 63) / 64) * 64, 64, reorderkernel);
+        }
+    }
+
     void PathTracingEstimator::SetRandomSeed(std::uint32_t seed)
     {
         std::srand(seed);
@@ -586,6 +894,12 @@ namespace Baikal
         RayTracingStats& stats
     )
     {
+        SelectKernels();
+        UpdateSceneBounds(scene);
+
+        // Paths are shaded over several bounces below
+        InitPathData(num_estimates);
+
         auto temporary = GetContext().CreateBuffer<float3>(num_estimates, CL_MEM_WRITE_ONLY);
 
         auto num_passes = 100u;
@@ -692,5 +1006,68 @@ namespace Baikal
             num_estimates / (((float)std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
                 / num_passes)
                 / 1000.f);
+
+        auto measure_secondary = [&](int pass)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (auto i = 0U; i < num_passes; ++i)
+            {
+                GetIntersector()->QueryIntersection(
+                    m_render_data->fr_rays[pass & 0x1],
+                    m_render_data->fr_hitcount,
+                    (std::uint32_t)num_estimates,
+                    m_render_data->fr_intersections,
+                    nullptr,
+                    nullptr
+                );
+            }
+
+            GetContext().Finish(0);
+
+            auto delta = std::chrono::high_resolution_clock::now() - start;
+
+            return num_estimates / (((float)std::chrono::duration_cast<std::chrono::milliseconds>(delta).count()
+                / num_passes)
+                / 1000.f);
+        };
+
+        // Measure traversal speed-up of coherence sorting bounce by bounce
+        stats.bounce_throughput.clear();
+        stats.bounce_sorted_throughput.clear();
+        stats.bounce_shading_time.clear();
+
+        for (auto pass = 1u; pass < GetMaxBounces(); ++pass)
+        {
+            stats.bounce_throughput.push_back(measure_secondary(pass));
+
+            SortRays(pass, num_estimates);
+
+            stats.bounce_sorted_throughput.push_back(measure_secondary(pass));
+
+            // Shade sorted hits to get rays of the next bounce
+            FilterPathStream(pass, num_estimates);
+
+            m_render_data->pp.Compact(
+                0,
+                m_render_data->hits,
+                m_render_data->iota,
+                m_render_data->compacted_indices,
+                (std::uint32_t)num_estimates,
+                m_render_data->hitcount);
+
+            RestorePixelIndices(pass, num_estimates);
+
+            GetContext().Finish(0);
+
+            auto shading_start = std::chrono::high_resolution_clock::now();
+
+            ShadeSurface(scene, pass, num_estimates, temporary, false);
+
+            GetContext().Finish(0);
+
+            stats.bounce_shading_time.push_back(std::chrono::duration<float, std::milli>(
+                std::chrono::high_resolution_clock::now() - shading_start).count());
+        }
     }
 }
@@ -234,7 +234,20 @@ namespace Baikal
         // Convert intersection info to compaction predicate
         void FilterPathStream(int pass, std::size_t size);
 
+        // Rebuild path guiding distributions from radiance gathered so far
+        void UpdatePathGuiding(ClwScene const& scene);
+
+        // Upload scene bounds if the scene has changed
+        void UpdateSceneBounds(ClwScene const& scene);
+
+        // Reorder rays of the pass by origin cell and direction octant
+        void SortRays(int pass, std::size_t size);
+
+        // Pick kernel handles of the currently built program
+        void SelectKernels();
+
         struct PathState;
+        struct KernelSet;
         struct RenderData;
 
         std::unique_ptr<RenderData> m_render_data;
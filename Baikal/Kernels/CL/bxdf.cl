@@ -62,6 +62,64 @@ float FresnelDielectric(float etai, float etat, float ndotwi, float ndotwt)
     return (rparl*rparl + rperp*rperp) * 0.5f;
 }
 
+/*
+ Directional albedo lookup tables
+ */
+// Tables are baked on the host (see Utils/bxdf_lut.h) and stored
+// at the beginning of texture data pool, constants should match.
+#define BXDF_LUT_SIZE 32
+#define BXDF_LUT_ETA_SIZE 16
+#define BXDF_LUT_MAX_ETA 3.f
+// Bounds transmission compensation factor
+#define BXDF_LUT_MIN_TRANSMISSION 0.25f
+
+// Bilinear lookup into [roughness][cos] table
+float4 BxdfLut_SampleSlice(__global float4 const* lut, float costheta, float roughness)
+{
+    float x = clamp(costheta, 0.f, 1.f) * (BXDF_LUT_SIZE - 1);
+    float y = clamp(roughness, 0.f, 1.f) * (BXDF_LUT_SIZE - 1);
+    int x0 = min((int)x, BXDF_LUT_SIZE - 2);
+    int y0 = min((int)y, BXDF_LUT_SIZE - 2);
+    float wx = x - x0;
+    float wy = y - y0;
+
+    float4 val00 = lut[y0 * BXDF_LUT_SIZE + x0];
+    float4 val01 = lut[y0 * BXDF_LUT_SIZE + x0 + 1];
+    float4 val10 = lut[(y0 + 1) * BXDF_LUT_SIZE + x0];
+    float4 val11 = lut[(y0 + 1) * BXDF_LUT_SIZE + x0 + 1];
+
+    return lerp(lerp(val00, val01, wx), lerp(val10, val11, wx), wy);
+}
+
+// Returns (E GGX, E Beckmann, average E GGX, average E Beckmann)
+float4 BxdfLut_GetAlbedo(float costheta, float roughness, TEXTURE_ARG_LIST)
+{
+    return BxdfLut_SampleSlice((__global float4 const*)texturedata, costheta, roughness);
+}
+
+// Returns (Fresnel averaged over GGX lobe, E GGX transmission, Fresnel averaged over Beckmann lobe, E Beckmann transmission)
+// for relative IOR eta = etat / etai
+float4 BxdfLut_GetDielectricAlbedo(float costheta, float roughness, float eta, TEXTURE_ARG_LIST)
+{
+    __global float4 const* lut = (__global float4 const*)texturedata + BXDF_LUT_SIZE * BXDF_LUT_SIZE;
+
+    float z = clamp(0.5f * (native_log(eta) / native_log(BXDF_LUT_MAX_ETA) + 1.f), 0.f, 1.f) * (BXDF_LUT_ETA_SIZE - 1);
+    int z0 = min((int)z, BXDF_LUT_ETA_SIZE - 2);
+    float wz = z - z0;
+
+    float4 val0 = BxdfLut_SampleSlice(lut + z0 * BXDF_LUT_SIZE * BXDF_LUT_SIZE, costheta, roughness);
+    float4 val1 = BxdfLut_SampleSlice(lut + (z0 + 1) * BXDF_LUT_SIZE * BXDF_LUT_SIZE, costheta, roughness);
+
+    return lerp(val0, val1, wz);
+}
+
+// Kulla-Conty multiple scattering lobe: energy lost by single scattering
+// is redistributed with a reciprocal diffuse-like term
+float Microfacet_GetMultiscatter(float ei, float eo, float eavg)
+{
+    return eavg < 0.999f ? (1.f - ei) * (1.f - eo) / (PI * (1.f - eavg)) : 0.f;
+}
+
 /*
  Microfacet Beckmann
  */
@@ -137,7 +195,12 @@ float MicrofacetDistribution_Beckmann_G1(float roughness, float3 v, float3 m)
     float mdotv = fabs(dot(m, v));
     float sinnv = native_sqrt(1.f - clamp(ndotv * ndotv, 0.f, 1.f));
     float tannv = ndotv > DENOM_EPS ? sinnv / ndotv : 0.f;
-    float a = tannv > DENOM_EPS ? 1.f / (roughness * tannv) : 0.f; 
+
+    // No shadowing at normal incidence
+    if (tannv <= DENOM_EPS)
+        return 1.f;
+
+    float a = 1.f / (roughness * tannv);
     float a2 = a * a;
 
     if (a > 1.6f)
@@ -164,8 +227,8 @@ float3 MicrofacetBeckmann_Evaluate(
     TEXTURE_ARG_LIST
     )
 {
-    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
-    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
+    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
     const float eta = dg->mat.simple.ni;
 
     // Incident and reflected zenith angles
@@ -179,8 +242,13 @@ float3 MicrofacetBeckmann_Evaluate(
 
     float denom = 4.f * costhetao * costhetai;
 
-    // F(eta) * D * G * ks / (4 * cosa * cosi)
-    return denom > DENOM_EPS ? F * ks * MicrofacetDistribution_Beckmann_G(roughness, wi, wo, wh) * MicrofacetDistribution_Beckmann_D(roughness, wh) / denom : 0.f;
+    // Multiple scattering compensation
+    float4 ei = BxdfLut_GetAlbedo(costhetai, roughness, TEXTURE_ARGS);
+    float4 eo = BxdfLut_GetAlbedo(costhetao, roughness, TEXTURE_ARGS);
+    float fms = Microfacet_GetMultiscatter(ei.y, eo.y, eo.w);
+
+    // F(eta) * (D * G / (4 * cosa * cosi) + fms) * ks
+    return denom > DENOM_EPS ? F * ks * (MicrofacetDistribution_Beckmann_G(roughness, wi, wo, wh) * MicrofacetDistribution_Beckmann_D(roughness, wh) / denom + fms) : 0.f;
 }
 
 
@@ -195,7 +263,7 @@ float MicrofacetBeckmann_GetPdf(
     TEXTURE_ARG_LIST
     )
 {
-    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
+    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
     return MicrofacetDistribution_Beckmann_GetPdf(roughness, dg, wi, wo, TEXTURE_ARGS);
 }
 
@@ -214,7 +282,7 @@ float3 MicrofacetBeckmann_Sample(
     float* pdf
     )
 {
-    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
+    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
 
     float3 wh;
     MicrofacetDistribution_Beckmann_SampleNormal(roughness, dg, TEXTURE_ARGS, sample, &wh);
@@ -324,8 +392,8 @@ float3 MicrofacetGGX_Evaluate(
     TEXTURE_ARG_LIST
     )
 {
-    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
-    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
+    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
 
     // Incident and reflected zenith angles
     float costhetao = fabs(wo.y);
@@ -337,8 +405,13 @@ float3 MicrofacetGGX_Evaluate(
     float F = dg->mat.simple.fresnel;
 
     float denom = (4.f * costhetao * costhetai);
+
+    // Multiple scattering compensation
+    float4 ei = BxdfLut_GetAlbedo(costhetai, roughness, TEXTURE_ARGS);
+    float4 eo = BxdfLut_GetAlbedo(costhetao, roughness, TEXTURE_ARGS);
+    float fms = Microfacet_GetMultiscatter(ei.x, eo.x, eo.z);
     
-    return denom > DENOM_EPS ? F * ks * MicrofacetDistribution_GGX_G(roughness, wi, wo, wh) * MicrofacetDistribution_GGX_D(roughness, wh) / denom : 0.f;
+    return denom > DENOM_EPS ? F * ks * (MicrofacetDistribution_GGX_G(roughness, wi, wo, wh) * MicrofacetDistribution_GGX_D(roughness, wh) / denom + fms) : 0.f;
 }
 
 
@@ -353,7 +426,7 @@ float MicrofacetGGX_GetPdf(
     TEXTURE_ARG_LIST
     )
 {
-    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
+    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
 
     float3 wh = normalize(wo + wi);
 
@@ -375,7 +448,7 @@ float3 MicrofacetGGX_Sample(
     float* pdf
     )
 {
-    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
+    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
 
     float3 wh;
     MicrofacetDistribution_GGX_SampleNormal(roughness, dg, TEXTURE_ARGS, sample, &wh);
@@ -403,7 +476,7 @@ float3 Lambert_Evaluate(
     TEXTURE_ARG_LIST
     )
 {
-    const float3 kd = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float3 kd = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
 
     float F = dg->mat.simple.fresnel;
 
@@ -441,7 +514,7 @@ float3 Lambert_Sample(
     float* pdf
     )
 {
-    const float3 kd = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float3 kd = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
 
     *wo = Sample_MapToHemisphere(sample, make_float3(0.f, 1.f, 0.f) , 1.f);
 
@@ -485,7 +558,7 @@ float3 Translucent_Sample(
     float* pdf
     )
 {
-    const float3 kd = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float3 kd = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
 
     float ndotwi = wi.y;
 
@@ -510,7 +583,7 @@ float3 Translucent_Evaluate(
     TEXTURE_ARG_LIST
     )
 {
-    const float3 kd = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float3 kd = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
 
     float ndotwi = wi.y;
     float ndotwo = wo.y;
@@ -571,7 +644,7 @@ float3 IdealReflect_Sample(
     float* pdf
     )
 {
-    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
     const float eta = dg->mat.simple.ni;
 
     // Mirror reflect wi
@@ -636,7 +709,7 @@ float3 IdealRefract_Sample(
     float* pdf
     )
 {
-    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
 
     float etai = 1.f;
     float etat = dg->mat.simple.ni;
@@ -686,8 +759,8 @@ float3 MicrofacetRefractionGGX_Evaluate(
     TEXTURE_ARG_LIST
     )
 {
-    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
-    const float roughness = max(Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx)), ROUGHNESS_EPS);
+    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float roughness = max(Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx)), ROUGHNESS_EPS);
 
     float ndotwi = wi.y;
     float ndotwo = wo.y;
@@ -720,8 +793,12 @@ float3 MicrofacetRefractionGGX_Evaluate(
     float denom = dot(ht, ht);
     denom *= (fabs(ndotwi) * fabs(ndotwo));
 
+    // Scale by inverse single scattering albedo to compensate energy lost at high roughness
+    float et = BxdfLut_GetDielectricAlbedo(fabs(ndotwi), roughness, etat / etai, TEXTURE_ARGS).y;
+    float compensation = 1.f / max(et, BXDF_LUT_MIN_TRANSMISSION);
+
     return denom > DENOM_EPS ? (F * ks * (widotwh * wodotwh)  * (etat)* (etat)*
-        MicrofacetDistribution_GGX_G(roughness, wi, wo, wh) * MicrofacetDistribution_GGX_D(roughness, wh) / denom) : 0.f;
+        MicrofacetDistribution_GGX_G(roughness, wi, wo, wh) * MicrofacetDistribution_GGX_D(roughness, wh) * compensation / denom) : 0.f;
 }
 
 
@@ -737,7 +814,7 @@ float MicrofacetRefractionGGX_GetPdf(
     TEXTURE_ARG_LIST
     )
 {
-    const float roughness = max(Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx)), ROUGHNESS_EPS);
+    const float roughness = max(Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx)), ROUGHNESS_EPS);
     float ndotwi = wi.y;
     float ndotwo = wo.y;
 
@@ -788,8 +865,8 @@ float3 MicrofacetRefractionGGX_Sample(
     float* pdf
     )
 {
-    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
-    const float roughness = max(Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx)), ROUGHNESS_EPS);
+    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float roughness = max(Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx)), ROUGHNESS_EPS);
 
     float ndotwi = wi.y;
 
@@ -818,7 +895,7 @@ float3 MicrofacetRefractionGGX_Sample(
     float c = dot(wi, wh);
     float eta = etai / etat;
 
-    float d = 1 + eta * (c * c - 1);
+    float d = 1 + eta * eta * (c * c - 1);
 
     if (d <= 0.f)
     {
@@ -844,8 +921,8 @@ float3 MicrofacetRefractionBeckmann_Evaluate(
     TEXTURE_ARG_LIST
     )
 {
-    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
-    const float roughness = max(Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx)), ROUGHNESS_EPS);
+    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float roughness = max(Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx)), ROUGHNESS_EPS);
 
     float ndotwi = wi.y;
     float ndotwo = wo.y;
@@ -873,8 +950,12 @@ float3 MicrofacetRefractionBeckmann_Evaluate(
     float denom = dot(ht, ht);
     denom *= (fabs(ndotwi) * fabs(ndotwo));
 
+    // Scale by inverse single scattering albedo to compensate energy lost at high roughness
+    float et = BxdfLut_GetDielectricAlbedo(fabs(ndotwi), roughness, etat / etai, TEXTURE_ARGS).w;
+    float compensation = 1.f / max(et, BXDF_LUT_MIN_TRANSMISSION);
+
     return denom > DENOM_EPS ? (F * ks * (widotwh * wodotwh)  * (etat)* (etat)*
-        MicrofacetDistribution_Beckmann_G(roughness, wi, wo, wh) * MicrofacetDistribution_Beckmann_D(roughness, wh) / denom) : 0.f;
+        MicrofacetDistribution_Beckmann_G(roughness, wi, wo, wh) * MicrofacetDistribution_Beckmann_D(roughness, wh) * compensation / denom) : 0.f;
 }
 
 
@@ -890,7 +971,7 @@ float MicrofacetRefractionBeckmann_GetPdf(
     TEXTURE_ARG_LIST
     )
 {
-    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
+    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
     float ndotwi = wi.y;
     float ndotwo = wo.y;
 
@@ -936,8 +1017,8 @@ float3 MicrofacetRefractionBeckmann_Sample(
     float* pdf
     )
 {
-    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
-    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
+    const float3 ks = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float roughness = Texture_GetValue1f(dg->mat.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.nsmapidx));
 
     float ndotwi = wi.y;
 
@@ -960,7 +1041,7 @@ float3 MicrofacetRefractionBeckmann_Sample(
     float c = dot(wi, wh);
     float eta = etai / etat;
 
-    float d = 1 + eta * (c * c - 1);
+    float d = 1 + eta * eta * (c * c - 1);
 
     if (d <= 0)
     {
@@ -1166,7 +1247,7 @@ float3 Emissive_GetLe(
     // Texture args
     TEXTURE_ARG_LIST)
 {
-    const float3 kd = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
+    const float3 kd = Texture_GetValue3f(dg->mat.simple.kx.xyz, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(dg->mat.simple.kxmapidx));
     return kd;
 }
 
@@ -40,6 +40,9 @@ THE SOFTWARE.
 #define CRAZY_LOW_DISTANCE 0.001f
 #define REASONABLE_RADIANCE(x) (clamp((x), 0.f, CRAZY_HIGH_RADIANCE))
 #define NON_BLACK(x) (length(x) > 0.f)
+// Fraction of the cone subtending 1/pdf solid angle a rough bounce adds to ray cone spread.
+// Full cone overblurs since pixel samples already average over the lobe.
+#define RAY_CONE_BXDF_SPREAD 0.25f
 
 #define MULTISCATTER
 
@@ -51,7 +54,13 @@ THE SOFTWARE.
 
 #define CMJ_DIM 16
 
+// Vertices per BDPT subpath including the one on the camera or the light,
+// i.e. each subpath bounces at most BDPT_MAX_SUBPATH_LEN - 1 times and full
+// paths are at most 2 * (BDPT_MAX_SUBPATH_LEN - 1) bounces long.
+// BidirectionalEstimator defines it from max bounces and sizes subpath buffers to match.
+#ifndef BDPT_MAX_SUBPATH_LEN
 #define BDPT_MAX_SUBPATH_LEN 3
+#endif
 
 #ifdef BAIKAL_ATOMIC_RESOLVE
 #define ADD_FLOAT3(x,y) atomic_add_float3((x),(y))
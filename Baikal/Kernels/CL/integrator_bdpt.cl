@@ -29,14 +29,13 @@ THE SOFTWARE.
 #include <../Baikal/Kernels/CL/normalmap.cl>
 #include <../Baikal/Kernels/CL/bxdf.cl>
 #include <../Baikal/Kernels/CL/light.cl>
-#include <../Baikal/Kernels/CL/camera.cl>
 #include <../Baikal/Kernels/CL/scene.cl>
 #include <../Baikal/Kernels/CL/material.cl>
 #include <../Baikal/Kernels/CL/volumetrics.cl>
 #include <../Baikal/Kernels/CL/path.cl>
 #include <../Baikal/Kernels/CL/vertex.cl>
 
-// Convert PDF of sampling point po from point p from solid angle measure to area measure
+// Convert PDF of sampling point p with normal n from point po from solid angle measure to area measure
 INLINE
 float Pdf_ConvertSolidAngleToArea(float pdf, float3 po, float3 p, float3 n)
 {
@@ -45,6 +44,196 @@ float Pdf_ConvertSolidAngleToArea(float pdf, float3 po, float3 p, float3 n)
     return pdf * fabs(dot(normalize(v), n)) / (dist * dist);
 }
 
+// Get PDF of light subpath starting at point pl of the light towards point p with normal n, in area measure at p.
+// Area lights emit with cosine distribution, point lights uniformly, other lights do not start light subpaths.
+// Light PDF is solid angle PDF of sampling pl from p, cosine at area light is recovered from it.
+INLINE
+float Light_GetEmissionPdf(Scene const* scene, int light_idx, float3 pl, float light_pdf, float3 p, float3 n)
+{
+    GLOBAL Light const* light = &scene->lights[light_idx];
+    float3 v = p - pl;
+    float dist2 = dot(v, v);
+
+    if (dist2 <= 0.f)
+    {
+        return 0.f;
+    }
+
+    float cos_p = fabs(dot(normalize(v), n));
+
+    if (light->type == kPoint)
+    {
+        return cos_p / (4.f * PI * dist2);
+    }
+
+    if (light->type == kArea && light_pdf > 0.f)
+    {
+        float3 v0, v1, v2;
+        Scene_GetTriangleVertices(scene, light->shapeidx, light->primidx, &v0, &v1, &v2);
+        float area = 0.5f * length(cross(v2 - v0, v1 - v0));
+
+        // Area lights are sampled uniformly, so light PDF is dist2 / (area * cos_light)
+        float cos_light = area > 0.f ? min(dist2 / (area * light_pdf), 1.f) : 0.f;
+        return cos_light / PI * cos_p / dist2;
+    }
+
+    return 0.f;
+}
+
+// Ratio of backward and forward PDFs of a vertex.
+// Singular vertices have zero PDFs, they are the same for every strategy going through them.
+INLINE
+float Bdpt_GetPdfRatio(float pdf_bwd, float pdf_fwd)
+{
+    return (pdf_bwd > 0.f ? pdf_bwd : 1.f) / (pdf_fwd > 0.f ? pdf_fwd : 1.f);
+}
+
+// Power heuristic MIS weight of a strategy connecting eye subpath of t vertices to light subpath of s vertices.
+// Arrays hold PDFs of sampling each vertex by its own subpath walk (forward) and by the opposite one (backward),
+// both in the same measure, and singular flags.
+//
+// Strategies of the estimator are:
+// s = 0 - BxDF sampling from eye vertex t - 2 hitting the light (ConnectDirect),
+// s = 1 - light sampling from eye vertex t - 1 (ConnectDirect),
+// s > 1 - connection of eye vertex t - 1 to light vertex s - 1 (Connect),
+// eye vertex index has to be within [1, max_vertex_index], light tracing to the camera (t = 1) is not done.
+// Only these strategies go into the weight, otherwise the estimator would be biased.
+INLINE
+float Bdpt_GetMisWeight(
+    float const* eye_pdf_fwd,
+    float const* eye_pdf_bwd,
+    int const* eye_singular,
+    int t,
+    float const* light_pdf_fwd,
+    float const* light_pdf_bwd,
+    int const* light_singular,
+    int s,
+    int max_vertex_index
+)
+{
+    float sum = 0.f;
+
+    // Move eye vertices to light subpath, strategy (s + t - i, i)
+    // connects eye vertex i - 1 to light vertex s + t - i - 1
+    float r = 1.f;
+    for (int i = t - 1; i > 1 && s + t - i - 1 <= max_vertex_index; --i)
+    {
+        r *= Bdpt_GetPdfRatio(eye_pdf_bwd[i], eye_pdf_fwd[i]);
+
+        if (!eye_singular[i] && !eye_singular[i - 1])
+        {
+            sum += r * r;
+        }
+    }
+
+    // Move light vertices to eye subpath, strategy (i, s + t - i)
+    // connects eye vertex s + t - i - 1 to light vertex i - 1 or hits the light from eye vertex s + t - 2
+    r = 1.f;
+    for (int i = s - 1; i >= 0 && s + t - max(i, 1) - 1 <= max_vertex_index; --i)
+    {
+        r *= Bdpt_GetPdfRatio(light_pdf_bwd[i], light_pdf_fwd[i]);
+
+        // Singular lights can't be hit, but can be connected to
+        bool singular_connection = light_singular[i] || (i > 1 && light_singular[i - 1]);
+
+        if (!singular_connection)
+        {
+            sum += r * r;
+        }
+    }
+
+    return 1.f / (1.f + sum);
+}
+
+// Start eye subpaths from the camera rays generated by the client
+KERNEL void InitEyeSubpath(
+    // Number of rays
+    GLOBAL int const* restrict num_rays,
+    // Camera rays
+    GLOBAL ray* restrict rays,
+    // Pixel indices
+    GLOBAL int* restrict pixel_indices0,
+    GLOBAL int* restrict pixel_indices1,
+    // Eye subpath
+    GLOBAL PathVertex* restrict eye_subpath,
+    // Eye subpath length
+    GLOBAL int* restrict eye_subpath_length,
+    // Path buffer
+    GLOBAL Path* restrict paths
+)
+{
+    int global_id = get_global_id(0);
+
+    if (global_id < *num_rays)
+    {
+        GLOBAL ray* my_ray = rays + global_id;
+        GLOBAL Path* my_path = paths + global_id;
+
+        pixel_indices0[global_id] = global_id;
+        pixel_indices1[global_id] = global_id;
+
+        // Camera vertex is sampled with probability 1
+        Ray_SetExtra(my_ray, make_float2(1.f, 0.f));
+
+        PathVertex v;
+        PathVertex_Init(&v,
+            my_ray->o.xyz,
+            my_ray->d.xyz,
+            my_ray->d.xyz,
+            0.f,
+            1.f,
+            1.f,
+            1.f,
+            kCamera,
+            -1);
+
+        eye_subpath[BDPT_MAX_SUBPATH_LEN * global_id] = v;
+        eye_subpath_length[global_id] = 1;
+
+        my_path->throughput = make_float3(1.f, 1.f, 1.f);
+        my_path->volume = INVALID_IDX;
+        my_path->flags = 0;
+        my_path->active = 0xFF;
+    }
+}
+
+// Add environment contribution for camera rays which missed the scene and count the sample
+KERNEL void ShadeBackgroundEnvMap(
+    // Ray batch
+    GLOBAL ray const* restrict rays,
+    // Intersection data
+    GLOBAL Intersection const* restrict isects,
+    // Output indices
+    GLOBAL int const* restrict output_indices,
+    // Number of rays
+    int num_rays,
+    GLOBAL Light const* restrict lights,
+    int env_light_idx,
+    // Textures
+    TEXTURE_ARG_LIST,
+    // Output values
+    GLOBAL float4* restrict output
+)
+{
+    int global_id = get_global_id(0);
+
+    if (global_id < num_rays)
+    {
+        int output_index = output_indices[global_id];
+
+        float4 v = make_float4(0.f, 0.f, 0.f, 1.f);
+
+        // In case of a miss
+        if (isects[global_id].shapeid < 0 && env_light_idx != -1)
+        {
+            Light light = lights[env_light_idx];
+            v.xyz = light.multiplier * Texture_SampleEnvMap(rays[global_id].d.xyz, TEXTURE_ARGS_IDX(light.tex));
+        }
+
+        ADD_FLOAT4(&output[output_index], v);
+    }
+}
+
 KERNEL void GenerateLightVertices(
     // Number of subpaths to generate
     int num_subpaths,
@@ -68,13 +257,15 @@ KERNEL void GenerateLightVertices(
     int env_light_idx,
     // Emissives
     GLOBAL Light const* restrict lights,
+    // Light distribution
+    GLOBAL int const* restrict light_distribution,
     // Number of emissive objects
     int num_lights,
     // RNG seed value
     uint rngseed,
     int frame,
     // RNG data
-    GLOBAL uint const* restrict random,
+    GLOBAL uint* restrict random,
     GLOBAL uint const* restrict sobolmat,
     // Output rays
     GLOBAL ray* restrict rays,
@@ -97,7 +288,8 @@ KERNEL void GenerateLightVertices(
         materials,
         lights,
         env_light_idx,
-        num_lights
+        num_lights,
+        light_distribution
     };
 
     int global_id = get_global_id(0); 
@@ -141,6 +333,23 @@ KERNEL void GenerateLightVertices(
         float light_pdf;
         float3 ke = Light_SampleVertex(idx, &scene, TEXTURE_ARGS, sample0, sample1, &p, &n, &wo, &light_pdf);
 
+        // Light PDF is a product of position and direction PDFs, vertex on the light
+        // gets the former and the next vertex is sampled with the latter
+        float dir_pdf = scene.lights[idx].type == kArea ? fabs(dot(n, wo)) / PI : 1.f / (4.f * PI);
+
+        // Only area and point lights can start a light subpath
+        if (light_pdf <= 0.f || selection_pdf <= 0.f || dir_pdf <= 0.f)
+        {
+            *my_count = 0;
+            Path_Kill(my_path);
+            Ray_SetInactive(my_ray);
+            return;
+        }
+
+        // Point lights emit uniformly, area lights have cosine falloff
+        float cos_term = scene.lights[idx].type == kArea ? fabs(dot(n, wo)) : 1.f;
+        float3 flow = ke * cos_term / (selection_pdf * light_pdf);
+
         // Calculate direction to image plane
         my_ray->d.xyz = normalize(wo);
         // Origin == camera position + nearz * d
@@ -152,7 +361,7 @@ KERNEL void GenerateLightVertices(
         // Set ray max
         my_ray->extra.x = 0xFFFFFFFF;
         my_ray->extra.y = 0xFFFFFFFF;
-        Ray_SetExtra(my_ray, 1.f);
+        Ray_SetExtra(my_ray, make_float2(dir_pdf, 0.f));
 
         PathVertex v;
         PathVertex_Init(&v,
@@ -160,17 +369,22 @@ KERNEL void GenerateLightVertices(
             n,
             n,
             0.f,
-            selection_pdf * light_pdf,
-            1.f,
-            100.f,//ke * fabs(dot(n, my_ray->d.xyz)) / selection_pdf * light_pdf,
+            selection_pdf * light_pdf / dir_pdf,
+            0.f,
+            flow,
             kLight,
             -1);
 
+        if (Light_IsSingular(&scene.lights[idx]))
+        {
+            v.flags = kVertexSingular;
+        }
+
         *my_count = 1;
         *my_vertex = v;
 
         // Initlize path data
-        my_path->throughput = ke * fabs(dot(n, my_ray->d.xyz)) / selection_pdf * light_pdf;
+        my_path->throughput = flow;
         my_path->volume = -1;
         my_path->flags = 0;
         my_path->active = 0xFF;
@@ -208,6 +422,8 @@ KERNEL void SampleSurface(
     int env_light_idx,
     // Emissives
     GLOBAL Light const* lights,
+    // Light distribution
+    GLOBAL int const* light_distribution,
     // Number of emissive objects
     int num_lights,
     // RNG seed
@@ -228,7 +444,11 @@ KERNEL void SampleSurface(
     GLOBAL ray* extension_rays,
     // Vertices
     GLOBAL PathVertex* subpath,
-    GLOBAL int* subpath_length
+    GLOBAL int* subpath_length,
+    // Output indices
+    GLOBAL int const* output_indices,
+    // Radiance
+    GLOBAL float3* output
 )
     {
         int global_id = get_global_id(0);
@@ -244,7 +464,8 @@ KERNEL void SampleSurface(
             materials,
             lights,
             env_light_idx,
-            num_lights
+            num_lights,
+            light_distribution
         };
 
         // Only applied to active rays after compaction
@@ -300,7 +521,16 @@ KERNEL void SampleSurface(
             // Terminate if emissive
             if (Bxdf_IsEmissive(&diffgeo)) 
             {
+                // Emitters seen directly from the camera, all other eye subpath
+                // hits are accounted for by ConnectDirect
+                if (transfer_mode == 0 && bounce == 0 && !backfacing)
+                {
+                    float3 v = Path_GetThroughput(path) * Emissive_GetLe(&diffgeo, TEXTURE_ARGS);
+                    ADD_FLOAT3(&output[output_indices[pixel_idx]], v);
+                }
+
                 Path_Kill(path);
+                Ray_SetInactive(extension_rays + global_id);
                 return;
             }
 
@@ -317,7 +547,7 @@ KERNEL void SampleSurface(
             }
 
             // Check if we need to apply normal map
-            DifferentialGeometry_ApplyBumpNormalMap(&diffgeo, TEXTURE_ARGS);
+            DifferentialGeometry_ApplyNormalMap(&diffgeo, TEXTURE_ARGS);
             DifferentialGeometry_CalculateTangentTransforms(&diffgeo);
 
             float lightpdf = 0.f;
@@ -340,9 +570,9 @@ KERNEL void SampleSurface(
             bxdfwo = normalize(bxdfwo);
             float3 t = bxdf * fabs(dot(diffgeo.n, bxdfwo));
 
-            // Write path vertex
+            // Write path vertex (each subpath is extended by a single work item)
             GLOBAL int* my_counter = subpath_length + pixel_idx;
-            int idx = atom_inc(my_counter);
+            int idx = *my_counter;
 
             if (idx < BDPT_MAX_SUBPATH_LEN)
             {
@@ -365,10 +595,20 @@ KERNEL void SampleSurface(
                     kSurface,
                     diffgeo.material_index);
 
-                *my_vertex = v;
+                if (Bxdf_IsSingular(&diffgeo))
+                {
+                    v.flags = kVertexSingular;
+                }
 
-                // TODO: wrong
-                if (my_prev_vertex->type == kSurface)
+                *my_vertex = v;
+                *my_counter = idx + 1;
+
+                // Backward PDF of the previous vertex is PDF of sampling it from this one arriving
+                // from the next vertex of the subpath. It is only valid while the subpath continues
+                // through the next vertex, connections recompute it for the two vertices they end at.
+                // Camera is never sampled from the scene (no light tracing to the camera),
+                // light vertex gets PDF of being hit by the opposite walk.
+                if (my_prev_vertex->type != kCamera)
                 {
                     float pdf_bwd = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&diffgeo, bxdfwo, wi, TEXTURE_ARGS), diffgeo.p, my_prev_vertex->position, my_prev_vertex->shading_normal);
                     my_prev_vertex->pdf_backward = pdf_bwd;
@@ -376,7 +616,6 @@ KERNEL void SampleSurface(
             }
             else
             {
-                atom_dec(my_counter);
                 Path_Kill(path);
                 Ray_SetInactive(extension_rays + global_id);
                 return;
@@ -406,6 +645,8 @@ KERNEL void SampleSurface(
 
     KERNEL void ConnectDirect(
         int eye_vertex_index,
+        // Max eye and light vertex index connections are done for
+        int max_vertex_index,
         int num_rays,
         GLOBAL int const* pixel_indices,
         GLOBAL PathVertex const* restrict eye_subpath,
@@ -420,6 +661,7 @@ KERNEL void SampleSurface(
         TEXTURE_ARG_LIST,
         int env_light_idx,
         GLOBAL Light const* restrict lights,
+        GLOBAL int const* restrict light_distribution,
         int num_lights,
         uint rngseed,
         GLOBAL uint const* restrict random,
@@ -444,10 +686,11 @@ KERNEL void SampleSurface(
             diffgeo.n = my_eye_vertex->shading_normal;
             diffgeo.ng = my_eye_vertex->geometric_normal;
             diffgeo.uv = my_eye_vertex->uv;
+            diffgeo.uv_footprint = 0.f;
             diffgeo.dpdu = GetOrthoVector(diffgeo.n);
             diffgeo.dpdv = cross(diffgeo.n, diffgeo.dpdu);
             diffgeo.mat = materials[my_eye_vertex->material_index];
-            diffgeo.mat.fresnel = 1.f;
+            diffgeo.mat.simple.fresnel = 1.f;
             DifferentialGeometry_CalculateTangentTransforms(&diffgeo);
 
             float3 wi = normalize(my_prev_eye_vertex->position - diffgeo.p);
@@ -471,20 +714,21 @@ KERNEL void SampleSurface(
                 materials,
                 lights,
                 env_light_idx,
-                num_lights
+                num_lights,
+                light_distribution
             };
 
             Sampler sampler;
 #if SAMPLER == SOBOL
             uint scramble = random[global_id] * 0x1fe3434f;
-            Sampler_Init(&sampler, frame, SAMPLE_DIM_SURFACE_OFFSET + eye_vertex_index * SAMPLE_DIMS_PER_BOUNCE, scramble); 
+            Sampler_Init(&sampler, frame, SAMPLE_DIM_CONNECT_OFFSET + eye_vertex_index * SAMPLE_DIMS_PER_BOUNCE, scramble);
 #elif SAMPLER == RANDOM
             uint scramble = global_id * rngseed;
             Sampler_Init(&sampler, scramble);
 #elif SAMPLER == CMJ
             uint rnd = random[global_id];
             uint scramble = rnd * 0x1fe3434f * ((frame + 331 * rnd) / (CMJ_DIM * CMJ_DIM));
-            Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_SURFACE_OFFSET + eye_vertex_index * SAMPLE_DIMS_PER_BOUNCE, scramble);
+            Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_CONNECT_OFFSET + eye_vertex_index * SAMPLE_DIMS_PER_BOUNCE, scramble);
 #endif
 
             float selection_pdf;
@@ -495,9 +739,6 @@ KERNEL void SampleSurface(
             float lightbxdfpdf = 0.f;
             float bxdfpdf = 0.f;
             float bxdflightpdf = 0.f;
-            float lightweight = 0.f;
-            float bxdfweight = 0.f;
-
 
             float3 lightwo;
             float3 bxdfwo;
@@ -508,8 +749,6 @@ KERNEL void SampleSurface(
 
             bool singular_light = Light_IsSingular(&scene.lights[light_idx]);
             bool singular_bxdf = Bxdf_IsSingular(&diffgeo);
-            lightweight = singular_light ? 1.f : BalanceHeuristic(1, lightpdf * selection_pdf, 1, lightbxdfpdf);
-            bxdfweight = singular_bxdf ? 1.f : BalanceHeuristic(1, bxdfpdf, 1, bxdflightpdf * selection_pdf);
 
             float3 radiance = 0.f; 
             float3 wo;
@@ -522,21 +761,62 @@ KERNEL void SampleSurface(
                 return;
             }
 
+            // PDFs of the eye subpath for MIS, one more vertex for the light hit by BxDF sampling
+            float eye_pdf_fwd[BDPT_MAX_SUBPATH_LEN + 1];
+            float eye_pdf_bwd[BDPT_MAX_SUBPATH_LEN + 1];
+            int eye_singular[BDPT_MAX_SUBPATH_LEN + 1];
+
+            for (int i = 0; i <= eye_vertex_index; ++i)
+            {
+                GLOBAL PathVertex const* v = eye_subpath + BDPT_MAX_SUBPATH_LEN * pixel_idx + i;
+                eye_pdf_fwd[i] = v->pdf_forward;
+                eye_pdf_bwd[i] = v->pdf_backward;
+                eye_singular[i] = v->flags & kVertexSingular;
+            }
+
+            // Light is either sampled or hit, this is one-sample MIS of both strategies
+            float light_sampling_prob = singular_light ? 1.f : (singular_bxdf ? 0.f : 0.5f);
             float split = Sampler_Sample1D(&sampler, SAMPLER_ARGS);
 
-            if (((singular_bxdf && !singular_light) || split < 0.5f) && bxdfpdf > 0.f)
+            if (split >= light_sampling_prob && bxdfpdf > 0.f)
             {
                 wo = CRAZY_HIGH_DISTANCE * bxdfwo; 
                 float ndotwo = fabs(dot(diffgeo.n, normalize(wo)));
                 le = Light_GetLe(light_idx, &scene, &diffgeo, &wo, TEXTURE_ARGS);
-                radiance = 2.f * bxdfweight * le * throughput * bxdf * ndotwo / bxdfpdf;
+
+                // Light is the last eye subpath vertex, PDFs are in solid angle measure at the connecting vertex
+                int t = eye_vertex_index + 2;
+                eye_pdf_fwd[t - 1] = bxdfpdf;
+                eye_pdf_bwd[t - 1] = bxdflightpdf * selection_pdf;
+                eye_singular[t - 1] = 0;
+                eye_pdf_bwd[t - 2] = Light_GetEmissionPdf(&scene, light_idx, diffgeo.p + wo, bxdflightpdf, diffgeo.p, diffgeo.n);
+                eye_pdf_bwd[t - 3] = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&diffgeo, normalize(wo), wi, TEXTURE_ARGS),
+                    diffgeo.p, my_prev_eye_vertex->position, my_prev_eye_vertex->shading_normal);
+
+                float weight = Bdpt_GetMisWeight(eye_pdf_fwd, eye_pdf_bwd, eye_singular, t, 0, 0, 0, 0, max_vertex_index);
+
+                // Light has been selected before sampling, so BxDF sample only counts for this light
+                radiance = weight * le * throughput * bxdf * ndotwo / (bxdfpdf * selection_pdf * (1.f - light_sampling_prob));
             }
 
-            if (((!singular_bxdf && singular_light) || split >= 0.5f) && lightpdf > 0.f) 
+            if (split < light_sampling_prob && lightpdf > 0.f) 
             {
                 wo = lightwo;
-                float ndotwo = fabs(dot(diffgeo.n, normalize(wo)));  
-                radiance = 2.f * lightweight * le * Bxdf_Evaluate(&diffgeo, wi, normalize(wo), TEXTURE_ARGS) * throughput * ndotwo / lightpdf / selection_pdf;
+                float ndotwo = fabs(dot(diffgeo.n, normalize(wo)));
+
+                // Light subpath is the single sampled point, PDFs are in solid angle measure at the connecting vertex
+                int t = eye_vertex_index + 1;
+                float light_pdf_fwd = lightpdf * selection_pdf;
+                float light_pdf_bwd = lightbxdfpdf;
+                int light_singular = singular_light;
+                eye_pdf_bwd[t - 1] = Light_GetEmissionPdf(&scene, light_idx, diffgeo.p + wo, lightpdf, diffgeo.p, diffgeo.n);
+                eye_pdf_bwd[t - 2] = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&diffgeo, normalize(wo), wi, TEXTURE_ARGS),
+                    diffgeo.p, my_prev_eye_vertex->position, my_prev_eye_vertex->shading_normal);
+
+                float weight = Bdpt_GetMisWeight(eye_pdf_fwd, eye_pdf_bwd, eye_singular, t,
+                    &light_pdf_fwd, &light_pdf_bwd, &light_singular, 1, max_vertex_index);
+
+                radiance = weight * le * Bxdf_Evaluate(&diffgeo, wi, normalize(wo), TEXTURE_ARGS) * throughput * ndotwo / (lightpdf * selection_pdf * light_sampling_prob);
             }
 
             // If we have some light here generate a shadow ray
@@ -569,6 +849,8 @@ KERNEL void SampleSurface(
         int eye_vertex_index,
         // Index of light vertex we are trying to connect
         int light_vertex_index,
+        // Max eye and light vertex index connections are done for
+        int max_vertex_index,
         GLOBAL int const* pixel_indices,
         // Vertex arrays
         GLOBAL PathVertex const* restrict eye_subpath,
@@ -580,7 +862,7 @@ KERNEL void SampleSurface(
         TEXTURE_ARG_LIST,
         GLOBAL ray* connection_rays,
         // Path contriburions to final image
-        GLOBAL float4* contributions
+        GLOBAL float3* contributions
     )
     {
         int global_id = get_global_id(0);
@@ -618,7 +900,7 @@ KERNEL void SampleSurface(
         eye_dg.dpdu = GetOrthoVector(eye_dg.n);
         eye_dg.dpdv = cross(eye_dg.n, eye_dg.dpdu);
         eye_dg.mat = materials[my_eye_vertex->material_index];
-        eye_dg.mat.fresnel = 1.f;
+        eye_dg.mat.simple.fresnel = 1.f;
         DifferentialGeometry_CalculateTangentTransforms(&eye_dg);
 
         DifferentialGeometry light_dg;
@@ -629,7 +911,7 @@ KERNEL void SampleSurface(
         light_dg.dpdu = GetOrthoVector(light_dg.n);
         light_dg.dpdv = cross(light_dg.dpdu, light_dg.n);
         light_dg.mat = materials[my_light_vertex->material_index];
-        light_dg.mat.fresnel = 1.f;
+        light_dg.mat.simple.fresnel = 1.f;
         DifferentialGeometry_CalculateTangentTransforms(&light_dg);
 
         // Vector from eye subpath vertex to previous eye subpath vertex (incoming vector)
@@ -670,53 +952,48 @@ KERNEL void SampleSurface(
         // as if only eye0->eye1->eye2 was generated using eye walk, 
         // and eye3->light3->light2->light1->light0 was generated using light walk.
 
-        // This is PDF of sampling eye subpath vertex from previous eye subpath vertex using eye walk strategy.
-        float eye_vertex_pdf_fwd = my_eye_vertex->pdf_forward;
-        // This is PDF of sampling light subpath vertex from previous light subpath vertex using light walk strategy.
-        float light_vertex_pdf_fwd = my_light_vertex->pdf_forward;
-
-        // Important: this is PDF of sampling eye subpath vertex from light subpath vertex using light walk strategy.
-        float eye_vertex_pdf_bwd = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&light_dg, light_wi, light_wo, TEXTURE_ARGS),
-            eye_dg.p, light_dg.p, light_dg.n);
-        // Important: this is PDF of sampling prev eye subpath vertex from eye subpath vertex using light walk strategy.
-        float eye_prev_vertex_pdf_bwd = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&eye_dg, eye_wi, eye_wo, TEXTURE_ARGS),
-            my_prev_eye_vertex->position, eye_dg.p, eye_dg.n);
+        // Forward PDFs of subpath vertices are stored along with backward PDFs valid for all the vertices
+        // except the last two, these depend on the connection and are calculated here.
+        float eye_pdf_fwd[BDPT_MAX_SUBPATH_LEN];
+        float eye_pdf_bwd[BDPT_MAX_SUBPATH_LEN];
+        int eye_singular[BDPT_MAX_SUBPATH_LEN];
 
-        // Important: this is PDF of sampling light subpath vertex from eye subpath vertex using eye walk strategy.
-        float light_vertex_pdf_bwd = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&eye_dg, eye_wo, eye_wi, TEXTURE_ARGS),
-            light_dg.p, eye_dg.p, eye_dg.n);
-        // Important: this is PDF of sampling prev light subpath vertex from light subpath vertex using eye walk strategy.
-        float light_prev_vertex_pdf_bwd = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&light_dg, light_wo, light_wi, TEXTURE_ARGS),
-            my_prev_light_vertex->position, light_dg.p, light_dg.n);
-
-        // We need sum of all weights
-        float weights_sum = (eye_vertex_pdf_bwd / eye_vertex_pdf_fwd);
-        float weights_eye = (eye_vertex_pdf_bwd / eye_vertex_pdf_fwd) * (eye_prev_vertex_pdf_bwd / my_prev_eye_vertex->pdf_forward);
-        weights_sum += weights_eye;
-
-        weights_sum += (light_vertex_pdf_bwd / light_vertex_pdf_fwd);
-        float weights_light = (light_vertex_pdf_bwd / light_vertex_pdf_fwd) * (light_prev_vertex_pdf_bwd / my_prev_light_vertex->pdf_forward);
-        weights_sum += weights_light;
-
-        // Iterate eye subpath
-        // (we already accounted for prev vertex, so start from one before, that's why -2)
-        for (int i = eye_vertex_index - 2; i >= 0; --i)
+        for (int i = 0; i <= eye_vertex_index; ++i)
         {
             GLOBAL PathVertex const* v = &eye_subpath[BDPT_MAX_SUBPATH_LEN * pixel_idx + i];
-            weights_eye *= (v->pdf_backward / v->pdf_forward);
-            weights_sum += weights_eye;
+            eye_pdf_fwd[i] = v->pdf_forward;
+            eye_pdf_bwd[i] = v->pdf_backward;
+            eye_singular[i] = v->flags & kVertexSingular;
         }
 
-        // Iterate light subpath
-        // (we already accounted for prev vertex, so start from one before, that's why -2)
-        for (int i = light_vertex_index - 2; i >= 0; --i)
+        float light_pdf_fwd[BDPT_MAX_SUBPATH_LEN];
+        float light_pdf_bwd[BDPT_MAX_SUBPATH_LEN];
+        int light_singular[BDPT_MAX_SUBPATH_LEN];
+
+        for (int i = 0; i <= light_vertex_index; ++i)
         {
             GLOBAL PathVertex const* v = &light_subpath[BDPT_MAX_SUBPATH_LEN * global_id + i];
-            weights_light *= (v->pdf_backward / v->pdf_forward);
-            weights_sum += weights_light; 
+            light_pdf_fwd[i] = v->pdf_forward;
+            light_pdf_bwd[i] = v->pdf_backward;
+            light_singular[i] = v->flags & kVertexSingular;
         }
 
-        float mis_weight = 1.f / (1.f + weights_sum);
+        // PDF of sampling eye subpath vertex from light subpath vertex using light walk strategy.
+        eye_pdf_bwd[eye_vertex_index] = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&light_dg, light_wi, light_wo, TEXTURE_ARGS),
+            light_dg.p, eye_dg.p, eye_dg.n);
+        // PDF of sampling prev eye subpath vertex from eye subpath vertex using light walk strategy.
+        eye_pdf_bwd[eye_vertex_index - 1] = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&eye_dg, eye_wo, eye_wi, TEXTURE_ARGS),
+            eye_dg.p, my_prev_eye_vertex->position, my_prev_eye_vertex->shading_normal);
+
+        // PDF of sampling light subpath vertex from eye subpath vertex using eye walk strategy.
+        light_pdf_bwd[light_vertex_index] = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&eye_dg, eye_wi, eye_wo, TEXTURE_ARGS),
+            eye_dg.p, light_dg.p, light_dg.n);
+        // PDF of sampling prev light subpath vertex from light subpath vertex using eye walk strategy.
+        light_pdf_bwd[light_vertex_index - 1] = Pdf_ConvertSolidAngleToArea(Bxdf_GetPdf(&light_dg, light_wo, light_wi, TEXTURE_ARGS),
+            light_dg.p, my_prev_light_vertex->position, my_prev_light_vertex->shading_normal);
+
+        float mis_weight = Bdpt_GetMisWeight(eye_pdf_fwd, eye_pdf_bwd, eye_singular, eye_vertex_index + 1,
+            light_pdf_fwd, light_pdf_bwd, light_singular, light_vertex_index + 1, max_vertex_index);
         contributions[global_id].xyz = REASONABLE_RADIANCE(mis_weight * (eye_contribution * light_contribution) / (dist * dist));
 
 
@@ -834,12 +1111,14 @@ KERNEL void GatherContributions(
     // Number of rays
     int num_rays,
     GLOBAL int const* restrict pixel_indices,
+    // Output indices
+    GLOBAL int const* restrict output_indices,
     // Shadow rays hits
     GLOBAL int const* restrict shadow_hits,
     // Light samples
     GLOBAL float3 const* restrict contributions,
     // Radiance sample buffer
-    GLOBAL float4* output
+    GLOBAL float3* restrict output
 )
 {
     int global_id = get_global_id(0);
@@ -847,18 +1126,13 @@ KERNEL void GatherContributions(
     if (global_id < num_rays)
     {
         int pixel_idx = pixel_indices[global_id];
-        // Prepare accumulator variable
-        float3 radiance = make_float3(0.f, 0.f, 0.f);
+        int output_index = output_indices[pixel_idx];
 
-        // Start collecting samples
+        // If shadow ray didn't hit anything and reached skydome
+        if (shadow_hits[global_id] == -1)
         {
-            // If shadow ray global_id't hit anything and reached skydome
-            if (shadow_hits[global_id] == -1)
-            {
-                // Add its contribution to radiance accumulator
-                radiance += contributions[global_id];
-                output[pixel_idx].xyz += radiance;
-            }
+            // Add its contribution to radiance accumulator
+            ADD_FLOAT3(&output[output_index], contributions[global_id]);
         }
     }
 }
@@ -937,21 +1211,6 @@ KERNEL void ApplyGammaAndCopyData(
 }
 
 
-INLINE void atomic_add_float(volatile __global float* addr, float val)
-{
-    union {
-        unsigned int u32;
-        float        f32;
-    } next, expected, current;
-    current.f32 = *addr;
-    do {
-        expected.f32 = current.f32;
-        next.f32 = expected.f32 + val;
-        current.u32 = atomic_cmpxchg((volatile __global unsigned int *)addr,
-            expected.u32, next.u32);
-    } while (current.u32 != expected.u32);
-}
-
 KERNEL void ConnectCaustics(
     int num_items,
     int eye_vertex_index,
@@ -961,7 +1220,7 @@ KERNEL void ConnectCaustics(
     GLOBAL Material const* restrict materials,
     TEXTURE_ARG_LIST,
     GLOBAL ray* restrict connection_rays,
-    GLOBAL float4* restrict contributions,
+    GLOBAL float3* restrict contributions,
     GLOBAL float2* restrict image_plane_positions
 )
 {
@@ -997,7 +1256,7 @@ KERNEL void ConnectCaustics(
     light_dg.dpdu = GetOrthoVector(light_dg.n);
     light_dg.dpdv = cross(light_dg.dpdu, light_dg.n);
     light_dg.mat = materials[my_light_vertex->material_index];
-    light_dg.mat.fresnel = 1.f;
+    light_dg.mat.simple.fresnel = 1.f;
     DifferentialGeometry_CalculateTangentTransforms(&light_dg);
 
     float3 eye_wo = normalize(light_dg.p - eye_dg.p);
@@ -121,6 +121,35 @@ float EnvironmentLight_GetPdf(
     return 1.f / (2.f * PI);
 }
 
+/// Get unshadowed irradiance at normal n from precomputed SH coefficients (bands 0..2)
+float3 EnvironmentLight_GetShIrradiance(
+                                        // Light
+                                        Light const* light,
+                                        // SH irradiance coefficients
+                                        GLOBAL float3 const* restrict sh,
+                                        // Shading normal
+                                        float3 n
+                                        )
+{
+    // Host projection parametrizes the sphere with x and z swapped
+    // relative to Texture_SampleEnvMap
+    float x = n.z;
+    float y = n.y;
+    float z = n.x;
+
+    float3 e = 0.2820947917738781f * sh[0];
+    e += -0.4886025119029199f * y * sh[1];
+    e += 0.4886025119029199f * z * sh[2];
+    e += -0.4886025119029199f * x * sh[3];
+    e += 1.092548430592079f * x * y * sh[4];
+    e += -1.092548430592079f * y * z * sh[5];
+    e += (0.9461746957575601f * z * z - 0.3153915652525201f) * sh[6];
+    e += -1.092548430592079f * x * z * sh[7];
+    e += 0.5462742152960395f * (x * x - y * y) * sh[8];
+
+    return light->multiplier * max(e, 0.f);
+}
+
 
 /*
  Area light
@@ -163,7 +192,7 @@ float3 AreaLight_GetLe(// Emissive object
         int mat_idx = Scene_GetMaterialIndex(scene, shapeidx, primidx);
         Material mat = scene->materials[mat_idx];
 
-        const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
+        const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, 0.f, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
         return ke;
     }
     else
@@ -211,7 +240,7 @@ float3 AreaLight_Sample(// Emissive object
     int mat_idx = Scene_GetMaterialIndex(scene, shapeidx, primidx);
     Material mat = scene->materials[mat_idx];
 
-    const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
+    const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, 0.f, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
 
     float3 v = -normalize(*wo);
 
@@ -312,7 +341,7 @@ float3 AreaLight_SampleVertex(
     int mat_idx = Scene_GetMaterialIndex(scene, shapeidx, primidx);
     Material mat = scene->materials[mat_idx];
 
-    const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
+    const float3 ke = Texture_GetValue3f(mat.simple.kx.xyz, tx, 0.f, TEXTURE_ARGS_IDX(mat.simple.kxmapidx));
 
     *wo = Sample_MapToHemisphere(sample1, *n, 1.f);
     *pdf = (1.f / area) * fabs(dot(*n, *wo)) / PI;
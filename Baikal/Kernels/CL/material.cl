@@ -89,83 +89,73 @@ void Material_Select(
     // Here we deal with combined material and we have to sample
     else
     {
-        // Prefetch current material
-        Material mat = dg->mat;
-        int iter = 0;
+        // Walk compiled graph, only selected BxDF record is fetched
+        GLOBAL MaterialOp const* ops = (GLOBAL MaterialOp const*)scene->materials;
+        int pc = dg->mat.compound.program;
+        MaterialOp op = ops[pc];
 
-        // Might need several passes of sampling
-        while (mat.type == kFresnelBlend || mat.type == kMix)
+        while (op.type != kMaterialOpBxdf)
         {
-            if (mat.type == kFresnelBlend)
+            float sample = Sampler_Sample1D(sampler, SAMPLER_ARGS);
+
+            if (op.type == kMaterialOpSelect)
             {
-                float etai = 1.f;
-                float etat = mat.compound.weight;
-                float cosi = dot(dg->n, wi);
+                // Entries hold cumulative probabilities, last one is always taken
+                int entry = pc + 1;
+                int last = pc + op.arg;
 
-                // Revert normal and eta if needed
-                if (cosi < 0.f)
+                while (entry < last && sample >= ops[entry].weight)
                 {
-                    float tmp = etai;
-                    etai = etat;
-                    etat = tmp;
-                    cosi = -cosi;
+                    ++entry;
                 }
 
-                float eta = etai / etat;
-                float sini2 = 1.f - cosi * cosi;
-                float sint2 = eta * eta * sini2;
-                float fresnel = 1.f;
+                op = ops[entry];
+                pc = entry;
 
-                if (sint2 < 1.f)
+                if (op.type == kMaterialOpJump)
                 {
-                    float cost = native_sqrt(max(0.f, 1.f - sint2));
-                    fresnel = FresnelDielectric(etai, etat, cosi, cost);
+                    pc += op.arg;
+                    op = ops[pc];
                 }
 
-                float sample = Sampler_Sample1D(sampler, SAMPLER_ARGS);
+                continue;
+            }
 
-                if (sample < fresnel)
-                {
-                    // Sample top
-                    idx = mat.compound.top_brdf_idx;
-                    //
-                    mat = scene->materials[idx];
-                    mat.simple.fresnel = 1.f;
-                }
-                else
-                {
-                    // Sample base
-                    idx = mat.compound.base_brdf_idx;
-                    // 
-                    mat = scene->materials[idx];
-                    mat.simple.fresnel = 1.f;
-                }
+            float weight;
+
+            if (op.type == kMaterialOpMix)
+            {
+                weight = Texture_GetValue1f(op.weight, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(op.weight_map_idx));
             }
             else
             {
-                float sample = Sampler_Sample1D(sampler, SAMPLER_ARGS);
+                float cosi = dot(dg->n, wi);
+                // Relative IOR, reverted if needed
+                float eta = cosi < 0.f ? 1.f / op.weight : op.weight;
 
-                float weight = Texture_GetValue1f(mat.compound.weight, dg->uv, TEXTURE_ARGS_IDX(mat.compound.weight_map_idx));
+                float roughness = op.roughness;
 
-                if (sample < weight)
-                {
-                    // Sample top
-                    idx = mat.compound.top_brdf_idx;
-                    //
-                    mat = scene->materials[idx];
-                    mat.simple.fresnel = 1.f;
-                }
-                else
+                // Textured roughness is sampled from top layer record following the op
+                if (roughness < 0.f)
                 {
-                    // Sample base
-                    idx = mat.compound.base_brdf_idx;
-                    //
-                    mat = scene->materials[idx];
-                    mat.simple.fresnel = 1.f;
+                    Material top = scene->materials[ops[pc + 1].arg];
+                    roughness = Texture_GetValue1f(top.simple.ns, dg->uv, dg->uv_footprint, TEXTURE_ARGS_IDX(top.simple.nsmapidx));
                 }
+
+                // Rough top layer reflects Fresnel term averaged over its lobe
+                float4 lut = BxdfLut_GetDielectricAlbedo(fabs(cosi), roughness, eta, TEXTURE_ARGS);
+                weight = op.type == kMaterialOpFresnelBlendBeckmann ? lut.z : lut.x;
             }
+
+            // Sample top or base
+            pc = sample < weight ? pc + 1 : pc + op.arg;
+            op = ops[pc];
         }
 
+        idx = op.arg;
+        Material mat = scene->materials[idx];
+        mat.simple.fresnel = 1.f;
+
         dg->material_index = idx;
         dg->mat = mat;
     }
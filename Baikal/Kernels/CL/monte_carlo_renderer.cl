@@ -118,7 +118,8 @@ void PerspectiveCamera_GeneratePaths(
         // Set ray max
         my_ray->extra.x = 0xFFFFFFFF;
         my_ray->extra.y = 0xFFFFFFFF;
-        Ray_SetExtra(my_ray, 1.f);
+        // Ray cone starts at the camera with the angle subtended by a pixel
+        Ray_SetExtra(my_ray, make_float2(1.f, camera->dim.y / (output_height * camera->focal_length)));
     }
 }
 
@@ -209,10 +210,193 @@ KERNEL void PerspectiveCameraDof_GeneratePaths(
         // Set ray max
         my_ray->extra.x = 0xFFFFFFFF;
         my_ray->extra.y = 0xFFFFFFFF;
-        Ray_SetExtra(my_ray, 1.f);
+        // Ray cone starts at the camera with the angle subtended by a pixel
+        Ray_SetExtra(my_ray, make_float2(1.f, camera->dim.y / (output_height * camera->focal_length)));
+    }
+}
+
+
+// Spherical camera implementation.
+// Image covers full 360 x 180 degrees panorama in equirectangular layout.
+KERNEL
+void SphericalCamera_GeneratePaths(
+    // Camera
+    GLOBAL Camera const* restrict camera, 
+    // Image resolution
+    int output_width,
+    int output_height,
+    // Pixel domain buffer
+    GLOBAL int const* restrict pixel_idx,
+    // Size of pixel domain buffer
+    GLOBAL int const* restrict num_pixels,
+    // RNG seed value
+    uint rng_seed,
+    // Current frame
+    uint frame,
+    // Rays to generate
+    GLOBAL ray* restrict rays,
+    // RNG data
+    GLOBAL uint* restrict random,
+    GLOBAL uint const* restrict sobol_mat
+)
+{
+    int global_id = get_global_id(0);
+
+    // Check borders
+    if (global_id < *num_pixels)
+    {
+        int idx = pixel_idx[global_id];
+        int y = idx / output_width;
+        int x = idx % output_width;
+
+        // Get pointer to ray & path handles
+        GLOBAL ray* my_ray = rays + global_id;
+
+        // Initialize sampler
+        Sampler sampler;
+#if SAMPLER == SOBOL
+        uint scramble = random[x + output_width * y] * 0x1fe3434f;
+
+        if (frame & 0xF)
+        {
+            random[x + output_width * y] = WangHash(scramble);
+        }
+
+        Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#elif SAMPLER == RANDOM
+        uint scramble = x + output_width * y * rng_seed;
+        Sampler_Init(&sampler, scramble);
+#elif SAMPLER == CMJ
+        uint rnd = random[x + output_width * y];
+        uint scramble = rnd * 0x1fe3434f * ((frame + 133 * rnd) / (CMJ_DIM * CMJ_DIM));
+        Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#endif
+
+        // Generate sample
+        float2 sample0 = Sampler_Sample2D(&sampler, SAMPLER_ARGS);
+
+        // Calculate [0..1] image plane sample
+        float2 img_sample;
+        img_sample.x = (float)x / output_width + sample0.x / output_width;
+        img_sample.y = (float)y / output_height + sample0.y / output_height;
+
+        // Map to longitude [-pi, pi] and latitude [-pi/2, pi/2]
+        float phi = (img_sample.x - 0.5f) * 2.f * PI;
+        float theta = (img_sample.y - 0.5f) * PI;
+
+        float cos_phi, cos_theta;
+        float sin_phi = sincos(phi, &cos_phi);
+        float sin_theta = sincos(theta, &cos_theta);
+
+        // Calculate direction in camera frame
+        my_ray->d.xyz = normalize(cos_theta * cos_phi * camera->forward + cos_theta * sin_phi * camera->right + sin_theta * camera->up);
+        // Origin == camera position + nearz * d
+        my_ray->o.xyz = camera->p + camera->zcap.x * my_ray->d.xyz;
+        // Max T value = zfar - znear since we moved origin to znear
+        my_ray->o.w = camera->zcap.y - camera->zcap.x;
+        // Generate random time from 0 to 1
+        my_ray->d.w = sample0.x;
+        // Set ray max
+        my_ray->extra.x = 0xFFFFFFFF;
+        my_ray->extra.y = 0xFFFFFFFF;
+        // Ray cone starts at the camera with the angle subtended by a pixel
+        Ray_SetExtra(my_ray, make_float2(1.f, PI / output_height));
     }
 }
 
+// Fisheye camera implementation.
+// Equidistant projection: angle from forward vector is proportional
+// to the distance from sensor center (r = focal_length * theta).
+KERNEL
+void FisheyeCamera_GeneratePaths(
+    // Camera
+    GLOBAL Camera const* restrict camera, 
+    // Image resolution
+    int output_width,
+    int output_height,
+    // Pixel domain buffer
+    GLOBAL int const* restrict pixel_idx,
+    // Size of pixel domain buffer
+    GLOBAL int const* restrict num_pixels,
+    // RNG seed value
+    uint rng_seed,
+    // Current frame
+    uint frame,
+    // Rays to generate
+    GLOBAL ray* restrict rays,
+    // RNG data
+    GLOBAL uint* restrict random,
+    GLOBAL uint const* restrict sobol_mat
+)
+{
+    int global_id = get_global_id(0);
+
+    // Check borders
+    if (global_id < *num_pixels)
+    {
+        int idx = pixel_idx[global_id];
+        int y = idx / output_width;
+        int x = idx % output_width;
+
+        // Get pointer to ray & path handles
+        GLOBAL ray* my_ray = rays + global_id;
+
+        // Initialize sampler
+        Sampler sampler;
+#if SAMPLER == SOBOL
+        uint scramble = random[x + output_width * y] * 0x1fe3434f;
+
+        if (frame & 0xF)
+        {
+            random[x + output_width * y] = WangHash(scramble);
+        }
+
+        Sampler_Init(&sampler, frame, SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#elif SAMPLER == RANDOM
+        uint scramble = x + output_width * y * rng_seed;
+        Sampler_Init(&sampler, scramble);
+#elif SAMPLER == CMJ
+        uint rnd = random[x + output_width * y];
+        uint scramble = rnd * 0x1fe3434f * ((frame + 133 * rnd) / (CMJ_DIM * CMJ_DIM));
+        Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_CAMERA_OFFSET, scramble);
+#endif
+
+        // Generate sample
+        float2 sample0 = Sampler_Sample2D(&sampler, SAMPLER_ARGS);
+
+        // Calculate [0..1] image plane sample
+        float2 img_sample;
+        img_sample.x = (float)x / output_width + sample0.x / output_width;
+        img_sample.y = (float)y / output_height + sample0.y / output_height;
+
+        // Transform into [-dim/2, dim/2]
+        float2 c_sample = (img_sample - make_float2(0.5f, 0.5f)) * camera->dim;
+
+        // Angle from optical axis, clamped to backward direction
+        float r = length(c_sample);
+        float theta = min(r / camera->focal_length, PI);
+
+        float cos_theta;
+        float sin_theta = sincos(theta, &cos_theta);
+
+        // Direction in image plane
+        float2 dir = r > 0.f ? c_sample / r : make_float2(0.f, 0.f);
+
+        // Calculate direction in camera frame
+        my_ray->d.xyz = normalize(cos_theta * camera->forward + sin_theta * dir.x * camera->right + sin_theta * dir.y * camera->up);
+        // Origin == camera position + nearz * d
+        my_ray->o.xyz = camera->p + camera->zcap.x * my_ray->d.xyz;
+        // Max T value = zfar - znear since we moved origin to znear
+        my_ray->o.w = camera->zcap.y - camera->zcap.x;
+        // Generate random time from 0 to 1
+        my_ray->d.w = sample0.x;
+        // Set ray max
+        my_ray->extra.x = 0xFFFFFFFF;
+        my_ray->extra.y = 0xFFFFFFFF;
+        // Ray cone starts at the camera with the angle subtended by a pixel
+        Ray_SetExtra(my_ray, make_float2(1.f, camera->dim.y / (output_height * camera->focal_length)));
+    }
+}
 
 KERNEL
 void PerspectiveCamera_GenerateVertices(
@@ -747,7 +931,7 @@ KERNEL void FillAOVs(
                     diffgeo.dpdv = -diffgeo.dpdv;
                 }
 
-                DifferentialGeometry_ApplyBumpNormalMap(&diffgeo, TEXTURE_ARGS);
+                DifferentialGeometry_ApplyNormalMap(&diffgeo, TEXTURE_ARGS);
                 DifferentialGeometry_CalculateTangentTransforms(&diffgeo);
 
                 aov_world_shading_normal[idx].xyz += diffgeo.n;
@@ -782,7 +966,7 @@ KERNEL void FillAOVs(
                 // Select BxDF
                 Material_Select(&scene, wi, &sampler, TEXTURE_ARGS, SAMPLER_ARGS, &diffgeo);
 
-                const float3 kd = Texture_GetValue3f(diffgeo.mat.simple.kx.xyz, diffgeo.uv, TEXTURE_ARGS_IDX(diffgeo.mat.simple.kxmapidx));
+                const float3 kd = Texture_GetValue3f(diffgeo.mat.simple.kx.xyz, diffgeo.uv, diffgeo.uv_footprint, TEXTURE_ARGS_IDX(diffgeo.mat.simple.kxmapidx));
 
                 aov_albedo[idx].xyz += kd;
                 aov_albedo[idx].w += 1.f;
@@ -808,7 +992,7 @@ KERNEL void FillAOVs(
                     diffgeo.dpdv = -diffgeo.dpdv;
                 }
 
-                DifferentialGeometry_ApplyBumpNormalMap(&diffgeo, TEXTURE_ARGS);
+                DifferentialGeometry_ApplyNormalMap(&diffgeo, TEXTURE_ARGS);
                 DifferentialGeometry_CalculateTangentTransforms(&diffgeo);
 
                 aov_world_tangent[idx].xyz += diffgeo.dpdu;
@@ -835,7 +1019,7 @@ KERNEL void FillAOVs(
                     diffgeo.dpdv = -diffgeo.dpdv;
                 }
 
-                DifferentialGeometry_ApplyBumpNormalMap(&diffgeo, TEXTURE_ARGS);
+                DifferentialGeometry_ApplyNormalMap(&diffgeo, TEXTURE_ARGS);
                 DifferentialGeometry_CalculateTangentTransforms(&diffgeo);
 
                 aov_world_bitangent[idx].xyz += diffgeo.dpdv;
@@ -860,7 +1044,7 @@ KERNEL void FillAOVs(
                 else if (type == kMicrofacetGGX || type == kMicrofacetBeckmann ||
                     type == kMicrofacetRefractionGGX || type == kMicrofacetRefractionBeckmann)
                 {
-                    gloss = 1.f - Texture_GetValue1f(diffgeo.mat.simple.ns, diffgeo.uv, TEXTURE_ARGS_IDX(diffgeo.mat.simple.nsmapidx));
+                    gloss = 1.f - Texture_GetValue1f(diffgeo.mat.simple.ns, diffgeo.uv, diffgeo.uv_footprint, TEXTURE_ARGS_IDX(diffgeo.mat.simple.nsmapidx));
                 }
 
 
@@ -26,13 +26,14 @@ THE SOFTWARE.
 #include <../Baikal/Kernels/CL/texture.cl>
 #include <../Baikal/Kernels/CL/payload.cl>
 
+// Bump maps are converted to normal maps on upload, so both are applied here
 void DifferentialGeometry_ApplyNormalMap(DifferentialGeometry* diffgeo, TEXTURE_ARG_LIST)
 {
     int nmapidx = diffgeo->mat.nmapidx;
     if (nmapidx != -1)
     {
         // Now n, dpdu, dpdv is orthonormal basis
-        float3 mappednormal = 2.f * Texture_Sample2D(diffgeo->uv, TEXTURE_ARGS_IDX(nmapidx)).xyz - make_float3(1.f, 1.f, 1.f);
+        float3 mappednormal = 2.f * Texture_SampleLod(diffgeo->uv, diffgeo->uv_footprint, TEXTURE_ARGS_IDX(nmapidx)).xyz - make_float3(1.f, 1.f, 1.f);
 
         // Return mapped version
         diffgeo->n = normalize(mappednormal.z *  diffgeo->n + mappednormal.x * diffgeo->dpdu + mappednormal.y * diffgeo->dpdv);
@@ -41,34 +42,4 @@ void DifferentialGeometry_ApplyNormalMap(DifferentialGeometry* diffgeo, TEXTURE_
     }
 }
 
-void DifferentialGeometry_ApplyBumpMap(DifferentialGeometry* diffgeo, TEXTURE_ARG_LIST)
-{
-    int nmapidx = diffgeo->mat.nmapidx;
-    if (nmapidx != -1)
-    {
-        // Now n, dpdu, dpdv is orthonormal basis
-        float3 mappednormal = 2.f * Texture_SampleBump(diffgeo->uv, TEXTURE_ARGS_IDX(nmapidx)) - make_float3(1.f, 1.f, 1.f);
-
-        // Return mapped version
-        diffgeo->n = normalize(mappednormal.z * diffgeo->n + mappednormal.x * diffgeo->dpdu + mappednormal.y * diffgeo->dpdv);
-        diffgeo->dpdv = normalize(cross(diffgeo->n, diffgeo->dpdu));
-        diffgeo->dpdu = normalize(cross(diffgeo->dpdv, diffgeo->n));
-    }
-}
-
-void DifferentialGeometry_ApplyBumpNormalMap(DifferentialGeometry* diffgeo, TEXTURE_ARG_LIST)
-{
-    int bump_flag = diffgeo->mat.bump_flag;
-    if (bump_flag)
-    {
-        DifferentialGeometry_ApplyBumpMap(diffgeo, TEXTURE_ARGS);
-    }
-    else
-    {
-        DifferentialGeometry_ApplyNormalMap(diffgeo, TEXTURE_ARGS);
-    }
-}
-
-
-
 #endif // NORMALMAP_CL
@@ -30,7 +30,16 @@ typedef struct _Path
     int volume;
     int flags;
     int active;
-    int extra1;
+    // Ray cone width at the origin of the current segment,
+    // spread angle travels with the ray (see ray.cl)
+    float cone_width;
+    // Number of guided vertices added so far (see path_guiding.cl)
+    int guide_count;
+    // Cache record and incident radiance of the pending light sample
+    int light_guide_record;
+    float light_guide_value;
+    // Number of guided vertices preceding the pending light sample
+    int light_guide_count;
 } Path;
 
 typedef enum _PathFlags
@@ -38,7 +47,8 @@ typedef enum _PathFlags
     kNone = 0x0,
     kKilled = 0x1,
     kScattered = 0x2,
-    kSpecularBounce = 0x4
+    kSpecularBounce = 0x4,
+    kShIrradiance = 0x8
 } PathFlags;
 
 bool Path_IsScattered(__global Path const* path)
@@ -77,6 +87,21 @@ void Path_SetSpecularFlag(__global Path* path)
     path->flags |= kSpecularBounce;
 }
 
+bool Path_IsShIrradiance(__global Path const* path)
+{
+    return path->flags & kShIrradiance;
+}
+
+void Path_ClearShIrradianceFlag(__global Path* path)
+{
+    path->flags &= ~kShIrradiance;
+}
+
+void Path_SetShIrradianceFlag(__global Path* path)
+{
+    path->flags |= kShIrradiance;
+}
+
 void Path_Restart(__global Path* path)
 {
     path->flags = 0;
@@ -0,0 +1,102 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#ifndef PATH_GUIDING_CL
+#define PATH_GUIDING_CL
+
+#include <../Baikal/Kernels/CL/common.cl>
+#include <../Baikal/Kernels/CL/utils.cl>
+#include <../Baikal/Kernels/CL/path.cl>
+#include <../Baikal/Kernels/CL/path_guiding_distribution.cl>
+
+// Guided vertex of a path: throughput after the vertex times the pdf of the sampled direction (xyz)
+// and the cache record (cell * bins + bin) of that direction (w, bit cast int)
+typedef float4 GuidingVertex;
+
+// Get cache cell containing the point
+INLINE int PathGuiding_GetCell(float3 p, float3 bounds_min, float3 bounds_max)
+{
+    float3 extents = max(bounds_max - bounds_min, make_float3(1e-5f, 1e-5f, 1e-5f));
+    float3 rel = (p - bounds_min) / extents * (float)GUIDING_GRID_RES;
+
+    int x = clamp((int)rel.x, 0, GUIDING_GRID_RES - 1);
+    int y = clamp((int)rel.y, 0, GUIDING_GRID_RES - 1);
+    int z = clamp((int)rel.z, 0, GUIDING_GRID_RES - 1);
+
+    return (z * GUIDING_GRID_RES + y) * GUIDING_GRID_RES + x;
+}
+
+// Add incident radiance sample to the training histogram
+INLINE void PathGuiding_Train(GLOBAL float* restrict train, int record, float value)
+{
+    if (record >= 0 && value > 0.f && isfinite(value))
+    {
+        atomic_add_float(train + record, value);
+    }
+}
+
+// Remember the direction sampled at a surface vertex, radiance found along it is trained by PathGuiding_TrainPath
+INLINE void PathGuiding_AddVertex(GLOBAL GuidingVertex* restrict vertices, GLOBAL Path* restrict path, int record, float pdf)
+{
+    float3 weight = Path_GetThroughput(path) * pdf;
+    vertices[path->guide_count % GUIDING_PATH_VERTICES] = make_float4(weight.x, weight.y, weight.z, as_float(record));
+    ++path->guide_count;
+}
+
+// Train the guided vertices preceding a contribution written to the output.
+// Radiance incident at a vertex along its direction is the contribution divided by the path throughput
+// after the vertex. Only the latest GUIDING_PATH_VERTICES - 1 vertices are trained: light samples are
+// gathered after the shading vertex has been added, so its slot may already hold a newer vertex.
+INLINE void PathGuiding_TrainPath(GLOBAL float* restrict train, GLOBAL GuidingVertex const* restrict vertices, int count, float3 contribution)
+{
+    for (int i = max(count - GUIDING_PATH_VERTICES + 1, 0); i < count; ++i)
+    {
+        GuidingVertex vertex = vertices[i % GUIDING_PATH_VERTICES];
+
+        float3 incident = make_float3(
+            vertex.x > 0.f ? contribution.x / vertex.x : 0.f,
+            vertex.y > 0.f ? contribution.y / vertex.y : 0.f,
+            vertex.z > 0.f ? contribution.z / vertex.z : 0.f);
+
+        PathGuiding_Train(train, as_int(vertex.w), luminance(incident));
+    }
+}
+
+// Fold radiance gathered during the last sample into the cache and rebuild sampling distributions.
+// Runs on the device between samples, one work item per cell.
+KERNEL void UpdatePathGuiding(
+    // Radiance gathered during the last sample
+    GLOBAL float* restrict train,
+    // Accumulated radiance
+    GLOBAL float* restrict radiance,
+    // Sampling distributions
+    GLOBAL float* restrict cdf
+)
+{
+    int cell = get_global_id(0);
+
+    if (cell < GUIDING_NUM_CELLS)
+    {
+        PathGuiding_UpdateCell(train, radiance, cdf, cell);
+    }
+}
+
+#endif // PATH_GUIDING_CL
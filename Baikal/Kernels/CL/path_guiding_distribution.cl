@@ -0,0 +1,145 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#ifndef PATH_GUIDING_DISTRIBUTION_CL
+#define PATH_GUIDING_DISTRIBUTION_CL
+
+// Layout and sampling math of the path guiding cache. Shared by the kernels (path_guiding.cl)
+// and the host (Utils/path_guiding.h), so only the plain C subset of OpenCL is used here.
+
+// Radiance cache for path guiding: uniform grid over the scene bounds,
+// each cell keeps a directional histogram over the sphere. Directions are binned
+// with cylindrical equal-area mapping (cos theta, phi), so all bins subtend the same solid angle.
+#define GUIDING_GRID_RES 16
+#define GUIDING_DIR_RES 8
+#define GUIDING_NUM_CELLS (GUIDING_GRID_RES * GUIDING_GRID_RES * GUIDING_GRID_RES)
+#define GUIDING_NUM_BINS (GUIDING_DIR_RES * GUIDING_DIR_RES)
+// Probability to sample the cache instead of the BxDF
+#define GUIDING_SAMPLING_FRACTION 0.5f
+// Part of a cell distribution spread uniformly, so no direction gets zero pdf
+#define GUIDING_UNIFORM_FRACTION 0.1f
+// Guided vertices each path keeps to train with radiance found further down the path (ring buffer)
+#define GUIDING_PATH_VERTICES 4
+
+// Get directional bin of a normalized direction
+INLINE int PathGuiding_GetBin(float3 d)
+{
+    float u = 0.5f * (clamp(d.z, -1.f, 1.f) + 1.f);
+    float v = atan2(d.y, d.x) / (2.f * PI);
+    v = v < 0.f ? v + 1.f : v;
+
+    int iu = clamp((int)(u * GUIDING_DIR_RES), 0, GUIDING_DIR_RES - 1);
+    int iv = clamp((int)(v * GUIDING_DIR_RES), 0, GUIDING_DIR_RES - 1);
+
+    return iu * GUIDING_DIR_RES + iv;
+}
+
+// Check if the cell has learned anything, untrained cells are sampled by BxDF only
+INLINE bool PathGuiding_IsTrained(GLOBAL float const* cdf, int cell)
+{
+    return cdf[cell * GUIDING_NUM_BINS + GUIDING_NUM_BINS - 1] > 0.f;
+}
+
+// Solid angle pdf of a direction in the cell
+INLINE float PathGuiding_GetPdf(GLOBAL float const* cdf, int cell, float3 d)
+{
+    GLOBAL float const* cell_cdf = cdf + cell * GUIDING_NUM_BINS;
+    int bin = PathGuiding_GetBin(d);
+
+    float p = cell_cdf[bin] - (bin > 0 ? cell_cdf[bin - 1] : 0.f);
+    return p * GUIDING_NUM_BINS / (4.f * PI);
+}
+
+// Sample direction from the cell distribution
+INLINE float3 PathGuiding_Sample(GLOBAL float const* cdf, int cell, float2 sample, float* pdf)
+{
+    GLOBAL float const* cell_cdf = cdf + cell * GUIDING_NUM_BINS;
+
+    // Find the bin with binary search over cdf
+    int first = 0;
+    int last = GUIDING_NUM_BINS - 1;
+
+    while (first < last)
+    {
+        int middle = (first + last) / 2;
+
+        if (cell_cdf[middle] <= sample.x)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    float lower = first > 0 ? cell_cdf[first - 1] : 0.f;
+    float p = cell_cdf[first] - lower;
+
+    // Reuse the remainder of the sample to place the direction within the bin
+    float s = p > 0.f ? clamp((sample.x - lower) / p, 0.f, 0.99999f) : 0.5f;
+
+    float u = ((first / GUIDING_DIR_RES) + s) / GUIDING_DIR_RES;
+    float v = ((first % GUIDING_DIR_RES) + sample.y) / GUIDING_DIR_RES;
+
+    float z = 2.f * u - 1.f;
+    float r = sqrt(fmax(1.f - z * z, 0.f));
+    float phi = 2.f * PI * v;
+
+    *pdf = p * GUIDING_NUM_BINS / (4.f * PI);
+    return make_float3(r * cos(phi), r * sin(phi), z);
+}
+
+// Fold radiance gathered during the last sample into the cell and rebuild its sampling distribution
+INLINE void PathGuiding_UpdateCell(GLOBAL float* train, GLOBAL float* radiance, GLOBAL float* cdf, int cell)
+{
+    int offset = cell * GUIDING_NUM_BINS;
+    float total = 0.f;
+
+    for (int i = 0; i < GUIDING_NUM_BINS; ++i)
+    {
+        float value = radiance[offset + i] + train[offset + i];
+        radiance[offset + i] = value;
+        train[offset + i] = 0.f;
+        total += value;
+    }
+
+    float sum = 0.f;
+
+    for (int i = 0; i < GUIDING_NUM_BINS; ++i)
+    {
+        if (total > 0.f)
+        {
+            sum += (1.f - GUIDING_UNIFORM_FRACTION) * radiance[offset + i] / total +
+                GUIDING_UNIFORM_FRACTION / GUIDING_NUM_BINS;
+        }
+
+        cdf[offset + i] = sum;
+    }
+
+    // Get rid of rounding errors, so the search always ends inside the cell
+    if (total > 0.f)
+    {
+        cdf[offset + GUIDING_NUM_BINS - 1] = 1.f;
+    }
+}
+
+#endif // PATH_GUIDING_DISTRIBUTION_CL
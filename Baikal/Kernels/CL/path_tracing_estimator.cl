@@ -34,12 +34,13 @@ THE SOFTWARE.
 #include <../Baikal/Kernels/CL/material.cl>
 #include <../Baikal/Kernels/CL/volumetrics.cl>
 #include <../Baikal/Kernels/CL/path.cl>
+#include <../Baikal/Kernels/CL/path_guiding.cl>
 
 
 KERNEL
 void InitPathData(
-    GLOBAL int const* restrict src_index, 
-    GLOBAL int* restrict dst_index,
+    GLOBAL int* restrict pixel_indices0,
+    GLOBAL int* restrict pixel_indices1,
     GLOBAL int const* restrict num_elements,
     GLOBAL Path* restrict paths
 )
@@ -50,13 +51,21 @@ void InitPathData(
     if (global_id < *num_elements)
     {
         GLOBAL Path* my_path = paths + global_id;
-        dst_index[global_id] = src_index[global_id];
+
+        // Both pixel index buffers start with identity mapping
+        pixel_indices0[global_id] = global_id;
+        pixel_indices1[global_id] = global_id;
 
         // Initalize path data
         my_path->throughput = make_float3(1.f, 1.f, 1.f);
         my_path->volume = INVALID_IDX;
         my_path->flags = 0;
         my_path->active = 0xFF;
+        my_path->cone_width = 0.f;
+        my_path->guide_count = 0;
+        my_path->light_guide_record = -1;
+        my_path->light_guide_value = 0.f;
+        my_path->light_guide_count = 0;
     }
 }
 
@@ -112,6 +121,8 @@ KERNEL void ShadeVolume(
     int frame,
     // Volume data
     GLOBAL Volume const* restrict volumes,
+    // Volume grids
+    VOLUME_ARG_LIST,
     // Shadow rays
     GLOBAL ray* restrict shadow_rays,
     // Light samples
@@ -178,6 +189,12 @@ KERNEL void ShadeVolume(
         // for scattering event
         int volume_idx = Path_GetVolumeIdx(path);
 
+#ifdef BAIKAL_PATH_GUIDING
+        // Volume vertices are not guided, the light sample only trains surface vertices before them
+        path->light_guide_record = -1;
+        path->light_guide_count = path->guide_count;
+#endif
+
         // Sample light source
         float pdf = 0.f;
         float selection_pdf = 0.f;
@@ -200,11 +217,13 @@ KERNEL void ShadeVolume(
         // Evaluate volume transmittion along the shadow ray (it is incorrect if the light source is outside of the
         // current volume, but in this case it will be discarded anyway since the intersection at the outer bound
         // of a current volume), so the result is fully correct.
-        float3 tr = Volume_Transmittance(&volumes[volume_idx], &shadow_rays[global_id], shadow_ray_length);
-
         // Volume emission is applied only if the light source is in the current volume(this is incorrect since the light source might be
         // outside of a volume and we have to compute fraction of ray in this case, but need to figure out how)
-        float3 r = Volume_Emission(&volumes[volume_idx], &shadow_rays[global_id], shadow_ray_length);
+        Sampler tracking_sampler;
+        Volume_InitTrackingSampler(&tracking_sampler, as_uint(Sampler_Sample1D(&sampler, SAMPLER_ARGS)), pixel_idx);
+
+        float3 r;
+        float3 tr = Volume_Evaluate(&volumes[volume_idx], &shadow_rays[global_id], shadow_ray_length, VOLUME_ARGS, &tracking_sampler, &r);
 
         // This is the estimate coming from a light source
         // TODO: remove hardcoded phase func and sigma
@@ -230,8 +249,15 @@ KERNEL void ShadeVolume(
         wo = Sample_MapToSphere(Sampler_Sample2D(&sampler, SAMPLER_ARGS));
         pdf = 1.f / (4.f * PI);
 
-        // Generate new path segment
+        // Ray cone grows up to the scattering point and widens by the phase function lobe,
+        // which is as rough as it gets
+        float cone_spread = Ray_GetExtra(&rays[hit_idx]).y;
+        path->cone_width += cone_spread * Intersection_GetDistance(isects + hit_idx);
+        cone_spread += RAY_CONE_BXDF_SPREAD * native_rsqrt(PI * pdf);
+
+        // Generate new path segment, pdf is used for MIS if it hits a light
         Ray_Init(indirect_rays + global_id, dg.p, normalize(wo), CRAZY_HIGH_DISTANCE, 0.f, 0xFFFFFFFF);
+        Ray_SetExtra(indirect_rays + global_id, make_float2(pdf, cone_spread));
 
         // Update path throughput multiplying by phase function.
         Path_MulThroughput(path, volumes[volume_idx].sigma_s * PhaseFunction_Uniform(wi, normalize(wo)) / pdf);
@@ -277,6 +303,8 @@ KERNEL void ShadeSurface(
     TEXTURE_ARG_LIST,
     // Environment texture index
     int env_light_idx,
+    // Environment SH irradiance
+    GLOBAL float3 const* restrict env_light_sh,
     // Emissives
     GLOBAL Light const* restrict lights,
     // Light distribution
@@ -295,6 +323,8 @@ KERNEL void ShadeSurface(
     int frame,
     // Volume data
     GLOBAL Volume const* restrict volumes,
+    // Volume grids
+    VOLUME_ARG_LIST,
     // Shadow rays
     GLOBAL ray* restrict shadow_rays,
     // Light samples
@@ -304,7 +334,15 @@ KERNEL void ShadeSurface(
     // Indirect rays
     GLOBAL ray* restrict indirect_rays,
     // Radiance
-    GLOBAL float3* restrict output
+    GLOBAL float3* restrict output,
+    // Path guiding sampling distributions
+    GLOBAL float const* restrict guiding_cdf,
+    // Path guiding training histograms
+    GLOBAL float* restrict guiding_train,
+    // Path guiding grid bounds (min, max)
+    GLOBAL float3 const* restrict guiding_bounds,
+    // Path guiding vertices
+    GLOBAL GuidingVertex* restrict guiding_vertices
 )
 {
     int global_id = get_global_id(0);
@@ -360,6 +398,11 @@ KERNEL void ShadeSurface(
         DifferentialGeometry diffgeo;
         Scene_FillDifferentialGeometry(&scene, &isect, &diffgeo); 
 
+        // Grow the ray cone up to the hit point, its footprint selects texture mip levels
+        float cone_spread = Ray_GetExtra(&rays[hit_idx]).y;
+        float cone_width = path->cone_width + cone_spread * isect.uvwt.w;
+        Scene_ApplyRayCone(&scene, &isect, wi, cone_width, &diffgeo);
+
         // Check if we are hitting from the inside
         float ngdotwi = dot(diffgeo.ng, wi);
         bool backfacing = ngdotwi < 0.f;
@@ -386,11 +429,20 @@ KERNEL void ShadeSurface(
 
                 // In this case we hit after an application of MIS process at previous step.
                 // That means BRDF weight has been already applied.
-                float3 v = Path_GetThroughput(path) * Emissive_GetLe(&diffgeo, TEXTURE_ARGS) * weight;
+                float3 le = Emissive_GetLe(&diffgeo, TEXTURE_ARGS) * weight;
+                float3 v = Path_GetThroughput(path) * le;
                 int output_index = output_indices[pixel_idx];
                 ADD_FLOAT3(&output[output_index], v);
+
+#ifdef BAIKAL_PATH_GUIDING
+                // Emitted radiance trains every guided vertex the path went through
+                PathGuiding_TrainPath(guiding_train, guiding_vertices + pixel_idx * GUIDING_PATH_VERTICES, path->guide_count, v);
+#endif
             }
 
+#ifdef BAIKAL_PATH_GUIDING
+            path->light_guide_record = -1;
+#endif
             Path_Kill(path);
             Ray_SetInactive(shadow_rays + global_id);
             Ray_SetInactive(indirect_rays + global_id);
@@ -414,11 +466,26 @@ KERNEL void ShadeSurface(
         }
 
 
-        DifferentialGeometry_ApplyBumpNormalMap(&diffgeo, TEXTURE_ARGS);
+        DifferentialGeometry_ApplyNormalMap(&diffgeo, TEXTURE_ARGS);
         DifferentialGeometry_CalculateTangentTransforms(&diffgeo);
 
         float ndotwi = fabs(dot(diffgeo.n, wi));
 
+#ifdef BAIKAL_SH_IBL_PREVIEW
+        // In preview mode Lambert lobes take environment lighting from SH irradiance,
+        // so environment shadow rays and BxDF sampled environment hits are skipped
+        bool sh_irradiance = env_light_idx > -1 && diffgeo.mat.type == kLambert;
+
+        if (sh_irradiance)
+        {
+            Path_SetShIrradianceFlag(path);
+        }
+        else
+        {
+            Path_ClearShIrradianceFlag(path);
+        }
+#endif
+
         float light_pdf = 0.f;
         float bxdf_light_pdf = 0.f;
         float bxdf_pdf = 0.f;
@@ -438,12 +505,65 @@ KERNEL void ShadeSurface(
         // Sample bxdf
         float3 bxdf = Bxdf_Sample(&diffgeo, wi, TEXTURE_ARGS, Sampler_Sample2D(&sampler, SAMPLER_ARGS), &bxdfwo, &bxdf_pdf);
 
+#ifdef BAIKAL_PATH_GUIDING
+        int guide_cell = PathGuiding_GetCell(diffgeo.p, guiding_bounds[0], guiding_bounds[1]);
+        bool guided = !Bxdf_IsSingular(&diffgeo) && PathGuiding_IsTrained(guiding_cdf, guide_cell);
+
+        // One-sample MIS between the BxDF and the learned distribution of the cell
+        if (guided)
+        {
+            float guide_selection = Sampler_Sample1D(&sampler, SAMPLER_ARGS);
+            float2 guide_sample = Sampler_Sample2D(&sampler, SAMPLER_ARGS);
+            float guide_pdf = 0.f;
+
+            if (guide_selection < GUIDING_SAMPLING_FRACTION)
+            {
+                bxdfwo = PathGuiding_Sample(guiding_cdf, guide_cell, guide_sample, &guide_pdf);
+                bxdf = Bxdf_Evaluate(&diffgeo, wi, bxdfwo, TEXTURE_ARGS);
+                bxdf_pdf = Bxdf_GetPdf(&diffgeo, wi, bxdfwo, TEXTURE_ARGS);
+            }
+            else
+            {
+                guide_pdf = PathGuiding_GetPdf(guiding_cdf, guide_cell, normalize(bxdfwo));
+            }
+
+            bxdf_pdf = mix(bxdf_pdf, guide_pdf, GUIDING_SAMPLING_FRACTION);
+        }
+
+        path->light_guide_record = -1;
+        path->light_guide_count = path->guide_count;
+#endif
+
+#ifdef BAIKAL_SH_IBL_PREVIEW
+        if (sh_irradiance && light_idx == env_light_idx)
+        {
+            Light light = scene.lights[light_idx];
+            float3 e = EnvironmentLight_GetShIrradiance(&light, env_light_sh, diffgeo.n);
+            float3 v = e * Bxdf_Evaluate(&diffgeo, wi, diffgeo.n, TEXTURE_ARGS) * throughput / selection_pdf;
+            int output_index = output_indices[pixel_idx];
+            ADD_FLOAT3(&output[output_index], REASONABLE_RADIANCE(v));
+
+#ifdef BAIKAL_PATH_GUIDING
+            PathGuiding_TrainPath(guiding_train, guiding_vertices + pixel_idx * GUIDING_PATH_VERTICES, path->guide_count, REASONABLE_RADIANCE(v));
+#endif
+
+            // Environment has been accounted for, no need to sample it
+            light_idx = -1;
+        }
+#endif
+
         // If we have light to sample we can hopefully do mis 
         if (light_idx > -1) 
         {
             // Sample light
             float3 le = Light_Sample(light_idx, &scene, &diffgeo, TEXTURE_ARGS, Sampler_Sample2D(&sampler, SAMPLER_ARGS), &lightwo, &light_pdf);
             light_bxdf_pdf = Bxdf_GetPdf(&diffgeo, wi, normalize(lightwo), TEXTURE_ARGS);
+#ifdef BAIKAL_PATH_GUIDING
+            if (guided)
+            {
+                light_bxdf_pdf = mix(light_bxdf_pdf, PathGuiding_GetPdf(guiding_cdf, guide_cell, normalize(lightwo)), GUIDING_SAMPLING_FRACTION);
+            }
+#endif
             light_weight = Light_IsSingular(&scene.lights[light_idx]) ? 1.f : BalanceHeuristic(1, light_pdf * selection_pdf, 1, light_bxdf_pdf); 
 
             // Apply MIS to account for both
@@ -452,6 +572,12 @@ KERNEL void ShadeSurface(
                 wo = lightwo;
                 float ndotwo = fabs(dot(diffgeo.n, normalize(wo)));
                 radiance = le * ndotwo * Bxdf_Evaluate(&diffgeo, wi, normalize(wo), TEXTURE_ARGS) * throughput * light_weight / light_pdf / selection_pdf;
+
+#ifdef BAIKAL_PATH_GUIDING
+                // Light sample trains the cache once its visibility is known (GatherLightSamples)
+                path->light_guide_record = guide_cell * GUIDING_NUM_BINS + PathGuiding_GetBin(normalize(wo));
+                path->light_guide_value = luminance(le) * light_weight / light_pdf / selection_pdf;
+#endif
             }
         }
 
@@ -471,8 +597,12 @@ KERNEL void ShadeSurface(
             int volume_idx = Path_GetVolumeIdx(path);
             if (volume_idx != -1)
             {
-                radiance *= Volume_Transmittance(&volumes[volume_idx], &shadow_rays[global_id], shadow_ray_length);
-                radiance += Volume_Emission(&volumes[volume_idx], &shadow_rays[global_id], shadow_ray_length) * throughput;
+                Sampler tracking_sampler;
+                Volume_InitTrackingSampler(&tracking_sampler, as_uint(Sampler_Sample1D(&sampler, SAMPLER_ARGS)), pixel_idx);
+
+                float3 emission;
+                radiance *= Volume_Evaluate(&volumes[volume_idx], &shadow_rays[global_id], shadow_ray_length, VOLUME_ARGS, &tracking_sampler, &emission);
+                radiance += emission * throughput;
             }
 
             // And write the light sample 
@@ -520,8 +650,32 @@ KERNEL void ShadeSurface(
             float3 indirect_ray_dir = bxdfwo;
             float3 indirect_ray_o = diffgeo.p + CRAZY_LOW_DISTANCE * s * diffgeo.ng;
 
+            // Rough lobes widen the ray cone by the solid angle a single sample represents,
+            // singular ones keep the spread (surface curvature is not accounted for)
+            if (!Bxdf_IsSingular(&diffgeo))
+            {
+                cone_spread += RAY_CONE_BXDF_SPREAD * native_rsqrt(PI * bxdf_pdf);
+            }
+
+            path->cone_width = cone_width;
+
+#ifdef BAIKAL_PATH_GUIDING
+            // Radiance found further down the path trains this bin, singular directions are not tracked
+            if (!Bxdf_IsSingular(&diffgeo))
+            {
+                PathGuiding_AddVertex(guiding_vertices + pixel_idx * GUIDING_PATH_VERTICES, path, guide_cell * GUIDING_NUM_BINS + PathGuiding_GetBin(bxdfwo), bxdf_pdf);
+            }
+#endif
+
             Ray_Init(indirect_rays + global_id, indirect_ray_o, indirect_ray_dir, CRAZY_HIGH_DISTANCE, 0.f, 0xFFFFFFFF);
-            Ray_SetExtra(indirect_rays + global_id, make_float2(bxdf_pdf, 0.f));
+            Ray_SetExtra(indirect_rays + global_id, make_float2(bxdf_pdf, cone_spread));
+
+            // Enter or leave the volume enclosed by the shape if the path goes through its surface
+            int shape_volume_idx = shapes[isect.shapeid - 1].volume_idx;
+            if (shape_volume_idx != -1 && dot(diffgeo.ng, indirect_ray_dir) * ngdotwi < 0.f)
+            {
+                path->volume = backfacing ? -1 : shape_volume_idx;
+            }
         }
         else
         {
@@ -551,6 +705,10 @@ KERNEL void ShadeBackgroundEnvMap(
     // Environment texture index
     GLOBAL Path const* restrict paths,
     GLOBAL Volume const* restrict volumes,
+    // Volume grids
+    VOLUME_ARG_LIST,
+    // RNG seed
+    uint rng_seed,
     // Output values
     GLOBAL float4* restrict output
 )
@@ -577,10 +735,14 @@ KERNEL void ShadeBackgroundEnvMap(
                 v.xyz = light.multiplier * Texture_SampleEnvMap(rays[global_id].d.xyz, TEXTURE_ARGS_IDX(light.tex));
             else
             {
-                v.xyz = light.multiplier * Texture_SampleEnvMap(rays[global_id].d.xyz, TEXTURE_ARGS_IDX(light.tex)) *
-                    Volume_Transmittance(&volumes[volume_idx], &rays[global_id], rays[global_id].o.w);
+                Sampler tracking_sampler;
+                Volume_InitTrackingSampler(&tracking_sampler, rng_seed, pixel_idx);
+
+                float3 emission;
+                float3 tr = Volume_Evaluate(&volumes[volume_idx], &rays[global_id], rays[global_id].o.w, VOLUME_ARGS, &tracking_sampler, &emission);
 
-                v.xyz += Volume_Emission(&volumes[volume_idx], &rays[global_id], rays[global_id].o.w);
+                v.xyz = light.multiplier * Texture_SampleEnvMap(rays[global_id].d.xyz, TEXTURE_ARGS_IDX(light.tex)) * tr;
+                v.xyz += emission;
             }
         }
 
@@ -603,7 +765,11 @@ KERNEL void GatherLightSamples(
     // throughput
     GLOBAL Path const* restrict paths,
     // Radiance sample buffer
-    GLOBAL float4* restrict output
+    GLOBAL float4* restrict output,
+    // Path guiding training histograms
+    GLOBAL float* restrict guiding_train,
+    // Path guiding vertices
+    GLOBAL GuidingVertex const* restrict guiding_vertices
 )
 {
     int global_id = get_global_id(0);
@@ -624,6 +790,12 @@ KERNEL void GatherLightSamples(
             {
                 // Add its contribution to radiance accumulator
                 radiance.xyz += light_samples[global_id];  
+
+#ifdef BAIKAL_PATH_GUIDING
+                GLOBAL Path const* path = paths + pixel_idx;
+                PathGuiding_Train(guiding_train, path->light_guide_record, path->light_guide_value);
+                PathGuiding_TrainPath(guiding_train, guiding_vertices + pixel_idx * GUIDING_PATH_VERTICES, path->light_guide_count, light_samples[global_id]);
+#endif
             }
         }
 
@@ -664,7 +836,9 @@ KERNEL void FilterPathStream(
     // Paths
     GLOBAL Path* restrict paths,
     // Predicate
-    GLOBAL int* restrict predicate
+    GLOBAL int* restrict predicate,
+    // Number of items to compact
+    int num_items
 )
 {
     int global_id = get_global_id(0);
@@ -695,6 +869,12 @@ KERNEL void FilterPathStream(
             predicate[global_id] = 0;
         }
     }
+    // Items past the working subset are dropped by compaction,
+    // this saves clearing predicate buffer on every bounce
+    else if (global_id < num_items)
+    {
+        predicate[global_id] = 0;
+    }
 }
 
 ///< Illuminate missing rays
@@ -719,8 +899,16 @@ KERNEL void ShadeMiss(
     TEXTURE_ARG_LIST,
     GLOBAL Path const* restrict paths,
     GLOBAL Volume const* restrict volumes,
+    // Volume grids
+    VOLUME_ARG_LIST,
+    // RNG seed
+    uint rng_seed,
     // Output values
-    GLOBAL float4* restrict output
+    GLOBAL float4* restrict output,
+    // Path guiding training histograms
+    GLOBAL float* restrict guiding_train,
+    // Path guiding vertices
+    GLOBAL GuidingVertex const* restrict guiding_vertices
 )
 {
     int global_id = get_global_id(0);
@@ -732,8 +920,14 @@ KERNEL void ShadeMiss(
 
         GLOBAL Path const* path = paths + pixel_idx;
 
+        bool skip = false;
+#ifdef BAIKAL_SH_IBL_PREVIEW
+        // Environment has been accounted for by SH irradiance at the previous vertex
+        skip = Path_IsShIrradiance(path);
+#endif
+
         // In case of a miss
-        if (isects[global_id].shapeid < 0 && Path_IsAlive(path))
+        if (isects[global_id].shapeid < 0 && Path_IsAlive(path) && !skip)
         {
             Light light = lights[env_light_idx];
 
@@ -744,10 +938,112 @@ KERNEL void ShadeMiss(
             float weight = BalanceHeuristic(1, extra.x, 1, light_pdf * selection_pdf);
 
             float3 t = Path_GetThroughput(path);
+            float3 le = weight * light.multiplier * Texture_SampleEnvMap(rays[global_id].d.xyz, TEXTURE_ARGS_IDX(light.tex));
             float4 v = 0.f;
-            v.xyz = REASONABLE_RADIANCE(weight * light.multiplier * Texture_SampleEnvMap(rays[global_id].d.xyz, TEXTURE_ARGS_IDX(light.tex)) * t);
+            v.xyz = REASONABLE_RADIANCE(le * t);
             ADD_FLOAT4(&output[output_index], v);
+
+#ifdef BAIKAL_PATH_GUIDING
+            PathGuiding_TrainPath(guiding_train, guiding_vertices + pixel_idx * GUIDING_PATH_VERTICES, path->guide_count, v.xyz);
+#endif
+        }
+    }
+}
+
+
+// Spread lower 10 bits of x to every third bit
+INLINE uint Part1By2(uint x)
+{
+    x &= 0x000003ff;
+    x = (x ^ (x << 16)) & 0xff0000ff;
+    x = (x ^ (x << 8)) & 0x0300f00f;
+    x = (x ^ (x << 4)) & 0x030c30c3;
+    x = (x ^ (x << 2)) & 0x09249249;
+    return x;
+}
+
+INLINE uint Morton3D(uint x, uint y, uint z)
+{
+    return (Part1By2(z) << 2) + (Part1By2(y) << 1) + Part1By2(x);
+}
+
+#define RAY_SORT_CELL_BITS 8
+// Keys of inactive rays and of the unused tail of the buffer,
+// they are sorted to the end in that order
+#define RAY_SORT_INACTIVE_KEY 0x7ffffffe
+#define RAY_SORT_TAIL_KEY 0x7fffffff
+
+///< Compute coherence sort keys: direction octant in the high bits,
+///< Morton code of the origin cell within the scene bounds in the low bits
+KERNEL void GenerateRaySortKeys(
+    // Ray batch
+    GLOBAL ray const* restrict rays,
+    // Number of rays
+    GLOBAL int const* restrict num_rays,
+    // Scene bounds (min, max)
+    GLOBAL float3 const* restrict scene_bounds,
+    // Ray buffer size
+    int size,
+    // Sort keys
+    GLOBAL int* restrict keys,
+    // Ray indices
+    GLOBAL int* restrict values
+)
+{
+    int global_id = get_global_id(0);
+
+    if (global_id < size)
+    {
+        int key = RAY_SORT_TAIL_KEY;
+
+        if (global_id < *num_rays)
+        {
+            GLOBAL ray const* r = rays + global_id;
+
+            if (Ray_IsActive(r))
+            {
+                float3 bounds_min = scene_bounds[0];
+                float3 extents = max(scene_bounds[1] - bounds_min, make_float3(1e-5f, 1e-5f, 1e-5f));
+                float3 rel = clamp((r->o.xyz - bounds_min) / extents, 0.f, 1.f) * (float)((1 << RAY_SORT_CELL_BITS) - 1);
+
+                uint cell = Morton3D((uint)rel.x, (uint)rel.y, (uint)rel.z);
+                uint octant = (r->d.x < 0.f ? 1 : 0) | (r->d.y < 0.f ? 2 : 0) | (r->d.z < 0.f ? 4 : 0);
+
+                key = (int)((octant << (3 * RAY_SORT_CELL_BITS)) | cell);
+            }
+            else
+            {
+                key = RAY_SORT_INACTIVE_KEY;
+            }
         }
+
+        keys[global_id] = key;
+        values[global_id] = global_id;
     }
 }
 
+///< Gather rays and their pixel indices in sorted order
+KERNEL void ReorderRays(
+    // Sorted ray indices
+    GLOBAL int const* restrict order,
+    // Number of rays
+    GLOBAL int const* restrict num_rays,
+    // Rays in original order
+    GLOBAL ray const* restrict rays_in,
+    // Pixel indices in original order
+    GLOBAL int const* restrict pixel_indices_in,
+    // Sorted rays
+    GLOBAL ray* restrict rays_out,
+    // Sorted pixel indices
+    GLOBAL int* restrict pixel_indices_out
+)
+{
+    int global_id = get_global_id(0);
+
+    if (global_id < *num_rays)
+    {
+        int idx = order[global_id];
+        rays_out[global_id] = rays_in[idx];
+        pixel_indices_out[global_id] = pixel_indices_in[idx];
+    }
+}
@@ -64,6 +64,9 @@ typedef struct
     int startvtx;
     // Start material idx
     int start_material_idx;
+    // Volume enclosed by the shape (-1 if none)
+    int volume_idx;
+    int padding[3];
     // Linear motion vector
     float3 linearvelocity;
     // Angular velocity
@@ -114,7 +117,9 @@ typedef struct _Material
             int weight_map_idx;
             int top_brdf_idx;
             int base_brdf_idx;
-            int padding1[8];
+            // Offset of compiled graph in material ops
+            int program;
+            int padding1[7];
         } compound;
 
         struct
@@ -149,11 +154,48 @@ typedef struct _Material
     };
 
     int type;
-    int bump_flag;
+    int padding2;
     int thin;
     int nmapidx;
 } Material;
 
+enum MaterialOpType
+{
+    // Select BxDF record
+    kMaterialOpBxdf,
+    // Stochastic choice between two branches by weight
+    kMaterialOpMix,
+    // Stochastic choice between two branches by Fresnel term of top layer
+    kMaterialOpFresnelBlend,
+    kMaterialOpFresnelBlendBeckmann,
+    // Stochastic choice among entries with precomputed probabilities
+    kMaterialOpSelect,
+    // Select entry pointing to a branch
+    kMaterialOpJump
+};
+
+// Compound materials are compiled into a flat sequence of ops in
+// pre-order: the first branch of binary op follows it, the second
+// one starts at op + arg. Ops are stored in the material buffer
+// after material records.
+typedef struct _MaterialOp
+{
+    int type;
+    // Material index (kMaterialOpBxdf), offset of second branch (kMaterialOpMix, kMaterialOpFresnelBlend),
+    // number of entries (kMaterialOpSelect) or offset of branch (kMaterialOpJump)
+    int arg;
+    // Mix weight, IOR or cumulative probability of select entry
+    float weight;
+    union
+    {
+        // Weight texture of kMaterialOpMix
+        int weight_map_idx;
+        // Top layer roughness of kMaterialOpFresnelBlend,
+        // negative if it is textured and has to be sampled from top layer record
+        float roughness;
+    };
+} MaterialOp;
+
 enum LightType
 {
     kPoint = 0x1,
@@ -235,6 +277,28 @@ typedef struct _Volume
         float3 sigma_e;
     } Volume;
 
+// Sparse density grid of a heterogeneous volume.
+// Voxels are grouped into bricks of VOLUME_BRICK_SIZE^3, bricks
+// containing only zero density are not stored in the brick pool.
+typedef struct _VolumeGrid
+    {
+        // World space bounds
+        float3 pmin;
+        float3 pmax;
+        // Voxel resolution
+        int resx;
+        int resy;
+        int resz;
+        // Offset of the grid in brick index table
+        int index_offset;
+        // Brick table resolution
+        int bricksx;
+        int bricksy;
+        int bricksz;
+        // Maximum density over the grid (majorant)
+        float max_density;
+    } VolumeGrid;
+
 /// Supported formats
 enum TextureFormat
 {
@@ -244,6 +308,15 @@ enum TextureFormat
     RGBA32
 };
 
+/// Supported wrap modes
+enum TextureWrap
+{
+    WRAP_REPEAT,
+    WRAP_MIRRORED_REPEAT,
+    WRAP_CLAMP_TO_EDGE,
+    WRAP_CLAMP_TO_BORDER
+};
+
 /// Texture description
 typedef
     struct _Texture
@@ -256,7 +329,13 @@ typedef
         int dataoffset;
         // Format
         int fmt;
-        int extra;
+        // Wrap mode
+        int wrap;
+        // Number of mip levels, they are tightly packed after the top one
+        int mipcount;
+        // Top left corner of the region in the texture atlas image, -1 if texture is not there
+        int atlasx;
+        int atlasy;
     } Texture;
 
 
@@ -275,6 +354,8 @@ typedef struct _DifferentialGeometry
     float3 dpdu;
     float3 dpdv;
     float  area;
+    // Ray cone footprint width in uv space, 0 means top texture mip level
+    float  uv_footprint;
 
     matrix4x4 world_to_tangent;
     matrix4x4 tangent_to_world;
@@ -33,7 +33,7 @@ typedef struct
     float4 d;
     // x - ray mask, y - activity flag
     int2 extra;
-    // Padding
+    // Extra data: x - pdf of the ray direction, y - ray cone spread angle
     float2 padding;
 } ray;
 
@@ -43,6 +43,12 @@ INLINE void Ray_SetInactive(GLOBAL ray* r)
     r->extra.y = 0;
 }
 
+// Check ray activity flag
+INLINE bool Ray_IsActive(GLOBAL ray const* r)
+{
+    return r->extra.y != 0;
+}
+
 // Set extra data for ray
 INLINE void Ray_SetExtra(GLOBAL ray* r, float2 extra)
 {
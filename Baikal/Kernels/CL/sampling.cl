@@ -31,6 +31,7 @@ THE SOFTWARE.
 #define SAMPLE_DIM_VOLUME_APPLY_OFFSET 100
 #define SAMPLE_DIM_VOLUME_EVALUATE_OFFSET 200
 #define SAMPLE_DIM_IMG_PLANE_EVALUATE_OFFSET 200
+#define SAMPLE_DIM_CONNECT_OFFSET 250
 
 typedef struct
 {
@@ -372,42 +373,91 @@ int lower_bound(GLOBAL float const* values, int n, float value)
 
     return b;
 }
-/// Sample 1D distribution
-float Distribution1D_Sample(float s, GLOBAL int const* data, float* pdf)
+
+// First element greater than value
+int upper_bound(GLOBAL float const* values, int n, float value)
+{
+    int count = n;
+    int b = 0;
+    int it = 0;
+    int step = 0;
+
+    while (count > 0)
+    {
+        it = b;
+        step = count / 2;
+        it += step;
+        if (values[it] <= value)
+        {
+            b = ++it;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    return b;
+}
+
+// Distribution layout (see Distribution1D::Serialize):
+// num_segments, CDF[num_segments + 1], PDF[num_segments],
+// alias probabilities[num_segments], alias indices[num_segments]
+
+/// Sample 1D distribution, CDF is inverted to keep stratification of the samples.
+/// Index of the segment the value falls into is returned in segment.
+float Distribution1D_SampleSegment(float s, GLOBAL int const* data, float* pdf, int* segment)
 {
     int num_segments = data[0];
 
     GLOBAL float const* cdf_data = (GLOBAL float const*)&data[1];
     GLOBAL float const* pdf_data = cdf_data + num_segments + 1;
 
-    int segment_idx = max(lower_bound(cdf_data, num_segments + 1, s), 1);
+    // First segment ending past s, empty segments are skipped.
+    // s at the end of the range maps to the last non-empty segment.
+    int segment_idx = s < cdf_data[num_segments] ?
+        upper_bound(cdf_data, num_segments + 1, s) :
+        lower_bound(cdf_data, num_segments + 1, cdf_data[num_segments]);
+    segment_idx = clamp(segment_idx, 1, num_segments);
 
     // Find lerp coefficient
-    float du = (s - cdf_data[segment_idx - 1]) / (cdf_data[segment_idx] - cdf_data[segment_idx - 1]);
+    float width = cdf_data[segment_idx] - cdf_data[segment_idx - 1];
+    float du = width > 0.f ? clamp((s - cdf_data[segment_idx - 1]) / width, 0.f, 1.f) : 0.f;
 
     // Calc pdf
     *pdf = pdf_data[segment_idx - 1];
+    *segment = segment_idx - 1;
 
-    return (segment_idx - 1 + du) / num_segments;;
+    return (segment_idx - 1 + du) / num_segments;
 }
 
 /// Sample 1D distribution
+float Distribution1D_Sample(float s, GLOBAL int const* data, float* pdf)
+{
+    int segment;
+    return Distribution1D_SampleSegment(s, data, pdf, &segment);
+}
+
+/// Sample segment of 1D distribution from alias table
 int Distribution1D_SampleDiscrete(float s, GLOBAL int const* data, float* pdf)
 {
     int num_segments = data[0];
 
     GLOBAL float const* cdf_data = (GLOBAL float const*)&data[1];
     GLOBAL float const* pdf_data = cdf_data + num_segments + 1;
+    GLOBAL float const* alias_probability = pdf_data + num_segments;
+    GLOBAL int const* alias = (GLOBAL int const*)(alias_probability + num_segments);
 
-    int segment_idx = max(lower_bound(cdf_data, num_segments + 1, s), 1);
-
-    // Find lerp coefficient
-    float du = (s - cdf_data[segment_idx - 1]) / (cdf_data[segment_idx] - cdf_data[segment_idx - 1]);
+    // Integer part of scaled sample picks the entry, fractional one decides between the entry and its alias
+    float scaled = s * num_segments;
+    int entry = min((int)scaled, num_segments - 1);
+    int segment_idx = min(scaled - entry, 0.99999994f) < alias_probability[entry] ? entry : alias[entry];
 
     // Calc pdf
-    *pdf = pdf_data[segment_idx - 1] / num_segments;
+    *pdf = pdf_data[segment_idx] / num_segments;
 
-    return segment_idx - 1;
+    return segment_idx;
 }
 
 /// PDF of  1D distribution
@@ -434,6 +484,50 @@ float Distribution1D_GetPdfDiscreet(int d, GLOBAL int const* data)
     return pdf_data[d] / num_segments;
 }
 
+// Distribution layout (see Distribution2D::Serialize):
+// width, height, marginal distribution over rows (height segments),
+// then height conditional distributions (width segments each), all in Distribution1D layout
+#define DISTRIBUTION1D_SIZE(n) (4 * (n) + 2)
+
+/// Sample 2D distribution, pdf is with respect to [0,1]^2 area
+float2 Distribution2D_Sample(float2 s, GLOBAL int const* data, float* pdf)
+{
+    int width = data[0];
+    int height = data[1];
 
+    GLOBAL int const* marginal = data + 2;
+
+    // Take the row from the sampled segment, v * height may round into a neighbouring empty row
+    float row_pdf;
+    int row;
+    float v = Distribution1D_SampleSegment(s.y, marginal, &row_pdf, &row);
+
+    GLOBAL int const* conditional = marginal + DISTRIBUTION1D_SIZE(height) + row * DISTRIBUTION1D_SIZE(width);
+
+    float column_pdf;
+    float u = Distribution1D_Sample(s.x, conditional, &column_pdf);
+
+    *pdf = row_pdf * column_pdf;
+    return make_float2(u, v);
+}
+
+/// PDF of 2D distribution at a point in [0,1]^2
+float Distribution2D_GetPdf(float2 uv, GLOBAL int const* data)
+{
+    int width = data[0];
+    int height = data[1];
+
+    int x = clamp((int)(uv.x * width), 0, width - 1);
+    int y = clamp((int)(uv.y * height), 0, height - 1);
+
+    GLOBAL int const* marginal = data + 2;
+    GLOBAL int const* conditional = marginal + DISTRIBUTION1D_SIZE(height) + y * DISTRIBUTION1D_SIZE(width);
+
+    GLOBAL float const* row_pdf = (GLOBAL float const*)&marginal[1] + height + 1;
+    GLOBAL float const* column_pdf = (GLOBAL float const*)&conditional[1] + width + 1;
+
+    // Rows with zero integral have undefined conditionals
+    return row_pdf[y] > 0.f ? row_pdf[y] * column_pdf[x] : 0.f;
+}
 
 #endif // SAMPLING_CL
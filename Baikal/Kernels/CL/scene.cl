@@ -120,6 +120,52 @@ INLINE void Scene_InterpolateAttributes(Scene const* scene, int shape_idx, int p
     *area = 0.5f * length(cross(v2 - v0, v1 - v0));
 }
 
+// Decode vertex tangent packed into normal w component at scene compile time:
+// w = sign * (angle + 4), angle is measured from GetOrthoVector(n), w == 0 means no tangent.
+// Returns object space tangent in xyz and bitangent sign in w.
+INLINE float4 Scene_GetVertexTangent(Scene const* scene, int idx)
+{
+    float4 n = ((GLOBAL float4 const*)scene->normals)[idx];
+
+    if (n.w == 0.f)
+    {
+        return make_float4(0.f, 0.f, 0.f, 0.f);
+    }
+
+    float3 nn = normalize(n.xyz);
+    float3 o = GetOrthoVector(nn);
+    float3 b = cross(nn, o);
+
+    float cos_angle;
+    float sin_angle = sincos(fabs(n.w) - 4.f, &cos_angle);
+
+    return make_float4(cos_angle * o + sin_angle * b, n.w < 0.f ? -1.f : 1.f);
+}
+
+// Interpolate precomputed vertex tangents, w is zero if any of the vertices has no tangent
+INLINE float4 Scene_InterpolateTangent(Scene const* scene, int shape_idx, int prim_idx, float2 barycentrics)
+{
+    // Extract shape data
+    Shape shape = scene->shapes[shape_idx];
+
+    // Fetch indices starting from startidx and offset by prim_idx
+    int i0 = scene->indices[shape.startidx + 3 * prim_idx];
+    int i1 = scene->indices[shape.startidx + 3 * prim_idx + 1];
+    int i2 = scene->indices[shape.startidx + 3 * prim_idx + 2];
+
+    float4 t0 = Scene_GetVertexTangent(scene, shape.startvtx + i0);
+    float4 t1 = Scene_GetVertexTangent(scene, shape.startvtx + i1);
+    float4 t2 = Scene_GetVertexTangent(scene, shape.startvtx + i2);
+
+    if (t0.w == 0.f || t1.w == 0.f || t2.w == 0.f)
+    {
+        return make_float4(0.f, 0.f, 0.f, 0.f);
+    }
+
+    float3 t = (1.f - barycentrics.x - barycentrics.y) * t0.xyz + barycentrics.x * t1.xyz + barycentrics.y * t2.xyz;
+    return make_float4(matrix_mul_vector3(shape.transform, t), t0.w);
+}
+
 // Get material index of a shape face
 INLINE int Scene_GetMaterialIndex(Scene const* scene, int shape_idx, int prim_idx)
 {
@@ -171,37 +217,21 @@ void Scene_FillDifferentialGeometry(// Scene
     int material_idx = Scene_GetMaterialIndex(scene, shape_idx, prim_idx);
     diffgeo->mat = scene->materials[material_idx];
 
-    // Get UVs
-    float2 uv0, uv1, uv2;
-    Scene_GetTriangleUVs(scene, shape_idx, prim_idx, &uv0, &uv1, &uv2);
-
     // Reverse geometric normal if shading normal points to different side
     if (dot(diffgeo->ng, diffgeo->n) < 0.f)
     {
         diffgeo->ng = -diffgeo->ng;
     }
 
-    /// Calculate tangent basis
-    /// From PBRT book
-    float du1 = uv0.x - uv2.x;
-    float du2 = uv1.x - uv2.x;
-    float dv1 = uv0.y - uv2.y;
-    float dv2 = uv1.y - uv2.y;
-    float3 dp1 = v0 - v2;
-    float3 dp2 = v1 - v2;
-    float det = du1 * dv2 - dv1 * du2;
-
-    if (0 && det != 0.f)
+    // Tangent basis is precomputed per vertex at scene compile time,
+    // fall back to arbitrary basis if uvs are missing or degenerate
+    float4 tangent = Scene_InterpolateTangent(scene, shape_idx, prim_idx, barycentrics);
+    float3 dpdu = tangent.xyz - dot(diffgeo->n, tangent.xyz) * diffgeo->n;
+
+    if (tangent.w != 0.f && dot(dpdu, dpdu) > 0.f)
     {
-        float invdet = 1.f / det;
-        diffgeo->dpdu = normalize( (dv2 * dp1 - dv1 * dp2) * invdet );
-        diffgeo->dpdv = normalize( (-du2 * dp1 + du1 * dp2) * invdet );
-        diffgeo->dpdu -= dot(diffgeo->n, diffgeo->dpdu) * diffgeo->n;
-        diffgeo->dpdu = normalize(diffgeo->dpdu);
-        
-        diffgeo->dpdv -= dot(diffgeo->n, diffgeo->dpdv) * diffgeo->n;
-        diffgeo->dpdv -= dot(diffgeo->dpdu, diffgeo->dpdv) * diffgeo->dpdu;
-        diffgeo->dpdv = normalize(diffgeo->dpdv);
+        diffgeo->dpdu = normalize(dpdu);
+        diffgeo->dpdv = tangent.w * cross(diffgeo->n, diffgeo->dpdu);
     }
     else
     {
@@ -210,6 +240,25 @@ void Scene_FillDifferentialGeometry(// Scene
     }
 
     diffgeo->material_index = material_idx;
+
+    // Textures are sampled at the top mip level unless ray cone is applied
+    diffgeo->uv_footprint = 0.f;
+}
+
+// Calculate uv space footprint of a ray cone of given width at the hit point
+INLINE void Scene_ApplyRayCone(Scene const* scene, Intersection const* isect, float3 wi, float cone_width, DifferentialGeometry* diffgeo)
+{
+    float2 uv0, uv1, uv2;
+    Scene_GetTriangleUVs(scene, isect->shapeid - 1, isect->primid, &uv0, &uv1, &uv2);
+
+    float2 duv1 = uv1 - uv0;
+    float2 duv2 = uv2 - uv0;
+    float uv_area = 0.5f * fabs(duv1.x * duv2.y - duv2.x * duv1.y);
+
+    // Footprint is stretched at grazing angles
+    float cos_theta = max(fabs(dot(diffgeo->n, wi)), 0.1f);
+
+    diffgeo->uv_footprint = diffgeo->area > 0.f ? cone_width / cos_theta * native_sqrt(uv_area / diffgeo->area) : 0.f;
 }
 
 
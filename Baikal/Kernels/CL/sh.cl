@@ -41,7 +41,10 @@ typedef struct _Texture
     // Offset in texture data array
     int dataoffset;
     int fmt;
-    int extra;
+    int wrap;
+    int mipcount;
+    int atlasx;
+    int atlasy;
 } Texture;
 
 
@@ -184,61 +187,67 @@ __kernel void ShProject(
     int w = envmap.w;
     int h = envmap.h;
 
+    // Out of range work items contribute zeroes but still take part in the reduction
+    float ylm[9] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+    float3 le = make_float3(0.f, 0.f, 0.f);
+
     if (x < w && y < h)
     {
-        // Calculate spherical angles
+        // Calculate spherical angles at texel centers (matches host ShProjectEnvironmentMap)
         float thetastep = PI / h;
         float phistep = 2.f*PI / w;
-        float theta0 = 0;//PI / h / 2.f;
-        float phi0 = 0;//2.f*PI / w / 2.f;
+        float theta0 = PI / h / 2.f;
+        float phi0 = 2.f*PI / w / 2.f;
 
         float phi = phi0 + x * phistep;
         float theta = theta0 + y * thetastep;
 
+        // Sample2D flips Y, so this fetches row y
         float2 uv;
-        uv.x = (float)x/w;
-        uv.y = 1.f - (float)y/h;
-        float3 le = 3.f * Sample2D(&envmap, texturedata, uv);
+        uv.x = (x + 0.5f) / w;
+        uv.y = 1.f - (y + 0.5f) / h;
 
         float sinphi = sin(phi);
         float cosphi = cos(phi);
         float costheta = cos(theta);
         float sintheta = sin(theta);
 
+        // Fold Riemann sum weight accounting for solid angle conversion (sin term)
+        le = Sample2D(&envmap, texturedata, uv) * sintheta * (PI / h) * (2.f * PI / w);
+
         // Construct point on unit sphere
-        float3 p = normalize(make_float3(sintheta * cosphi, costheta, sintheta * sinphi));
+        float3 p = make_float3(sintheta * cosphi, costheta, sintheta * sinphi);
 
         // Evaluate SH functions at w up to lmax band
-        float ylm[9];
         ShEvaluate(p, ylm);
+    }
 
-        // Evaluate Riemann sum
-        for (int i = 0; i < 9; ++i)
-        {
-            // Calculate the coefficient into local memory
-             cx[lid] = le * ylm[i] * sintheta * (PI / h) * (2.f * PI / w);
-
-             barrier(CLK_LOCAL_MEM_FENCE);
+    // Evaluate Riemann sum
+    for (int i = 0; i < 9; ++i)
+    {
+        // Calculate the coefficient into local memory
+        cx[lid] = le * ylm[i];
 
-             // Reduce the coefficient to get the resulting one
-             for (int stride = 1; stride <= (64 >> 1); stride <<= 1)
-             {
-                 if (lid < 64/(2*stride))
-                 {
-                     cx[2*(lid + 1)*stride-1] = cx[2*(lid + 1)*stride-1] + cx[(2*lid + 1)*stride-1];
-                 }
+        barrier(CLK_LOCAL_MEM_FENCE);
 
-                 barrier(CLK_LOCAL_MEM_FENCE);
-             }
+        // Reduce the coefficient to get the resulting one
+        for (int stride = 1; stride <= (64 >> 1); stride <<= 1)
+        {
+            if (lid < 64/(2*stride))
+            {
+                cx[2*(lid + 1)*stride-1] = cx[2*(lid + 1)*stride-1] + cx[(2*lid + 1)*stride-1];
+            }
 
-             // Put the coefficient into global memory
-             if (lid == 0)
-             {
-                coeffs[g * 9 + i] = cx[63];
-             }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
 
-             barrier(CLK_LOCAL_MEM_FENCE);
+        // Put the coefficient into global memory
+        if (lid == 0)
+        {
+            coeffs[g * 9 + i] = cx[63];
         }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
     }
 }
 
@@ -352,20 +361,16 @@ __kernel void ShReduce(
 {
     __local float3 lds[GROUP_SIZE];
 
-    int gid = get_global_id(0);
-    int lid = get_global_id(0);
-
-    // How many items to reduce for a single work item
-    int numprivate = numsets / GROUP_SIZE;
+    int lid = get_local_id(0);
 
     for (int i=0;i<9;++i)
     {
         float3 res = {0,0,0};
 
-        // Private reduction
-        for (int j=0;j<numprivate;++j)
+        // Private reduction: strided so any number of sets is covered
+        for (int j = lid; j < numsets; j += GROUP_SIZE)
         {
-            res += coeffs[gid * numprivate * 9 + j * 9 + i];
+            res += coeffs[j * 9 + i];
         }
 
         // LDS reduction
@@ -27,26 +27,154 @@ THE SOFTWARE.
 #include <../Baikal/Kernels/CL/utils.cl>
 
 
-/// To simplify a bit
+/// To simplify a bit.
+/// If the device supports images, host defines BAIKAL_TEXTURE_ATLAS and RGBA8 textures
+/// are sampled from an atlas image (see TextureAtlas), other textures are kept in texturedata.
+#ifdef BAIKAL_TEXTURE_ATLAS
+#define TEXTURE_ARG_LIST __global Texture const* textures, __global char const* texturedata, __read_only image2d_t texture_atlas
+#define TEXTURE_ARG_LIST_IDX(x) int x, __global Texture const* textures, __global char const* texturedata, __read_only image2d_t texture_atlas
+#define TEXTURE_ARGS textures, texturedata, texture_atlas
+#define TEXTURE_ARGS_IDX(x) x, textures, texturedata, texture_atlas
+#else
 #define TEXTURE_ARG_LIST __global Texture const* textures, __global char const* texturedata
 #define TEXTURE_ARG_LIST_IDX(x) int x, __global Texture const* textures, __global char const* texturedata
 #define TEXTURE_ARGS textures, texturedata
 #define TEXTURE_ARGS_IDX(x) x, textures, texturedata
+#endif
 
-/// Sample 2D texture
+/// Apply wrap mode to integer texel coordinate, returns -1 outside of clamp to border texture
 inline
-float4 Texture_Sample2D(float2 uv, TEXTURE_ARG_LIST_IDX(texidx))
+int Texture_WrapCoord(int x, int size, int wrap)
+{
+    switch (wrap)
+    {
+        case WRAP_MIRRORED_REPEAT:
+        {
+            int period = 2 * size;
+            x %= period;
+            x = x < 0 ? x + period : x;
+            return x < size ? x : period - 1 - x;
+        }
+
+        case WRAP_CLAMP_TO_EDGE:
+        {
+            return clamp(x, 0, size - 1);
+        }
+
+        case WRAP_CLAMP_TO_BORDER:
+        {
+            return x >= 0 && x < size ? x : -1;
+        }
+
+        default:
+        {
+            x %= size;
+            return x < 0 ? x + size : x;
+        }
+    }
+}
+
+#ifdef BAIKAL_TEXTURE_ATLAS
+/// Atlas regions have borders, so coordinates are never clamped by the sampler
+__constant sampler_t TextureAtlas_Sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+/// Apply wrap mode to continuous texel coordinate (texel centers at integers), so that
+/// filtering taps at floor(x) and floor(x) + 1 stay within [-1, size] covered by the region border
+inline
+float Texture_WrapCoordf(float x, int size, int wrap)
+{
+    switch (wrap)
+    {
+        case WRAP_MIRRORED_REPEAT:
+        {
+            float period = 2.f * size;
+            x -= period * floor(x / period);
+            // Mirrored half goes backwards, texel i maps to period - 1 - i
+            return x < size ? x : period - 1.f - x;
+        }
+
+        case WRAP_CLAMP_TO_EDGE:
+        {
+            return clamp(x, 0.f, size - 1.f);
+        }
+
+        case WRAP_CLAMP_TO_BORDER:
+        {
+            return clamp(x, -1.f, (float)size);
+        }
+
+        default:
+        {
+            return x - size * floor(x / size);
+        }
+    }
+}
+#endif
+
+/// Fetch single texel converted to float, border texels are black
+inline
+float4 Texture_GetTexel(__global char const* mydata, int fmt, int width, int x, int y)
+{
+    if (x < 0 || y < 0)
+    {
+        return make_float4(0.f, 0.f, 0.f, 0.f);
+    }
+
+    int idx = width * y + x;
+
+    switch (fmt)
+    {
+        case RGBA32:
+        {
+            return *((__global float4 const*)mydata + idx);
+        }
+
+        case RGBA16:
+        {
+            return vload_half4(idx, (__global half const*)mydata);
+        }
+
+        case RGBA8:
+        {
+            return convert_float4(*((__global uchar4 const*)mydata + idx)) * (1.f / 255.f);
+        }
+
+        default:
+        {
+            return make_float4(0.f, 0.f, 0.f, 0.f);
+        }
+    }
+}
+
+/// Sample given mip level of 2D texture with bilinear filtering and separate wrap modes along the axes
+inline
+float4 Texture_SampleLevelWrap(float2 uv, int level, int wrap_x, int wrap_y, TEXTURE_ARG_LIST_IDX(texidx))
 {
     // Get width and height
     int width = textures[texidx].w;
     int height = textures[texidx].h;
+    int fmt = textures[texidx].fmt;
 
     // Find the origin of the data in the pool
     __global char const* mydata = texturedata + textures[texidx].dataoffset;
 
-    // Handle UV wrap
-    // TODO: need UV mode support
-    uv -= floor(uv);
+    // Mip levels are tightly packed after the top one
+    int texel_size = fmt == RGBA32 ? 16 : (fmt == RGBA16 ? 8 : 4);
+
+#ifdef BAIKAL_TEXTURE_ATLAS
+    // Atlas levels are placed left to right, each with one texel border
+    int atlasx = textures[texidx].atlasx;
+#endif
+
+    for (int i = 0; i < level; ++i)
+    {
+        mydata += width * height * texel_size;
+#ifdef BAIKAL_TEXTURE_ATLAS
+        atlasx += width + 2;
+#endif
+        width = max(width >> 1, 1);
+        height = max(height >> 1, 1);
+    }
 
     // Reverse Y:
     // it is needed as textures are loaded with Y axis going top to down
@@ -54,71 +182,83 @@ float4 Texture_Sample2D(float2 uv, TEXTURE_ARG_LIST_IDX(texidx))
     uv.y = 1.f - uv.y;
 
     // Calculate integer coordinates
-    int x0 = clamp((int)floor(uv.x * width), 0, width - 1);
-    int y0 = clamp((int)floor(uv.y * height), 0, height - 1);
-
-    // Calculate samples for linear filtering
-    int x1 = clamp(x0 + 1, 0,  width - 1);
-    int y1 = clamp(y0 + 1, 0, height - 1);
-
-    // Calculate weights for linear filtering
-    float wx = uv.x * width - floor(uv.x * width);
-    float wy = uv.y * height - floor(uv.y * height);
+    float fx = uv.x * width;
+    float fy = uv.y * height;
 
-    switch (textures[texidx].fmt)
+#ifdef BAIKAL_TEXTURE_ATLAS
+    if (textures[texidx].atlasx >= 0)
     {
-        case RGBA32:
-        {
-            __global float4 const* mydataf = (__global float4 const*)mydata;
+        // Sampler centers texels at half integers, the border provides wrapped neighbours
+        float2 coord = make_float2(atlasx + 1.5f + Texture_WrapCoordf(fx, width, wrap_x),
+                                   textures[texidx].atlasy + 1.5f + Texture_WrapCoordf(fy, height, wrap_y));
+        return read_imagef(texture_atlas, TextureAtlas_Sampler, coord);
+    }
+#endif
 
-            // Get 4 values for linear filtering
-            float4 val00 = *(mydataf + width * y0 + x0);
-            float4 val01 = *(mydataf + width * y0 + x1);
-            float4 val10 = *(mydataf + width * y1 + x0);
-            float4 val11 = *(mydataf + width * y1 + x1);
+    int x = (int)floor(fx);
+    int y = (int)floor(fy);
 
-            // Filter and return the result
-            return lerp(lerp(val00, val01, wx), lerp(val10, val11, wx), wy);
-        }
+    // Calculate weights for linear filtering
+    float wx = fx - x;
+    float wy = fy - y;
+
+    // Handle UV wrap for samples of linear filtering
+    int x0 = Texture_WrapCoord(x, width, wrap_x);
+    int y0 = Texture_WrapCoord(y, height, wrap_y);
+    int x1 = Texture_WrapCoord(x + 1, width, wrap_x);
+    int y1 = Texture_WrapCoord(y + 1, height, wrap_y);
+
+    // Get 4 values
+    float4 val00 = Texture_GetTexel(mydata, fmt, width, x0, y0);
+    float4 val01 = Texture_GetTexel(mydata, fmt, width, x1, y0);
+    float4 val10 = Texture_GetTexel(mydata, fmt, width, x0, y1);
+    float4 val11 = Texture_GetTexel(mydata, fmt, width, x1, y1);
+
+    // Filter and return the result
+    return lerp(lerp(val00, val01, wx), lerp(val10, val11, wx), wy);
+}
 
-        case RGBA16:
-        {
-            __global half const* mydatah = (__global half const*)mydata;
+/// Sample given mip level of 2D texture with bilinear filtering
+inline
+float4 Texture_SampleLevel(float2 uv, int level, TEXTURE_ARG_LIST_IDX(texidx))
+{
+    int wrap = textures[texidx].wrap;
+    return Texture_SampleLevelWrap(uv, level, wrap, wrap, TEXTURE_ARGS_IDX(texidx));
+}
 
-            // Get 4 values
-            float4 val00 = vload_half4(width * y0 + x0, mydatah);
-            float4 val01 = vload_half4(width * y0 + x1, mydatah);
-            float4 val10 = vload_half4(width * y1 + x0, mydatah);
-            float4 val11 = vload_half4(width * y1 + x1, mydatah);
+/// Sample 2D texture
+inline
+float4 Texture_Sample2D(float2 uv, TEXTURE_ARG_LIST_IDX(texidx))
+{
+    return Texture_SampleLevel(uv, 0, TEXTURE_ARGS_IDX(texidx));
+}
 
-            // Filter and return the result
-            return lerp(lerp(val00, val01, wx), lerp(val10, val11, wx), wy);
-        }
+/// Sample 2D texture with a footprint given as a width in uv space,
+/// mip level is selected from the footprint and adjacent levels are blended
+inline
+float4 Texture_SampleLod(float2 uv, float footprint, TEXTURE_ARG_LIST_IDX(texidx))
+{
+    int mipcount = textures[texidx].mipcount;
 
-        case RGBA8:
-        {
-            __global uchar4 const* mydatac = (__global uchar4 const*)mydata;
+    if (footprint <= 0.f || mipcount <= 1)
+    {
+        return Texture_SampleLevel(uv, 0, TEXTURE_ARGS_IDX(texidx));
+    }
 
-            // Get 4 values and convert to float
-            uchar4 valu00 = *(mydatac + width * y0 + x0);
-            uchar4 valu01 = *(mydatac + width * y0 + x1);
-            uchar4 valu10 = *(mydatac + width * y1 + x0);
-            uchar4 valu11 = *(mydatac + width * y1 + x1);
+    float texels = footprint * native_sqrt((float)(textures[texidx].w * textures[texidx].h));
+    float lod = clamp(native_log2(texels), 0.f, (float)(mipcount - 1));
 
-            float4 val00 = make_float4((float)valu00.x / 255.f, (float)valu00.y / 255.f, (float)valu00.z / 255.f, (float)valu00.w / 255.f);
-            float4 val01 = make_float4((float)valu01.x / 255.f, (float)valu01.y / 255.f, (float)valu01.z / 255.f, (float)valu01.w / 255.f);
-            float4 val10 = make_float4((float)valu10.x / 255.f, (float)valu10.y / 255.f, (float)valu10.z / 255.f, (float)valu10.w / 255.f);
-            float4 val11 = make_float4((float)valu11.x / 255.f, (float)valu11.y / 255.f, (float)valu11.z / 255.f, (float)valu11.w / 255.f);
+    int level = (int)lod;
+    float weight = lod - level;
 
-            // Filter and return the result
-            return lerp(lerp(val00, val01, wx), lerp(val10, val11, wx), wy);
-        }
+    float4 value = Texture_SampleLevel(uv, level, TEXTURE_ARGS_IDX(texidx));
 
-        default:
-        {
-            return make_float4(0.f, 0.f, 0.f, 0.f);
-        }
+    if (weight > 0.f)
+    {
+        value = lerp(value, Texture_SampleLevel(uv, level + 1, TEXTURE_ARGS_IDX(texidx)), weight);
     }
+
+    return value;
 }
 
 /// Sample lattitue-longitude environment map using 3d vector
@@ -134,8 +274,8 @@ float3 Texture_SampleEnvMap(float3 d, TEXTURE_ARG_LIST_IDX(texidx))
     uv.x = phi / (2*PI);
     uv.y = 1.f - theta / PI;
 
-    // Sample the texture
-    return Texture_Sample2D(uv, TEXTURE_ARGS_IDX(texidx)).xyz;
+    // Sample the texture, theta is clamped, so poles do not blend top and bottom rows
+    return Texture_SampleLevelWrap(uv, 0, textures[texidx].wrap, WRAP_CLAMP_TO_EDGE, TEXTURE_ARGS_IDX(texidx)).xyz;
 }
 
 /// Get data from parameter value or texture
@@ -145,6 +285,8 @@ float3 Texture_GetValue3f(
                 float3 v,
                 // Texture coordinate
                 float2 uv,
+                // Footprint width in uv space
+                float footprint,
                 // Texture args
                 TEXTURE_ARG_LIST_IDX(texidx)
                 )
@@ -153,7 +295,7 @@ float3 Texture_GetValue3f(
     if (texidx != -1)
     {
         // Sample texture
-        return native_powr(Texture_Sample2D(uv, TEXTURE_ARGS_IDX(texidx)).xyz, 2.2f);
+        return native_powr(Texture_SampleLod(uv, footprint, TEXTURE_ARGS_IDX(texidx)).xyz, 2.2f);
     }
 
     // Return fixed color otherwise
@@ -167,6 +309,8 @@ float4 Texture_GetValue4f(
                 float4 v,
                 // Texture coordinate
                 float2 uv,
+                // Footprint width in uv space
+                float footprint,
                 // Texture args
                 TEXTURE_ARG_LIST_IDX(texidx)
                 )
@@ -175,7 +319,7 @@ float4 Texture_GetValue4f(
     if (texidx != -1)
     {
         // Sample texture
-        return native_powr(Texture_Sample2D(uv, TEXTURE_ARGS_IDX(texidx)), 2.2f);
+        return native_powr(Texture_SampleLod(uv, footprint, TEXTURE_ARGS_IDX(texidx)), 2.2f);
     }
 
     // Return fixed color otherwise
@@ -189,6 +333,8 @@ float Texture_GetValue1f(
                         float v,
                         // Texture coordinate
                         float2 uv,
+                        // Footprint width in uv space
+                        float footprint,
                         // Texture args
                         TEXTURE_ARG_LIST_IDX(texidx)
                         )
@@ -197,181 +343,11 @@ float Texture_GetValue1f(
     if (texidx != -1)
     {
         // Sample texture
-        return Texture_Sample2D(uv, TEXTURE_ARGS_IDX(texidx)).x;
+        return Texture_SampleLod(uv, footprint, TEXTURE_ARGS_IDX(texidx)).x;
     }
 
     // Return fixed color otherwise
     return v;
 }
 
-inline float3 TextureData_SampleNormalFromBump_uchar4(__global uchar4 const* mydatac, int width, int height, int t0, int s0)
-{
-	int t0minus = clamp(t0 - 1, 0, height - 1);
-	int t0plus = clamp(t0 + 1, 0, height - 1);
-	int s0minus = clamp(s0 - 1, 0, width - 1);
-	int s0plus = clamp(s0 + 1, 0, width - 1);
-
-	const uchar utex00 = (*(mydatac + width * t0minus + s0minus)).x;
-	const uchar utex10 = (*(mydatac + width * t0minus + (s0))).x;
-	const uchar utex20 = (*(mydatac + width * t0minus + s0plus)).x;
-
-	const uchar utex01 = (*(mydatac + width * (t0)+s0minus)).x;
-	const uchar utex21 = (*(mydatac + width * (t0)+(s0 + 1))).x;
-
-	const uchar utex02 = (*(mydatac + width * t0plus + s0minus)).x;
-	const uchar utex12 = (*(mydatac + width * t0plus + (s0))).x;
-	const uchar utex22 = (*(mydatac + width * t0plus + s0plus)).x;
-
-	const float tex00 = (float)utex00 / 255.f;
-	const float tex10 = (float)utex10 / 255.f;
-	const float tex20 = (float)utex20 / 255.f;
-
-	const float tex01 = (float)utex01 / 255.f;
-	const float tex21 = (float)utex21 / 255.f;
-
-	const float tex02 = (float)utex02 / 255.f;
-	const float tex12 = (float)utex12 / 255.f;
-	const float tex22 = (float)utex22 / 255.f;
-
-	const float Gx = tex00 - tex20 + 2.0f * tex01 - 2.0f * tex21 + tex02 - tex22;
-	const float Gy = tex00 + 2.0f * tex10 + tex20 - tex02 - 2.0f * tex12 - tex22;
-	const float3 n = make_float3(Gx, Gy, 1.f);
-
-	return n;
-}
-
-inline float3 TextureData_SampleNormalFromBump_half4(__global half const* mydatah, int width, int height, int t0, int s0)
-{
-	int t0minus = clamp(t0 - 1, 0, height - 1);
-	int t0plus = clamp(t0 + 1, 0, height - 1);
-	int s0minus = clamp(s0 - 1, 0, width - 1);
-	int s0plus = clamp(s0 + 1, 0, width - 1);
-
-	const float tex00 = vload_half4(width * t0minus + s0minus, mydatah).x;
-	const float tex10 = vload_half4(width * t0minus + (s0), mydatah).x;
-	const float tex20 = vload_half4(width * t0minus + s0plus, mydatah).x;
-
-	const float tex01 = vload_half4(width * (t0)+s0minus, mydatah).x;
-	const float tex21 = vload_half4(width * (t0)+s0plus, mydatah).x;
-
-	const float tex02 = vload_half4(width * t0plus + s0minus, mydatah).x;
-	const float tex12 = vload_half4(width * t0plus + (s0), mydatah).x;
-	const float tex22 = vload_half4(width * t0plus + s0plus, mydatah).x;
-
-	const float Gx = tex00 - tex20 + 2.0f * tex01 - 2.0f * tex21 + tex02 - tex22;
-	const float Gy = tex00 + 2.0f * tex10 + tex20 - tex02 - 2.0f * tex12 - tex22;
-	const float3 n = make_float3(Gx, Gy, 1.f);
-
-	return n;
-}
-
-inline float3 TextureData_SampleNormalFromBump_float4(__global float4 const* mydataf, int width, int height, int t0, int s0)
-{
-	int t0minus = clamp(t0 - 1, 0, height - 1);
-	int t0plus = clamp(t0 + 1, 0, height - 1);
-	int s0minus = clamp(s0 - 1, 0, width - 1);
-	int s0plus = clamp(s0 + 1, 0, width - 1);
-
-	const float tex00 = (*(mydataf + width * t0minus + s0minus)).x;
-	const float tex10 = (*(mydataf + width * t0minus + (s0))).x;
-	const float tex20 = (*(mydataf + width * t0minus + s0plus)).x;
-
-	const float tex01 = (*(mydataf + width * (t0)+s0minus)).x;
-	const float tex21 = (*(mydataf + width * (t0)+s0plus)).x;
-
-	const float tex02 = (*(mydataf + width * t0plus + s0minus)).x;
-	const float tex12 = (*(mydataf + width * t0plus + (s0))).x;
-	const float tex22 = (*(mydataf + width * t0plus + s0plus)).x;
-
-	const float Gx = tex00 - tex20 + 2.0f * tex01 - 2.0f * tex21 + tex02 - tex22;
-	const float Gy = tex00 + 2.0f * tex10 + tex20 - tex02 - 2.0f * tex12 - tex22;
-	const float3 n = make_float3(Gx, Gy, 1.f);
-
-	return n;
-}
-
-/// Sample 2D texture
-inline
-float3 Texture_SampleBump(float2 uv, TEXTURE_ARG_LIST_IDX(texidx))
-{
-    // Get width and height
-    int width = textures[texidx].w;
-    int height = textures[texidx].h;
-
-    // Find the origin of the data in the pool
-    __global char const* mydata = texturedata + textures[texidx].dataoffset;
-
-    // Handle UV wrap
-    // TODO: need UV mode support
-    uv -= floor(uv);
-
-    // Reverse Y:
-    // it is needed as textures are loaded with Y axis going top to down
-    // and our axis goes from down to top
-    uv.y = 1.f - uv.y;
-
-    // Calculate integer coordinates
-    int s0 = clamp((int)floor(uv.x * width), 0, width - 1);
-    int t0 = clamp((int)floor(uv.y * height), 0, height - 1);
-
-	int s1 = clamp(s0 + 1, 0, width - 1);
-	int t1 = clamp(t0 + 1, 0, height - 1);
-
-	// Calculate weights for linear filtering
-	float wx = uv.x * width - floor(uv.x * width);
-	float wy = uv.y * height - floor(uv.y * height);
-
-    switch (textures[texidx].fmt)
-    {
-    case RGBA32:
-    {
-        __global float3 const* mydataf = (__global float3 const*)mydata;
-
-		float3 n00 = TextureData_SampleNormalFromBump_float4(mydataf, width, height, t0, s0);
-		float3 n01 = TextureData_SampleNormalFromBump_float4(mydataf, width, height, t0, s1);
-		float3 n10 = TextureData_SampleNormalFromBump_float4(mydataf, width, height, t1, s0);
-		float3 n11 = TextureData_SampleNormalFromBump_float4(mydataf, width, height, t1, s1);
-
-		float3 n = lerp3(lerp3(n00, n01, wx), lerp3(n10, n11, wx), wy);
-
-		return 0.5f * normalize(n) + make_float3(0.5f, 0.5f, 0.5f);
-    }
-
-    case RGBA16:
-    {
-        __global half const* mydatah = (__global half const*)mydata;
-
-		float3 n00 = TextureData_SampleNormalFromBump_half4(mydatah, width, height, t0, s0);
-		float3 n01 = TextureData_SampleNormalFromBump_half4(mydatah, width, height, t0, s1);
-		float3 n10 = TextureData_SampleNormalFromBump_half4(mydatah, width, height, t1, s0);
-		float3 n11 = TextureData_SampleNormalFromBump_half4(mydatah, width, height, t1, s1);
-
-		float3 n = lerp3(lerp3(n00, n01, wx), lerp3(n10, n11, wx), wy);
-
-		return 0.5f * normalize(n) + make_float3(0.5f, 0.5f, 0.5f);
-    }
-
-    case RGBA8:
-    {
-        __global uchar4 const* mydatac = (__global uchar4 const*)mydata;
-
-		float3 n00 = TextureData_SampleNormalFromBump_uchar4(mydatac, width, height, t0, s0);
-		float3 n01 = TextureData_SampleNormalFromBump_uchar4(mydatac, width, height, t0, s1);
-		float3 n10 = TextureData_SampleNormalFromBump_uchar4(mydatac, width, height, t1, s0);
-		float3 n11 = TextureData_SampleNormalFromBump_uchar4(mydatac, width, height, t1, s1);
-
-		float3 n = lerp3(lerp3(n00, n01, wx), lerp3(n10, n11, wx), wy);
-
-		return 0.5f * normalize(n) + make_float3(0.5f, 0.5f, 0.5f);
-    }
-
-    default:
-    {
-        return make_float3(0.f, 0.f, 0.f);
-    }
-    }
-}
-
-
-
 #endif // TEXTURE_CL
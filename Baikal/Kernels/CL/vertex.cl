@@ -31,6 +31,13 @@ enum PathVertexType
     kLight
 };
 
+// Path vertex flags
+enum PathVertexFlags
+{
+    // Vertex BxDF or light is a delta distribution
+    kVertexSingular = 0x1
+};
+
 // Path vertex descriptor
 typedef struct _PathVertex
 {
@@ -24,6 +24,7 @@ THE SOFTWARE.
 
 #include <../Baikal/Kernels/CL/common.cl>
 #include <../Baikal/Kernels/CL/payload.cl>
+#include <../Baikal/Kernels/CL/sampling.cl>
 #include <../Baikal/Kernels/CL/path.cl>
 
 #define FAKE_SHAPE_SENTINEL 0xFFFFFF
@@ -59,35 +60,159 @@ float PhaseFunction_HG(float3 wi, float3 wo, float g)
         (1.f - g*g) / native_powr(1.f + g*g - 2.f * g * costheta, 1.5f);
 }
 
-// Evaluate volume transmittance along the ray [0, dist] segment
-float3 Volume_Transmittance(__global Volume const* volume, __global ray const* ray, float dist)
+// Brick size should match SparseGrid::kBrickSize on the host side
+#define VOLUME_BRICK_SIZE 8
+// Upper bound for the number of tentative collisions per tracking call
+#define VOLUME_MAX_TRACKING_STEPS 256
+
+#define VOLUME_ARG_LIST __global VolumeGrid const* volume_grids, __global int const* volume_brick_indices, __global float const* volume_bricks
+#define VOLUME_ARGS volume_grids, volume_brick_indices, volume_bricks
+
+// Fetch grid density at world space point p (nearest voxel)
+float VolumeGrid_GetDensity(__global VolumeGrid const* grid, float3 p, VOLUME_ARG_LIST)
 {
-    switch (volume->type)
+    float3 uvw = (p - grid->pmin) / (grid->pmax - grid->pmin);
+
+    int x = clamp((int)(uvw.x * grid->resx), 0, grid->resx - 1);
+    int y = clamp((int)(uvw.y * grid->resy), 0, grid->resy - 1);
+    int z = clamp((int)(uvw.z * grid->resz), 0, grid->resz - 1);
+
+    int brick = volume_brick_indices[grid->index_offset +
+        ((z / VOLUME_BRICK_SIZE) * grid->bricksy + (y / VOLUME_BRICK_SIZE)) * grid->bricksx + (x / VOLUME_BRICK_SIZE)];
+
+    // Empty bricks are not stored in the pool
+    if (brick < 0)
+        return 0.f;
+
+    int voxel = ((z % VOLUME_BRICK_SIZE) * VOLUME_BRICK_SIZE + (y % VOLUME_BRICK_SIZE)) * VOLUME_BRICK_SIZE + (x % VOLUME_BRICK_SIZE);
+    return volume_bricks[brick * VOLUME_BRICK_SIZE * VOLUME_BRICK_SIZE * VOLUME_BRICK_SIZE + voxel];
+}
+
+// Clip [0, maxdist] segment of the ray against grid bounds
+bool VolumeGrid_Clip(__global VolumeGrid const* grid, float3 o, float3 d, float maxdist, float* tmin, float* tmax)
+{
+    float3 invd = 1.f / d;
+    float3 t0 = (grid->pmin - o) * invd;
+    float3 t1 = (grid->pmax - o) * invd;
+    float3 tnear = min(t0, t1);
+    float3 tfar = max(t0, t1);
+
+    *tmin = max(max(tnear.x, tnear.y), max(tnear.z, 0.f));
+    *tmax = min(min(tfar.x, tfar.y), min(tfar.z, maxdist));
+    return *tmin < *tmax;
+}
+
+// Tracking consumes an unbounded number of random numbers,
+// so it runs on a hashed uniform sampler seeded once per call site
+void Volume_InitTrackingSampler(Sampler* sampler, uint seed, uint salt)
+{
+    sampler->index = WangHash(seed ^ WangHash(salt));
+    sampler->dimension = 0;
+    sampler->scramble = 0;
+}
+
+// Ratio tracking of heterogeneous volume transmittance along the ray [0, dist] segment.
+// Emission is estimated at every tentative collision as well.
+float3 Volume_RatioTrack(__global Volume const* volume, float3 o, float3 d, float maxdist, VOLUME_ARG_LIST, Sampler* sampler, float3* emission)
+{
+    __global VolumeGrid const* grid = volume_grids + volume->data;
+
+    float3 sigma_t = volume->sigma_a + volume->sigma_s;
+    float majorant = grid->max_density * max(sigma_t.x, max(sigma_t.y, sigma_t.z));
+
+    float3 tr = 1.f;
+    *emission = 0.f;
+
+    float t, tmax;
+    if (majorant <= 0.f || !VolumeGrid_Clip(grid, o, d, maxdist, &t, &tmax))
+        return tr;
+
+    for (int i = 0; i < VOLUME_MAX_TRACKING_STEPS; ++i)
     {
-        case kHomogeneous:
+        t -= native_log(1.f - UniformSampler_Sample1D(sampler)) / majorant;
+
+        if (t >= tmax)
+            break;
+
+        float density = VolumeGrid_GetDensity(grid, o + t * d, VOLUME_ARGS);
+
+        *emission += tr * volume->sigma_e * density / majorant;
+        tr *= 1.f - sigma_t * density / majorant;
+
+        if (max(tr.x, max(tr.y, tr.z)) <= 0.f)
+            break;
+    }
+
+    return tr;
+}
+
+// Delta tracking of a real collision along the ray [0, maxdist] segment.
+// The collision is sampled proportionally to the largest extinction channel,
+// weight compensates the other channels (it is 1 for gray extinction).
+// Returns collision distance or -1 if the ray leaves the segment.
+float Volume_DeltaTrack(__global Volume const* volume, float3 o, float3 d, float maxdist, VOLUME_ARG_LIST, Sampler* sampler, float3* weight, float3* emission)
+{
+    __global VolumeGrid const* grid = volume_grids + volume->data;
+
+    float3 sigma_t = volume->sigma_a + volume->sigma_s;
+    float majorant = grid->max_density * max(sigma_t.x, max(sigma_t.y, sigma_t.z));
+
+    *weight = 1.f;
+    *emission = 0.f;
+
+    float t, tmax;
+    if (majorant <= 0.f || !VolumeGrid_Clip(grid, o, d, maxdist, &t, &tmax))
+        return -1.f;
+
+    for (int i = 0; i < VOLUME_MAX_TRACKING_STEPS; ++i)
+    {
+        t -= native_log(1.f - UniformSampler_Sample1D(sampler)) / majorant;
+
+        if (t >= tmax)
+            break;
+
+        float density = VolumeGrid_GetDensity(grid, o + t * d, VOLUME_ARGS);
+        float3 sigma = sigma_t * density;
+        float sigma_max = max(sigma.x, max(sigma.y, sigma.z));
+
+        *emission += *weight * volume->sigma_e * density / majorant;
+
+        // Real collision
+        if (sigma_max > 0.f && UniformSampler_Sample1D(sampler) * majorant <= sigma_max)
         {
-            // For homogeneous it is e(-sigma * dist)
-            float3 sigma_t = volume->sigma_a + volume->sigma_s;
-            return native_exp(-sigma_t * dist);
+            *weight *= sigma / sigma_max;
+            return t;
         }
+
+        // Null collision
+        *weight *= (majorant - sigma) / (majorant - sigma_max);
     }
-    
-    return 1.f;
+
+    return -1.f;
 }
 
-// Evaluate volume selfemission along the ray [0, dist] segment
-float3 Volume_Emission(__global Volume const* volume, __global ray const* ray, float dist)
+// Evaluate volume transmittance and selfemission along the ray [0, dist] segment
+float3 Volume_Evaluate(__global Volume const* volume, __global ray const* ray, float dist, VOLUME_ARG_LIST, Sampler* sampler, float3* emission)
 {
     switch (volume->type)
     {
         case kHomogeneous:
         {
-            // For homogeneous it is simply Tr * Ev (since sigma_e is constant)
-            return Volume_Transmittance(volume, ray, dist) * volume->sigma_e;
+            // For homogeneous it is e(-sigma * dist)
+            float3 sigma_t = volume->sigma_a + volume->sigma_s;
+            float3 tr = native_exp(-sigma_t * dist);
+            // Emission is simply Tr * Ev (since sigma_e is constant)
+            *emission = tr * volume->sigma_e;
+            return tr;
+        }
+        case kHeterogeneous:
+        {
+            return Volume_RatioTrack(volume, ray->o.xyz, ray->d.xyz, dist, VOLUME_ARGS, sampler, emission);
         }
     }
-    
-    return 0.f;
+
+    *emission = 0.f;
+    return 1.f;
 }
 
 // Sample volume in order to find next scattering event
@@ -126,6 +251,8 @@ __kernel void EvaluateVolume(
     __global int const* numrays,
     // Volumes
     __global Volume const* volumes,
+    // Volume grids
+    VOLUME_ARG_LIST,
     // Textures
     TEXTURE_ARG_LIST,
     // RNG seed
@@ -178,9 +305,42 @@ __kernel void EvaluateVolume(
             Sampler_Init(&sampler, frame % (CMJ_DIM * CMJ_DIM), SAMPLE_DIM_SURFACE_OFFSET + bounce * SAMPLE_DIMS_PER_BOUNCE + SAMPLE_DIM_VOLUME_APPLY_OFFSET, scramble);
 #endif
 
+            float maxdist = Intersection_GetDistance(isects + globalid);
+
+            if (volumes[volidx].type == kHeterogeneous)
+            {
+                Sampler tracking_sampler;
+                Volume_InitTrackingSampler(&tracking_sampler, as_uint(Sampler_Sample1D(&sampler, SAMPLER_ARGS)), pixelidx);
+
+                // Track real collision against the grid majorant
+                float3 weight;
+                float3 emission;
+                float d = Volume_DeltaTrack(&volumes[volidx], rays[globalid].o.xyz, rays[globalid].d.xyz, maxdist,
+                    VOLUME_ARGS, &tracking_sampler, &weight, &emission);
+
+                Path_AddContribution(path, output, pixelidx, emission);
+
+                if (d < 0.f)
+                {
+                    Path_ClearScatterFlag(path);
+                    Path_MulThroughput(path, weight);
+                }
+                else
+                {
+                    // Collision weight is Tr * sigma_t(x), ShadeVolume multiplies by constant sigma_s
+                    // which gives Tr * sigma_s(x) / sigma_t(x) * sigma_s ratio, so divide by the base extinction here
+                    float3 sigma_t = volumes[volidx].sigma_a + volumes[volidx].sigma_s;
+                    Path_SetScatterFlag(path);
+                    Path_MulThroughput(path, select((float3)(0.f), weight / sigma_t, isgreater(sigma_t, (float3)(0.f))));
+                    isects[globalid].shapeid = FAKE_SHAPE_SENTINEL;
+                    isects[globalid].uvwt.w = d;
+                }
+
+                return;
+            }
+
             // Try sampling volume for a next scattering event
             float pdf = 0.f;
-            float maxdist = Intersection_GetDistance(isects + globalid);
             float d = Volume_SampleDistance(&volumes[volidx], &rays[globalid], maxdist, Sampler_Sample1D(&sampler, SAMPLER_ARGS), &pdf);
             
             // Check if we shall skip the event (it is either outside of a volume or not happened at all)
@@ -191,19 +351,23 @@ __kernel void EvaluateVolume(
                 // In case we skip we just need to apply volume absorbtion and emission for the segment we went through
                 // and clear scatter flag
                 Path_ClearScatterFlag(path);
+                float3 emission;
+                float3 tr = Volume_Evaluate(&volumes[volidx], &rays[globalid], maxdist, VOLUME_ARGS, &sampler, &emission);
                 // Emission contribution accounting for a throughput we have so far
-                Path_AddContribution(path, output, pixelidx, Volume_Emission(&volumes[volidx], &rays[globalid], maxdist));
+                Path_AddContribution(path, output, pixelidx, emission);
                 // And finally update the throughput
-                Path_MulThroughput(path, Volume_Transmittance(&volumes[volidx], &rays[globalid], maxdist));
+                Path_MulThroughput(path, tr);
             }
             else
             {
                 // Set scattering flag to notify ShadeVolume kernel to handle this path
                 Path_SetScatterFlag(path);
+                float3 emission;
+                float3 tr = Volume_Evaluate(&volumes[volidx], &rays[globalid], d, VOLUME_ARGS, &sampler, &emission);
                 // Emission contribution accounting for a throughput we have so far
-                Path_AddContribution(path, output, pixelidx, Volume_Emission(&volumes[volidx], &rays[globalid], d) / pdf);
+                Path_AddContribution(path, output, pixelidx, emission / pdf);
                 // Update the throughput
-                Path_MulThroughput(path, (Volume_Transmittance(&volumes[volidx], &rays[globalid], d) / pdf));
+                Path_MulThroughput(path, tr / pdf);
                 // Put fake shape to prevent from being compacted away
                 isects[globalid].shapeid = FAKE_SHAPE_SENTINEL;
                 // And keep scattering distance around as well
@@ -4,6 +4,7 @@
 #include "Renderers/monte_carlo_renderer.h"
 #include "Renderers/adaptive_renderer.h"
 #include "Estimators/path_tracing_estimator.h"
+#include "Estimators/bidirectional_estimator.h"
 #include "PostEffects/bilateral_denoiser.h"
 
 #include <memory>
@@ -35,6 +36,12 @@ namespace Baikal
                         m_context, 
                         std::make_unique<PathTracingEstimator>(m_context, m_intersector.get())
                         ));
+            case RendererType::kBidirectionalPathTracer:
+                return std::unique_ptr<Renderer>(
+                    new MonteCarloRenderer(
+                        m_context,
+                        std::make_unique<BidirectionalEstimator>(m_context, m_intersector.get())
+                        ));
             default:
                 throw std::runtime_error("Renderer not supported");
         }
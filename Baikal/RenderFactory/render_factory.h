@@ -45,7 +45,8 @@ namespace Baikal
     public:
         enum class RendererType
         {
-            kUnidirectionalPathTracer
+            kUnidirectionalPathTracer,
+            kBidirectionalPathTracer
         };
         
         enum class PostEffectType
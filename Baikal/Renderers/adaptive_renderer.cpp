@@ -10,6 +10,10 @@ namespace Baikal
     {
         auto samples_buffer_size = GetEstimator().GetWorkBufferSize();
         m_sample_buffer = GetContext().CreateBuffer<float3>(samples_buffer_size, CL_MEM_READ_WRITE);
+
+        m_accumulate_single_sample_kernel.kernel = GetKernel("AccumulateSingleSample");
+        m_generate_tile_domain_adaptive_kernel.kernel = GetKernel("GenerateTileDomain_Adaptive");
+        m_estimate_variance_kernel = GetKernel("EstimateVariance");
     }
 
     void AdaptiveRenderer::Clear(RadeonRays::float3 const& val,
@@ -51,7 +55,7 @@ namespace Baikal
             m_estimator->Estimate(
                 scene,
                 num_rays,
-                Estimator::QualityLevel::kStandard,
+                m_quality,
                 m_sample_buffer,
                 false,
                 true
@@ -90,12 +94,13 @@ namespace Baikal
         std::uint32_t num_elements
     )
     {
-        auto accumulate_kernel = GetKernel("AccumulateSingleSample");
+        auto& accumulate_kernel = m_accumulate_single_sample_kernel.kernel;
+        auto bind = m_accumulate_single_sample_kernel.NeedsBinding(m_estimator.get(), 0);
 
         int argc = 0;
         accumulate_kernel.SetArg(argc++, sample_buffer);
         accumulate_kernel.SetArg(argc++, accumulation_buffer);
-        accumulate_kernel.SetArg(argc++, m_estimator->GetOutputIndexBuffer());
+        SetStaticArg(accumulate_kernel, argc, bind, m_estimator->GetOutputIndexBuffer());
         accumulate_kernel.SetArg(argc++, num_elements);
 
         {
@@ -109,7 +114,7 @@ namespace Baikal
         std::uint32_t height
     )
     {
-        auto estimate_kernel = GetKernel("EstimateVariance");
+        auto& estimate_kernel = m_estimate_variance_kernel;
 
         int argc = 0;
         estimate_kernel.SetArg(argc++, accumulation_buffer);
@@ -150,33 +155,14 @@ namespace Baikal
     {
         // Write distribution data
         int* distribution_ptr = nullptr;
-        auto num_tiles = m_variance_buffer.GetElementCount();
-        auto required_size = (1 + 1 + num_tiles + num_tiles);
+        auto required_size = m_tile_distribution.GetSerializedSize();
         if (m_tile_distribution_buffer.GetElementCount() < required_size)
         {
             m_tile_distribution_buffer = GetContext().CreateBuffer<int>(required_size, CL_MEM_READ_ONLY);
         }
 
         GetContext().MapBuffer(0, m_tile_distribution_buffer, CL_MAP_WRITE, &distribution_ptr).Wait();
-        auto current = distribution_ptr;
-
-        // Write the number of segments first
-        *current++ = (int)m_tile_distribution.m_num_segments;
-
-        // Then write num_segments  + 1 CDF values
-        auto values = reinterpret_cast<float*>(current);
-        for (auto i = 0u; i < m_tile_distribution.m_num_segments + 1; ++i)
-        {
-            values[i] = m_tile_distribution.m_cdf[i];
-        }
-
-        // Then write num_segments PDF values
-        values += m_tile_distribution.m_num_segments + 1;
-
-        for (auto i = 0u; i < m_tile_distribution.m_num_segments; ++i)
-        {
-            values[i] = m_tile_distribution.m_func_values[i] / m_tile_distribution.m_func_sum;
-        }
+        m_tile_distribution.Serialize(distribution_ptr);
 
         GetContext().UnmapBuffer(0, m_tile_distribution_buffer, distribution_ptr);
     }
@@ -188,7 +174,8 @@ namespace Baikal
     )
     {
         // Fetch kernel
-        CLWKernel generate_kernel = GetKernel("GenerateTileDomain_Adaptive");
+        auto& generate_kernel = m_generate_tile_domain_adaptive_kernel.kernel;
+        auto bind = m_generate_tile_domain_adaptive_kernel.NeedsBinding(m_estimator.get(), 0);
 
         // Set kernel parameters
         int argc = 0;
@@ -200,11 +187,11 @@ namespace Baikal
         generate_kernel.SetArg(argc++, tile_size.y);
         generate_kernel.SetArg(argc++, rand_uint());
         generate_kernel.SetArg(argc++, m_sample_counter);
-        generate_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
-        generate_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
+        SetStaticArg(generate_kernel, argc, bind, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
+        SetStaticArg(generate_kernel, argc, bind, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
         generate_kernel.SetArg(argc++, m_tile_distribution_buffer);
-        generate_kernel.SetArg(argc++, m_estimator->GetOutputIndexBuffer());
-        generate_kernel.SetArg(argc++, m_estimator->GetRayCountBuffer());
+        SetStaticArg(generate_kernel, argc, bind, m_estimator->GetOutputIndexBuffer());
+        SetStaticArg(generate_kernel, argc, bind, m_estimator->GetRayCountBuffer());
 
         // Run shading kernel
         {
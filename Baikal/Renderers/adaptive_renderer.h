@@ -82,6 +82,9 @@ namespace Baikal
         void UpdateTileDistribution();
 
     private:
+        ClwBoundKernel m_accumulate_single_sample_kernel;
+        ClwBoundKernel m_generate_tile_domain_adaptive_kernel;
+        CLWKernel m_estimate_variance_kernel;
         mutable CLWBuffer<float> m_variance_buffer;
         mutable CLWBuffer<float3> m_sample_buffer;
         CLWBuffer<int> m_tile_distribution_buffer;
@@ -53,8 +53,20 @@ namespace Baikal
         : Baikal::ClwClass(context, "../Baikal/Kernels/CL/monte_carlo_renderer.cl")
         , m_estimator(std::move(estimator))
         , m_sample_counter(0u)
+        , m_quality(Estimator::QualityLevel::kStandard)
     {
         m_estimator->SetWorkBufferSize(kTileSizeX * kTileSizeY);
+
+        // Ray generation kernels indexed by camera type
+        m_camera_kernels[static_cast<std::size_t>(CameraType::kDefault)].kernel = GetKernel("PerspectiveCamera_GeneratePaths");
+        m_camera_kernels[static_cast<std::size_t>(CameraType::kPhysical)].kernel = GetKernel("PerspectiveCameraDof_GeneratePaths");
+        m_camera_kernels[static_cast<std::size_t>(CameraType::kSpherical)].kernel = GetKernel("SphericalCamera_GeneratePaths");
+        m_camera_kernels[static_cast<std::size_t>(CameraType::kFisheye)].kernel = GetKernel("FisheyeCamera_GeneratePaths");
+
+        m_generate_tile_domain_kernel.kernel = GetKernel("GenerateTileDomain");
+        m_fill_aovs_kernel.kernel = GetKernel("FillAOVs");
+        m_copy_kernel = GetKernel("ApplyGammaAndCopyData");
+        m_accumulate_kernel = GetKernel("AccumulateData");
     }
 
     void MonteCarloRenderer::Clear(RadeonRays::float3 const& val, Output& output) const
@@ -108,7 +120,7 @@ namespace Baikal
             m_estimator->Estimate(
                 scene,
                 num_rays,
-                Estimator::QualityLevel::kStandard,
+                m_quality,
                 output->data());
         }
 
@@ -128,7 +140,8 @@ namespace Baikal
     )
     {
         // Fetch kernel
-        CLWKernel generate_kernel = GetKernel("GenerateTileDomain");
+        auto& generate_kernel = m_generate_tile_domain_kernel.kernel;
+        auto bind = m_generate_tile_domain_kernel.NeedsBinding(m_estimator.get(), 0);
 
         // Set kernel parameters
         int argc = 0;
@@ -140,10 +153,10 @@ namespace Baikal
         generate_kernel.SetArg(argc++, tile_size.y);
         generate_kernel.SetArg(argc++, rand_uint());
         generate_kernel.SetArg(argc++, m_sample_counter);
-        generate_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
-        generate_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
-        generate_kernel.SetArg(argc++, m_estimator->GetOutputIndexBuffer());
-        generate_kernel.SetArg(argc++, m_estimator->GetRayCountBuffer());
+        SetStaticArg(generate_kernel, argc, bind, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
+        SetStaticArg(generate_kernel, argc, bind, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
+        SetStaticArg(generate_kernel, argc, bind, m_estimator->GetOutputIndexBuffer());
+        SetStaticArg(generate_kernel, argc, bind, m_estimator->GetRayCountBuffer());
 
         // Run shading kernel
         {
@@ -198,28 +211,28 @@ namespace Baikal
         // Intersect ray batch
         m_estimator->TraceFirstHit(scene, num_rays);
 
-        CLWKernel fill_kernel = GetKernel("FillAOVs");
-
-        auto argc = 0U;
-        fill_kernel.SetArg(argc++, m_estimator->GetRayBuffer());
-        fill_kernel.SetArg(argc++, m_estimator->GetFirstHitBuffer());
-        fill_kernel.SetArg(argc++, m_estimator->GetOutputIndexBuffer());
-        fill_kernel.SetArg(argc++, m_estimator->GetRayCountBuffer());
-        fill_kernel.SetArg(argc++, scene.vertices);
-        fill_kernel.SetArg(argc++, scene.normals);
-        fill_kernel.SetArg(argc++, scene.uvs);
-        fill_kernel.SetArg(argc++, scene.indices);
-        fill_kernel.SetArg(argc++, scene.shapes);
-        fill_kernel.SetArg(argc++, scene.materialids);
-        fill_kernel.SetArg(argc++, scene.materials);
-        fill_kernel.SetArg(argc++, scene.textures);
-        fill_kernel.SetArg(argc++, scene.texturedata);
-        fill_kernel.SetArg(argc++, scene.envmapidx);
-        fill_kernel.SetArg(argc++, scene.lights);
-        fill_kernel.SetArg(argc++, scene.num_lights);
+        auto& fill_kernel = m_fill_aovs_kernel.kernel;
+        auto bind = m_fill_aovs_kernel.NeedsBinding(&scene, scene.revision);
+
+        int argc = 0;
+        SetStaticArg(fill_kernel, argc, bind, m_estimator->GetRayBuffer());
+        SetStaticArg(fill_kernel, argc, bind, m_estimator->GetFirstHitBuffer());
+        SetStaticArg(fill_kernel, argc, bind, m_estimator->GetOutputIndexBuffer());
+        SetStaticArg(fill_kernel, argc, bind, m_estimator->GetRayCountBuffer());
+        SetStaticArg(fill_kernel, argc, bind, scene.vertices);
+        SetStaticArg(fill_kernel, argc, bind, scene.normals);
+        SetStaticArg(fill_kernel, argc, bind, scene.uvs);
+        SetStaticArg(fill_kernel, argc, bind, scene.indices);
+        SetStaticArg(fill_kernel, argc, bind, scene.shapes);
+        SetStaticArg(fill_kernel, argc, bind, scene.materialids);
+        SetStaticArg(fill_kernel, argc, bind, scene.materials);
+        SetTextureArgs(fill_kernel, argc, bind, scene);
+        SetStaticArg(fill_kernel, argc, bind, scene.envmapidx);
+        SetStaticArg(fill_kernel, argc, bind, scene.lights);
+        SetStaticArg(fill_kernel, argc, bind, scene.num_lights);
         fill_kernel.SetArg(argc++, rand_uint());
-        fill_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
-        fill_kernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
+        SetStaticArg(fill_kernel, argc, bind, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
+        SetStaticArg(fill_kernel, argc, bind, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
         fill_kernel.SetArg(argc++, m_sample_counter);
         for (auto i = 1U; i < static_cast<std::uint32_t>(Renderer::OutputType::kMax); ++i)
         {
@@ -251,22 +264,22 @@ namespace Baikal
     )
     {
         // Fetch kernel
-        std::string kernel_name = (scene.camera_type == CameraType::kDefault) ? "PerspectiveCamera_GeneratePaths" : "PerspectiveCameraDof_GeneratePaths";
-
-        auto genkernel = GetKernel(kernel_name);
+        auto& bound = m_camera_kernels[static_cast<std::size_t>(scene.camera_type)];
+        auto& genkernel = bound.kernel;
+        auto bind = bound.NeedsBinding(m_estimator.get(), 0);
 
         // Set kernel parameters
         int argc = 0;
         genkernel.SetArg(argc++, scene.camera);
         genkernel.SetArg(argc++, output.width());
         genkernel.SetArg(argc++, output.height());
-        genkernel.SetArg(argc++, m_estimator->GetOutputIndexBuffer());
-        genkernel.SetArg(argc++, m_estimator->GetRayCountBuffer());
+        SetStaticArg(genkernel, argc, bind, m_estimator->GetOutputIndexBuffer());
+        SetStaticArg(genkernel, argc, bind, m_estimator->GetRayCountBuffer());
         genkernel.SetArg(argc++, (int)rand_uint());
         genkernel.SetArg(argc++, m_sample_counter);
-        genkernel.SetArg(argc++, m_estimator->GetRayBuffer());
-        genkernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
-        genkernel.SetArg(argc++, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
+        SetStaticArg(genkernel, argc, bind, m_estimator->GetRayBuffer());
+        SetStaticArg(genkernel, argc, bind, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kRandomSeed));
+        SetStaticArg(genkernel, argc, bind, m_estimator->GetRandomBuffer(Estimator::RandomBufferType::kSobolLUT));
 
         {
             int globalsize = tile_size.x * tile_size.y;
@@ -276,12 +289,12 @@ namespace Baikal
 
     CLWKernel MonteCarloRenderer::GetCopyKernel()
     {
-        return GetKernel("ApplyGammaAndCopyData");
+        return m_copy_kernel;
     }
 
     CLWKernel MonteCarloRenderer::GetAccumulateKernel()
     {
-        return GetKernel("AccumulateData");
+        return m_accumulate_kernel;
     }
 
     void MonteCarloRenderer::SetRandomSeed(std::uint32_t seed)
@@ -306,4 +319,19 @@ namespace Baikal
     {
         m_estimator->SetMaxBounces(max_bounces);
     }
+
+    void MonteCarloRenderer::SetPathGuiding(bool enable)
+    {
+        m_estimator->SetPathGuiding(enable);
+    }
+
+    void MonteCarloRenderer::SetRaySorting(bool enable)
+    {
+        m_estimator->SetRaySorting(enable);
+    }
+
+    void MonteCarloRenderer::SetQualityLevel(Estimator::QualityLevel quality)
+    {
+        m_quality = quality;
+    }
 }
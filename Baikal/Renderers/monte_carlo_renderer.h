@@ -31,6 +31,7 @@ THE SOFTWARE.
 
 #include "CLW.h"
 
+#include <array>
 #include <memory>
 
 
@@ -78,6 +79,15 @@ namespace Baikal
         // Set max number of light bounces
         void SetMaxBounces(std::uint32_t max_bounces);
 
+        // Enable learned path guiding (path tracing estimator only)
+        void SetPathGuiding(bool enable);
+
+        // Enable coherence sorting of secondary rays (path tracing estimator only)
+        void SetRaySorting(bool enable);
+
+        // Set estimate quality (kRough enables fast preview approximations)
+        void SetQualityLevel(Estimator::QualityLevel quality);
+
     protected:
         void GeneratePrimaryRays(
             ClwScene const& scene,
@@ -102,9 +112,20 @@ namespace Baikal
         // Find non-zero AOV
         Output* FindFirstNonZeroOutput(bool include_color = true) const;
 
+    private:
+        // Kernels are fetched once. Estimator work buffers are allocated
+        // at construction, so they are bound on the first launch only.
+        // Ray generation kernels for each camera type
+        std::array<ClwBoundKernel, 4> m_camera_kernels;
+        ClwBoundKernel m_generate_tile_domain_kernel;
+        ClwBoundKernel m_fill_aovs_kernel;
+        CLWKernel m_copy_kernel;
+        CLWKernel m_accumulate_kernel;
+
     public:
         std::unique_ptr<Estimator> m_estimator;
         mutable std::uint32_t m_sample_counter;
+        Estimator::QualityLevel m_quality;
     };
 
 }
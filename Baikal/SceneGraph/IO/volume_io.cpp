@@ -0,0 +1,148 @@
+#include "volume_io.h"
+#include "../volume.h"
+#include "../scene1.h"
+#include "../shape.h"
+#include "../iterator.h"
+
+#include "XML/tinyxml2.h"
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace Baikal
+{
+    using namespace tinyxml2;
+
+    // Reads Mitsuba grid volume format:
+    // 'V', 'O', 'L', version (3), encoding (1 - float32), xres, yres, zres, channels,
+    // bounding box (xmin, ymin, zmin, xmax, ymax, zmax), then x-major voxel data.
+    class MitsubaVolumeIo : public VolumeIo
+    {
+    public:
+        GridVolume* LoadVolume(std::string const& filename) const override;
+    };
+
+    std::unique_ptr<VolumeIo> VolumeIo::CreateVolumeIo()
+    {
+        return std::unique_ptr<VolumeIo>(new MitsubaVolumeIo());
+    }
+
+    GridVolume* MitsubaVolumeIo::LoadVolume(std::string const& filename) const
+    {
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+
+        if (!in)
+        {
+            throw std::runtime_error("Can't load " + filename + " volume");
+        }
+
+        char header[4];
+        in.read(header, 4);
+
+        if (!in || header[0] != 'V' || header[1] != 'O' || header[2] != 'L' || header[3] != 3)
+        {
+            throw std::runtime_error(filename + " is not a supported volume file");
+        }
+
+        std::int32_t encoding = 0;
+        std::int32_t res[3] = { 0, 0, 0 };
+        std::int32_t channels = 0;
+        float bounds[6];
+
+        in.read(reinterpret_cast<char*>(&encoding), sizeof(encoding));
+        in.read(reinterpret_cast<char*>(res), sizeof(res));
+        in.read(reinterpret_cast<char*>(&channels), sizeof(channels));
+        in.read(reinterpret_cast<char*>(bounds), sizeof(bounds));
+
+        if (!in || encoding != 1 || channels < 1 || res[0] <= 0 || res[1] <= 0 || res[2] <= 0)
+        {
+            throw std::runtime_error(filename + " has unsupported volume encoding");
+        }
+
+        auto num_voxels = static_cast<std::size_t>(res[0]) * res[1] * res[2];
+        std::vector<float> data(num_voxels * channels);
+        in.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(float));
+
+        if (!in)
+        {
+            throw std::runtime_error(filename + " volume data is truncated");
+        }
+
+        // Only the first channel is used as density
+        if (channels > 1)
+        {
+            for (std::size_t i = 0; i < num_voxels; ++i)
+            {
+                data[i] = data[i * channels];
+            }
+        }
+
+        auto volume = new GridVolume();
+        volume->SetGrid(SparseGrid(data.data(), res[0], res[1], res[2]));
+        volume->SetBounds(RadeonRays::bbox(
+            RadeonRays::float3(bounds[0], bounds[1], bounds[2]),
+            RadeonRays::float3(bounds[3], bounds[4], bounds[5])));
+
+        return volume;
+    }
+
+    static RadeonRays::float3 StringToFloat3(char const* value)
+    {
+        RadeonRays::float3 v(0.f, 0.f, 0.f);
+
+        if (value)
+        {
+            std::istringstream iss(value);
+            iss >> v.x >> v.y >> v.z;
+        }
+
+        return v;
+    }
+
+    // Volumes file is a list of elements like
+    // <Volume shape="Smoke" file="smoke.vol" absorption="0.1 0.1 0.1" scattering="1 1 1" emission="0 0 0"/>
+    // Shapes without a file get homogeneous volume.
+    void VolumeIo::LoadSceneVolumes(Scene1& scene, std::string const& filename, std::string const& basepath) const
+    {
+        XMLDocument doc;
+
+        if (doc.LoadFile(filename.c_str()) != XML_SUCCESS)
+        {
+            throw std::runtime_error("Can't load " + filename + " volume list");
+        }
+
+        std::map<std::string, Shape*> name2shape;
+        auto shape_iter = scene.CreateShapeIterator();
+
+        for (; shape_iter->IsValid(); shape_iter->Next())
+        {
+            // TODO: remove this hack
+            auto shape = const_cast<Shape*>(shape_iter->ItemAs<Shape const>());
+            name2shape.emplace(shape->GetName(), shape);
+        }
+
+        for (auto element = doc.FirstChildElement("Volume"); element; element = element->NextSiblingElement("Volume"))
+        {
+            auto shape_name = element->Attribute("shape");
+            auto iter = shape_name ? name2shape.find(shape_name) : name2shape.end();
+
+            if (iter == name2shape.cend())
+            {
+                continue;
+            }
+
+            auto file = element->Attribute("file");
+            Volume* volume = file ? static_cast<Volume*>(LoadVolume(basepath + file)) : new HomogeneousVolume();
+            volume->SetAbsorption(StringToFloat3(element->Attribute("absorption")));
+            volume->SetScattering(StringToFloat3(element->Attribute("scattering")));
+            volume->SetEmission(StringToFloat3(element->Attribute("emission")));
+
+            scene.AttachAutoreleaseObject(volume);
+            iter->second->SetVolume(volume);
+        }
+    }
+}
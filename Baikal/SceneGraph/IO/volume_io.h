@@ -0,0 +1,66 @@
+/**********************************************************************
+ Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ********************************************************************/
+
+/**
+ \file volume_io.h
+ \author Dmitry Kozlov
+ \version 1.0
+ \brief
+ */
+#pragma once
+
+#include <string>
+#include <memory>
+
+namespace Baikal
+{
+    class GridVolume;
+    class Scene1;
+    
+    /**
+     \brief Interface for volume loading
+     
+     VolumeIo is responsible for loading voxel grids from disk into sparse grid volumes.
+     */
+    class VolumeIo
+    {
+    public:
+        // Create default volume IO
+        static std::unique_ptr<VolumeIo> CreateVolumeIo();
+        
+        // Constructor
+        VolumeIo() = default;
+        // Destructor
+        virtual ~VolumeIo() = default;
+        
+        // Load volume from file
+        virtual GridVolume* LoadVolume(std::string const& filename) const = 0;
+
+        // Helper method: attach volumes listed in XML file to scene shapes by name.
+        // Loaded volumes are owned by the scene.
+        void LoadSceneVolumes(Scene1& scene, std::string const& filename, std::string const& basepath) const;
+        
+        // Disallow copying
+        VolumeIo(VolumeIo const&) = delete;
+        VolumeIo& operator = (VolumeIo const&) = delete;
+    };
+}
@@ -40,6 +40,7 @@ namespace Baikal
     , m_focal_length(0.f)
     , m_zcap(0.f, 0.f)
     , m_aspect(0.f)
+    , m_projection(Projection::kPerspective)
     {
         // Construct camera frame
         LookAt(eye, at, up);
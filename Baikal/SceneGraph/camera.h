@@ -45,6 +45,18 @@ namespace Baikal
     class PerspectiveCamera : public Camera
     {
     public:
+        // Mapping of the image plane to ray directions
+        enum class Projection
+        {
+            // Pinhole or thin lens if aperture is set
+            kPerspective,
+            // Full 360 x 180 degrees panorama in equirectangular layout
+            kSpherical,
+            // Equidistant fisheye: angle from forward vector is
+            // distance from sensor center divided by focal length
+            kFisheye
+        };
+
         // Pass camera position, camera aim, camera up vector, depth limits, vertical field of view
         // and image plane aspect ratio
         PerspectiveCamera(RadeonRays::float3 const& eye,
@@ -82,6 +94,10 @@ namespace Baikal
         void SetDepthRange(RadeonRays::float2 const& range);
         RadeonRays::float2 GetDepthRange() const;
         
+        // Set projection, perspective by default
+        void SetProjection(Projection projection);
+        Projection GetProjection() const;
+        
         RadeonRays::float3 GetForwardVector() const;
         RadeonRays::float3 GetUpVector() const;
         RadeonRays::float3 GetRightVector() const;
@@ -127,6 +143,8 @@ namespace Baikal
         float  m_focus_distance;
         float  m_aperture;
         
+        Projection m_projection;
+        
         friend std::ostream& operator << (std::ostream& o, PerspectiveCamera const& p);
     };
     
@@ -148,6 +166,17 @@ namespace Baikal
         SetDirty(true);
     }
     
+    inline void PerspectiveCamera::SetProjection(Projection projection)
+    {
+        m_projection = projection;
+        SetDirty(true);
+    }
+    
+    inline PerspectiveCamera::Projection PerspectiveCamera::GetProjection() const
+    {
+        return m_projection;
+    }
+    
     inline float PerspectiveCamera::GetFocusDistance() const
     {
         return m_focus_distance;
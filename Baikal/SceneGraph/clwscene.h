@@ -2,15 +2,23 @@
 
 #include "CLW.h"
 #include "math/float3.h"
+#include "math/bbox.h"
 #include "SceneGraph/scene1.h"
 #include "radeon_rays.h"
 #include "SceneGraph/Collector/collector.h"
 
+#include <cstdint>
+#include <set>
+#include <vector>
+
 
 namespace Baikal
 {
     using namespace RadeonRays;
 
+    class Texture;
+    class Volume;
+
     enum class CameraType
     {
         kDefault,
@@ -34,18 +42,47 @@ namespace Baikal
         CLWBuffer<Light> lights;
         CLWBuffer<int> materialids;
         CLWBuffer<Volume> volumes;
+        // Sparse grids of heterogeneous volumes
+        CLWBuffer<VolumeGrid> volume_grids;
+        CLWBuffer<int> volume_brick_indices;
+        CLWBuffer<float> volume_bricks;
+        // Volumes the buffers above have been written from
+        std::vector<Baikal::Volume const*> volume_list;
         CLWBuffer<Texture> textures;
         CLWBuffer<char> texturedata;
+        // RGBA8 textures with borders, only created if the device supports images
+        CLWImage2D texture_atlas;
 
         CLWBuffer<Camera> camera;
         CLWBuffer<int> light_distributions;
 
+        // SH irradiance of the environment light (bands 0..2), used for preview shading
+        CLWBuffer<RadeonRays::float3> envmap_sh;
+        // Texture of the environment light and the one envmap_sh has been projected from
+        Baikal::Texture const* envmap_texture = nullptr;
+        Baikal::Texture const* envmap_sh_texture = nullptr;
+
         std::unique_ptr<Bundle> material_bundle;
+        // Material record of each collected material, identical materials share records
+        std::vector<int> material_slots;
         std::unique_ptr<Bundle> texture_bundle;
+        // Bump textures, uploaded converted to normal maps
+        std::set<Baikal::Texture const*> bump_maps;
+        // Constant textures folded into material records
+        std::set<Baikal::Texture const*> folded_textures;
+
+        // World space bounds of the scene shapes
+        RadeonRays::bbox bounds;
 
         int num_lights;
         int envmapidx;
         CameraType camera_type;
+        // Incremented by the controller each time scene data is updated,
+        // allows kernels to keep scene arguments bound between launches
+        std::uint32_t revision = 0;
+        // Incremented when anything but the camera is updated,
+        // so caches of scene radiance survive camera moves
+        std::uint32_t content_revision = 0;
 
         std::vector<RadeonRays::Shape*> isect_shapes;
         std::vector<RadeonRays::Shape*> visible_shapes;
@@ -2,19 +2,90 @@
 #include "light.h"
 #include "camera.h"
 #include "iterator.h"
+#include "shape.h"
 
 #include <vector>
 #include <list>
 #include <cassert>
 #include <set>
+#include <unordered_map>
 
 namespace Baikal
 {
+    /**
+     \brief Object list with constant time lookup, insertion and removal.
+
+     \details Objects are stored contiguously in a vector and their positions are tracked in a
+     hash map. Removal moves the last object into the freed slot, so the order only depends
+     on the sequence of attach/detach calls and stays deterministic between runs.
+     */
+    template <typename T> class IndexedList
+    {
+    public:
+        using const_iterator = typename std::vector<T const*>::const_iterator;
+
+        // Returns false if the object is already in the list
+        bool Insert(T const* object)
+        {
+            auto res = m_index.emplace(object, m_objects.size());
+
+            if (res.second)
+            {
+                m_objects.push_back(object);
+            }
+
+            return res.second;
+        }
+
+        // Returns false if the object is not in the list
+        bool Remove(T const* object)
+        {
+            auto iter = m_index.find(object);
+
+            if (iter == m_index.end())
+            {
+                return false;
+            }
+
+            // Move the last object into the freed slot and update its position
+            auto idx = iter->second;
+            auto last = m_objects.back();
+            m_objects[idx] = last;
+            m_index[last] = idx;
+
+            m_objects.pop_back();
+            m_index.erase(object);
+
+            return true;
+        }
+
+        void Reserve(std::size_t size)
+        {
+            m_objects.reserve(size);
+            m_index.reserve(size);
+        }
+
+        std::size_t Size() const { return m_objects.size(); }
+        const_iterator cbegin() const { return m_objects.cbegin(); }
+        const_iterator cend() const { return m_objects.cend(); }
+
+    private:
+        std::vector<T const*> m_objects;
+        std::unordered_map<T const*, std::size_t> m_index;
+    };
+
     // Data structures for shapes and lights
-    using ShapeList = std::vector<Shape const*>;
-    using LightList = std::vector<Light const*>;
+    using ShapeList = IndexedList<Shape>;
+    using LightList = IndexedList<Light>;
     using AutoreleasePool = std::set<SceneObject const*>;
 
+    // World space AABB of a shape at given shape revision
+    struct ShapeBounds
+    {
+        RadeonRays::bbox aabb;
+        std::uint32_t revision;
+    };
+
     // Internal data
     struct Scene1::SceneImpl
     {
@@ -25,12 +96,43 @@ namespace Baikal
         DirtyFlags m_dirty_flags;
 
         AutoreleasePool m_autorelease_pool;
+
+        // Scene AABB is cached along with bounds of every shape, it is valid
+        // as long as no shape is changed (global shape revision stays the same)
+        std::unordered_map<Shape const*, ShapeBounds> m_shape_bounds;
+        RadeonRays::bbox m_aabb;
+        std::uint32_t m_aabb_shape_revision;
+        bool m_aabb_valid;
+
+        // Bounds of a shape, recalculated only if the shape has changed
+        RadeonRays::bbox const& GetShapeBounds(Shape const* shape)
+        {
+            auto iter = m_shape_bounds.find(shape);
+
+            if (iter == m_shape_bounds.end())
+            {
+                iter = m_shape_bounds.emplace(shape, ShapeBounds{ shape->GetWorldAABB(), shape->GetRevision() }).first;
+            }
+            else if (iter->second.revision != shape->GetRevision())
+            {
+                iter->second = ShapeBounds{ shape->GetWorldAABB(), shape->GetRevision() };
+            }
+
+            return iter->second.aabb;
+        }
+
+        bool IsAabbValid() const
+        {
+            return m_aabb_valid && m_aabb_shape_revision == Shape::GetGlobalRevision();
+        }
     };
 
     Scene1::Scene1()
     : m_impl(new SceneImpl)
     {
         m_impl->m_camera = nullptr;
+        m_impl->m_aabb_shape_revision = 0;
+        m_impl->m_aabb_valid = false;
         ClearDirtyFlags();
     }
 
@@ -72,63 +174,71 @@ namespace Baikal
     {
         assert(light);
 
-        // Check if the light is already in the scene
-        LightList::const_iterator citer =  std::find(m_impl->m_lights.cbegin(),
-                                                     m_impl->m_lights.cend(),
-                                                     light);
-        
-        // And insert only if not
-        if (citer == m_impl->m_lights.cend())
+        // Insert only if the light is not in the scene yet
+        if (m_impl->m_lights.Insert(light))
         {
-            m_impl->m_lights.push_back(light);
-
             SetDirtyFlag(kLights);
         }
     }
 
     void Scene1::DetachLight(Light const* light)
     {
-        // Check if the light is in the scene
-        LightList::const_iterator citer =  std::find(m_impl->m_lights.cbegin(),
-                                                     m_impl->m_lights.cend(),
-                                                     light);
-        
-        // And remove it if yes
-        if (citer != m_impl->m_lights.cend())
+        // Remove the light if it is in the scene
+        if (m_impl->m_lights.Remove(light))
         {
-            m_impl->m_lights.erase(citer);
-            
             SetDirtyFlag(kLights);
         }
     }
 
     std::size_t Scene1::GetNumLights() const
     {
-        return m_impl->m_lights.size();
+        return m_impl->m_lights.Size();
     }
 
     std::unique_ptr<Iterator> Scene1::CreateShapeIterator() const
     {
         return std::unique_ptr<Iterator>(
             new IteratorImpl<ShapeList::const_iterator>
-            (m_impl->m_shapes.begin(), m_impl->m_shapes.end()));
+            (m_impl->m_shapes.cbegin(), m_impl->m_shapes.cend()));
     }
     
     void Scene1::AttachShape(Shape const* shape)
     {
         assert(shape);
         
-        // Check if the shape is already in the scene
-        ShapeList::const_iterator citer =  std::find(m_impl->m_shapes.cbegin(),
-                                                     m_impl->m_shapes.cend(),
-                                                     shape);
-        
-        // And attach it if not
-        if (citer == m_impl->m_shapes.cend())
+        // Attach only if the shape is not in the scene yet
+        if (m_impl->m_shapes.Insert(shape))
         {
-            m_impl->m_shapes.push_back(shape);
-            
             SetDirtyFlag(kShapes);
+
+            // New shape only grows the bounds
+            if (m_impl->IsAabbValid())
+            {
+                m_impl->m_aabb.grow(m_impl->GetShapeBounds(shape));
+            }
+        }
+    }
+    
+    void Scene1::AttachShapes(Shape const* const* shapes, std::size_t num_shapes)
+    {
+        assert(shapes || num_shapes == 0);
+
+        m_impl->m_shapes.Reserve(m_impl->m_shapes.Size() + num_shapes);
+
+        for (std::size_t i = 0; i < num_shapes; ++i)
+        {
+            assert(shapes[i]);
+
+            // Attach only if not in the scene yet (or earlier in the same batch)
+            if (m_impl->m_shapes.Insert(shapes[i]))
+            {
+                SetDirtyFlag(kShapes);
+
+                if (m_impl->IsAabbValid())
+                {
+                    m_impl->m_aabb.grow(m_impl->GetShapeBounds(shapes[i]));
+                }
+            }
         }
     }
     
@@ -136,23 +246,20 @@ namespace Baikal
     {
         assert(shape);
         
-        // Check if the shape is in the scene
-        ShapeList::const_iterator citer =  std::find(m_impl->m_shapes.cbegin(),
-                                                     m_impl->m_shapes.cend(),
-                                                     shape);
-        
-        // And detach if yes
-        if (citer != m_impl->m_shapes.cend())
+        // Detach the shape if it is in the scene
+        if (m_impl->m_shapes.Remove(shape))
         {
-            m_impl->m_shapes.erase(citer);
-            
             SetDirtyFlag(kShapes);
+
+            // Bounds might shrink, recalculate them on next request
+            m_impl->m_shape_bounds.erase(shape);
+            m_impl->m_aabb_valid = false;
         }
     }
     
     std::size_t Scene1::GetNumShapes() const
     {
-        return m_impl->m_shapes.size();
+        return m_impl->m_shapes.Size();
     }
     
     void Scene1::AttachAutoreleaseObject(SceneObject const* object)
@@ -191,7 +298,7 @@ namespace Baikal
     {
         return std::unique_ptr<Iterator>(
             new IteratorImpl<LightList::const_iterator>
-            (m_impl->m_lights.begin(), m_impl->m_lights.end()));
+            (m_impl->m_lights.cbegin(), m_impl->m_lights.cend()));
     }
     
     bool Scene1::IsValid() const
@@ -203,15 +310,22 @@ namespace Baikal
 
     RadeonRays::bbox Scene1::GetWorldAABB() const
     {
-        auto iter = CreateShapeIterator();
+        if (m_impl->IsAabbValid())
+        {
+            return m_impl->m_aabb;
+        }
 
+        // Some shapes have changed, only their bounds are recalculated
         RadeonRays::bbox result;
-        for (; iter->IsValid(); iter->Next())
+        for (auto iter = m_impl->m_shapes.cbegin(); iter != m_impl->m_shapes.cend(); ++iter)
         {
-            auto aabb = iter->ItemAs<Shape const>()->GetWorldAABB();
-            result.grow(aabb);
+            result.grow(m_impl->GetShapeBounds(*iter));
         }
 
+        m_impl->m_aabb = result;
+        m_impl->m_aabb_shape_revision = Shape::GetGlobalRevision();
+        m_impl->m_aabb_valid = true;
+
         return result;
     }
 
@@ -78,6 +78,8 @@ namespace Baikal
         // Add or remove shapes
         void AttachShape(Shape const* shape);
         void DetachShape(Shape const* shape);
+        // Add several shapes at once (shapes already in the scene are skipped)
+        void AttachShapes(Shape const* const* shapes, std::size_t num_shapes);
         
         // Get number of shapes in the scene
         std::size_t GetNumShapes() const;
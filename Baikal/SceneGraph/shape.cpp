@@ -1,4 +1,6 @@
 #include "shape.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 
 namespace Baikal
@@ -24,6 +26,8 @@ namespace Baikal
     void Mesh::SetIndices(std::vector<std::uint32_t>&& indices)
     {
         m_indices = std::move(indices);
+
+        SetDirty(true);
     }
 
     std::size_t Mesh::GetNumIndices() const
@@ -71,6 +75,8 @@ namespace Baikal
     void Mesh::SetVertices(std::vector<RadeonRays::float3>&& vertices)
     {
         m_vertices = std::move(vertices);
+
+        SetDirty(true);
     }
 
     
@@ -119,6 +125,8 @@ namespace Baikal
     void Mesh::SetNormals(std::vector<RadeonRays::float3>&& normals)
     {
         m_normals = std::move(normals);
+
+        SetDirty(true);
     }
 
     
@@ -165,6 +173,8 @@ namespace Baikal
     void Mesh::SetUVs(std::vector<RadeonRays::float2>&& uvs)
     {
         m_uvs = std::move(uvs);
+
+        SetDirty(true);
     }
 
     std::size_t Mesh::GetNumUVs() const
@@ -222,11 +232,47 @@ namespace Baikal
     void Mesh::SetDirty(bool dirty) const
     {
         Shape::SetDirty(dirty);
-        m_aabb_cached = false;
+
+        // Clearing the flag does not change the geometry
+        if (dirty)
+        {
+            m_aabb_cached = false;
+        }
+    }
+
+    // Advanced each time any shape is marked dirty, allows scenes
+    // to check if their cached shape data is up to date in constant time
+    static std::atomic<std::uint32_t> g_shape_revision(0);
+
+    void Shape::SetDirty(bool dirty) const
+    {
+        SceneObject::SetDirty(dirty);
+
+        if (dirty)
+        {
+            // Revisions are unique stamps of the global counter, so the latest change of
+            // a shape and shapes it depends on is found by taking the maximum
+            m_revision = ++g_shape_revision;
+        }
+    }
+
+    std::uint32_t Shape::GetRevision() const
+    {
+        return m_revision;
+    }
+
+    std::uint32_t Shape::GetGlobalRevision()
+    {
+        return g_shape_revision;
     }
 
     RadeonRays::bbox Instance::GetLocalAABB() const
     {
         return m_base_shape->GetLocalAABB();
     }
+
+    std::uint32_t Instance::GetRevision() const
+    {
+        return std::max(Shape::GetRevision(), m_base_shape ? m_base_shape->GetRevision() : 0u);
+    }
 }
@@ -41,6 +41,7 @@
 namespace Baikal
 {
     class Material;
+    class Volume;
     
     /**
      \brief Shape base interface.
@@ -59,6 +60,10 @@ namespace Baikal
         void SetMaterial(Material const* material);
         Material const* GetMaterial() const;
 
+        // Get and set volume enclosed by the shape
+        void SetVolume(Volume const* volume);
+        Volume const* GetVolume() const;
+
         // Get and set transform
         void SetTransform(RadeonRays::matrix const& t);
         RadeonRays::matrix GetTransform() const;
@@ -71,15 +76,27 @@ namespace Baikal
         virtual RadeonRays::bbox GetLocalAABB() const = 0;
         RadeonRays::bbox GetWorldAABB() const;
 
+        // Marking a shape dirty advances its revision
+        void SetDirty(bool dirty) const override;
+        // Changes each time the shape (or shape it depends on) is changed,
+        // unlike dirty flag it is never reset
+        virtual std::uint32_t GetRevision() const;
+        // Changes each time any shape is changed
+        static std::uint32_t GetGlobalRevision();
+
         // Forbidden stuff
         Shape(Shape const&) = delete;
         Shape& operator = (Shape const&) = delete;
     private:
         Material const* m_material;
 
+        Volume const* m_volume;
+
         RadeonRays::matrix m_transform;
 
         bool m_shadow;
+
+        mutable std::uint32_t m_revision;
     };
     
     /**
@@ -148,7 +165,9 @@ namespace Baikal
     
     inline Shape::Shape() 
         : m_material(nullptr)
+        , m_volume(nullptr)
         , m_shadow(true)
+        , m_revision(0)
     {
     }
     
@@ -163,6 +182,17 @@ namespace Baikal
         return m_material;
     }
 
+    inline void Shape::SetVolume(Volume const* volume)
+    {
+        m_volume = volume;
+        SetDirty(true);
+    }
+
+    inline Volume const* Shape::GetVolume() const
+    {
+        return m_volume;
+    }
+
     inline void Shape::SetTransform(RadeonRays::matrix const& t)
     {
         m_transform = t;
@@ -202,6 +232,9 @@ namespace Baikal
         // Local space AABB
         RadeonRays::bbox GetLocalAABB() const override;
 
+        // Instance changes with its base shape
+        std::uint32_t GetRevision() const override;
+
         // Forbidden stuff
         Instance(Instance const&) = delete;
         Instance& operator = (Instance const&) = delete;
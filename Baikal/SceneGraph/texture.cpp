@@ -1,75 +1,161 @@
 #include "texture.h"
 
-#include "Utils/half.h"
+#include "Utils/half_convert.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TEXTURE_USE_SSE
+#include <xmmintrin.h>
+#endif
 
 namespace Baikal
 {
-    RadeonRays::float3 Texture::ComputeAverageValue() const
+    namespace
     {
-        auto avg = RadeonRays::float3();
+        // Statistics of a single row, sums are kept per row to limit float error
+        struct RowStatistics
+        {
+            float sum[4];
+            float max[4];
+        };
+
+        // Convert a row of texels to float RGBA
+        void ConvertRow(char const* data, Texture::Format format, int width, float* row)
+        {
+            switch (format)
+            {
+            case Texture::Format::kRgba8:
+            {
+                auto texels = reinterpret_cast<std::uint8_t const*>(data);
+                for (auto i = 0; i < 4 * width; ++i)
+                {
+                    row[i] = texels[i] / 255.f;
+                }
+                break;
+            }
+            case Texture::Format::kRgba16:
+            {
+                HalfToFloat(reinterpret_cast<std::uint16_t const*>(data), row, 4 * width);
+                break;
+            }
+            case Texture::Format::kRgba32:
+            {
+                std::memcpy(row, data, 4 * width * sizeof(float));
+                break;
+            }
+            }
+        }
 
-        switch (m_format) {
-        case Format::kRgba8:
+        // Sum and max of float RGBA texels
+        RowStatistics AccumulateRow(float const* row, int width)
         {
-            auto data = reinterpret_cast<std::uint8_t*>(m_data.get());
-            auto num_elements = m_size.x * m_size.y;
+            RowStatistics result;
 
+#ifdef TEXTURE_USE_SSE
+            // A texel fills an SSE register
+            __m128 sum = _mm_setzero_ps();
+            __m128 max = _mm_setzero_ps();
 
-            for (auto i = 0u; i < num_elements; ++i)
+            for (auto i = 0; i < width; ++i)
             {
-                float r = data[4 * i] / 255.f;
-                float g = data[4 * i + 1] / 255.f;
-                float b = data[4 * i + 2] / 255.f;
-                avg += RadeonRays::float3(r, g, b);
+                __m128 texel = _mm_loadu_ps(row + 4 * i);
+                sum = _mm_add_ps(sum, texel);
+                max = _mm_max_ps(max, texel);
             }
 
-            avg *= (1.f / num_elements);
-            break;
+            _mm_storeu_ps(result.sum, sum);
+            _mm_storeu_ps(result.max, max);
+#else
+            std::fill(result.sum, result.sum + 4, 0.f);
+            std::fill(result.max, result.max + 4, 0.f);
+
+            for (auto i = 0; i < width; ++i)
+            {
+                for (auto c = 0; c < 4; ++c)
+                {
+                    result.sum[c] += row[4 * i + c];
+                    result.max[c] = std::max(result.max[c], row[4 * i + c]);
+                }
+            }
+#endif
+
+            return result;
         }
-        case Format::kRgba16:
-        {
-            auto data = reinterpret_cast<std::uint16_t*>(m_data.get());
-            auto num_elements = m_size.x * m_size.y;
 
-            for (auto i = 0u; i < num_elements; ++i)
+        // Luminance histogram bin from float exponent, avoids log2 per texel
+        int GetLuminanceBin(float luminance)
+        {
+            if (!(luminance > 0.f))
             {
-                auto r = data[4 * i];
-                auto g = data[4 * i + 1];
-                auto b = data[4 * i + 2];
+                return 0;
+            }
 
-                half hr, hg, hb; 
-                hr.setBits(r);
-                hg.setBits(g);
-                hb.setBits(b);
+            std::uint32_t bits;
+            std::memcpy(&bits, &luminance, sizeof(float));
 
+            int exponent = static_cast<int>((bits >> 23) & 0xff) - 127;
 
-                avg += RadeonRays::float3(hr, hg, hb);
-            }
+            return std::min(std::max(exponent + Texture::Statistics::kNumLuminanceBins / 2, 0),
+                Texture::Statistics::kNumLuminanceBins - 1);
+        }
+    }
 
-            avg *= (1.f / num_elements);
-            break;
+    RadeonRays::float3 Texture::ComputeAverageValue() const
+    {
+        return GetStatistics().average;
+    }
+
+    Texture::Statistics const& Texture::GetStatistics() const
+    {
+        if (m_statistics)
+        {
+            return *m_statistics;
         }
-        case Format::kRgba32:
+
+        std::unique_ptr<Statistics> statistics(new Statistics);
+        std::fill(statistics->luminance_histogram, statistics->luminance_histogram + Statistics::kNumLuminanceBins, 0u);
+
+        auto width = m_size.x;
+        auto height = m_size.y;
+        auto row_size = GetSizeInBytes() / std::max(height, 1);
+
+        std::vector<float> row(4 * width);
+        double sum[3] = { 0.0, 0.0, 0.0 };
+        float max[3] = { 0.f, 0.f, 0.f };
+
+        for (auto y = 0; y < height; ++y)
         {
-            auto data = reinterpret_cast<float*>(m_data.get());
-            auto num_elements = m_size.x * m_size.y;
+            ConvertRow(m_data.get() + y * row_size, m_format, width, &row[0]);
 
-            for (auto i = 0u; i < num_elements; ++i)
-            {
-                auto r = data[4 * i];
-                auto g = data[4 * i + 1];
-                auto b = data[4 * i + 2];
+            auto row_statistics = AccumulateRow(&row[0], width);
 
-                avg += RadeonRays::float3(r, g, b);
+            for (auto c = 0; c < 3; ++c)
+            {
+                sum[c] += row_statistics.sum[c];
+                max[c] = std::max(max[c], row_statistics.max[c]);
             }
 
-            avg *= (1.f / num_elements);
-            break;
-        }
-        default:
-            break;
+            for (auto x = 0; x < width; ++x)
+            {
+                auto texel = &row[4 * x];
+                auto luminance = 0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2];
+                ++statistics->luminance_histogram[GetLuminanceBin(luminance)];
+            }
         }
 
-        return avg;
+        auto num_elements = std::max(width * height, 1);
+
+        statistics->average = RadeonRays::float3(
+            static_cast<float>(sum[0] / num_elements),
+            static_cast<float>(sum[1] / num_elements),
+            static_cast<float>(sum[2] / num_elements));
+        statistics->max = RadeonRays::float3(max[0], max[1], max[2]);
+
+        m_statistics = std::move(statistics);
+
+        return *m_statistics;
     }
-}
\ No newline at end of file
+}
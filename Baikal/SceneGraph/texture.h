@@ -31,6 +31,7 @@
 #include "math/float3.h"
 #include "math/float2.h"
 #include "math/int2.h"
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -55,6 +56,26 @@ namespace Baikal
             kRgba32
         };
 
+        enum class WrapMode
+        {
+            kRepeat,
+            kMirroredRepeat,
+            kClampToEdge,
+            kClampToBorder
+        };
+
+        // Derived statistics of texture data (RGB channels)
+        struct Statistics
+        {
+            // Luminance histogram has a bin per power of 2: bin i counts texels
+            // with luminance in [2^(i - 16), 2^(i - 15)), darker ones go to bin 0
+            static int const kNumLuminanceBins = 32;
+
+            RadeonRays::float3 average;
+            RadeonRays::float3 max;
+            std::uint32_t luminance_histogram[kNumLuminanceBins];
+        };
+
         // Constructor
         Texture();
         // Note, that texture takes ownership of its data array
@@ -74,9 +95,17 @@ namespace Baikal
         // Get data size in bytes
         std::size_t GetSizeInBytes() const;
 
+        // Set wrap mode for texture coordinates outside of [0, 1]
+        void SetWrapMode(WrapMode wrap_mode);
+        // Get wrap mode
+        WrapMode GetWrapMode() const;
+
         // Average normalized value
         RadeonRays::float3 ComputeAverageValue() const;
 
+        // Statistics are computed on first request and cached until texture data changes
+        Statistics const& GetStatistics() const;
+
         // Disallow copying
         Texture(Texture const&) = delete;
         Texture& operator = (Texture const&) = delete;
@@ -88,12 +117,17 @@ namespace Baikal
         RadeonRays::int2 m_size;
         // Format
         Format m_format;
+        // Wrap mode
+        WrapMode m_wrap_mode;
+        // Cached statistics, nullptr if not computed for current data
+        mutable std::unique_ptr<Statistics> m_statistics;
     };
 
     inline Texture::Texture()
         : m_data(new char[16])
         , m_size(2,2)
         , m_format(Format::kRgba8)
+        , m_wrap_mode(WrapMode::kRepeat)
     {
         // Create checkerboard by default
         m_data[0] = m_data[1] = m_data[2] = m_data[3] = (char)0xFF;
@@ -106,6 +140,7 @@ namespace Baikal
     : m_data(data)
     , m_size(size)
     , m_format(format)
+    , m_wrap_mode(WrapMode::kRepeat)
     {
     }
 
@@ -114,6 +149,7 @@ namespace Baikal
         m_data.reset(data);
         m_size = size;
         m_format = format;
+        m_statistics.reset();
         SetDirty(true);
     }
 
@@ -132,6 +168,17 @@ namespace Baikal
         return m_format;
     }
     
+    inline void Texture::SetWrapMode(WrapMode wrap_mode)
+    {
+        m_wrap_mode = wrap_mode;
+        SetDirty(true);
+    }
+
+    inline Texture::WrapMode Texture::GetWrapMode() const
+    {
+        return m_wrap_mode;
+    }
+    
     inline std::size_t Texture::GetSizeInBytes() const
     {
         std::uint32_t component_size = 1;
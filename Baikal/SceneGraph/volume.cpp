@@ -0,0 +1,59 @@
+#include "volume.h"
+
+namespace Baikal
+{
+    RadeonRays::float3 Volume::GetAbsorption() const
+    {
+        return m_sigma_a;
+    }
+
+    void Volume::SetAbsorption(RadeonRays::float3 const& sigma_a)
+    {
+        m_sigma_a = sigma_a;
+        SetDirty(true);
+    }
+
+    RadeonRays::float3 Volume::GetScattering() const
+    {
+        return m_sigma_s;
+    }
+
+    void Volume::SetScattering(RadeonRays::float3 const& sigma_s)
+    {
+        m_sigma_s = sigma_s;
+        SetDirty(true);
+    }
+
+    RadeonRays::float3 Volume::GetEmission() const
+    {
+        return m_sigma_e;
+    }
+
+    void Volume::SetEmission(RadeonRays::float3 const& sigma_e)
+    {
+        m_sigma_e = sigma_e;
+        SetDirty(true);
+    }
+
+    void GridVolume::SetGrid(SparseGrid&& grid)
+    {
+        m_grid = std::move(grid);
+        SetDirty(true);
+    }
+
+    SparseGrid const& GridVolume::GetGrid() const
+    {
+        return m_grid;
+    }
+
+    void GridVolume::SetBounds(RadeonRays::bbox const& bounds)
+    {
+        m_bounds = bounds;
+        SetDirty(true);
+    }
+
+    RadeonRays::bbox GridVolume::GetBounds() const
+    {
+        return m_bounds;
+    }
+}
@@ -0,0 +1,121 @@
+/**********************************************************************
+ Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ********************************************************************/
+
+/**
+ \file volume.h
+ \author Dmitry Kozlov
+ \version 1.0
+ \brief Contains declaration of participating media supported by the renderer.
+ */
+#pragma once
+
+#include "math/float3.h"
+#include "math/bbox.h"
+
+#include "scene_object.h"
+#include "Utils/sparse_grid.h"
+
+namespace Baikal
+{
+    /**
+     \brief Volume base interface.
+     
+     Volume describes participating medium enclosed by a shape.
+     Coefficients are per unit length and are scaled by medium density.
+     */
+    class Volume : public SceneObject
+    {
+    public:
+        // Constructor
+        Volume();
+        // Destructor
+        virtual ~Volume() = 0;
+
+        // Set and get absorption coefficient
+        RadeonRays::float3 GetAbsorption() const;
+        void SetAbsorption(RadeonRays::float3 const& sigma_a);
+
+        // Set and get scattering coefficient
+        RadeonRays::float3 GetScattering() const;
+        void SetScattering(RadeonRays::float3 const& sigma_s);
+
+        // Set and get emission coefficient
+        RadeonRays::float3 GetEmission() const;
+        void SetEmission(RadeonRays::float3 const& sigma_e);
+
+    private:
+        // Absorption
+        RadeonRays::float3 m_sigma_a;
+        // Scattering
+        RadeonRays::float3 m_sigma_s;
+        // Emission
+        RadeonRays::float3 m_sigma_e;
+    };
+
+    inline Volume::Volume()
+    : m_sigma_a(0.f, 0.f, 0.f)
+    , m_sigma_s(0.f, 0.f, 0.f)
+    , m_sigma_e(0.f, 0.f, 0.f)
+    {
+    }
+
+    inline Volume::~Volume()
+    {
+    }
+
+    /**
+     \brief Homogeneous volume.
+     
+     Medium of constant unit density.
+     */
+    class HomogeneousVolume : public Volume
+    {
+    public:
+        HomogeneousVolume() = default;
+    };
+
+    /**
+     \brief Heterogeneous volume.
+     
+     Medium with density defined by sparse voxel grid spanning world space bounds.
+     Density is assumed zero outside of the bounds.
+     */
+    class GridVolume : public Volume
+    {
+    public:
+        GridVolume() = default;
+
+        // Set and get density grid
+        void SetGrid(SparseGrid&& grid);
+        SparseGrid const& GetGrid() const;
+
+        // Set and get world space bounds of the grid
+        void SetBounds(RadeonRays::bbox const& bounds);
+        RadeonRays::bbox GetBounds() const;
+
+    private:
+        // Density
+        SparseGrid m_grid;
+        // World space bounds
+        RadeonRays::bbox m_bounds;
+    };
+}
@@ -0,0 +1,249 @@
+#include "bxdf_lut.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace Baikal
+{
+    using namespace RadeonRays;
+
+    namespace
+    {
+        // Stratified samples per dimension for each texel
+        int const kNumStrata = 16;
+        // Same as ROUGHNESS_EPS in bxdf.cl
+        float const kMinRoughness = 0.0001f;
+        // Avoid exactly grazing incident direction
+        float const kMinCos = 0.001f;
+        float const kPi = 3.14159265358979323846f;
+
+        // Shadowing and normal sampling mirror bxdf.cl
+        float GgxG1(float roughness, float ndotv)
+        {
+            float sinnv = std::sqrt(1.f - std::min(ndotv * ndotv, 1.f));
+            float tannv = ndotv > 1e-8f ? sinnv / ndotv : 0.f;
+            float a2 = roughness * roughness;
+            return 2.f / (1.f + std::sqrt(1.f + a2 * tannv * tannv));
+        }
+
+        float BeckmannG1(float roughness, float ndotv)
+        {
+            float sinnv = std::sqrt(1.f - std::min(ndotv * ndotv, 1.f));
+            float tannv = ndotv > 1e-8f ? sinnv / ndotv : 0.f;
+            if (tannv <= 1e-8f)
+                return 1.f;
+
+            float a = 1.f / (roughness * tannv);
+            float a2 = a * a;
+
+            if (a > 1.6f)
+                return 1.f;
+
+            return (3.535f * a + 2.181f * a2) / (1.f + 2.276f * a + 2.577f * a2);
+        }
+
+        float3 GgxSampleNormal(float roughness, float r1, float r2)
+        {
+            float theta = std::atan2(roughness * std::sqrt(r1), std::sqrt(1.f - r1));
+            float phi = 2.f * kPi * r2;
+            return float3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        }
+
+        float3 BeckmannSampleNormal(float roughness, float r1, float r2)
+        {
+            float theta = std::atan(std::sqrt(-roughness * roughness * std::log(std::max(1e-8f, 1.f - r1))));
+            float phi = 2.f * kPi * r2;
+            return float3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        }
+
+        // Dielectric Fresnel for relative IOR eta = etat / etai, 1 for total internal reflection
+        float FresnelDielectric(float eta, float cosi)
+        {
+            float sint2 = (1.f - cosi * cosi) / (eta * eta);
+
+            if (sint2 >= 1.f)
+                return 1.f;
+
+            float cost = std::sqrt(1.f - sint2);
+            float rparl = (eta * cosi - cost) / (eta * cosi + cost);
+            float rperp = (cosi - eta * cost) / (cosi + eta * cost);
+            return 0.5f * (rparl * rparl + rperp * rperp);
+        }
+
+        struct Albedo
+        {
+            // Reflection albedo (F = 1)
+            float reflection;
+            // Fresnel averaged over reflection lobe
+            float fresnel;
+            // Transmission albedo (F = 0)
+            float transmission;
+        };
+
+        // Halfway vectors sampled proportional to D(m) * cos(m) on a stratified grid
+        template <typename SampleNormal>
+        std::vector<float3> SampleNormals(float roughness, SampleNormal sample_normal)
+        {
+            std::vector<float3> normals;
+            normals.reserve(kNumStrata * kNumStrata);
+
+            for (int i = 0; i < kNumStrata; ++i)
+            {
+                for (int j = 0; j < kNumStrata; ++j)
+                {
+                    normals.push_back(sample_normal(roughness, (i + 0.5f) / kNumStrata, (j + 0.5f) / kNumStrata));
+                }
+            }
+
+            return normals;
+        }
+
+        // Integrate single scattering albedo over halfway vectors distributed
+        // proportional to D(m) * cos(m), so that distribution term cancels out.
+        template <typename G1>
+        Albedo IntegrateAlbedo(float costheta, float roughness, float eta, G1 g1, std::vector<float3> const& normals)
+        {
+            float3 wi(std::sqrt(1.f - costheta * costheta), costheta, 0.f);
+            float inveta = 1.f / eta;
+            float g1i = g1(roughness, costheta);
+
+            double reflection = 0.0;
+            double fresnel_reflection = 0.0;
+            double transmission = 0.0;
+
+            for (auto& m : normals)
+            {
+                float idotm = dot(wi, m);
+                float denom = costheta * m.y;
+
+                if (idotm <= 0.f || denom <= 0.f)
+                    continue;
+
+                // f * cos / pdf = G * |wo.m| / (cos * m.y)
+                float3 wr = 2.f * idotm * m - wi;
+                if (wr.y > 0.f)
+                {
+                    float weight = g1i * g1(roughness, wr.y) * dot(wr, m) / denom;
+                    reflection += weight;
+                    fresnel_reflection += weight * FresnelDielectric(eta, idotm);
+                }
+
+                // f * cos / pdf = G * |wi.m| / (cos * m.y)
+                float d = 1.f - inveta * inveta * (1.f - idotm * idotm);
+                if (d > 0.f)
+                {
+                    float3 wt = (inveta * idotm - std::sqrt(d)) * m - inveta * wi;
+                    if (wt.y < 0.f)
+                    {
+                        transmission += g1i * g1(roughness, -wt.y) * idotm / denom;
+                    }
+                }
+            }
+
+            double n = static_cast<double>(normals.size());
+
+            Albedo albedo;
+            albedo.reflection = static_cast<float>(reflection / n);
+            albedo.fresnel = reflection > 0.0 ? static_cast<float>(fresnel_reflection / reflection) : FresnelDielectric(eta, costheta);
+            albedo.transmission = static_cast<float>(transmission / n);
+            return albedo;
+        }
+
+        float LutCos(int idx)
+        {
+            return std::max(static_cast<float>(idx) / (kBxdfLutSize - 1), kMinCos);
+        }
+
+        float LutRoughness(int idx)
+        {
+            return std::max(static_cast<float>(idx) / (kBxdfLutSize - 1), kMinRoughness);
+        }
+
+        float LutEta(int idx)
+        {
+            return std::exp(std::log(kBxdfLutMaxEta) * (2.f * idx / (kBxdfLutEtaSize - 1) - 1.f));
+        }
+
+        // Bake all entries for a given roughness
+        void BakeRoughness(int roughness_idx, std::vector<float3>& lut)
+        {
+            auto roughness = LutRoughness(roughness_idx);
+            auto ggx_normals = SampleNormals(roughness, GgxSampleNormal);
+            auto beckmann_normals = SampleNormals(roughness, BeckmannSampleNormal);
+
+            // 2D table
+            for (int i = 0; i < kBxdfLutSize; ++i)
+            {
+                auto ggx = IntegrateAlbedo(LutCos(i), roughness, 1.f, GgxG1, ggx_normals);
+                auto beckmann = IntegrateAlbedo(LutCos(i), roughness, 1.f, BeckmannG1, beckmann_normals);
+                lut[BxdfLutIndex2D(i, roughness_idx)] = float3(ggx.reflection, beckmann.reflection, 0.f, 0.f);
+            }
+
+            // Cosine weighted average over the hemisphere (trapezoidal rule)
+            float ggx_avg = 0.f;
+            float beckmann_avg = 0.f;
+            for (int i = 0; i + 1 < kBxdfLutSize; ++i)
+            {
+                auto& e0 = lut[BxdfLutIndex2D(i, roughness_idx)];
+                auto& e1 = lut[BxdfLutIndex2D(i + 1, roughness_idx)];
+                float mu0 = static_cast<float>(i) / (kBxdfLutSize - 1);
+                float mu1 = static_cast<float>(i + 1) / (kBxdfLutSize - 1);
+                ggx_avg += (e0.x * mu0 + e1.x * mu1) * (mu1 - mu0);
+                beckmann_avg += (e0.y * mu0 + e1.y * mu1) * (mu1 - mu0);
+            }
+
+            for (int i = 0; i < kBxdfLutSize; ++i)
+            {
+                lut[BxdfLutIndex2D(i, roughness_idx)].z = ggx_avg;
+                lut[BxdfLutIndex2D(i, roughness_idx)].w = beckmann_avg;
+            }
+
+            // 3D table
+            for (int eta_idx = 0; eta_idx < kBxdfLutEtaSize; ++eta_idx)
+            {
+                auto eta = LutEta(eta_idx);
+
+                for (int i = 0; i < kBxdfLutSize; ++i)
+                {
+                    auto ggx = IntegrateAlbedo(LutCos(i), roughness, eta, GgxG1, ggx_normals);
+                    auto beckmann = IntegrateAlbedo(LutCos(i), roughness, eta, BeckmannG1, beckmann_normals);
+                    lut[BxdfLutIndex3D(i, roughness_idx, eta_idx)] = float3(ggx.fresnel, ggx.transmission, beckmann.fresnel, beckmann.transmission);
+                }
+            }
+        }
+
+        std::vector<float3> BakeBxdfLut()
+        {
+            std::vector<float3> lut(kBxdfLutSize * kBxdfLutSize * (1 + kBxdfLutEtaSize));
+
+            int num_threads = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), kBxdfLutSize));
+
+            std::vector<std::thread> threads;
+            for (int t = 0; t < num_threads; ++t)
+            {
+                threads.emplace_back([t, num_threads, &lut]()
+                {
+                    for (int roughness_idx = t; roughness_idx < kBxdfLutSize; roughness_idx += num_threads)
+                    {
+                        BakeRoughness(roughness_idx, lut);
+                    }
+                });
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            return lut;
+        }
+    }
+
+    std::vector<float3> const& GetBxdfLut()
+    {
+        // Baked once per process
+        static std::vector<float3> const lut = BakeBxdfLut();
+        return lut;
+    }
+}
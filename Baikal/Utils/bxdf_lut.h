@@ -0,0 +1,58 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "math/float3.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace Baikal
+{
+    ///< Directional albedo tables of microfacet BxDFs used by bxdf.cl for energy compensation
+    ///< and layered material weights. Tables are baked on first use and cached for the process.
+    ///<
+    ///< Layout (4 component texels, cos(theta) varies fastest, then roughness, then relative IOR):
+    ///<  2D table [roughness][cos]: (E GGX, E Beckmann, average E GGX, average E Beckmann)
+    ///<  3D table [eta][roughness][cos]: (Fresnel averaged over GGX reflection lobe, E GGX transmission,
+    ///<                                  Fresnel averaged over Beckmann reflection lobe, E Beckmann transmission)
+    ///< Roughness and cos(theta) span [0, 1], relative IOR spans [1 / kBxdfLutMaxEta, kBxdfLutMaxEta] in log space.
+    ///< Constants should match BXDF_LUT_* in bxdf.cl.
+    ///<
+    static const int kBxdfLutSize = 32;
+    static const int kBxdfLutEtaSize = 16;
+    static const float kBxdfLutMaxEta = 3.f;
+
+    // Baked tables, 2D table followed by 3D table
+    std::vector<RadeonRays::float3> const& GetBxdfLut();
+
+    // Texel index of 2D and 3D tables
+    inline std::size_t BxdfLutIndex2D(int cos_idx, int roughness_idx)
+    {
+        return roughness_idx * kBxdfLutSize + cos_idx;
+    }
+
+    inline std::size_t BxdfLutIndex3D(int cos_idx, int roughness_idx, int eta_idx)
+    {
+        return kBxdfLutSize * kBxdfLutSize + (eta_idx * kBxdfLutSize + roughness_idx) * kBxdfLutSize + cos_idx;
+    }
+}
@@ -1,10 +1,46 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <string>
 #include "CLW.h"
 
 namespace Baikal
 {
+    // Devices with image support sample RGBA8 textures from an atlas image,
+    // kernels are built with BAIKAL_TEXTURE_ATLAS then, see texture.cl
+    inline bool HasTextureAtlas(CLWContext const& context)
+    {
+        cl_bool image_support = CL_FALSE;
+        clGetDeviceInfo(context.GetDevice(0).GetID(), CL_DEVICE_IMAGE_SUPPORT, sizeof(image_support), &image_support, nullptr);
+        return image_support == CL_TRUE;
+    }
+
+    // Kernel handle which remembers the data its static arguments are bound to,
+    // so these arguments are only set again once the data changes
+    struct ClwBoundKernel
+    {
+        CLWKernel kernel;
+        void const* data = nullptr;
+        std::uint32_t revision = 0;
+
+        // Returns true if static arguments have to be set for given data revision
+        bool NeedsBinding(void const* new_data, std::uint32_t new_revision)
+        {
+            if (data == new_data && revision == new_revision)
+            {
+                return false;
+            }
+
+            data = new_data;
+            revision = new_revision;
+            return true;
+        }
+
+        // Forces static arguments to be set on the next launch
+        void Invalidate() { data = nullptr; }
+    };
+
     class ClwClass
     {
     public:
@@ -18,14 +54,43 @@ namespace Baikal
         CLWContext GetContext() const { return m_context; }
         CLWKernel GetKernel(std::string const& name);
         std::string GetBuildOpts() const { return m_buildopts; }
-        
+        std::string const& GetProgramOpts() const { return m_opts; }
+
+        // Sets next kernel argument, skips it if static arguments are already bound
+        template <typename T>
+        static void SetStaticArg(CLWKernel& kernel, int& argc, bool bind, T const& value)
+        {
+            if (bind)
+            {
+                kernel.SetArg(argc, value);
+            }
+
+            ++argc;
+        }
+
+        // Sets arguments of TEXTURE_ARG_LIST, the atlas image is only there if the device supports images
+        template <typename Scene>
+        void SetTextureArgs(CLWKernel& kernel, int& argc, bool bind, Scene const& scene) const
+        {
+            SetStaticArg(kernel, argc, bind, scene.textures);
+            SetStaticArg(kernel, argc, bind, scene.texturedata);
+
+            if (m_texture_atlas)
+            {
+                SetStaticArg(kernel, argc, bind, scene.texture_atlas);
+            }
+        }
         
     private:
         CLWContext m_context;
         CLWProgram m_program;
+        // Programs built so far keyed by options, so switching options
+        // back and forth does not trigger recompilation
+        std::map<std::string, CLWProgram> m_programs;
         std::string m_buildopts;
         std::string m_cl_file;
         std::string m_opts;
+        bool m_texture_atlas;
     };
     
     inline ClwClass::ClwClass(
@@ -36,6 +101,7 @@ namespace Baikal
     : m_context(context)
     , m_cl_file(cl_file)
     , m_opts(opts)
+    , m_texture_atlas(HasTextureAtlas(context))
     {
         m_buildopts.append(" -cl-mad-enable -cl-fast-relaxed-math "
                          "-cl-std=CL1.2 -I . ");
@@ -52,21 +118,37 @@ namespace Baikal
 #endif
                          );
 
+        if (m_texture_atlas)
+        {
+            m_buildopts.append("-D BAIKAL_TEXTURE_ATLAS ");
+        }
+
         auto cmdopts = m_buildopts;
         cmdopts.append(opts);
         m_program = CLWProgram::CreateFromFile(cl_file.c_str(),
                                                cmdopts.c_str(), m_context);
+        m_programs.emplace(opts, m_program);
     }
 
     inline void ClwClass::Rebuild(std::string const& opts)
     {
         if (m_opts != opts)
         {
+            m_opts = opts;
+
+            auto iter = m_programs.find(opts);
+
+            if (iter != m_programs.cend())
+            {
+                m_program = iter->second;
+                return;
+            }
+
             auto cmdopts = m_buildopts;
             cmdopts.append(opts);
-            m_opts = opts;
             m_program = CLWProgram::CreateFromFile(m_cl_file.c_str(),
                 cmdopts.c_str(), m_context);
+            m_programs.emplace(opts, m_program);
         }
     }
 
@@ -0,0 +1,55 @@
+#include "clw_shproject.h"
+
+namespace Baikal
+{
+    using namespace RadeonRays;
+
+    // Work group size of ShProject kernel (both dimensions)
+    static int const kProjectGroupSize = 8;
+    // Work group size of ShReduce kernel
+    static int const kReduceGroupSize = 256;
+
+    ClwShProjector::ClwShProjector(CLWContext context)
+        : ClwClass(context, "../Baikal/Kernels/CL/sh.cl")
+    {
+        m_project_kernel = GetKernel("ShProject");
+        m_reduce_kernel = GetKernel("ShReduce");
+    }
+
+    void ClwShProjector::Project(ClwScene const& scene, int texidx, int width, int height, CLWBuffer<float3> coeffs)
+    {
+        auto num_groups_x = (width + kProjectGroupSize - 1) / kProjectGroupSize;
+        auto num_groups_y = (height + kProjectGroupSize - 1) / kProjectGroupSize;
+        auto num_sets = num_groups_x * num_groups_y;
+
+        // Grow partial sums buffer if needed
+        if (m_partial.GetElementCount() < static_cast<std::size_t>(num_sets * kNumCoefficients))
+        {
+            m_partial = GetContext().CreateBuffer<float3>(num_sets * kNumCoefficients, CL_MEM_READ_WRITE);
+        }
+
+        // Project each 8x8 block of texels
+        {
+            int argc = 0;
+            m_project_kernel.SetArg(argc++, scene.textures);
+            m_project_kernel.SetArg(argc++, scene.texturedata);
+            m_project_kernel.SetArg(argc++, texidx);
+            m_project_kernel.SetArg(argc++, m_partial);
+
+            size_t gs[] = { static_cast<size_t>(num_groups_x * kProjectGroupSize), static_cast<size_t>(num_groups_y * kProjectGroupSize) };
+            size_t ls[] = { static_cast<size_t>(kProjectGroupSize), static_cast<size_t>(kProjectGroupSize) };
+
+            GetContext().Launch2D(0, gs, ls, m_project_kernel);
+        }
+
+        // Reduce partial sums with a single work group
+        {
+            int argc = 0;
+            m_reduce_kernel.SetArg(argc++, m_partial);
+            m_reduce_kernel.SetArg(argc++, num_sets);
+            m_reduce_kernel.SetArg(argc++, coeffs);
+
+            GetContext().Launch1D(0, kReduceGroupSize, kReduceGroupSize, m_reduce_kernel);
+        }
+    }
+}
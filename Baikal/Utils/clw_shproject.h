@@ -0,0 +1,56 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "CLW.h"
+#include "Utils/clw_class.h"
+#include "SceneGraph/clwscene.h"
+
+namespace Baikal
+{
+    /**
+    \brief Device spherical harmonics projection of environment maps.
+
+    Runs ShProject / ShReduce kernels from sh.cl on a latitude-longitude texture
+    already uploaded to the device. Kernels are fixed to lmax = 2 (9 coefficients),
+    which is all irradiance reconstruction needs. Results match ShProjectEnvironmentMap.
+    Textures are read from texturedata, so those placed to the texture atlas are not supported.
+    */
+    class ClwShProjector : protected ClwClass
+    {
+    public:
+        // Number of RGB coefficients produced
+        static int const kNumCoefficients = 9;
+
+        // Constructor
+        ClwShProjector(CLWContext context);
+
+        // Project texture texidx (width x height) of the scene into coeffs (kNumCoefficients items)
+        void Project(ClwScene const& scene, int texidx, int width, int height, CLWBuffer<RadeonRays::float3> coeffs);
+
+    private:
+        CLWKernel m_project_kernel;
+        CLWKernel m_reduce_kernel;
+        // Per work group partial sums
+        CLWBuffer<RadeonRays::float3> m_partial;
+    };
+}
@@ -41,32 +41,109 @@ namespace Baikal
         {
             m_cdf[i] /= m_func_sum;
         }
+
+        BuildAliasTable();
+    }
+
+    void Distribution1D::BuildAliasTable()
+    {
+        m_alias_probability.resize(m_num_segments);
+        m_alias.resize(m_num_segments);
+
+        // Segment probabilities scaled so that the average is 1
+        std::vector<float> scaled(m_num_segments, 1.f);
+
+        if (m_func_sum > 0.f)
+        {
+            for (auto i = 0u; i < m_num_segments; ++i)
+            {
+                scaled[i] = m_func_values[i] / m_func_sum;
+            }
+        }
+
+        std::vector<std::uint32_t> small;
+        std::vector<std::uint32_t> large;
+
+        for (auto i = 0u; i < m_num_segments; ++i)
+        {
+            (scaled[i] < 1.f ? small : large).push_back(i);
+        }
+
+        // Pair each underfull entry with an overfull one, which donates the rest of the bucket
+        while (!small.empty() && !large.empty())
+        {
+            auto s = small.back();
+            small.pop_back();
+            auto l = large.back();
+            large.pop_back();
+
+            m_alias_probability[s] = scaled[s];
+            m_alias[s] = l;
+
+            scaled[l] = (scaled[l] + scaled[s]) - 1.f;
+            (scaled[l] < 1.f ? small : large).push_back(l);
+        }
+
+        // What is left is full up to rounding errors
+        for (auto i : large)
+        {
+            m_alias_probability[i] = 1.f;
+            m_alias[i] = i;
+        }
+
+        for (auto i : small)
+        {
+            m_alias_probability[i] = 1.f;
+            m_alias[i] = i;
+        }
     }
 
     float Distribution1D::Sample1D(float u, float& pdf) const
     {
-        assert(m_num_segments > 0);
+        std::uint32_t segment = 0;
+        return Sample1D(u, pdf, segment);
+    }
 
-        // Find the segment here u lies
-        // this one is in [0, N-1] and we need to handle corner case:
-        // for 0 it returns 0 index
-        auto iter = std::lower_bound(m_cdf.cbegin(), m_cdf.cend(), u); 
+    float Distribution1D::Sample1D(float u, float& pdf, std::uint32_t& segment) const
+    {
+        assert(m_num_segments > 0);
 
-        // Find segment index : clamp it as last may be returned for 1
-        auto segment_idx = std::max((std::uint32_t)std::distance(m_cdf.cbegin(), iter), 1u);
+        // Invert CDF, so that samples keep their stratification.
+        // Find the first segment ending past u, this skips empty segments.
+        // u at the end of the range maps to the last non-empty segment.
+        auto iter = u < m_cdf.back() ?
+            std::upper_bound(m_cdf.cbegin(), m_cdf.cend(), u) :
+            std::lower_bound(m_cdf.cbegin(), m_cdf.cend(), m_cdf.back());
 
-        assert(u >= m_cdf[segment_idx - 1] && u <= m_cdf[segment_idx]);
+        // Find segment index : clamp it as end may be returned for 1
+        auto segment_idx = std::min(std::max((std::uint32_t)std::distance(m_cdf.cbegin(), iter), 1u), m_num_segments);
 
         // Find lerp coefficient
-        float du = (u - m_cdf[segment_idx - 1]) / (m_cdf[segment_idx] - m_cdf[segment_idx - 1]);
+        float width = m_cdf[segment_idx] - m_cdf[segment_idx - 1];
+        float du = width > 0.f ? std::min(std::max((u - m_cdf[segment_idx - 1]) / width, 0.f), 1.f) : 0.f;
 
         // Calc pdf
         pdf = m_func_values[segment_idx - 1] / m_func_sum;
+        segment = segment_idx - 1;
 
         // Return corresponding value
         return (segment_idx - 1 + du) / m_num_segments;
     }
 
+    std::uint32_t Distribution1D::SampleDiscrete(float u, float& pdf) const
+    {
+        assert(m_num_segments > 0);
+
+        float scaled = u * m_num_segments;
+        auto entry = std::min(static_cast<std::uint32_t>(scaled), m_num_segments - 1);
+        float remainder = std::min(scaled - entry, 0.99999994f);
+        auto segment_idx = remainder < m_alias_probability[entry] ? entry : m_alias[entry];
+
+        pdf = m_func_values[segment_idx] / m_func_sum / m_num_segments;
+
+        return segment_idx;
+    }
+
     float Distribution1D::pdf(float u) const
     {
         // Find the segment here u lies
@@ -78,4 +155,38 @@ namespace Baikal
         // Calc pdf
         return m_func_values[segment_idx - 1] / m_func_sum;
     }
-}
\ No newline at end of file
+
+    std::size_t Distribution1D::GetSerializedSize() const
+    {
+        return 1 + (m_num_segments + 1) + 3 * m_num_segments;
+    }
+
+    void Distribution1D::Serialize(int* data) const
+    {
+        // Write the number of segments first
+        *data++ = static_cast<int>(m_num_segments);
+
+        // Then write num_segments + 1 CDF values
+        auto values = reinterpret_cast<float*>(data);
+        std::copy(m_cdf.cbegin(), m_cdf.cend(), values);
+
+        // Then write num_segments PDF values
+        values += m_num_segments + 1;
+
+        for (auto i = 0u; i < m_num_segments; ++i)
+        {
+            values[i] = m_func_values[i] / m_func_sum;
+        }
+
+        // And the alias table
+        values += m_num_segments;
+        std::copy(m_alias_probability.cbegin(), m_alias_probability.cend(), values);
+
+        auto alias = reinterpret_cast<int*>(values + m_num_segments);
+
+        for (auto i = 0u; i < m_num_segments; ++i)
+        {
+            alias[i] = static_cast<int>(m_alias[i]);
+        }
+    }
+}
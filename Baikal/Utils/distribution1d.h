@@ -21,6 +21,7 @@ THE SOFTWARE.
 ********************************************************************/
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -29,6 +30,8 @@ namespace Baikal
     ///< The class represents 1D piecewise constant distribution of random variable.
     ///< The PDF is proprtional to passed function defined at N points in [0,1] interval
     ///< Partially taken from Pharr & Humphreys, but a bug with lower bound fixed.
+    ///< Continuous sampling inverts the CDF, so it is monotonic in u and keeps stratification of samples.
+    ///< Discrete sampling goes through an alias table (Vose's method), so it is O(1) in the number of segments.
     ///<
     struct Distribution1D
     {
@@ -42,10 +45,21 @@ namespace Baikal
         // Sample one value using this distribution
         // u is uniformely distributed random var
         float Sample1D(float u, float& pdf) const;
+        // Same as above, also returns index of the segment the value falls into
+        float Sample1D(float u, float& pdf, std::uint32_t& segment) const;
+
+        // Sample segment index, pdf is the discrete probability of the segment
+        std::uint32_t SampleDiscrete(float u, float& pdf) const;
 
         // PDF
         float pdf(float u) const;
 
+        // Number of ints needed to serialize the distribution for the device
+        std::size_t GetSerializedSize() const;
+        // Write the distribution in the layout expected by Distribution1D_* functions in sampling.cl:
+        // num_segments, CDF (num_segments + 1), PDF, alias probabilities and alias indices (num_segments each)
+        void Serialize(int* data) const;
+
         // Function values
         std::vector<float> m_func_values;
         // Cumulative distribution function
@@ -54,5 +68,13 @@ namespace Baikal
         std::uint32_t m_num_segments;
         // Integral of the function over the whole range (normalizer)
         float m_func_sum;
+        // Probability to keep the segment of an alias table entry
+        std::vector<float> m_alias_probability;
+        // Segment to take otherwise
+        std::vector<std::uint32_t> m_alias;
+
+    private:
+        // Build alias table from function values
+        void BuildAliasTable();
     };
 }
\ No newline at end of file
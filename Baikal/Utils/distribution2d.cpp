@@ -0,0 +1,270 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "distribution2d.h"
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+using namespace RadeonRays;
+
+namespace Baikal
+{
+    // Smaller grids are not worth spawning threads for
+    static std::uint32_t const kMinRowsPerThread = 64;
+
+    Distribution2D::Distribution2D()
+        : m_width(0u)
+        , m_height(0u)
+    {
+    }
+
+    Distribution2D::Distribution2D(float const* values, std::uint32_t width, std::uint32_t height)
+    {
+        Set(values, width, height);
+    }
+
+    void Distribution2D::Set(float const* values, std::uint32_t width, std::uint32_t height)
+    {
+        assert(width > 0 && height > 0);
+        m_width = width;
+        m_height = height;
+        m_conditional.resize(height);
+
+        // Rows are split between the threads, rows are independent
+        auto const num_threads = std::max(1u, std::min(height / kMinRowsPerThread, std::thread::hardware_concurrency()));
+
+        auto worker = [&](std::uint32_t thread_idx)
+        {
+            auto const row_begin = static_cast<std::uint32_t>(static_cast<std::uint64_t>(height) * thread_idx / num_threads);
+            auto const row_end = static_cast<std::uint32_t>(static_cast<std::uint64_t>(height) * (thread_idx + 1) / num_threads);
+
+            for (auto y = row_begin; y < row_end; ++y)
+            {
+                m_conditional[y].Set(values + static_cast<std::size_t>(y) * width, width);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads - 1);
+
+        for (auto i = 1u; i < num_threads; ++i)
+        {
+            threads.push_back(std::thread(worker, i));
+        }
+
+        worker(0);
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        // Marginal distribution is over row integrals
+        std::vector<float> row_integrals(height);
+        for (auto y = 0u; y < height; ++y)
+        {
+            row_integrals[y] = m_conditional[y].m_func_sum;
+        }
+
+        m_marginal.Set(&row_integrals[0], height);
+    }
+
+    float2 Distribution2D::Sample2D(float2 const& u, float& pdf) const
+    {
+        assert(m_width > 0 && m_height > 0);
+
+        // Take the row from the sampled segment, v * m_height may round into a neighbouring empty row
+        float row_pdf = 0.f;
+        std::uint32_t row = 0;
+        float v = m_marginal.Sample1D(u.y, row_pdf, row);
+
+        float column_pdf = 0.f;
+        float x = m_conditional[row].Sample1D(u.x, column_pdf);
+
+        pdf = row_pdf * column_pdf;
+        return float2(x, v);
+    }
+
+    float Distribution2D::GetPdf(float2 const& uv) const
+    {
+        if (m_marginal.m_func_sum <= 0.f)
+        {
+            return 0.f;
+        }
+
+        auto x = std::min(static_cast<std::uint32_t>(std::max(uv.x, 0.f) * m_width), m_width - 1);
+        auto y = std::min(static_cast<std::uint32_t>(std::max(uv.y, 0.f) * m_height), m_height - 1);
+
+        return m_conditional[y].m_func_values[x] / m_marginal.m_func_sum;
+    }
+
+    std::size_t Distribution2D::GetSerializedSize() const
+    {
+        return 2 + m_marginal.GetSerializedSize() + m_height * (m_height > 0 ? m_conditional[0].GetSerializedSize() : 0);
+    }
+
+    void Distribution2D::Serialize(int* data) const
+    {
+        *data++ = static_cast<int>(m_width);
+        *data++ = static_cast<int>(m_height);
+
+        m_marginal.Serialize(data);
+        data += m_marginal.GetSerializedSize();
+
+        // All rows have the same number of segments, so each takes the same space
+        for (auto const& row : m_conditional)
+        {
+            row.Serialize(data);
+            data += row.GetSerializedSize();
+        }
+    }
+
+    HierarchicalDistribution2D::HierarchicalDistribution2D()
+        : m_width(0u)
+        , m_height(0u)
+    {
+    }
+
+    HierarchicalDistribution2D::HierarchicalDistribution2D(float const* values, std::uint32_t width, std::uint32_t height)
+    {
+        Set(values, width, height);
+    }
+
+    void HierarchicalDistribution2D::Set(float const* values, std::uint32_t width, std::uint32_t height)
+    {
+        assert(width > 0 && height > 0);
+        m_width = width;
+        m_height = height;
+        m_levels.clear();
+
+        Level base;
+        base.width = width;
+        base.height = height;
+        base.values.assign(values, values + static_cast<std::size_t>(width) * height);
+        m_levels.push_back(std::move(base));
+
+        // Each texel of a coarser level sums up to 2x2 texels below it, odd sizes round up
+        while (m_levels.back().width > 1 || m_levels.back().height > 1)
+        {
+            Level const& prev = m_levels.back();
+
+            Level next;
+            next.width = (prev.width + 1) / 2;
+            next.height = (prev.height + 1) / 2;
+            next.values.resize(static_cast<std::size_t>(next.width) * next.height);
+
+            for (auto y = 0u; y < next.height; ++y)
+            {
+                for (auto x = 0u; x < next.width; ++x)
+                {
+                    next.values[y * next.width + x] =
+                        GetValue(prev, 2 * x, 2 * y) + GetValue(prev, 2 * x + 1, 2 * y) +
+                        GetValue(prev, 2 * x, 2 * y + 1) + GetValue(prev, 2 * x + 1, 2 * y + 1);
+                }
+            }
+
+            m_levels.push_back(std::move(next));
+        }
+    }
+
+    float HierarchicalDistribution2D::GetValue(Level const& level, std::uint32_t x, std::uint32_t y) const
+    {
+        return (x < level.width && y < level.height) ? level.values[y * level.width + x] : 0.f;
+    }
+
+    float2 HierarchicalDistribution2D::Sample2D(float2 const& u, float& pdf) const
+    {
+        assert(!m_levels.empty());
+
+        float ux = std::min(u.x, 0.99999994f);
+        float uy = std::min(u.y, 0.99999994f);
+        std::uint32_t x = 0;
+        std::uint32_t y = 0;
+
+        // Descend from the 1x1 level, at each step pick column of children first and then the child in it
+        for (auto i = static_cast<int>(m_levels.size()) - 2; i >= 0; --i)
+        {
+            auto const& level = m_levels[i];
+            x *= 2;
+            y *= 2;
+
+            float v00 = GetValue(level, x, y);
+            float v10 = GetValue(level, x + 1, y);
+            float v01 = GetValue(level, x, y + 1);
+            float v11 = GetValue(level, x + 1, y + 1);
+
+            float left = v00 + v01;
+            float right = v10 + v11;
+            float p = left + right > 0.f ? left / (left + right) : 0.5f;
+
+            if (ux < p)
+            {
+                ux /= p;
+            }
+            else
+            {
+                ux = (ux - p) / (1.f - p);
+                ++x;
+                v00 = v10;
+                v01 = v11;
+            }
+
+            p = v00 + v01 > 0.f ? v00 / (v00 + v01) : 0.5f;
+
+            if (uy < p)
+            {
+                uy /= p;
+            }
+            else
+            {
+                uy = (uy - p) / (1.f - p);
+                ++y;
+            }
+
+            // Keep rescaled samples within [0, 1) under rounding
+            ux = std::min(ux, 0.99999994f);
+            uy = std::min(uy, 0.99999994f);
+        }
+
+        // Take the pdf of the texel found in the descent, uv may round into a neighbouring texel
+        float total = m_levels.back().values[0];
+        pdf = total > 0.f ? m_levels[0].values[y * m_width + x] * m_width * m_height / total : 0.f;
+
+        return float2((x + ux) / m_width, (y + uy) / m_height);
+    }
+
+    float HierarchicalDistribution2D::GetPdf(float2 const& uv) const
+    {
+        float total = m_levels.back().values[0];
+
+        if (total <= 0.f)
+        {
+            return 0.f;
+        }
+
+        auto x = std::min(static_cast<std::uint32_t>(std::max(uv.x, 0.f) * m_width), m_width - 1);
+        auto y = std::min(static_cast<std::uint32_t>(std::max(uv.y, 0.f) * m_height), m_height - 1);
+
+        return m_levels[0].values[y * m_width + x] * m_width * m_height / total;
+    }
+}
@@ -0,0 +1,115 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "distribution1d.h"
+#include "math/float2.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Baikal
+{
+    ///< The class represents 2D piecewise constant distribution over [0,1]^2.
+    ///< The PDF is proportional to passed function defined on width x height grid (row-major, rows along y).
+    ///< Sampling picks a row from the marginal distribution of row integrals and then a column
+    ///< from the conditional distribution of the row, both by inverting the Distribution1D CDFs,
+    ///< so stratification of the samples is kept.
+    ///<
+    class Distribution2D
+    {
+    public:
+        Distribution2D();
+        Distribution2D(float const* values, std::uint32_t width, std::uint32_t height);
+
+        // Conditional distributions are built in parallel for large grids
+        void Set(float const* values, std::uint32_t width, std::uint32_t height);
+
+        // Sample point using this distribution, u is uniformly distributed in [0,1]^2,
+        // pdf is with respect to area of [0,1]^2
+        RadeonRays::float2 Sample2D(RadeonRays::float2 const& u, float& pdf) const;
+
+        // PDF of a point in [0,1]^2
+        float GetPdf(RadeonRays::float2 const& uv) const;
+
+        // Integral of the function over [0,1]^2
+        float GetIntegral() const { return m_marginal.m_func_sum; }
+
+        std::uint32_t GetWidth() const { return m_width; }
+        std::uint32_t GetHeight() const { return m_height; }
+
+        // Number of ints needed to serialize the distribution for the device
+        std::size_t GetSerializedSize() const;
+        // Write the distribution in the layout expected by Distribution2D_* functions in sampling.cl:
+        // width, height, marginal distribution, then conditional distributions of the rows,
+        // each in Distribution1D::Serialize layout
+        void Serialize(int* data) const;
+
+    private:
+        std::uint32_t m_width;
+        std::uint32_t m_height;
+        // Distribution over columns for each row
+        std::vector<Distribution1D> m_conditional;
+        // Distribution over rows
+        Distribution1D m_marginal;
+    };
+
+    ///< Hierarchical sample warping over the same piecewise constant function (Clarberg et al. / McCool & Harwood).
+    ///< Function sums are kept in a mip pyramid, a sample descends from the top level choosing between
+    ///< child texels and rescaling itself on the way. Unlike marginal + conditional sampling the warp is
+    ///< continuous in both dimensions, so stratification of input samples is preserved.
+    ///< The pdf is exactly the one of Distribution2D for the same values.
+    ///<
+    class HierarchicalDistribution2D
+    {
+    public:
+        HierarchicalDistribution2D();
+        HierarchicalDistribution2D(float const* values, std::uint32_t width, std::uint32_t height);
+
+        void Set(float const* values, std::uint32_t width, std::uint32_t height);
+
+        RadeonRays::float2 Sample2D(RadeonRays::float2 const& u, float& pdf) const;
+
+        float GetPdf(RadeonRays::float2 const& uv) const;
+
+        std::uint32_t GetWidth() const { return m_width; }
+        std::uint32_t GetHeight() const { return m_height; }
+
+        // Number of mip levels, level 0 has the function values and the last one is 1x1
+        std::size_t GetNumLevels() const { return m_levels.size(); }
+
+    private:
+        struct Level
+        {
+            std::uint32_t width;
+            std::uint32_t height;
+            std::vector<float> values;
+        };
+
+        float GetValue(Level const& level, std::uint32_t x, std::uint32_t y) const;
+
+        std::uint32_t m_width;
+        std::uint32_t m_height;
+        std::vector<Level> m_levels;
+    };
+}
@@ -0,0 +1,131 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "half_convert.h"
+#include "half.h"
+
+#if defined(__F16C__) || defined(__AVX2__)
+// F16C is always there, no need to check at runtime
+#define HALF_CONVERT_USE_F16C
+#include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+// F16C code is compiled for its own target and selected at runtime
+#define HALF_CONVERT_USE_F16C
+#define HALF_CONVERT_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace Baikal
+{
+    namespace
+    {
+        void HalfToFloatTable(std::uint16_t const* src, float* dst, std::size_t count)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                half h;
+                h.setBits(src[i]);
+                dst[i] = h;
+            }
+        }
+
+        void FloatToHalfTable(float const* src, std::uint16_t* dst, std::size_t count)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                dst[i] = half(src[i]).bits();
+            }
+        }
+
+#ifdef HALF_CONVERT_USE_F16C
+#ifdef HALF_CONVERT_DISPATCH
+#define HALF_CONVERT_F16C_TARGET __attribute__((target("avx,f16c")))
+#else
+#define HALF_CONVERT_F16C_TARGET
+#endif
+        // 8 values per iteration, the tail goes through tables
+        HALF_CONVERT_F16C_TARGET
+        void HalfToFloatF16c(std::uint16_t const* src, float* dst, std::size_t count)
+        {
+            std::size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128i h = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+                _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+            }
+
+            HalfToFloatTable(src + i, dst + i, count - i);
+        }
+
+        HALF_CONVERT_F16C_TARGET
+        void FloatToHalfF16c(float const* src, std::uint16_t* dst, std::size_t count)
+        {
+            std::size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+            }
+
+            FloatToHalfTable(src + i, dst + i, count - i);
+        }
+#undef HALF_CONVERT_F16C_TARGET
+#endif
+    }
+
+    bool IsHalfConversionAccelerated()
+    {
+#if defined(HALF_CONVERT_DISPATCH)
+        static bool const has_f16c = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+        return has_f16c;
+#elif defined(HALF_CONVERT_USE_F16C)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void HalfToFloat(std::uint16_t const* src, float* dst, std::size_t count)
+    {
+#ifdef HALF_CONVERT_USE_F16C
+        if (IsHalfConversionAccelerated())
+        {
+            HalfToFloatF16c(src, dst, count);
+            return;
+        }
+#endif
+        HalfToFloatTable(src, dst, count);
+    }
+
+    void FloatToHalf(float const* src, std::uint16_t* dst, std::size_t count)
+    {
+#ifdef HALF_CONVERT_USE_F16C
+        if (IsHalfConversionAccelerated())
+        {
+            FloatToHalfF16c(src, dst, count);
+            return;
+        }
+#endif
+        FloatToHalfTable(src, dst, count);
+    }
+}
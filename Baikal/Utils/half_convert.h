@@ -0,0 +1,39 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Baikal
+{
+    ///< Bulk conversion between arrays of half bit patterns (as stored in kRgba16 textures)
+    ///< and floats. Uses F16C when the CPU has it and falls back to half class tables otherwise,
+    ///< results are the same in both cases (float to half rounds to nearest even) except for NaNs:
+    ///< F16C quiets signaling NaNs, so their payloads may differ from the table conversion.
+    ///<
+    void HalfToFloat(std::uint16_t const* src, float* dst, std::size_t count);
+    void FloatToHalf(float const* src, std::uint16_t* dst, std::size_t count);
+
+    // Check if conversions run on F16C instructions
+    bool IsHalfConversionAccelerated();
+}
@@ -0,0 +1,56 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "math/float2.h"
+#include "math/float3.h"
+#include "math/mathutils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Baikal
+{
+    ///< Path guiding cache layout and sampling math of the kernels (path_guiding_distribution.cl)
+    ///< compiled for the host, so the cache can be sized and tested without a device.
+    namespace PathGuiding
+    {
+        using RadeonRays::float2;
+        using RadeonRays::float3;
+        using std::atan2;
+        using std::cos;
+        using std::fmax;
+        using std::sin;
+        using std::sqrt;
+
+        // OpenCL built-ins used by the shared code
+        inline float clamp(float x, float a, float b) { return std::min(std::max(x, a), b); }
+        inline int clamp(int x, int a, int b) { return std::min(std::max(x, a), b); }
+        inline float3 make_float3(float x, float y, float z) { return float3(x, y, z); }
+
+#define GLOBAL
+#define INLINE inline
+#include "Kernels/CL/path_guiding_distribution.cl"
+#undef INLINE
+#undef GLOBAL
+    }
+}
@@ -24,16 +24,136 @@ THE SOFTWARE.
 
 #include <vector>
 #include <cmath>
+#include <thread>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SHPROJECT_USE_SSE
+#include <xmmintrin.h>
+#endif
 
 using namespace RadeonRays;
 
+namespace
+{
+    // Number of terms covered by closed form evaluation (bands 0..2)
+    int const kNumClosedFormTerms = 9;
+
+    ///< Closed form of ShEvaluate for bands up to 2 at unit direction (x, y, z).
+    ///< Follows ShEvaluate conventions (Condon-Shortley phase, z as polar axis).
+    inline void ShEvaluateBand2(float x, float y, float z, float* ylm)
+    {
+        ylm[0] = 0.2820947917738781f;
+        ylm[1] = -0.4886025119029199f * y;
+        ylm[2] = 0.4886025119029199f * z;
+        ylm[3] = -0.4886025119029199f * x;
+        ylm[4] = 1.092548430592079f * x * y;
+        ylm[5] = -1.092548430592079f * y * z;
+        ylm[6] = 0.9461746957575601f * z * z - 0.3153915652525201f;
+        ylm[7] = -1.092548430592079f * x * z;
+        ylm[8] = 0.5462742152960395f * (x * x - y * y);
+    }
+
+    ///< Sums le * ylm over the texels [begin, end) of a single lat-long row.
+    ///< The row is at polar angle theta, direction is (sin(theta)cos(phi), cos(theta), sin(theta)sin(phi)).
+    void ProjectRowBand2(float3 const* row, int begin, int end, float sintheta, float costheta,
+        float const* sinphi, float const* cosphi, float3* sum)
+    {
+        float ylm[kNumClosedFormTerms];
+
+        for (int i = begin; i < end; ++i)
+        {
+            ShEvaluateBand2(sintheta * cosphi[i], costheta, sintheta * sinphi[i], ylm);
+
+            for (int k = 0; k < kNumClosedFormTerms; ++k)
+            {
+                sum[k] += row[i] * ylm[k];
+            }
+        }
+    }
+
+#ifdef SHPROJECT_USE_SSE
+    ///< SSE version of ProjectRowBand2: evaluates 4 texels at a time
+    ///< keeping accumulators in SoA form (one register per term and channel).
+    void ProjectRowBand2Sse(float3 const* row, int width, float sintheta, float costheta,
+        float const* sinphi, float const* cosphi, float3* sum)
+    {
+        static_assert(sizeof(float3) == 4 * sizeof(float), "float3 is expected to be 4 floats wide");
+
+        __m128 acc[kNumClosedFormTerms][3];
+        for (int k = 0; k < kNumClosedFormTerms; ++k)
+        {
+            acc[k][0] = acc[k][1] = acc[k][2] = _mm_setzero_ps();
+        }
+
+        __m128 const st = _mm_set1_ps(sintheta);
+        __m128 const y = _mm_set1_ps(costheta);
+
+        __m128 const c0 = _mm_set1_ps(0.2820947917738781f);
+        __m128 const c1 = _mm_set1_ps(0.4886025119029199f);
+        __m128 const c1n = _mm_set1_ps(-0.4886025119029199f);
+        __m128 const c2 = _mm_set1_ps(1.092548430592079f);
+        __m128 const c2n = _mm_set1_ps(-1.092548430592079f);
+        __m128 const c20a = _mm_set1_ps(0.9461746957575601f);
+        __m128 const c20b = _mm_set1_ps(0.3153915652525201f);
+        __m128 const c22 = _mm_set1_ps(0.5462742152960395f);
+
+        int const simd_width = width & ~3;
+
+        for (int i = 0; i < simd_width; i += 4)
+        {
+            __m128 x = _mm_mul_ps(st, _mm_loadu_ps(cosphi + i));
+            __m128 z = _mm_mul_ps(st, _mm_loadu_ps(sinphi + i));
+
+            // Load 4 texels and transpose them into channel vectors
+            __m128 r = _mm_loadu_ps(&row[i].x);
+            __m128 g = _mm_loadu_ps(&row[i + 1].x);
+            __m128 b = _mm_loadu_ps(&row[i + 2].x);
+            __m128 a = _mm_loadu_ps(&row[i + 3].x);
+            _MM_TRANSPOSE4_PS(r, g, b, a);
+
+            __m128 ylm[kNumClosedFormTerms];
+            ylm[0] = c0;
+            ylm[1] = _mm_mul_ps(c1n, y);
+            ylm[2] = _mm_mul_ps(c1, z);
+            ylm[3] = _mm_mul_ps(c1n, x);
+            ylm[4] = _mm_mul_ps(c2, _mm_mul_ps(x, y));
+            ylm[5] = _mm_mul_ps(c2n, _mm_mul_ps(y, z));
+            ylm[6] = _mm_sub_ps(_mm_mul_ps(c20a, _mm_mul_ps(z, z)), c20b);
+            ylm[7] = _mm_mul_ps(c2n, _mm_mul_ps(x, z));
+            ylm[8] = _mm_mul_ps(c22, _mm_sub_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+
+            for (int k = 0; k < kNumClosedFormTerms; ++k)
+            {
+                acc[k][0] = _mm_add_ps(acc[k][0], _mm_mul_ps(ylm[k], r));
+                acc[k][1] = _mm_add_ps(acc[k][1], _mm_mul_ps(ylm[k], g));
+                acc[k][2] = _mm_add_ps(acc[k][2], _mm_mul_ps(ylm[k], b));
+            }
+        }
+
+        // Horizontal reduction of the lanes
+        for (int k = 0; k < kNumClosedFormTerms; ++k)
+        {
+            float lanes[3][4];
+            _mm_storeu_ps(lanes[0], acc[k][0]);
+            _mm_storeu_ps(lanes[1], acc[k][1]);
+            _mm_storeu_ps(lanes[2], acc[k][2]);
+
+            sum[k] += float3(lanes[0][0] + lanes[0][1] + lanes[0][2] + lanes[0][3],
+                             lanes[1][0] + lanes[1][1] + lanes[1][2] + lanes[1][3],
+                             lanes[2][0] + lanes[2][1] + lanes[2][2] + lanes[2][3]);
+        }
+
+        // Remaining texels
+        ProjectRowBand2(row, simd_width, width, sintheta, costheta, sinphi, cosphi, sum);
+    }
+#endif
+}
+
 ///< The function projects latitude-longitude environment map to SH basis up to lmax band
 void ShProjectEnvironmentMap(float3 const* envmap, int width, int height, int lmax, float3* coeffs)
 {
-    // Resulting coefficients for RGB
-    // std::vector<float3> coeffs(NumShTerms(lmax));
-    // Temporary coefficients storage
-    std::vector<float>  ylm(NumShTerms(lmax));
+    int const num_terms = NumShTerms(lmax);
 
     // Precompute sin and cos for the sphere
     std::vector<float> sintheta(height);
@@ -58,32 +178,88 @@ void ShProjectEnvironmentMap(float3 const* envmap, int width, int height, int lm
         costheta[i] = std::cos(theta0 + i * thetastep);
     }
 
-    // Iterate over the pixels calculating Riemann sum
-    for (int phi = 0; phi < width; ++phi)
+    // Solid angle of a texel without the sin term
+    float const texel_area = (PI / height) * (2.f * PI / width);
+
+    // Rows are split between the threads, each thread has its own accumulators
+    int const num_threads = std::max(1, std::min(height, static_cast<int>(std::thread::hardware_concurrency())));
+    int const terms_per_thread = std::max(num_terms, kNumClosedFormTerms);
+    std::vector<float3> partial(num_threads * terms_per_thread);
+
+    auto worker = [&](int thread_idx)
     {
-        for (int theta = 0; theta < height; ++theta)
+        int const row_begin = static_cast<int>(static_cast<long long>(height) * thread_idx / num_threads);
+        int const row_end = static_cast<int>(static_cast<long long>(height) * (thread_idx + 1) / num_threads);
+
+        float3* acc = &partial[thread_idx * terms_per_thread];
+
+        // Unweighted sum over the row, weighted by the row solid angle once the row is done
+        std::vector<float3> row_sum(terms_per_thread);
+        std::vector<float> ylm(num_terms);
+
+        for (int theta = row_begin; theta < row_end; ++theta)
         {
-            // Construct direction vector
-            float3 w = normalize(float3(sintheta[theta] * cosphi[phi], costheta[theta], sintheta[theta] * sinphi[phi]));
+            float3 const* row = envmap + static_cast<std::size_t>(width) * theta;
 
-            // Construct uv sample coordinates
-            float2 uv = float2((float)phi / width, (float)theta / height);
+            std::fill(row_sum.begin(), row_sum.end(), float3());
 
-            // Sample environment map
-            int iu = (int)floor(uv.x * width);
-            int iv = (int)floor(uv.y * height);
+            if (lmax <= 2)
+            {
+#ifdef SHPROJECT_USE_SSE
+                ProjectRowBand2Sse(row, width, sintheta[theta], costheta[theta], &sinphi[0], &cosphi[0], &row_sum[0]);
+#else
+                ProjectRowBand2(row, 0, width, sintheta[theta], costheta[theta], &sinphi[0], &cosphi[0], &row_sum[0]);
+#endif
+            }
+            else
+            {
+                for (int phi = 0; phi < width; ++phi)
+                {
+                    // Construct direction vector
+                    float3 w = float3(sintheta[theta] * cosphi[phi], costheta[theta], sintheta[theta] * sinphi[phi]);
 
-            float3 le = envmap[width * iv + iu];
+                    // Evaluate SH functions at w up to lmax band
+                    ShEvaluate(w, lmax, &ylm[0]);
 
-            // Evaluate SH functions at w up to lmax band
-            ShEvaluate(w, lmax, &ylm[0]);
+                    for (int i = 0; i < num_terms; ++i)
+                    {
+                        row_sum[i] += row[phi] * ylm[i];
+                    }
+                }
+            }
 
-            // Evaluate Riemann sum accouting for solid angle conversion (sin term)
-            for (int i = 0; i < NumShTerms(lmax); ++i)
+            // Riemann sum weight accouting for solid angle conversion (sin term)
+            float const weight = sintheta[theta] * texel_area;
+
+            for (int i = 0; i < num_terms; ++i)
             {
-                coeffs[i] += le * ylm[i] * sintheta[theta] * (PI / height) * (2.f * PI / width);
+                acc[i] += row_sum[i] * weight;
             }
         }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+
+    for (int i = 1; i < num_threads; ++i)
+    {
+        threads.push_back(std::thread(worker, i));
+    }
+
+    worker(0);
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // Reduce per-thread accumulators
+    for (int t = 0; t < num_threads; ++t)
+    {
+        for (int i = 0; i < num_terms; ++i)
+        {
+            coeffs[i] += partial[t * terms_per_thread + i];
+        }
     }
 }
 
@@ -0,0 +1,98 @@
+#include "sparse_grid.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace Baikal
+{
+    const int SparseGrid::kBrickSize;
+    const int SparseGrid::kBrickVoxels;
+
+    SparseGrid::SparseGrid()
+        : m_resx(0)
+        , m_resy(0)
+        , m_resz(0)
+        , m_bricksx(0)
+        , m_bricksy(0)
+        , m_bricksz(0)
+        , m_max_value(0.f)
+    {
+    }
+
+    SparseGrid::SparseGrid(float const* values, int resx, int resy, int resz)
+    {
+        Set(values, resx, resy, resz);
+    }
+
+    void SparseGrid::Set(float const* values, int resx, int resy, int resz)
+    {
+        assert(values);
+        assert(resx > 0 && resy > 0 && resz > 0);
+
+        m_resx = resx;
+        m_resy = resy;
+        m_resz = resz;
+
+        m_bricksx = (resx + kBrickSize - 1) / kBrickSize;
+        m_bricksy = (resy + kBrickSize - 1) / kBrickSize;
+        m_bricksz = (resz + kBrickSize - 1) / kBrickSize;
+
+        m_brick_indices.assign(m_bricksx * m_bricksy * m_bricksz, -1);
+        m_bricks.clear();
+        m_max_value = 0.f;
+
+        std::vector<float> brick(kBrickVoxels);
+
+        for (int bz = 0; bz < m_bricksz; ++bz)
+        for (int by = 0; by < m_bricksy; ++by)
+        for (int bx = 0; bx < m_bricksx; ++bx)
+        {
+            std::fill(brick.begin(), brick.end(), 0.f);
+
+            bool empty = true;
+
+            // Voxels outside of the grid are left zero
+            int maxz = std::min(kBrickSize, resz - bz * kBrickSize);
+            int maxy = std::min(kBrickSize, resy - by * kBrickSize);
+            int maxx = std::min(kBrickSize, resx - bx * kBrickSize);
+
+            for (int z = 0; z < maxz; ++z)
+            for (int y = 0; y < maxy; ++y)
+            for (int x = 0; x < maxx; ++x)
+            {
+                auto gx = bx * kBrickSize + x;
+                auto gy = by * kBrickSize + y;
+                auto gz = bz * kBrickSize + z;
+
+                auto value = std::max(values[(gz * resy + gy) * resx + gx], 0.f);
+
+                brick[(z * kBrickSize + y) * kBrickSize + x] = value;
+                empty = empty && value == 0.f;
+                m_max_value = std::max(m_max_value, value);
+            }
+
+            if (!empty)
+            {
+                m_brick_indices[(bz * m_bricksy + by) * m_bricksx + bx] = static_cast<int>(GetNumBricks());
+                m_bricks.insert(m_bricks.end(), brick.cbegin(), brick.cend());
+            }
+        }
+    }
+
+    float SparseGrid::GetValue(int x, int y, int z) const
+    {
+        assert(x >= 0 && x < m_resx);
+        assert(y >= 0 && y < m_resy);
+        assert(z >= 0 && z < m_resz);
+
+        auto brick = m_brick_indices[((z / kBrickSize) * m_bricksy + (y / kBrickSize)) * m_bricksx + (x / kBrickSize)];
+
+        if (brick < 0)
+        {
+            return 0.f;
+        }
+
+        auto voxel = ((z % kBrickSize) * kBrickSize + (y % kBrickSize)) * kBrickSize + (x % kBrickSize);
+        return m_bricks[brick * kBrickVoxels + voxel];
+    }
+}
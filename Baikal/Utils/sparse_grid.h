@@ -0,0 +1,86 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Baikal
+{
+    ///< The class represents sparse scalar grid stored as a brick map.
+    ///< Voxels are grouped into bricks of kBrickSize^3, bricks with zero
+    ///< values only are dropped and the rest are packed into a brick pool
+    ///< referenced from a coarse brick index table (-1 for empty bricks).
+    ///<
+    class SparseGrid
+    {
+    public:
+        // Should match VOLUME_BRICK_SIZE in volumetrics.cl
+        static const int kBrickSize = 8;
+        static const int kBrickVoxels = kBrickSize * kBrickSize * kBrickSize;
+
+        SparseGrid();
+        // values is dense x-major array of resx * resy * resz elements,
+        // negative values are clamped to zero
+        SparseGrid(float const* values, int resx, int resy, int resz);
+
+        void Set(float const* values, int resx, int resy, int resz);
+
+        // Voxel value (0 for voxels in empty bricks)
+        float GetValue(int x, int y, int z) const;
+
+        // Voxel resolution
+        int GetResX() const { return m_resx; }
+        int GetResY() const { return m_resy; }
+        int GetResZ() const { return m_resz; }
+
+        // Brick table resolution
+        int GetBricksX() const { return m_bricksx; }
+        int GetBricksY() const { return m_bricksy; }
+        int GetBricksZ() const { return m_bricksz; }
+
+        // Number of non-empty bricks
+        std::size_t GetNumBricks() const { return m_bricks.size() / kBrickVoxels; }
+
+        // Brick index table
+        std::vector<int> const& GetBrickIndices() const { return m_brick_indices; }
+        // Brick pool
+        std::vector<float> const& GetBricks() const { return m_bricks; }
+
+        // Maximum value over the grid
+        float GetMaxValue() const { return m_max_value; }
+
+    private:
+        int m_resx;
+        int m_resy;
+        int m_resz;
+
+        int m_bricksx;
+        int m_bricksy;
+        int m_bricksz;
+
+        std::vector<int> m_brick_indices;
+        std::vector<float> m_bricks;
+
+        float m_max_value;
+    };
+}
@@ -0,0 +1,140 @@
+#include "texture_atlas.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace Baikal
+{
+    using RadeonRays::int2;
+
+    // Apply wrap mode to integer texel coordinate, returns -1 outside of clamp to border texture.
+    // Should match Texture_WrapCoord in texture.cl.
+    static int WrapCoord(int x, int size, Texture::WrapMode wrap)
+    {
+        switch (wrap)
+        {
+            case Texture::WrapMode::kMirroredRepeat:
+            {
+                int period = 2 * size;
+                x %= period;
+                x = x < 0 ? x + period : x;
+                return x < size ? x : period - 1 - x;
+            }
+
+            case Texture::WrapMode::kClampToEdge:
+            {
+                return std::min(std::max(x, 0), size - 1);
+            }
+
+            case Texture::WrapMode::kClampToBorder:
+            {
+                return x >= 0 && x < size ? x : -1;
+            }
+
+            default:
+            {
+                x %= size;
+                return x < 0 ? x + size : x;
+            }
+        }
+    }
+
+    TextureAtlas::TextureAtlas(std::uint32_t max_width, std::uint32_t max_height)
+        : m_max_width(max_width)
+        , m_max_height(max_height)
+        , m_shelf_x(0)
+        , m_shelf_y(0)
+        , m_shelf_height(0)
+        , m_width(0)
+    {
+    }
+
+    bool TextureAtlas::Add(int2 size, int mip_count, int2& origin)
+    {
+        auto region = GetRegionSize(size, mip_count);
+        auto width = static_cast<std::uint32_t>(region.x);
+        auto height = static_cast<std::uint32_t>(region.y);
+
+        if (width > m_max_width)
+        {
+            return false;
+        }
+
+        // Start a new shelf once the current one is full
+        if (m_shelf_x + width > m_max_width)
+        {
+            m_shelf_y += m_shelf_height;
+            m_shelf_x = 0;
+            m_shelf_height = 0;
+        }
+
+        if (m_shelf_y + height > m_max_height)
+        {
+            return false;
+        }
+
+        origin = int2(static_cast<int>(m_shelf_x), static_cast<int>(m_shelf_y));
+
+        m_shelf_x += width;
+        m_shelf_height = std::max(m_shelf_height, height);
+        m_width = std::max(m_width, m_shelf_x);
+
+        return true;
+    }
+
+    int2 TextureAtlas::GetSize() const
+    {
+        return int2(static_cast<int>(m_width), static_cast<int>(m_shelf_y + m_shelf_height));
+    }
+
+    int2 TextureAtlas::GetRegionSize(int2 size, int mip_count)
+    {
+        int2 region(0, size.y + 2);
+
+        for (int level = 0; level < mip_count; ++level)
+        {
+            region.x += size.x + 2;
+            size.x = std::max(size.x / 2, 1);
+            size.y = std::max(size.y / 2, 1);
+        }
+
+        return region;
+    }
+
+    void TextureAtlas::WriteMipChain(std::uint8_t const* data, int2 size, int mip_count, Texture::WrapMode wrap,
+        int2 origin, std::uint8_t* atlas, std::uint32_t atlas_width)
+    {
+        assert(data && atlas);
+
+        for (int level = 0; level < mip_count; ++level)
+        {
+            // Border texels are fetched through the wrap mode, clamp to border ones are black
+            for (int y = -1; y <= size.y; ++y)
+            {
+                auto src_y = WrapCoord(y, size.y, wrap);
+                auto dst = atlas + 4 * (static_cast<std::size_t>(origin.y + 1 + y) * atlas_width + origin.x);
+
+                for (int x = -1; x <= size.x; ++x)
+                {
+                    auto src_x = WrapCoord(x, size.x, wrap);
+                    auto texel = dst + 4 * (1 + x);
+
+                    if (src_x < 0 || src_y < 0)
+                    {
+                        std::memset(texel, 0, 4);
+                    }
+                    else
+                    {
+                        std::memcpy(texel, data + 4 * (static_cast<std::size_t>(src_y) * size.x + src_x), 4);
+                    }
+                }
+            }
+
+            data += 4 * static_cast<std::size_t>(size.x) * size.y;
+            origin.x += size.x + 2;
+            size.x = std::max(size.x / 2, 1);
+            size.y = std::max(size.y / 2, 1);
+        }
+    }
+}
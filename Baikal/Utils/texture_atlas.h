@@ -0,0 +1,68 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "math/int2.h"
+#include "SceneGraph/texture.h"
+
+#include <cstdint>
+
+namespace Baikal
+{
+    ///< The class packs RGBA8 textures with their mip chains into a single 2D image,
+    ///< so the device can sample them through an image object with hardware bilinear filtering.
+    ///< Mip levels of a texture are placed left to right, each surrounded by one texel border
+    ///< holding the texels its wrap mode maps to, so filtering next to the edges matches
+    ///< Texture_SampleLevel in texture.cl. Regions are packed into shelves of decreasing height
+    ///< if textures are added sorted by height.
+    ///<
+    class TextureAtlas
+    {
+    public:
+        TextureAtlas(std::uint32_t max_width, std::uint32_t max_height);
+
+        // Reserve a region for the mip chain of given top level size, returns false if it does not fit.
+        // origin is the top left corner of the region including the border.
+        bool Add(RadeonRays::int2 size, int mip_count, RadeonRays::int2& origin);
+
+        // Size of the atlas covering all regions added so far
+        RadeonRays::int2 GetSize() const;
+
+        // Size of the region taken by a mip chain including the borders
+        static RadeonRays::int2 GetRegionSize(RadeonRays::int2 size, int mip_count);
+
+        // Copy RGBA8 mip chain (levels tightly packed after the top one) with borders to the region at origin.
+        // atlas is RGBA8 image data with atlas_width texels per row.
+        static void WriteMipChain(std::uint8_t const* data, RadeonRays::int2 size, int mip_count, Texture::WrapMode wrap,
+            RadeonRays::int2 origin, std::uint8_t* atlas, std::uint32_t atlas_width);
+
+    private:
+        std::uint32_t m_max_width;
+        std::uint32_t m_max_height;
+        // Current shelf
+        std::uint32_t m_shelf_x;
+        std::uint32_t m_shelf_y;
+        std::uint32_t m_shelf_height;
+        // Widest shelf so far
+        std::uint32_t m_width;
+    };
+}
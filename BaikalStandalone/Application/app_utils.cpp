@@ -165,6 +165,9 @@ namespace Baikal
         , height(512)
         , num_bounces(5)
         , num_samples(-1)
+        , sh_ibl_preview(false)
+        , path_guiding(false)
+        , ray_sorting(false)
         , interop(true)
         , cspeed(10.25f)
         , mode(ConfigManager::Mode::kUseSingleGpu)
@@ -45,6 +45,9 @@ namespace Baikal
         int height;
         int num_bounces;
         int num_samples;
+        bool sh_ibl_preview;
+        bool path_guiding;
+        bool ray_sorting;
         bool interop;
         float cspeed;
         ConfigManager::Mode mode;
@@ -418,6 +418,14 @@ namespace Baikal
             std::cout << "\tPrimary: " << m_settings.stats.primary_throughput * 1e-6f << " Mrays/s\n";
             std::cout << "\tSecondary: " << m_settings.stats.secondary_throughput * 1e-6f << " Mrays/s\n";
             std::cout << "\tShadow: " << m_settings.stats.shadow_throughput * 1e-6f << " Mrays/s\n";
+
+            auto& stats = m_settings.stats;
+            for (auto i = 0u; i < stats.bounce_throughput.size(); ++i)
+            {
+                std::cout << "\tBounce " << i + 1 << ": " << stats.bounce_throughput[i] * 1e-6f << " Mrays/s, sorted: "
+                    << stats.bounce_sorted_throughput[i] * 1e-6f << " Mrays/s (x" << stats.bounce_sorted_throughput[i] / stats.bounce_throughput[i] << "), shading: "
+                    << stats.bounce_shading_time[i] << " ms\n";
+            }
         }
     }
 
@@ -427,6 +435,9 @@ namespace Baikal
         static float focal_length = 35.f;
         static float focus_distance = 1.f;
         static int num_bounces = 5;
+        static bool sh_ibl_preview = false;
+        static bool path_guiding = false;
+        static bool ray_sorting = false;
         static char const* outputs =
             "Color\0"
             "World position\0"
@@ -461,6 +472,9 @@ namespace Baikal
             ImGui::Text("Number of instances: %d", m_num_instances);
             ImGui::Separator();
             ImGui::SliderInt("GI bounces", &num_bounces, 1, 10);
+            ImGui::Checkbox("SH diffuse IBL (preview)", &sh_ibl_preview);
+            ImGui::Checkbox("Path guiding", &path_guiding);
+            ImGui::Checkbox("Sort secondary rays", &ray_sorting);
             ImGui::SliderFloat("Aperture(mm)", &aperture, 0.0f, 100.0f);
             ImGui::SliderFloat("Focal length(mm)", &focal_length, 5.f, 200.0f);
             ImGui::SliderFloat("Focus distance(m)", &focus_distance, 0.05f, 20.f);
@@ -494,6 +508,27 @@ namespace Baikal
                 update = true;
             }
 
+            if (sh_ibl_preview != m_settings.sh_ibl_preview)
+            {
+                m_settings.sh_ibl_preview = sh_ibl_preview;
+                m_cl->SetShIblPreview(sh_ibl_preview);
+                update = true;
+            }
+
+            if (path_guiding != m_settings.path_guiding)
+            {
+                m_settings.path_guiding = path_guiding;
+                m_cl->SetPathGuiding(path_guiding);
+                update = true;
+            }
+
+            if (ray_sorting != m_settings.ray_sorting)
+            {
+                m_settings.ray_sorting = ray_sorting;
+                m_cl->SetRaySorting(ray_sorting);
+                update = true;
+            }
+
             auto gui_out_type = static_cast<Baikal::Renderer::OutputType>(output);
 
             if (gui_out_type != m_cl->GetOutputType())
@@ -566,6 +601,12 @@ namespace Baikal
                 ImGui::Text("Primary rays: %f Mrays/s", stats.primary_throughput * 1e-6f);
                 ImGui::Text("Secondary rays: %f Mrays/s", stats.secondary_throughput * 1e-6f);
                 ImGui::Text("Shadow rays: %f Mrays/s", stats.shadow_throughput * 1e-6f);
+
+                for (auto i = 0u; i < stats.bounce_throughput.size(); ++i)
+                {
+                    ImGui::Text("Bounce %u: %f Mrays/s, sorted: %f Mrays/s", i + 1,
+                        stats.bounce_throughput[i] * 1e-6f, stats.bounce_sorted_throughput[i] * 1e-6f);
+                }
             }
 
             ImGui::End();
@@ -29,10 +29,12 @@ THE SOFTWARE.
 #include "SceneGraph/material.h"
 #include "SceneGraph/IO/scene_io.h"
 #include "SceneGraph/IO/material_io.h"
+#include "SceneGraph/IO/volume_io.h"
 #include "SceneGraph/material.h"
 
 #include "Renderers/monte_carlo_renderer.h"
 #include "Renderers/adaptive_renderer.h"
+#include "Utils/half_convert.h"
 
 #include <fstream>
 #include <sstream>
@@ -182,6 +184,17 @@ namespace Baikal
 
                 material_io->ReplaceSceneMaterials(*m_scene, *mats, mapping);
             }
+
+            // Check if we have volumes attached to shapes
+            std::ifstream in_volumes(basepath + "volumes.xml");
+
+            if (in_volumes)
+            {
+                in_volumes.close();
+
+                auto volume_io = Baikal::VolumeIo::CreateVolumeIo();
+                volume_io->LoadSceneVolumes(*m_scene, basepath + "volumes.xml", basepath);
+            }
         }
 
         m_camera.reset(new Baikal::PerspectiveCamera(
@@ -409,10 +422,22 @@ namespace Baikal
             throw std::runtime_error("Can't create image file on disk");
         }
 
-        ImageSpec spec(width, height, 3, TypeDesc::FLOAT);
+        // Tonemapped output fits half precision, store it that way to halve file size
+        std::vector<float> rgb(3 * width * height);
+        for (auto i = 0; i < width * height; ++i)
+        {
+            rgb[3 * i] = tempbuf[i].x;
+            rgb[3 * i + 1] = tempbuf[i].y;
+            rgb[3 * i + 2] = tempbuf[i].z;
+        }
+
+        std::vector<std::uint16_t> halfbuf(rgb.size());
+        Baikal::FloatToHalf(&rgb[0], &halfbuf[0], rgb.size());
+
+        ImageSpec spec(width, height, 3, TypeDesc::HALF);
 
         out->open(name, spec);
-        out->write_image(TypeDesc::FLOAT, &tempbuf[0], sizeof(float3));
+        out->write_image(TypeDesc::HALF, &halfbuf[0]);
         out->close();
     }
 
@@ -534,6 +559,32 @@ namespace Baikal
         }
     }
 
+    void AppClRender::SetShIblPreview(bool enable)
+    {
+        auto quality = enable ? Estimator::QualityLevel::kRough : Estimator::QualityLevel::kStandard;
+
+        for (int i = 0; i < m_cfgs.size(); ++i)
+        {
+            static_cast<Baikal::MonteCarloRenderer*>(m_cfgs[i].renderer.get())->SetQualityLevel(quality);
+        }
+    }
+
+    void AppClRender::SetPathGuiding(bool enable)
+    {
+        for (int i = 0; i < m_cfgs.size(); ++i)
+        {
+            static_cast<Baikal::MonteCarloRenderer*>(m_cfgs[i].renderer.get())->SetPathGuiding(enable);
+        }
+    }
+
+    void AppClRender::SetRaySorting(bool enable)
+    {
+        for (int i = 0; i < m_cfgs.size(); ++i)
+        {
+            static_cast<Baikal::MonteCarloRenderer*>(m_cfgs[i].renderer.get())->SetRaySorting(enable);
+        }
+    }
+
     void AppClRender::SetOutputType(Renderer::OutputType type)
     {
         for (int i = 0; i < m_cfgs.size(); ++i)
@@ -91,6 +91,9 @@ namespace Baikal
         Renderer::OutputType GetOutputType() { return m_output_type; };
 
         void SetNumBounces(int num_bounces);
+        void SetShIblPreview(bool enable);
+        void SetPathGuiding(bool enable);
+        void SetRaySorting(bool enable);
         void SetOutputType(Renderer::OutputType type);
     private:
         void InitCl(AppSettings& settings, GLuint tex);
@@ -77,9 +77,9 @@ public:
 
         auto platform = platforms[platform_index];
         auto device = platform.GetDevice(device_index);
-        auto context = CLWContext::Create(device);
+        m_context = CLWContext::Create(device);
 
-        ASSERT_NO_THROW(m_factory = std::make_unique<Baikal::ClwRenderFactory>(context));
+        ASSERT_NO_THROW(m_factory = std::make_unique<Baikal::ClwRenderFactory>(m_context));
         ASSERT_NO_THROW(m_renderer = m_factory->CreateRenderer(Baikal::ClwRenderFactory::RendererType::kUnidirectionalPathTracer));
         ASSERT_NO_THROW(m_controller = m_factory->CreateSceneController());
         ASSERT_NO_THROW(m_output = m_factory->CreateOutput(kOutputWidth, kOutputHeight));
@@ -235,6 +235,7 @@ public:
         return std::find(begin, end, option) != end;
     }
 
+    CLWContext m_context;
     std::unique_ptr<Baikal::Renderer> m_renderer;
     std::unique_ptr<Baikal::SceneController<Baikal::ClwScene>> m_controller;
     std::unique_ptr<Baikal::RenderFactory<Baikal::ClwScene>> m_factory;
@@ -135,3 +135,51 @@ TEST_F(CameraTest, Camera_FocusDistance)
         ASSERT_TRUE(CompareToReference(oss.str()));
     }
 }
+
+TEST_F(CameraTest, Camera_Spherical)
+{
+    ClearOutput();
+    m_camera->SetProjection(Baikal::PerspectiveCamera::Projection::kSpherical);
+
+    ASSERT_NO_THROW(m_controller->CompileScene(*m_scene));
+
+    auto& scene = m_controller->GetCachedScene(*m_scene);
+
+    for (auto i = 0u; i < kNumIterations; ++i)
+    {
+        ASSERT_NO_THROW(m_renderer->Render(scene));
+    }
+
+    std::ostringstream oss;
+    oss << test_name() << ".png";
+    SaveOutput(oss.str());
+    ASSERT_TRUE(CompareToReference(oss.str()));
+}
+
+TEST_F(CameraTest, Camera_Fisheye)
+{
+    // Sensor half size of 0.018 maps to 3, 1.5 and 1 radians off the axis
+    std::vector<float> values = { 0.006f, 0.012f, 0.018f };
+
+    m_camera->SetProjection(Baikal::PerspectiveCamera::Projection::kFisheye);
+
+    for (auto v : values)
+    {
+        ClearOutput();
+        m_camera->SetFocalLength(v);
+
+        ASSERT_NO_THROW(m_controller->CompileScene(*m_scene));
+
+        auto& scene = m_controller->GetCachedScene(*m_scene);
+
+        for (auto i = 0u; i < kNumIterations; ++i)
+        {
+            ASSERT_NO_THROW(m_renderer->Render(scene));
+        }
+
+        std::ostringstream oss;
+        oss << test_name() << v << ".png";
+        SaveOutput(oss.str());
+        ASSERT_TRUE(CompareToReference(oss.str()));
+    }
+}
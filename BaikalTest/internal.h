@@ -22,8 +22,33 @@ THE SOFTWARE.
 #include "gtest/gtest.h"
 
 #include "Baikal/Utils/distribution1d.h"
+#include "Baikal/Utils/distribution2d.h"
+#include "Baikal/Utils/shproject.h"
+#include "Baikal/Utils/sh.h"
+#include "Baikal/Utils/sparse_grid.h"
+#include "Baikal/Utils/bxdf_lut.h"
+#include "Baikal/Utils/half.h"
+#include "Baikal/Utils/half_convert.h"
+#include "Baikal/Utils/texture_atlas.h"
+#include "Baikal/Utils/path_guiding.h"
+#include "Baikal/SceneGraph/texture.h"
+#include "Baikal/SceneGraph/shape.h"
+#include "Baikal/SceneGraph/scene1.h"
+#include "Baikal/SceneGraph/volume.h"
+#include "Baikal/SceneGraph/IO/volume_io.h"
+#include "Baikal/SceneGraph/material.h"
+#include "Baikal/SceneGraph/iterator.h"
+#include "Baikal/SceneGraph/Collector/collector.h"
+#include "Baikal/Controllers/clw_scene_controller.h"
 #include "math/mathutils.h"
 
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
 class InternalTest : public ::testing::Test
 {
 
@@ -46,4 +71,1054 @@ TEST_F(InternalTest, Distribuiton1D)
     }
 
     cnts[0] += cnts[1];
-}
\ No newline at end of file
+}
+
+TEST_F(InternalTest, Distribution1DAliasTable)
+{
+    float vals[] = { 1, 0, 3, 4, 2, 0.5f, 7, 2.5f };
+    std::uint32_t const num_segments = 8;
+    float const sum = 20.f;
+    Baikal::Distribution1D dist(vals, num_segments);
+
+    // Alias table reproduces segment probabilities exactly
+    std::vector<float> probabilities(num_segments, 0.f);
+    for (auto i = 0u; i < num_segments; ++i)
+    {
+        probabilities[i] += dist.m_alias_probability[i] / num_segments;
+        probabilities[dist.m_alias[i]] += (1.f - dist.m_alias_probability[i]) / num_segments;
+    }
+
+    for (auto i = 0u; i < num_segments; ++i)
+    {
+        ASSERT_NEAR(probabilities[i], vals[i] / sum, 1e-5f);
+    }
+
+    // Stratified samples hit segments in proportion to their values
+    int const num_samples = 80000;
+    std::vector<int> counts(num_segments, 0);
+    float previous = 0.f;
+    for (auto i = 0; i < num_samples; ++i)
+    {
+        float u = (i + 0.5f) / num_samples;
+
+        float pdf = 0.f;
+        auto segment = dist.SampleDiscrete(u, pdf);
+        ASSERT_LT(segment, num_segments);
+        ASSERT_NEAR(pdf, vals[segment] / sum, 1e-5f);
+        ++counts[segment];
+
+        // Continuous samples invert CDF, so they are monotonic and never land in empty segments
+        float v = dist.Sample1D(u, pdf);
+        auto v_segment = std::min(static_cast<std::uint32_t>(v * num_segments), num_segments - 1);
+        ASSERT_GE(v, previous);
+        ASSERT_GT(vals[v_segment], 0.f);
+        ASSERT_NEAR(pdf, vals[v_segment] / sum * num_segments, 1e-4f);
+        ASSERT_NEAR(dist.m_cdf[v_segment] + (v * num_segments - v_segment) * vals[v_segment] / sum, u, 1e-4f);
+        previous = v;
+    }
+
+    // Zero sample skips leading empty segments
+    float const leading_zeros[] = { 0.f, 0.f, 1.f, 1.f };
+    Baikal::Distribution1D skip(leading_zeros, 4);
+    float skip_pdf = 0.f;
+    ASSERT_FLOAT_EQ(skip.Sample1D(0.f, skip_pdf), 0.5f);
+    ASSERT_FLOAT_EQ(skip_pdf, 2.f);
+
+    for (auto i = 0u; i < num_segments; ++i)
+    {
+        ASSERT_NEAR(static_cast<float>(counts[i]) / num_samples, vals[i] / sum, 1e-3f);
+    }
+
+    // Device layout
+    std::vector<int> data(dist.GetSerializedSize());
+    dist.Serialize(&data[0]);
+
+    ASSERT_EQ(data.size(), 1 + (num_segments + 1) + 3 * num_segments);
+    ASSERT_EQ(data[0], static_cast<int>(num_segments));
+
+    auto values = reinterpret_cast<float const*>(&data[1]);
+    ASSERT_FLOAT_EQ(values[num_segments], 1.f);
+    ASSERT_FLOAT_EQ(values[num_segments + 1 + 3], vals[3] / sum * num_segments);
+
+    auto alias_probability = values + 2 * num_segments + 1;
+    auto alias = reinterpret_cast<int const*>(alias_probability + num_segments);
+    for (auto i = 0u; i < num_segments; ++i)
+    {
+        ASSERT_EQ(alias_probability[i], dist.m_alias_probability[i]);
+        ASSERT_EQ(alias[i], static_cast<int>(dist.m_alias[i]));
+    }
+}
+
+TEST_F(InternalTest, Distribution2D)
+{
+    std::uint32_t const width = 5;
+    std::uint32_t const height = 3;
+    float vals[] =
+    {
+        1, 2, 0, 4, 1,
+        0, 0, 0, 0, 0,
+        3, 1, 2, 0, 6
+    };
+    float const sum = 20.f;
+
+    Baikal::Distribution2D dist(vals, width, height);
+    Baikal::HierarchicalDistribution2D hdist(vals, width, height);
+
+    ASSERT_FLOAT_EQ(dist.GetIntegral(), sum / (width * height));
+    ASSERT_EQ(hdist.GetNumLevels(), 4u);
+
+    // Exact pdf at texel centers
+    for (auto y = 0u; y < height; ++y)
+    {
+        for (auto x = 0u; x < width; ++x)
+        {
+            RadeonRays::float2 uv((x + 0.5f) / width, (y + 0.5f) / height);
+            float expected = vals[y * width + x] * width * height / sum;
+            ASSERT_NEAR(dist.GetPdf(uv), expected, 1e-5f);
+            ASSERT_NEAR(hdist.GetPdf(uv), expected, 1e-5f);
+        }
+    }
+
+    // Stratified samples hit texels in proportion to their values
+    int const num_strata = 300;
+    std::vector<int> counts(width * height, 0);
+    std::vector<int> hcounts(width * height, 0);
+
+    for (auto i = 0; i < num_strata; ++i)
+    {
+        for (auto j = 0; j < num_strata; ++j)
+        {
+            RadeonRays::float2 u((j + 0.5f) / num_strata, (i + 0.5f) / num_strata);
+
+            float pdf = 0.f;
+            auto uv = dist.Sample2D(u, pdf);
+            auto x = std::min(static_cast<std::uint32_t>(uv.x * width), width - 1);
+            auto y = std::min(static_cast<std::uint32_t>(uv.y * height), height - 1);
+            ASSERT_GT(vals[y * width + x], 0.f);
+            ASSERT_NEAR(pdf, dist.GetPdf(uv), 1e-4f);
+            ++counts[y * width + x];
+
+            uv = hdist.Sample2D(u, pdf);
+            x = std::min(static_cast<std::uint32_t>(uv.x * width), width - 1);
+            y = std::min(static_cast<std::uint32_t>(uv.y * height), height - 1);
+            ASSERT_GT(vals[y * width + x], 0.f);
+            ASSERT_NEAR(pdf, hdist.GetPdf(uv), 1e-4f);
+            ++hcounts[y * width + x];
+        }
+    }
+
+    for (auto i = 0u; i < width * height; ++i)
+    {
+        ASSERT_NEAR(static_cast<float>(counts[i]) / (num_strata * num_strata), vals[i] / sum, 2e-3f);
+        ASSERT_NEAR(static_cast<float>(hcounts[i]) / (num_strata * num_strata), vals[i] / sum, 2e-3f);
+    }
+
+    // Device layout: width, height, marginal, conditionals
+    std::vector<int> data(dist.GetSerializedSize());
+    dist.Serialize(&data[0]);
+
+    ASSERT_EQ(data.size(), 2 + (4 * height + 2) + height * (4 * width + 2));
+    ASSERT_EQ(data[0], static_cast<int>(width));
+    ASSERT_EQ(data[1], static_cast<int>(height));
+    ASSERT_EQ(data[2], static_cast<int>(height));
+
+    auto row_pdf = reinterpret_cast<float const*>(&data[3]) + height + 1;
+    ASSERT_NEAR(row_pdf[2], 12.f / sum * height, 1e-5f);
+
+    auto conditional = &data[2 + 4 * height + 2 + 2 * (4 * width + 2)];
+    ASSERT_EQ(conditional[0], static_cast<int>(width));
+    auto column_pdf = reinterpret_cast<float const*>(&conditional[1]) + width + 1;
+    ASSERT_NEAR(column_pdf[4], 6.f / 12.f * width, 1e-5f);
+}
+
+TEST_F(InternalTest, Distribution2DLarge)
+{
+    // Large enough to be built by several threads
+    std::uint32_t const width = 512;
+    std::uint32_t const height = 256;
+
+    std::vector<float> vals(width * height);
+    double sum = 0.0;
+    for (auto i = 0u; i < width * height; ++i)
+    {
+        vals[i] = static_cast<float>((i * 7919u) % 101u);
+        sum += vals[i];
+    }
+
+    Baikal::Distribution2D dist(&vals[0], width, height);
+    Baikal::HierarchicalDistribution2D hdist(&vals[0], width, height);
+
+    for (auto i = 0u; i < width * height; i += 97)
+    {
+        RadeonRays::float2 uv((i % width + 0.5f) / width, (i / width + 0.5f) / height);
+        float expected = static_cast<float>(vals[i] * width * height / sum);
+        ASSERT_NEAR(dist.GetPdf(uv), expected, 1e-3f * expected + 1e-6f);
+        ASSERT_NEAR(hdist.GetPdf(uv), expected, 1e-3f * expected + 1e-6f);
+    }
+
+    // Hierarchical warp of a constant function is identity, so stratification is kept
+    std::vector<float> ones(64 * 64, 1.f);
+    Baikal::HierarchicalDistribution2D constant(&ones[0], 64, 64);
+
+    for (auto i = 0; i < 1000; ++i)
+    {
+        RadeonRays::float2 u(RadeonRays::rand_float(), RadeonRays::rand_float());
+
+        float pdf = 0.f;
+        auto uv = constant.Sample2D(u, pdf);
+
+        ASSERT_NEAR(uv.x, u.x, 1e-5f);
+        ASSERT_NEAR(uv.y, u.y, 1e-5f);
+        ASSERT_FLOAT_EQ(pdf, 1.f);
+    }
+}
+
+TEST_F(InternalTest, Distribution2DEmptyRows)
+{
+    // Tall map where every other row is empty, rows are small enough for v * height to round across them
+    std::uint32_t const width = 64;
+    std::uint32_t const height = 4096;
+
+    std::vector<float> vals(width * height, 0.f);
+    for (auto y = 0u; y < height; y += 2)
+    {
+        std::fill(vals.begin() + y * width, vals.begin() + (y + 1) * width, 1.f);
+    }
+
+    Baikal::Distribution2D dist(&vals[0], width, height);
+    Baikal::HierarchicalDistribution2D hdist(&vals[0], width, height);
+
+    // Sweep the whole range of u.y including the ends of non-empty rows in the marginal CDF
+    auto const num_samples = 4 * height;
+    for (auto i = 0u; i <= num_samples; ++i)
+    {
+        RadeonRays::float2 u(0.5f, static_cast<float>(i) / num_samples);
+
+        float pdf = 0.f;
+        auto uv = dist.Sample2D(u, pdf);
+
+        // Half of the area has zero density, so all valid samples have pdf of 2
+        ASSERT_FLOAT_EQ(pdf, 2.f);
+        ASSERT_GE(uv.y, 0.f);
+        ASSERT_LE(uv.y, 1.f);
+
+        uv = hdist.Sample2D(u, pdf);
+
+        ASSERT_FLOAT_EQ(pdf, 2.f);
+        ASSERT_GE(uv.y, 0.f);
+        ASSERT_LE(uv.y, 1.f);
+    }
+}
+
+TEST_F(InternalTest, ShProjectEnvironmentMap)
+{
+    // Lat-long map: L(w) = 1 + w.y
+    int const width = 512;
+    int const height = 256;
+    int const lmax = 2;
+
+    std::vector<RadeonRays::float3> envmap(width * height);
+    for (int y = 0; y < height; ++y)
+    {
+        float costheta = std::cos(PI * (y + 0.5f) / height);
+        for (int x = 0; x < width; ++x)
+        {
+            envmap[y * width + x] = RadeonRays::float3(1.f, 1.f + costheta, 1.f - costheta);
+        }
+    }
+
+    std::vector<RadeonRays::float3> coeffs(NumShTerms(lmax));
+
+    ShProjectEnvironmentMap(&envmap[0], width, height, lmax, &coeffs[0]);
+
+    // Constant term integrates to 4pi * Y00, linear term projects onto Y1-1 = -K * y only
+    float const c0 = 4.f * PI * 0.2820948f;
+    float const c1 = -0.4886025f * 4.f * PI / 3.f;
+
+    ASSERT_NEAR(coeffs[0].x, c0, 1e-2f);
+    ASSERT_NEAR(coeffs[0].y, c0, 1e-2f);
+    ASSERT_NEAR(coeffs[0].z, c0, 1e-2f);
+    ASSERT_NEAR(coeffs[1].x, 0.f, 1e-2f);
+    ASSERT_NEAR(coeffs[1].y, c1, 1e-2f);
+    ASSERT_NEAR(coeffs[1].z, -c1, 1e-2f);
+
+    for (int i = 2; i < NumShTerms(lmax); ++i)
+    {
+        ASSERT_NEAR(coeffs[i].x, 0.f, 1e-2f);
+        ASSERT_NEAR(coeffs[i].y, 0.f, 1e-2f);
+        ASSERT_NEAR(coeffs[i].z, 0.f, 1e-2f);
+    }
+}
+
+TEST_F(InternalTest, SparseGrid)
+{
+    using Baikal::SparseGrid;
+
+    // Ball of density in a corner of a grid not divisible by brick size,
+    // only the corner brick and its 3 face neighbours intersect it
+    int const resx = 37;
+    int const resy = 21;
+    int const resz = 29;
+
+    std::vector<float> density(resx * resy * resz);
+    for (int z = 0; z < resz; ++z)
+        for (int y = 0; y < resy; ++y)
+            for (int x = 0; x < resx; ++x)
+            {
+                float d2 = float(x * x + y * y + z * z);
+                density[(z * resy + y) * resx + x] = d2 < 100.f ? 1.f - d2 / 100.f : 0.f;
+            }
+
+    SparseGrid grid(&density[0], resx, resy, resz);
+
+    ASSERT_EQ(grid.GetBricksX(), 5);
+    ASSERT_EQ(grid.GetBricksY(), 3);
+    ASSERT_EQ(grid.GetBricksZ(), 4);
+    ASSERT_EQ(grid.GetBrickIndices().size(), 5u * 3u * 4u);
+    ASSERT_EQ(grid.GetBricks().size(), grid.GetNumBricks() * SparseGrid::kBrickVoxels);
+    ASSERT_EQ(grid.GetNumBricks(), 4u);
+    ASSERT_FLOAT_EQ(grid.GetMaxValue(), 1.f);
+
+    for (int z = 0; z < resz; ++z)
+        for (int y = 0; y < resy; ++y)
+            for (int x = 0; x < resx; ++x)
+            {
+                ASSERT_EQ(grid.GetValue(x, y, z), density[(z * resy + y) * resx + x]);
+            }
+}
+
+TEST_F(InternalTest, VolumeIo)
+{
+    using namespace Baikal;
+    using RadeonRays::float3;
+
+    int const res[3] = { 9, 10, 11 };
+    float const bounds[6] = { -1.f, -2.f, -3.f, 1.f, 2.f, 3.f };
+    std::int32_t const encoding = 1;
+    std::int32_t const channels = 2;
+
+    // Two channels, only the first one is density
+    std::vector<float> data(res[0] * res[1] * res[2] * channels);
+    for (std::size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = (i % channels) ? -1.f : ((i / channels) % 7 ? 0.f : float(i % 5));
+    }
+
+    {
+        std::ofstream out("volume_test.vol", std::ios::out | std::ios::binary);
+        out.write("VOL\x03", 4);
+        out.write(reinterpret_cast<char const*>(&encoding), sizeof(encoding));
+        out.write(reinterpret_cast<char const*>(res), sizeof(res));
+        out.write(reinterpret_cast<char const*>(&channels), sizeof(channels));
+        out.write(reinterpret_cast<char const*>(bounds), sizeof(bounds));
+        out.write(reinterpret_cast<char const*>(data.data()), data.size() * sizeof(float));
+    }
+
+    {
+        std::ofstream out("volume_test.xml");
+        out << "<Volume shape=\"smoke\" file=\"volume_test.vol\" absorption=\"0.5 0.25 0.125\" scattering=\"1 2 3\"/>\n";
+        out << "<Volume shape=\"fog\" scattering=\"0.1 0.1 0.1\"/>\n";
+    }
+
+    auto volume_io = VolumeIo::CreateVolumeIo();
+    std::unique_ptr<GridVolume> volume(volume_io->LoadVolume("volume_test.vol"));
+
+    auto const& grid = volume->GetGrid();
+    ASSERT_EQ(grid.GetResX(), res[0]);
+    ASSERT_EQ(grid.GetResY(), res[1]);
+    ASSERT_EQ(grid.GetResZ(), res[2]);
+    ASSERT_FLOAT_EQ(volume->GetBounds().pmin.y, -2.f);
+    ASSERT_FLOAT_EQ(volume->GetBounds().pmax.z, 3.f);
+
+    for (int z = 0; z < res[2]; ++z)
+        for (int y = 0; y < res[1]; ++y)
+            for (int x = 0; x < res[0]; ++x)
+            {
+                ASSERT_EQ(grid.GetValue(x, y, z), data[((z * res[1] + y) * res[0] + x) * channels]);
+            }
+
+    float3 vertices[] = { float3(0.f, 0.f, 0.f), float3(1.f, 0.f, 0.f), float3(0.f, 1.f, 1.f) };
+    std::uint32_t indices[] = { 0, 1, 2 };
+
+    Mesh smoke;
+    smoke.SetVertices(vertices, 3);
+    smoke.SetIndices(indices, 3);
+    smoke.SetName("smoke");
+
+    Mesh fog;
+    fog.SetVertices(vertices, 3);
+    fog.SetIndices(indices, 3);
+    fog.SetName("fog");
+
+    Mesh empty;
+    empty.SetVertices(vertices, 3);
+    empty.SetIndices(indices, 3);
+
+    Scene1 scene;
+    scene.AttachShape(&smoke);
+    scene.AttachShape(&fog);
+    scene.AttachShape(&empty);
+
+    volume_io->LoadSceneVolumes(scene, "volume_test.xml", "");
+
+    std::remove("volume_test.vol");
+    std::remove("volume_test.xml");
+
+    auto smoke_volume = dynamic_cast<GridVolume const*>(smoke.GetVolume());
+    ASSERT_NE(smoke_volume, nullptr);
+    ASSERT_EQ(smoke_volume->GetGrid().GetNumBricks(), grid.GetNumBricks());
+    ASSERT_FLOAT_EQ(smoke_volume->GetAbsorption().y, 0.25f);
+    ASSERT_FLOAT_EQ(smoke_volume->GetScattering().z, 3.f);
+
+    ASSERT_NE(dynamic_cast<HomogeneousVolume const*>(fog.GetVolume()), nullptr);
+    ASSERT_FLOAT_EQ(fog.GetVolume()->GetScattering().x, 0.1f);
+    ASSERT_EQ(empty.GetVolume(), nullptr);
+}
+
+TEST_F(InternalTest, BxdfLut)
+{
+    using namespace Baikal;
+
+    auto const& lut = GetBxdfLut();
+
+    ASSERT_EQ(lut.size(), std::size_t(kBxdfLutSize * kBxdfLutSize * (kBxdfLutEtaSize + 1)));
+
+    // Smooth microfacet surface reflects all energy
+    for (int i = 0; i < kBxdfLutSize; ++i)
+    {
+        ASSERT_NEAR(lut[BxdfLutIndex2D(i, 0)].x, 1.f, 1e-2f);
+        ASSERT_NEAR(lut[BxdfLutIndex2D(i, 0)].y, 1.f, 1e-2f);
+    }
+
+    // Single scattering albedo decreases with roughness
+    for (int i = 1; i < kBxdfLutSize; ++i)
+    {
+        ASSERT_LE(lut[BxdfLutIndex2D(kBxdfLutSize - 1, i)].x, lut[BxdfLutIndex2D(kBxdfLutSize - 1, i - 1)].x + 1e-3f);
+        ASSERT_LE(lut[BxdfLutIndex2D(kBxdfLutSize - 1, i)].z, 1.f);
+    }
+
+    // Smooth dielectric at normal incidence: F = ((eta - 1) / (eta + 1))^2
+    auto const& smooth = lut[BxdfLutIndex3D(kBxdfLutSize - 1, 0, kBxdfLutEtaSize - 1)];
+    float f0 = (kBxdfLutMaxEta - 1.f) / (kBxdfLutMaxEta + 1.f);
+    ASSERT_NEAR(smooth.x, f0 * f0, 1e-2f);
+    ASSERT_NEAR(smooth.z, f0 * f0, 1e-2f);
+    ASSERT_NEAR(smooth.y, 1.f, 1e-2f);
+    ASSERT_NEAR(smooth.w, 1.f, 1e-2f);
+}
+
+TEST_F(InternalTest, CompileMaterial)
+{
+    using namespace Baikal;
+
+    auto roughness_data = new char[4 * 4];
+    std::memset(roughness_data, 0x80, 4 * 4);
+    Texture roughness_map(roughness_data, RadeonRays::int2(2, 2), Texture::Format::kRgba8);
+
+    SingleBxdf textured_top(SingleBxdf::BxdfType::kMicrofacetGGX);
+    textured_top.SetInputValue("roughness", &roughness_map);
+    SingleBxdf constant_top(SingleBxdf::BxdfType::kMicrofacetBeckmann);
+    constant_top.SetInputValue("roughness", RadeonRays::float4(0.3f, 0.3f, 0.3f, 0.3f));
+    SingleBxdf base(SingleBxdf::BxdfType::kLambert);
+
+    MultiBxdf textured_blend(MultiBxdf::Type::kFresnelBlend);
+    textured_blend.SetInputValue("top_material", &textured_top);
+    textured_blend.SetInputValue("base_material", &base);
+    textured_blend.SetInputValue("ior", RadeonRays::float4(1.5f, 1.5f, 1.5f, 1.5f));
+
+    MultiBxdf constant_blend(MultiBxdf::Type::kFresnelBlend);
+    constant_blend.SetInputValue("top_material", &constant_top);
+    constant_blend.SetInputValue("base_material", &base);
+    constant_blend.SetInputValue("ior", RadeonRays::float4(1.33f, 1.33f, 1.33f, 1.33f));
+
+    MultiBxdf textured_mix(MultiBxdf::Type::kMix);
+    textured_mix.SetInputValue("top_material", &textured_blend);
+    textured_mix.SetInputValue("base_material", &constant_blend);
+    textured_mix.SetInputValue("weight", &roughness_map);
+
+    MultiBxdf constant_mix(MultiBxdf::Type::kMix);
+    constant_mix.SetInputValue("top_material", &textured_blend);
+    constant_mix.SetInputValue("base_material", &base);
+    constant_mix.SetInputValue("weight", RadeonRays::float4(0.25f, 0.25f, 0.25f, 0.25f));
+
+    // Every material gets its own record
+    std::vector<Material const*> materials =
+    {
+        &textured_top, &constant_top, &base, &textured_blend, &constant_blend, &textured_mix, &constant_mix
+    };
+    std::vector<Texture const*> textures = { &roughness_map };
+
+    Collector mat_collector;
+    ContainerIterator<std::vector<Material const*>> mat_iter(std::move(materials));
+    mat_collector.Collect(mat_iter, [](void const* item) { return std::set<void const*>{ item }; });
+    mat_collector.Commit();
+
+    Collector tex_collector;
+    ContainerIterator<std::vector<Texture const*>> tex_iter(std::move(textures));
+    tex_collector.Collect(tex_iter, [](void const* item) { return std::set<void const*>{ item }; });
+    tex_collector.Commit();
+
+    std::vector<int> slots(mat_collector.GetNumItems());
+    for (std::size_t i = 0; i < slots.size(); ++i)
+    {
+        slots[i] = static_cast<int>(i);
+    }
+
+    auto slot = [&](Material const* material) { return slots[mat_collector.GetItemIndex(material)]; };
+
+    // Textured mix: top branch follows the op, base one is referenced by offset
+    {
+        std::vector<ClwScene::MaterialOp> ops;
+        ClwSceneController::CompileMaterial(&textured_mix, mat_collector, tex_collector, slots, ops);
+
+        ASSERT_EQ(ops.size(), 7u);
+        ASSERT_EQ(ops[0].type, ClwScene::kMaterialOpMix);
+        ASSERT_EQ(ops[0].arg, 4);
+        ASSERT_EQ(ops[0].weight_map_idx, static_cast<int>(tex_collector.GetItemIndex(&roughness_map)));
+
+        // Textured roughness is sampled from the top record following the op
+        ASSERT_EQ(ops[1].type, ClwScene::kMaterialOpFresnelBlend);
+        ASSERT_EQ(ops[1].arg, 2);
+        ASSERT_FLOAT_EQ(ops[1].weight, 1.5f);
+        ASSERT_LT(ops[1].roughness, 0.f);
+        ASSERT_EQ(ops[2].type, ClwScene::kMaterialOpBxdf);
+        ASSERT_EQ(ops[2].arg, slot(&textured_top));
+        ASSERT_EQ(ops[3].type, ClwScene::kMaterialOpBxdf);
+        ASSERT_EQ(ops[3].arg, slot(&base));
+
+        ASSERT_EQ(ops[4].type, ClwScene::kMaterialOpFresnelBlendBeckmann);
+        ASSERT_EQ(ops[4].arg, 2);
+        ASSERT_FLOAT_EQ(ops[4].weight, 1.33f);
+        ASSERT_FLOAT_EQ(ops[4].roughness, 0.3f);
+        ASSERT_EQ(ops[5].arg, slot(&constant_top));
+        ASSERT_EQ(ops[6].arg, slot(&base));
+    }
+
+    // Constant mix is folded into a select with cumulative probabilities
+    {
+        std::vector<ClwScene::MaterialOp> ops;
+        ClwSceneController::CompileMaterial(&constant_mix, mat_collector, tex_collector, slots, ops);
+
+        ASSERT_EQ(ops.size(), 6u);
+        ASSERT_EQ(ops[0].type, ClwScene::kMaterialOpSelect);
+        ASSERT_EQ(ops[0].arg, 2);
+
+        ASSERT_EQ(ops[1].type, ClwScene::kMaterialOpJump);
+        ASSERT_FLOAT_EQ(ops[1].weight, 0.25f);
+        ASSERT_EQ(1 + ops[1].arg, 3);
+        ASSERT_EQ(ops[3].type, ClwScene::kMaterialOpFresnelBlend);
+
+        ASSERT_EQ(ops[2].type, ClwScene::kMaterialOpBxdf);
+        ASSERT_FLOAT_EQ(ops[2].weight, 1.f);
+        ASSERT_EQ(ops[2].arg, slot(&base));
+    }
+}
+
+TEST_F(InternalTest, BumpToNormalMap)
+{
+    using namespace Baikal;
+
+    // Height grows along x: 0, 1, 2, 3 in every row
+    int const width = 4;
+    int const height = 3;
+    std::vector<float> heights(4 * width * height);
+    for (int i = 0; i < width * height; ++i)
+    {
+        std::fill(heights.begin() + 4 * i, heights.begin() + 4 * i + 4, static_cast<float>(i % width));
+    }
+
+    auto data = new char[heights.size() * sizeof(float)];
+    std::memcpy(data, heights.data(), heights.size() * sizeof(float));
+    Texture bump(data, RadeonRays::int2(width, height), Texture::Format::kRgba32);
+
+    // Float heights are converted to half normals
+    std::vector<std::uint16_t> normals(4 * width * height);
+    ClwSceneController::ConvertBumpToNormalMap(&bump, reinterpret_cast<char*>(normals.data()));
+
+    std::vector<float> decoded(normals.size());
+    HalfToFloat(normals.data(), decoded.data(), decoded.size());
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            // Sobel gradient: 8 inside, 4 at the clamped borders
+            float gx = (x == 0 || x == width - 1) ? -4.f : -8.f;
+            float len = std::sqrt(gx * gx + 1.f);
+            auto texel = &decoded[4 * (y * width + x)];
+
+            ASSERT_NEAR(texel[0], 0.5f * gx / len + 0.5f, 1e-3f);
+            ASSERT_NEAR(texel[1], 0.5f, 1e-3f);
+            ASSERT_NEAR(texel[2], 0.5f / len + 0.5f, 1e-3f);
+            ASSERT_EQ(texel[3], 1.f);
+        }
+    }
+
+    // Flat 8 bit heights give RGBA8 normals along z
+    auto flat_data = new char[4 * width * height];
+    std::memset(flat_data, 0x40, 4 * width * height);
+    Texture flat(flat_data, RadeonRays::int2(width, height), Texture::Format::kRgba8);
+
+    std::vector<std::uint8_t> flat_normals(4 * width * height);
+    ClwSceneController::ConvertBumpToNormalMap(&flat, reinterpret_cast<char*>(flat_normals.data()));
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        ASSERT_EQ(flat_normals[4 * i], 128);
+        ASSERT_EQ(flat_normals[4 * i + 1], 128);
+        ASSERT_EQ(flat_normals[4 * i + 2], 255);
+    }
+}
+
+TEST_F(InternalTest, VertexTangentEncoding)
+{
+    using namespace Baikal;
+    using RadeonRays::float2;
+    using RadeonRays::float3;
+
+    // Host mirror of Scene_GetVertexTangent from scene.cl
+    auto decode = [](float3 const& n)
+    {
+        auto nn = normalize(float3(n.x, n.y, n.z));
+        float3 o = std::fabs(nn.z) > 0.f ? float3(0.f, -nn.z, nn.y) : float3(nn.y, -nn.x, 0.f);
+        o = normalize(o);
+        auto b = cross(nn, o);
+        auto angle = std::fabs(n.w) - 4.f;
+        return o * std::cos(angle) + b * std::sin(angle);
+    };
+
+    float3 const vertices[] = { float3(0.f, 0.f, 0.f), float3(1.f, 0.f, 0.f), float3(1.f, 1.f, 0.f), float3(0.f, 1.f, 0.f) };
+    float3 const normals[] = { float3(0.f, 0.f, 1.f), float3(0.f, 0.f, 1.f), float3(0.f, 0.f, 1.f), float3(0.f, 0.f, 1.f) };
+    std::uint32_t const indices[] = { 0, 1, 2, 0, 2, 3 };
+
+    struct Case
+    {
+        float2 uvs[4];
+        float3 tangent;
+        float sign;
+    };
+
+    Case const cases[] =
+    {
+        // u along x, v along y
+        { { float2(0.f, 0.f), float2(1.f, 0.f), float2(1.f, 1.f), float2(0.f, 1.f) }, float3(1.f, 0.f, 0.f), 1.f },
+        // u mirrored: tangent flips, bitangent keeps pointing along y, so handedness flips
+        { { float2(1.f, 0.f), float2(0.f, 0.f), float2(0.f, 1.f), float2(1.f, 1.f) }, float3(-1.f, 0.f, 0.f), -1.f },
+        // u along y, v along -x: rotated tangent frame of the same handedness
+        { { float2(0.f, 1.f), float2(0.f, 0.f), float2(1.f, 0.f), float2(1.f, 1.f) }, float3(0.f, 1.f, 0.f), 1.f }
+    };
+
+    for (auto const& c : cases)
+    {
+        Mesh mesh;
+        mesh.SetVertices(vertices, 4);
+        mesh.SetNormals(normals, 4);
+        mesh.SetUVs(c.uvs, 4);
+        mesh.SetIndices(indices, 6);
+
+        std::vector<float3> encoded(normals, normals + 4);
+        ClwSceneController::EncodeVertexTangents(&mesh, encoded.data());
+
+        for (auto const& n : encoded)
+        {
+            ASSERT_NE(n.w, 0.f);
+            ASSERT_EQ(n.w < 0.f ? -1.f : 1.f, c.sign);
+
+            auto t = decode(n);
+            ASSERT_NEAR(t.x, c.tangent.x, 1e-5f);
+            ASSERT_NEAR(t.y, c.tangent.y, 1e-5f);
+            ASSERT_NEAR(t.z, c.tangent.z, 1e-5f);
+        }
+    }
+
+    // Degenerate uvs have no tangent
+    {
+        float2 const uvs[] = { float2(0.5f, 0.5f), float2(0.5f, 0.5f), float2(0.5f, 0.5f), float2(0.5f, 0.5f) };
+
+        Mesh mesh;
+        mesh.SetVertices(vertices, 4);
+        mesh.SetNormals(normals, 4);
+        mesh.SetUVs(uvs, 4);
+        mesh.SetIndices(indices, 6);
+
+        std::vector<float3> encoded(normals, normals + 4);
+        ClwSceneController::EncodeVertexTangents(&mesh, encoded.data());
+
+        for (auto const& n : encoded)
+        {
+            ASSERT_EQ(n.w, 0.f);
+        }
+    }
+}
+
+TEST_F(InternalTest, PathGuidingSampling)
+{
+    using namespace Baikal::PathGuiding;
+
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    // Radiance concentrated in a few bins of the second cell, the rest is covered by the uniform part
+    int const cell = 1;
+    std::vector<float> train(2 * GUIDING_NUM_BINS, 0.f);
+    std::vector<float> radiance(2 * GUIDING_NUM_BINS, 0.f);
+    std::vector<float> cdf(2 * GUIDING_NUM_BINS, 0.f);
+    train[cell * GUIDING_NUM_BINS + 3] = 10.f;
+    train[cell * GUIDING_NUM_BINS + 40] = 5.f;
+    train[cell * GUIDING_NUM_BINS + 41] = 1.f;
+
+    ASSERT_FALSE(PathGuiding_IsTrained(cdf.data(), cell));
+    PathGuiding_UpdateCell(train.data(), radiance.data(), cdf.data(), cell);
+    ASSERT_TRUE(PathGuiding_IsTrained(cdf.data(), cell));
+    ASSERT_FALSE(PathGuiding_IsTrained(cdf.data(), 0));
+
+    // Training radiance is folded into the accumulated one
+    ASSERT_EQ(radiance[cell * GUIDING_NUM_BINS + 3], 10.f);
+    ASSERT_EQ(train[cell * GUIDING_NUM_BINS + 3], 0.f);
+
+    float const* cell_cdf = cdf.data() + cell * GUIDING_NUM_BINS;
+
+    int const num_samples = 200000;
+    std::vector<int> counts(GUIDING_NUM_BINS, 0);
+
+    for (int i = 0; i < num_samples; ++i)
+    {
+        float pdf = 0.f;
+        auto d = PathGuiding_Sample(cdf.data(), cell, float2(uniform(rng), uniform(rng)), &pdf);
+
+        // Sampled direction lands in the bin it was drawn from and reports the same pdf
+        ASSERT_NEAR(std::sqrt(d.sqnorm()), 1.f, 1e-4f);
+        ASSERT_NEAR(PathGuiding_GetPdf(cdf.data(), cell, d), pdf, 1e-4f * pdf);
+        ++counts[PathGuiding_GetBin(d)];
+    }
+
+    // Bins are taken with their probabilities
+    for (int i = 0; i < GUIDING_NUM_BINS; ++i)
+    {
+        float p = cell_cdf[i] - (i > 0 ? cell_cdf[i - 1] : 0.f);
+        ASSERT_NEAR(counts[i] / static_cast<float>(num_samples), p, 5e-3f);
+    }
+
+    // Bins span equal solid angles and pdf integrates to one over the sphere
+    float integral = 0.f;
+    for (int i = 0; i < GUIDING_NUM_BINS; ++i)
+    {
+        float z = 2.f * ((i / GUIDING_DIR_RES) + 0.5f) / GUIDING_DIR_RES - 1.f;
+        float phi = 2.f * PI * ((i % GUIDING_DIR_RES) + 0.5f) / GUIDING_DIR_RES;
+        float r = std::sqrt(std::max(1.f - z * z, 0.f));
+        RadeonRays::float3 d(r * std::cos(phi), r * std::sin(phi), z);
+
+        ASSERT_EQ(PathGuiding_GetBin(d), i);
+        integral += PathGuiding_GetPdf(cdf.data(), cell, d) * 4.f * PI / GUIDING_NUM_BINS;
+    }
+
+    ASSERT_NEAR(integral, 1.f, 1e-5f);
+}
+
+TEST_F(InternalTest, PathGuidingMis)
+{
+    using namespace Baikal::PathGuiding;
+
+    std::mt19937 rng(29);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    // Cell has learned radiance coming from below, BxDF samples upper hemisphere only
+    std::vector<float> train(GUIDING_NUM_BINS, 0.f);
+    std::vector<float> radiance(GUIDING_NUM_BINS, 0.f);
+    std::vector<float> cdf(GUIDING_NUM_BINS, 0.f);
+    for (int i = 0; i < GUIDING_NUM_BINS / 2; ++i)
+    {
+        train[i] = 1.f;
+    }
+    PathGuiding_UpdateCell(train.data(), radiance.data(), cdf.data(), 0);
+
+    // Diffuse lobe around z under constant unit radiance reflects exactly one
+    auto bxdf = [](RadeonRays::float3 const& d) { return std::max(d.z, 0.f) / PI; };
+
+    int const num_samples = 400000;
+    double estimate = 0.0;
+
+    for (int i = 0; i < num_samples; ++i)
+    {
+        float selection = uniform(rng);
+        float sx = uniform(rng);
+        float sy = uniform(rng);
+
+        RadeonRays::float3 d;
+        float guide_pdf = 0.f;
+
+        // One-sample MIS mixes BxDF and guiding pdfs with the selection probability
+        if (selection < GUIDING_SAMPLING_FRACTION)
+        {
+            d = PathGuiding_Sample(cdf.data(), 0, float2(sx, sy), &guide_pdf);
+        }
+        else
+        {
+            // Cosine weighted hemisphere
+            float r = std::sqrt(sx);
+            d = RadeonRays::float3(r * std::cos(2.f * PI * sy), r * std::sin(2.f * PI * sy), std::sqrt(std::max(1.f - sx, 0.f)));
+            guide_pdf = PathGuiding_GetPdf(cdf.data(), 0, d);
+        }
+
+        float bxdf_pdf = bxdf(d);
+        float pdf = (1.f - GUIDING_SAMPLING_FRACTION) * bxdf_pdf + GUIDING_SAMPLING_FRACTION * guide_pdf;
+
+        estimate += pdf > 0.f ? bxdf(d) / pdf : 0.f;
+    }
+
+    ASSERT_NEAR(estimate / num_samples, 1.0, 1e-2);
+}
+
+TEST_F(InternalTest, TextureStatistics)
+{
+    using namespace Baikal;
+
+    float const texels[] =
+    {
+        1.f, 0.f, 0.f, 1.f,
+        0.f, 2.f, 0.f, 1.f,
+        0.f, 0.f, 4.f, 1.f,
+        0.5f, 0.5f, 0.5f, 1.f
+    };
+
+    auto data = new char[sizeof(texels)];
+    std::memcpy(data, texels, sizeof(texels));
+
+    Texture texture(data, RadeonRays::int2(2, 2), Texture::Format::kRgba32);
+
+    auto const& statistics = texture.GetStatistics();
+
+    ASSERT_FLOAT_EQ(statistics.average.x, 0.375f);
+    ASSERT_FLOAT_EQ(statistics.average.y, 0.625f);
+    ASSERT_FLOAT_EQ(statistics.average.z, 1.125f);
+    ASSERT_FLOAT_EQ(statistics.max.x, 1.f);
+    ASSERT_FLOAT_EQ(statistics.max.y, 2.f);
+    ASSERT_FLOAT_EQ(statistics.max.z, 4.f);
+
+    // Luminances 0.2126, 1.4304, 0.2888 and 0.5 fall into [1/8, 1/4), [1, 2), [1/4, 1/2) and [1/2, 1)
+    int const offset = Texture::Statistics::kNumLuminanceBins / 2;
+    for (int i = 0; i < Texture::Statistics::kNumLuminanceBins; ++i)
+    {
+        bool occupied = i >= offset - 3 && i <= offset;
+        ASSERT_EQ(statistics.luminance_histogram[i], occupied ? 1u : 0u);
+    }
+
+    // Cached until the data changes
+    ASSERT_EQ(&texture.GetStatistics(), &statistics);
+
+    auto rgba8 = new char[4];
+    rgba8[0] = (char)0xFF;
+    rgba8[1] = rgba8[2] = 0;
+    rgba8[3] = (char)0xFF;
+    texture.SetData(rgba8, RadeonRays::int2(1, 1), Texture::Format::kRgba8);
+
+    ASSERT_FLOAT_EQ(texture.ComputeAverageValue().x, 1.f);
+    ASSERT_FLOAT_EQ(texture.ComputeAverageValue().y, 0.f);
+}
+
+TEST_F(InternalTest, TextureAtlas)
+{
+    using namespace Baikal;
+    using RadeonRays::int2;
+
+    // 4x2 texture with two mip levels takes (4 + 2) + (2 + 2) by 2 + 2 texels
+    ASSERT_EQ(TextureAtlas::GetRegionSize(int2(4, 2), 2).x, 10);
+    ASSERT_EQ(TextureAtlas::GetRegionSize(int2(4, 2), 2).y, 4);
+
+    TextureAtlas atlas(16, 10);
+    int2 origin;
+
+    ASSERT_TRUE(atlas.Add(int2(4, 2), 2, origin));
+    ASSERT_EQ(origin.x, 0);
+    ASSERT_EQ(origin.y, 0);
+
+    // Does not fit next to the first region, starts a new shelf
+    ASSERT_TRUE(atlas.Add(int2(6, 2), 1, origin));
+    ASSERT_EQ(origin.x, 0);
+    ASSERT_EQ(origin.y, 4);
+
+    ASSERT_TRUE(atlas.Add(int2(2, 1), 1, origin));
+    ASSERT_EQ(origin.x, 8);
+    ASSERT_EQ(origin.y, 4);
+
+    ASSERT_FALSE(atlas.Add(int2(16, 1), 1, origin));
+    ASSERT_FALSE(atlas.Add(int2(4, 4), 1, origin));
+
+    ASSERT_EQ(atlas.GetSize().x, 12);
+    ASSERT_EQ(atlas.GetSize().y, 8);
+
+    // Red channel holds texel index, 2x2 level followed by 1x1 level
+    std::uint8_t const texels[] =
+    {
+        0, 0, 0, 255, 1, 0, 0, 255,
+        2, 0, 0, 255, 3, 0, 0, 255,
+        4, 0, 0, 255
+    };
+
+    int const width = 7;
+    auto get_red = [](std::vector<std::uint8_t> const& image, int x, int y)
+    {
+        return static_cast<int>(image[4 * (y * width + x)]);
+    };
+
+    std::vector<std::uint8_t> image(4 * width * 4, 0xFF);
+    TextureAtlas::WriteMipChain(texels, int2(2, 2), 2, Texture::WrapMode::kRepeat, int2(0, 0), &image[0], width);
+
+    // Repeat borders hold texels of the opposite edges
+    int const repeat[4][4] =
+    {
+        { 3, 2, 3, 2 },
+        { 1, 0, 1, 0 },
+        { 3, 2, 3, 2 },
+        { 1, 0, 1, 0 }
+    };
+
+    for (int y = 0; y < 4; ++y)
+    {
+        for (int x = 0; x < 4; ++x)
+        {
+            ASSERT_EQ(get_red(image, x, y), repeat[y][x]);
+        }
+    }
+
+    // Second level is 1x1 with its own border, texel below it is left untouched
+    for (int y = 0; y < 3; ++y)
+    {
+        for (int x = 4; x < 7; ++x)
+        {
+            ASSERT_EQ(get_red(image, x, y), 4);
+        }
+    }
+
+    ASSERT_EQ(get_red(image, 5, 3), 0xFF);
+
+    TextureAtlas::WriteMipChain(texels, int2(2, 2), 1, Texture::WrapMode::kClampToEdge, int2(0, 0), &image[0], width);
+    ASSERT_EQ(get_red(image, 0, 0), 0);
+    ASSERT_EQ(get_red(image, 3, 3), 3);
+    ASSERT_EQ(get_red(image, 3, 1), 1);
+
+    // Clamp to border texels are black, alpha included
+    TextureAtlas::WriteMipChain(texels, int2(2, 2), 1, Texture::WrapMode::kClampToBorder, int2(0, 0), &image[0], width);
+    ASSERT_EQ(get_red(image, 1, 1), 0);
+    ASSERT_EQ(image[4 * (1 * width + 1) + 3], 255);
+    ASSERT_EQ(get_red(image, 3, 2), 0);
+    ASSERT_EQ(image[4 * (2 * width + 3) + 3], 0);
+}
+
+TEST_F(InternalTest, SceneBounds)
+{
+    using namespace Baikal;
+    using RadeonRays::float3;
+
+    float3 vertices[] = { float3(0.f, 0.f, 0.f), float3(1.f, 0.f, 0.f), float3(0.f, 1.f, 1.f) };
+    std::uint32_t indices[] = { 0, 1, 2 };
+
+    Mesh mesh;
+    mesh.SetVertices(vertices, 3);
+    mesh.SetIndices(indices, 3);
+
+    Instance instance(&mesh);
+
+    Scene1 scene;
+    scene.AttachShape(&mesh);
+    ASSERT_FLOAT_EQ(scene.GetWorldAABB().pmax.x, 1.f);
+
+    // Attached shapes grow cached bounds
+    instance.SetTransform(RadeonRays::scale(float3(2.f, 1.f, 1.f)));
+    scene.AttachShape(&instance);
+    ASSERT_FLOAT_EQ(scene.GetWorldAABB().pmax.x, 2.f);
+
+    // Shape changes are picked up, instances follow their base shapes
+    instance.SetTransform(RadeonRays::scale(float3(4.f, 1.f, 1.f)));
+    ASSERT_FLOAT_EQ(scene.GetWorldAABB().pmax.x, 4.f);
+
+    vertices[1] = float3(2.f, 0.f, 0.f);
+    mesh.SetVertices(vertices, 3);
+    ASSERT_FLOAT_EQ(scene.GetWorldAABB().pmax.x, 8.f);
+
+    // Clearing dirty flags does not invalidate anything
+    mesh.SetDirty(false);
+    instance.SetDirty(false);
+    ASSERT_FLOAT_EQ(scene.GetWorldAABB().pmax.x, 8.f);
+
+    scene.DetachShape(&instance);
+    ASSERT_FLOAT_EQ(scene.GetWorldAABB().pmax.x, 2.f);
+    ASSERT_FLOAT_EQ(scene.GetWorldAABB().pmin.x, 0.f);
+}
+
+TEST_F(InternalTest, InstanceBaseShapeBounds)
+{
+    using namespace Baikal;
+    using RadeonRays::float3;
+
+    float3 small_vertices[] = { float3(0.f, 0.f, 0.f), float3(1.f, 0.f, 0.f), float3(0.f, 1.f, 1.f) };
+    float3 large_vertices[] = { float3(0.f, 0.f, 0.f), float3(3.f, 0.f, 0.f), float3(0.f, 1.f, 1.f) };
+    std::uint32_t indices[] = { 0, 1, 2 };
+
+    Mesh small;
+    small.SetVertices(small_vertices, 3);
+    small.SetIndices(indices, 3);
+
+    Mesh large;
+    large.SetVertices(large_vertices, 3);
+    large.SetIndices(indices, 3);
+    // One change ahead of the small mesh, so a sum of revisions would not change on the switch below
+    large.SetDirty(true);
+
+    Instance instance(&large);
+
+    Scene1 scene;
+    scene.AttachShape(&instance);
+    ASSERT_FLOAT_EQ(scene.GetWorldAABB().pmax.x, 3.f);
+
+    // Base shapes changed before the current one are picked up as well
+    instance.SetBaseShape(&small);
+    ASSERT_FLOAT_EQ(scene.GetWorldAABB().pmax.x, 1.f);
+
+    instance.SetBaseShape(&large);
+    ASSERT_FLOAT_EQ(scene.GetWorldAABB().pmax.x, 3.f);
+}
+
+TEST_F(InternalTest, HalfConversion)
+{
+    // Every half value converts exactly as the half class does
+    std::vector<std::uint16_t> bits(1 << 16);
+    for (std::size_t i = 0; i < bits.size(); ++i)
+    {
+        bits[i] = static_cast<std::uint16_t>(i);
+    }
+
+    std::vector<float> values(bits.size());
+    Baikal::HalfToFloat(&bits[0], &values[0], bits.size());
+
+    for (std::size_t i = 0; i < bits.size(); ++i)
+    {
+        half h;
+        h.setBits(bits[i]);
+        float expected = h;
+
+        if (std::isnan(expected))
+        {
+            ASSERT_TRUE(std::isnan(values[i]));
+        }
+        else
+        {
+            ASSERT_EQ(std::memcmp(&expected, &values[i], sizeof(float)), 0);
+        }
+    }
+
+    // Floats round to the same halves as the half class, odd count covers the tail
+    std::size_t const count = (1 << 20) + 3;
+    std::vector<float> src(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        src[i] = (RadeonRays::rand_float() - 0.5f) * std::pow(2.f, RadeonRays::rand_float() * 40.f - 24.f);
+    }
+
+    std::vector<std::uint16_t> dst(count);
+    Baikal::FloatToHalf(&src[0], &dst[0], count);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(dst[i], half(src[i]).bits());
+    }
+}
@@ -25,6 +25,9 @@ THE SOFTWARE.
 #include "SceneGraph/light.h"
 #include "SceneGraph/shape.h"
 #include "SceneGraph/material.h"
+#include "SceneGraph/texture.h"
+#include "Utils/sh.h"
+#include "Utils/shproject.h"
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -609,4 +612,54 @@ TEST_F(LightTest, Light_DirectionalAndEmissiveSphere)
         SaveOutput(oss.str());
         ASSERT_TRUE(CompareToReference(oss.str()));
     }
-}
\ No newline at end of file
+}
+
+// Large environment maps are projected to SH on the device, results should match the host projection
+TEST_F(LightTest, Light_EnvironmentShDevice)
+{
+    int const width = 2048;
+    int const height = 512;
+
+    std::vector<float3> texels(width * height);
+    auto data = new float[4 * width * height];
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            auto i = y * width + x;
+            texels[i] = float3(1.f, float(x) / width, float(y) / height);
+            data[4 * i] = texels[i].x;
+            data[4 * i + 1] = texels[i].y;
+            data[4 * i + 2] = texels[i].z;
+            data[4 * i + 3] = 1.f;
+        }
+    }
+
+    auto texture = new Baikal::Texture(reinterpret_cast<char*>(data), RadeonRays::int2(width, height), Baikal::Texture::Format::kRgba32);
+    m_scene->AttachAutoreleaseObject(texture);
+
+    auto light = new Baikal::ImageBasedLight();
+    light->SetTexture(texture);
+    m_scene->AttachLight(light);
+    m_scene->AttachAutoreleaseObject(light);
+
+    ASSERT_NO_THROW(m_controller->CompileScene(*m_scene));
+
+    auto& scene = m_controller->GetCachedScene(*m_scene);
+
+    std::vector<float3> radiance(9);
+    std::vector<float3> expected(9);
+    ShProjectEnvironmentMap(&texels[0], width, height, 2, &radiance[0]);
+    ShConvolveCosTheta(2, &radiance[0], &expected[0]);
+
+    std::vector<float3> coeffs(9);
+    ASSERT_NO_THROW(m_context.ReadBuffer(0, scene.envmap_sh, &coeffs[0], coeffs.size()).Wait());
+
+    for (auto i = 0u; i < coeffs.size(); ++i)
+    {
+        ASSERT_NEAR(coeffs[i].x, expected[i].x, 1e-3f);
+        ASSERT_NEAR(coeffs[i].y, expected[i].y, 1e-3f);
+        ASSERT_NEAR(coeffs[i].z, expected[i].z, 1e-3f);
+    }
+}
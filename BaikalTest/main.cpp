@@ -28,6 +28,7 @@ THE SOFTWARE.
 #include "camera.h"
 #include "light.h"
 #include "material.h"
+#include "performance.h"
 
 int g_argc;
 char** g_argv;
@@ -35,7 +36,9 @@ char** g_argv;
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
+    ::testing::AddGlobalTestEnvironment(new PerformanceEnvironment());
     g_argc = argc;
     g_argv = argv;
+    PerformanceEnvironment::FilterTests();
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,552 @@
+/**********************************************************************
+Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "basic.h"
+#include "Renderers/monte_carlo_renderer.h"
+#include "PostEffects/post_effect.h"
+#include "SceneGraph/material.h"
+#include "SceneGraph/shape.h"
+#include "SceneGraph/texture.h"
+#include "SceneGraph/iterator.h"
+#include "Utils/half.h"
+#include "Utils/half_convert.h"
+#include "Utils/sh.h"
+#include "Utils/shproject.h"
+#include "math/matrix.h"
+#include "math/mathutils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+///< Performance results collected over the run. They are written as JSON to the -perfout path once
+///< all tests finish, so results of different builds can be diffed.
+///< The layout follows Google Benchmark output: {"context": {...}, "benchmarks": [{"name", "value", "unit"}]}
+///<
+class PerformanceReport
+{
+public:
+    static PerformanceReport& Get()
+    {
+        static PerformanceReport report;
+        return report;
+    }
+
+    void SetContext(std::string const& key, std::string const& value)
+    {
+        m_context[key] = value;
+    }
+
+    void Add(std::string const& name, double value, std::string const& unit)
+    {
+        m_entries.push_back({ name, value, unit });
+        std::cout << name << ": " << value << " " << unit << "\n";
+    }
+
+    bool IsEmpty() const { return m_entries.empty(); }
+
+    void Write(std::string const& path) const
+    {
+        std::ofstream out(path);
+
+        if (!out)
+        {
+            throw std::runtime_error("Can't open " + path + " for writing");
+        }
+
+        out << "{\n  \"context\": {";
+
+        for (auto iter = m_context.cbegin(); iter != m_context.cend(); ++iter)
+        {
+            out << (iter == m_context.cbegin() ? "\n" : ",\n");
+            out << "    \"" << Escape(iter->first) << "\": \"" << Escape(iter->second) << "\"";
+        }
+
+        out << "\n  },\n  \"benchmarks\": [";
+
+        for (auto i = 0u; i < m_entries.size(); ++i)
+        {
+            out << (i == 0 ? "\n" : ",\n");
+            out << "    { \"name\": \"" << Escape(m_entries[i].name) << "\", \"value\": "
+                << std::setprecision(6) << m_entries[i].value << ", \"unit\": \"" << m_entries[i].unit << "\" }";
+        }
+
+        out << "\n  ]\n}\n";
+    }
+
+private:
+    struct Entry
+    {
+        std::string name;
+        double value;
+        std::string unit;
+    };
+
+    static std::string Escape(std::string const& str)
+    {
+        std::string result;
+
+        for (auto c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                result.push_back('\\');
+            }
+
+            result.push_back(c);
+        }
+
+        return result;
+    }
+
+    std::map<std::string, std::string> m_context;
+    std::vector<Entry> m_entries;
+};
+
+// Writes collected performance results after all tests.
+// Performance suite is opt-in: without -perfout its tests are filtered out and nothing is written.
+class PerformanceEnvironment : public ::testing::Environment
+{
+public:
+    static char* GetOutputPath()
+    {
+        return BasicTest::GetCmdOption(g_argv, g_argv + g_argc, "-perfout");
+    }
+
+    // Exclude performance tests from the gtest filter unless results are requested
+    static void FilterTests()
+    {
+        if (GetOutputPath())
+        {
+            return;
+        }
+
+        std::string filter = ::testing::GTEST_FLAG(filter);
+        filter += filter.find('-') == std::string::npos ? "-" : ":";
+        ::testing::GTEST_FLAG(filter) = filter + "PerformanceTest.*:HostPerformanceTest.*";
+    }
+
+    void TearDown() override
+    {
+        auto& report = PerformanceReport::Get();
+        char* path_option = GetOutputPath();
+
+        if (path_option && !report.IsEmpty())
+        {
+            report.Write(path_option);
+        }
+    }
+};
+
+class PerformanceTest : public BasicTest
+{
+public:
+    static std::uint32_t constexpr kPerfOutputWidth = 1024;
+    static std::uint32_t constexpr kPerfOutputHeight = 1024;
+    // Each measurement is repeated and the median is reported
+    static std::uint32_t constexpr kNumRuns = 7;
+    static std::uint32_t constexpr kTextureSize = 2048;
+
+    virtual void SetUp()
+    {
+        BasicTest::SetUp();
+
+        ASSERT_NO_THROW(m_output = m_factory->CreateOutput(kPerfOutputWidth, kPerfOutputHeight));
+        ASSERT_NO_THROW(m_renderer->SetOutput(Baikal::Renderer::OutputType::kColor, m_output.get()));
+
+        auto& report = PerformanceReport::Get();
+        report.SetContext("device", m_context.GetDevice(0).GetName());
+        report.SetContext("output_size", std::to_string(kPerfOutputWidth) + "x" + std::to_string(kPerfOutputHeight));
+    }
+
+    // Fixed set of procedural scenes the numbers are reported for
+    std::vector<std::string> GetScenes() const
+    {
+        return { "sphere+ibl", "sphere+plane+area", "100spheres+plane+ibl+disney" };
+    }
+
+    // Controller is recreated too, so its cache can't match a new scene at the address of an old one
+    void LoadScene(std::string const& name)
+    {
+        m_controller = m_factory->CreateSceneController();
+
+        auto io = Baikal::SceneIo::CreateSceneIoTest();
+        m_scene = io->LoadScene(name, "");
+        SetupCamera();
+    }
+
+    // Run the function kNumRuns times and return median time in ms, device work is included
+    template <typename F>
+    double Measure(F&& f)
+    {
+        std::vector<double> times(kNumRuns);
+
+        for (auto& time : times)
+        {
+            m_context.Finish(0);
+            auto start = std::chrono::high_resolution_clock::now();
+
+            f();
+
+            m_context.Finish(0);
+            time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+
+    void Report(std::string const& scene, std::string const& metric, double value, std::string const& unit)
+    {
+        PerformanceReport::Get().Add(test_name() + "/" + scene + "/" + metric, value, unit);
+    }
+};
+
+// Benchmarks of host side code, no device is involved
+class HostPerformanceTest : public ::testing::Test
+{
+public:
+    // Each measurement is repeated and the median is reported
+    static std::uint32_t constexpr kNumRuns = 7;
+
+    // Run the function kNumRuns times and return median time in ms
+    template <typename F>
+    double Measure(F&& f)
+    {
+        std::vector<double> times(kNumRuns);
+
+        for (auto& time : times)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            f();
+
+            time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+
+    void Report(std::string const& metric, double value, std::string const& unit)
+    {
+        std::string test_name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        PerformanceReport::Get().Add(test_name + "/" + metric, value, unit);
+    }
+};
+
+// SH projection of an 8K environment map
+TEST_F(HostPerformanceTest, ShProjectEnvironmentMap)
+{
+    int const width = 8192;
+    int const height = 4096;
+    int const lmax = 2;
+
+    std::vector<RadeonRays::float3> envmap(width * height);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            envmap[y * width + x] = RadeonRays::float3(1.f, float(x) / width, float(y) / height);
+        }
+    }
+
+    std::vector<RadeonRays::float3> coeffs(NumShTerms(lmax));
+
+    auto time = Measure([&]()
+    {
+        ShProjectEnvironmentMap(&envmap[0], width, height, lmax, &coeffs[0]);
+    });
+
+    Report("8192x4096", time, "ms");
+}
+
+// Bulk half conversions of 16M values against per-element half class conversion
+TEST_F(HostPerformanceTest, HalfConversion)
+{
+    std::size_t const count = 1 << 24;
+
+    std::vector<float> values(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        values[i] = (float(i % 4093) - 2046.f) / 64.f;
+    }
+
+    std::vector<std::uint16_t> bits(count);
+
+    auto float_to_half = Measure([&]()
+    {
+        Baikal::FloatToHalf(&values[0], &bits[0], count);
+    });
+
+    auto float_to_half_table = Measure([&]()
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            bits[i] = half(values[i]).bits();
+        }
+    });
+
+    auto half_to_float = Measure([&]()
+    {
+        Baikal::HalfToFloat(&bits[0], &values[0], count);
+    });
+
+    auto half_to_float_table = Measure([&]()
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            half h;
+            h.setBits(bits[i]);
+            values[i] = h;
+        }
+    });
+
+    PerformanceReport::Get().SetContext("half_conversion", Baikal::IsHalfConversionAccelerated() ? "F16C" : "table");
+    Report("FloatToHalf", float_to_half, "ms");
+    Report("FloatToHalfPerElement", float_to_half_table, "ms");
+    Report("HalfToFloat", half_to_float, "ms");
+    Report("HalfToFloatPerElement", half_to_float_table, "ms");
+}
+
+// Full compilation of a scene by a fresh controller, includes acceleration structure build
+TEST_F(PerformanceTest, SceneCompile)
+{
+    for (auto const& name : GetScenes())
+    {
+        ASSERT_NO_THROW(LoadScene(name));
+
+        auto time = Measure([&]()
+        {
+            auto controller = m_factory->CreateSceneController();
+            controller->CompileScene(*m_scene);
+        });
+
+        Report(name, "compile_time", time, "ms");
+    }
+}
+
+// Recompilation after camera and shape transform changes
+TEST_F(PerformanceTest, IncrementalUpdate)
+{
+    for (auto const& name : GetScenes())
+    {
+        ASSERT_NO_THROW(LoadScene(name));
+        ASSERT_NO_THROW(m_controller->CompileScene(*m_scene));
+
+        int frame = 0;
+
+        auto time = Measure([&]()
+        {
+            ++frame;
+            m_camera->LookAt(RadeonRays::float3(0.01f * frame, 0.f, -6.f),
+                RadeonRays::float3(0.f, 0.f, 0.f),
+                RadeonRays::float3(0.f, 1.f, 0.f));
+            m_controller->CompileScene(*m_scene);
+        });
+
+        Report(name, "camera_update_time", time, "ms");
+
+        std::unique_ptr<Baikal::Iterator> shape_iter(m_scene->CreateShapeIterator());
+        ASSERT_TRUE(shape_iter->IsValid());
+        auto shape = const_cast<Baikal::Shape*>(shape_iter->ItemAs<Baikal::Shape const>());
+
+        time = Measure([&]()
+        {
+            ++frame;
+            shape->SetTransform(RadeonRays::translation(RadeonRays::float3(0.f, 0.001f * frame, 0.f)));
+            m_controller->CompileScene(*m_scene);
+        });
+
+        Report(name, "transform_update_time", time, "ms");
+    }
+}
+
+// Upload of a large material texture
+TEST_F(PerformanceTest, TextureUpload)
+{
+    for (auto const& name : GetScenes())
+    {
+        ASSERT_NO_THROW(LoadScene(name));
+
+        auto size = RadeonRays::int2(kTextureSize, kTextureSize);
+        auto num_bytes = static_cast<std::size_t>(kTextureSize) * kTextureSize * 4;
+
+        // Checker pattern, regenerated before each run so the texture is uploaded every time
+        auto create_data = [&]()
+        {
+            auto data = new char[num_bytes];
+
+            for (auto i = 0u; i < num_bytes; ++i)
+            {
+                auto texel = i / 4;
+                data[i] = static_cast<char>((((texel % kTextureSize) / 64 + (texel / kTextureSize) / 64) & 1) ? 200 : 50);
+            }
+
+            return data;
+        };
+
+        auto texture = std::make_unique<Baikal::Texture>(create_data(), size, Baikal::Texture::Format::kRgba8);
+        auto material = std::make_unique<Baikal::SingleBxdf>(Baikal::SingleBxdf::BxdfType::kLambert);
+        material->SetInputValue("albedo", texture.get());
+
+        for (auto iter = m_scene->CreateShapeIterator(); iter->IsValid(); iter->Next())
+        {
+            const_cast<Baikal::Shape*>(iter->ItemAs<Baikal::Shape const>())->SetMaterial(material.get());
+        }
+
+        ASSERT_NO_THROW(m_controller->CompileScene(*m_scene));
+
+        std::vector<char*> data(kNumRuns);
+        for (auto& d : data)
+        {
+            d = create_data();
+        }
+
+        auto run = 0u;
+        auto time = Measure([&]()
+        {
+            texture->SetData(data[run++], size, Baikal::Texture::Format::kRgba8);
+            m_controller->CompileScene(*m_scene);
+        });
+
+        Report(name, "texture_upload_time", time, "ms");
+
+        // Shapes refer to the material, drop the scene before it goes away
+        m_controller.reset();
+        m_scene.reset();
+    }
+}
+
+// Primary, secondary and shadow ray throughput and per-bounce shading time
+TEST_F(PerformanceTest, RayThroughput)
+{
+    auto renderer = static_cast<Baikal::MonteCarloRenderer*>(m_renderer.get());
+
+    for (auto const& name : GetScenes())
+    {
+        ASSERT_NO_THROW(LoadScene(name));
+        ASSERT_NO_THROW(m_controller->CompileScene(*m_scene));
+
+        auto& scene = m_controller->GetCachedScene(*m_scene);
+
+        Baikal::Estimator::RayTracingStats stats;
+        ASSERT_NO_THROW(renderer->Benchmark(scene, stats));
+
+        Report(name, "primary_throughput", stats.primary_throughput * 1e-6, "Mrays/s");
+        Report(name, "secondary_throughput", stats.secondary_throughput * 1e-6, "Mrays/s");
+        Report(name, "shadow_throughput", stats.shadow_throughput * 1e-6, "Mrays/s");
+
+        for (auto i = 0u; i < stats.bounce_throughput.size(); ++i)
+        {
+            auto bounce = "bounce" + std::to_string(i + 1);
+            Report(name, bounce + "_throughput", stats.bounce_throughput[i] * 1e-6, "Mrays/s");
+            Report(name, bounce + "_sorted_throughput", stats.bounce_sorted_throughput[i] * 1e-6, "Mrays/s");
+            Report(name, bounce + "_shading_time", stats.bounce_shading_time[i], "ms");
+        }
+    }
+}
+
+// Time of a whole sample pass
+TEST_F(PerformanceTest, RenderIteration)
+{
+    for (auto const& name : GetScenes())
+    {
+        ASSERT_NO_THROW(LoadScene(name));
+        ASSERT_NO_THROW(m_controller->CompileScene(*m_scene));
+
+        auto& scene = m_controller->GetCachedScene(*m_scene);
+
+        // Warm up kernel compilation
+        ClearOutput();
+        ASSERT_NO_THROW(m_renderer->Render(scene));
+
+        auto time = Measure([&]()
+        {
+            m_renderer->Render(scene);
+        });
+
+        Report(name, "render_iteration_time", time, "ms");
+    }
+}
+
+// Post-processing of rendered outputs
+TEST_F(PerformanceTest, PostEffect)
+{
+    std::unique_ptr<Baikal::Output> position;
+    std::unique_ptr<Baikal::Output> normal;
+    std::unique_ptr<Baikal::Output> albedo;
+    std::unique_ptr<Baikal::Output> denoised;
+
+    ASSERT_NO_THROW(position = m_factory->CreateOutput(kPerfOutputWidth, kPerfOutputHeight));
+    ASSERT_NO_THROW(normal = m_factory->CreateOutput(kPerfOutputWidth, kPerfOutputHeight));
+    ASSERT_NO_THROW(albedo = m_factory->CreateOutput(kPerfOutputWidth, kPerfOutputHeight));
+    ASSERT_NO_THROW(denoised = m_factory->CreateOutput(kPerfOutputWidth, kPerfOutputHeight));
+
+    ASSERT_NO_THROW(m_renderer->SetOutput(Baikal::Renderer::OutputType::kWorldPosition, position.get()));
+    ASSERT_NO_THROW(m_renderer->SetOutput(Baikal::Renderer::OutputType::kWorldShadingNormal, normal.get()));
+    ASSERT_NO_THROW(m_renderer->SetOutput(Baikal::Renderer::OutputType::kAlbedo, albedo.get()));
+
+    std::unique_ptr<Baikal::PostEffect> denoiser;
+    ASSERT_NO_THROW(denoiser = m_factory->CreatePostEffect(
+        Baikal::RenderFactory<Baikal::ClwScene>::PostEffectType::kBilateralDenoiser));
+
+    Baikal::PostEffect::InputSet input_set;
+    input_set[Baikal::Renderer::OutputType::kColor] = m_output.get();
+    input_set[Baikal::Renderer::OutputType::kWorldPosition] = position.get();
+    input_set[Baikal::Renderer::OutputType::kWorldShadingNormal] = normal.get();
+    input_set[Baikal::Renderer::OutputType::kAlbedo] = albedo.get();
+
+    for (auto const& name : GetScenes())
+    {
+        ASSERT_NO_THROW(LoadScene(name));
+        ASSERT_NO_THROW(m_controller->CompileScene(*m_scene));
+
+        auto& scene = m_controller->GetCachedScene(*m_scene);
+
+        ClearOutput();
+        for (auto i = 0u; i < 4; ++i)
+        {
+            ASSERT_NO_THROW(m_renderer->Render(scene));
+        }
+
+        ASSERT_NO_THROW(denoiser->Apply(input_set, *denoised));
+
+        auto time = Measure([&]()
+        {
+            denoiser->Apply(input_set, *denoised);
+        });
+
+        Report(name, "bilateral_denoiser_time", time, "ms");
+    }
+
+    ASSERT_NO_THROW(m_renderer->SetOutput(Baikal::Renderer::OutputType::kWorldPosition, nullptr));
+    ASSERT_NO_THROW(m_renderer->SetOutput(Baikal::Renderer::OutputType::kWorldShadingNormal, nullptr));
+    ASSERT_NO_THROW(m_renderer->SetOutput(Baikal::Renderer::OutputType::kAlbedo, nullptr));
+}
@@ -436,6 +436,81 @@ rpr_int rprContextCreateInstance(rpr_context in_context, rpr_shape shape, rpr_sh
     return result;
 }
 
+rpr_int rprContextCreateInstances(rpr_context in_context, rpr_shape shape, size_t num_instances, rpr_bool transpose, rpr_float const * transforms, rpr_material_node const * materials, rpr_shape * out_instances)
+{
+    //cast data
+    ContextObject* context = WrapObject::Cast<ContextObject>(in_context);
+    ShapeObject* mesh = WrapObject::Cast<ShapeObject>(shape);
+
+    if (!context)
+    {
+        return RPR_ERROR_INVALID_CONTEXT;
+    }
+
+    if (!mesh || (num_instances && !out_instances))
+    {
+        return RPR_ERROR_INVALID_PARAMETER;
+    }
+
+    rpr_int result = RPR_SUCCESS;
+    size_t num_created = 0;
+    try
+    {
+        //validate all materials before creating anything
+        std::vector<MaterialObject*> mats(materials ? num_instances : 0, nullptr);
+        for (size_t i = 0; i < mats.size(); ++i)
+        {
+            if (materials[i])
+            {
+                mats[i] = WrapObject::Cast<MaterialObject>(materials[i]);
+                if (!mats[i])
+                {
+                    return RPR_ERROR_INVALID_PARAMETER;
+                }
+                //can throw exception if mat is a Texture
+                ShapeObject::ValidateMaterial(mats[i]);
+            }
+        }
+
+        for (; num_created < num_instances; ++num_created)
+        {
+            ShapeObject* instance = context->CreateShapeInstance(mesh);
+            out_instances[num_created] = instance;
+
+            if (transforms)
+            {
+                RadeonRays::matrix m;
+                memcpy(m.m, transforms + num_created * 16, 16 * sizeof(rpr_float));
+
+                if (!transpose)
+                {
+                    m = m.transpose();
+                }
+
+                instance->SetTransform(m);
+            }
+
+            if (!mats.empty() && mats[num_created])
+            {
+                instance->SetMaterial(mats[num_created]);
+            }
+        }
+    }
+    catch (Exception& e)
+    {
+        result = e.m_error;
+
+        //don't leave a partially created batch behind
+        for (size_t i = 0; i < num_created; ++i)
+        {
+            delete static_cast<WrapObject*>(out_instances[i]);
+            out_instances[i] = nullptr;
+        }
+    }
+
+    return result;
+}
+
 rpr_int rprContextCreateMesh(rpr_context in_context, 
                             rpr_float const * in_vertices, size_t in_num_vertices, rpr_int in_vertex_stride,
                             rpr_float const * in_normals, size_t in_num_normals, rpr_int in_normal_stride,
@@ -579,8 +654,7 @@ rpr_int rprCameraGetInfo(rpr_camera in_camera, rpr_camera_info in_camera_info, s
     }
     case RPR_CAMERA_MODE:
     {
-        //TODO: only prespective camera supported now
-        rpr_camera_mode value = RPR_CAMERA_MODE_PERSPECTIVE;
+        rpr_camera_mode value = cam->GetMode();
         size_ret = sizeof(value);
         data.resize(size_ret);
         memcpy(&data[0], &value, size_ret);
@@ -780,16 +854,16 @@ rpr_int rprCameraSetMode(rpr_camera in_camera, rpr_camera_mode mode)
         return RPR_ERROR_INVALID_PARAMETER;
     }
 
-    //TODO: only perspective camera used for now
-    switch (mode)
+    rpr_int result = RPR_SUCCESS;
+    try
     {
-    case RPR_CAMERA_MODE_PERSPECTIVE:
-        break;
-    default:
-        UNIMLEMENTED_FUNCTION
+        camera->SetMode(mode);
     }
-    
-    return RPR_SUCCESS;
+    catch (Exception& e)
+    {
+        result = e.m_error;
+    }
+    return result;
 }
 
 rpr_int rprCameraSetOrthoWidth(rpr_camera camera, rpr_float width)
@@ -864,8 +938,13 @@ rpr_int rprImageGetInfo(rpr_image in_image, rpr_image_info in_image_info, size_t
         break;
     }
     case RPR_IMAGE_WRAP:
-        UNSUPPORTED_FUNCTION
+    {
+        rpr_image_wrap_type value = img->GetTextureWrap();
+        size_ret = sizeof(value);
+        data.resize(size_ret);
+        memcpy(&data[0], &value, size_ret);
         break;
+    }
     default:
         UNIMLEMENTED_FUNCTION
     }
@@ -884,7 +963,22 @@ rpr_int rprImageGetInfo(rpr_image in_image, rpr_image_info in_image_info, size_t
 
 rpr_int rprImageSetWrap(rpr_image image, rpr_image_wrap_type type)
 {
-    UNSUPPORTED_FUNCTION
+    MaterialObject* img = WrapObject::Cast<MaterialObject>(image);
+    if (!img || !img->IsImg())
+    {
+        return RPR_ERROR_INVALID_IMAGE;
+    }
+
+    rpr_int result = RPR_SUCCESS;
+    try
+    {
+        img->SetTextureWrap(type);
+    }
+    catch (Exception& e)
+    {
+        result = e.m_error;
+    }
+    return result;
 }
 
 rpr_int rprShapeSetTransform(rpr_shape in_shape, rpr_bool transpose, rpr_float const * transform)
@@ -1606,6 +1700,31 @@ rpr_int rprSceneAttachShape(rpr_scene in_scene, rpr_shape in_shape)
     return RPR_SUCCESS;
 }
 
+rpr_int rprSceneAttachShapes(rpr_scene in_scene, size_t num_shapes, rpr_shape const * in_shapes)
+{
+    //cast
+    SceneObject* scene = WrapObject::Cast<SceneObject>(in_scene);
+    if (!scene || (num_shapes && !in_shapes))
+    {
+        return RPR_ERROR_INVALID_PARAMETER;
+    }
+
+    //validate the whole batch before attaching anything
+    std::vector<ShapeObject*> shapes(num_shapes);
+    for (size_t i = 0; i < num_shapes; ++i)
+    {
+        shapes[i] = WrapObject::Cast<ShapeObject>(in_shapes[i]);
+        if (!shapes[i])
+        {
+            return RPR_ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    scene->AttachShapes(shapes.data(), shapes.size());
+
+    return RPR_SUCCESS;
+}
+
 rpr_int rprSceneDetachShape(rpr_scene in_scene, rpr_shape in_shape)
 {
     //cast
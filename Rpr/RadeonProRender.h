@@ -960,6 +960,29 @@ extern RPR_API_ENTRY rpr_int rprContextCreateScene(rpr_context context, rpr_scen
  */
 extern RPR_API_ENTRY rpr_int rprContextCreateInstance(rpr_context context, rpr_shape shape, rpr_shape * out_instance);
 
+/** @brief Create a batch of instances of the same shape
+ *
+ *  Equivalent to calling rprContextCreateInstance, rprShapeSetTransform and
+ *  rprShapeSetMaterial for every instance, but the arguments are validated once
+ *  and no instance is created if any of them is invalid.
+ *
+ *  Possible error codes are:
+ *
+ *      RPR_ERROR_OUT_OF_SYSTEM_MEMORY
+ *      RPR_ERROR_OUT_OF_VIDEO_MEMORY
+ *      RPR_ERROR_INVALID_PARAMETER
+ *
+ *  @param  context        The context to create instances for
+ *  @param  shape          Parent shape for the instances
+ *  @param  num_instances  Number of instances to create
+ *  @param  transpose      Determines whether the transforms are transposed
+ *  @param  transforms     Array of num_instances 4x4 matrices (16 floats each) or NULL to keep identity
+ *  @param  materials      Array of num_instances materials or NULL, NULL entries leave the instance without material
+ *  @param  out_instances  Array of num_instances receiving the created instances
+ *  @return RPR_SUCCESS in case of success, error code otherwise
+ */
+extern RPR_API_ENTRY rpr_int rprContextCreateInstances(rpr_context context, rpr_shape shape, size_t num_instances, rpr_bool transpose, rpr_float const * transforms, rpr_material_node const * materials, rpr_shape * out_instances);
+
 /** @brief Create a mesh
  *
  *  FireRender supports mixed meshes consisting of triangles and quads.
@@ -1697,6 +1720,18 @@ extern RPR_API_ENTRY rpr_int rprSceneClear(rpr_scene scene);
  */
 extern RPR_API_ENTRY rpr_int rprSceneAttachShape(rpr_scene scene, rpr_shape shape);
 
+/** @brief Attach several shapes to the scene
+ *
+ *  Equivalent to calling rprSceneAttachShape for every shape. Shapes already
+ *  attached to the scene are skipped.
+ *
+ *  @param  scene       The scene to attach
+ *  @param  num_shapes  Number of shapes in the array
+ *  @param  shapes      Array of shapes to attach
+ *  @return             RPR_SUCCESS in case of success, error code otherwise
+ */
+extern RPR_API_ENTRY rpr_int rprSceneAttachShapes(rpr_scene scene, size_t num_shapes, rpr_shape const * shapes);
+
 /** @brief Detach a shape from the scene
  *
  *  A scene is essentially a collection of shapes, lights and volume regions.
@@ -21,6 +21,7 @@ THE SOFTWARE.
 ********************************************************************/
 
 #include "WrapObject/CameraObject.h"
+#include "WrapObject/Exception.h"
 #include "SceneGraph/camera.h"
 #include "radeon_rays.h"
 
@@ -77,4 +78,25 @@ void CameraObject::GetLookAt(RadeonRays::float3& eye,
     eye = m_cam->GetPosition();
     at = m_cam->GetForwardVector() + eye;
     up = m_cam->GetUpVector();
-}
\ No newline at end of file
+}
+
+void CameraObject::SetMode(rpr_camera_mode mode)
+{
+    switch (mode)
+    {
+    case RPR_CAMERA_MODE_PERSPECTIVE:
+        m_cam->SetProjection(PerspectiveCamera::Projection::kPerspective);
+        break;
+    case RPR_CAMERA_MODE_LATITUDE_LONGITUDE_360:
+        m_cam->SetProjection(PerspectiveCamera::Projection::kSpherical);
+        break;
+    default:
+        throw Exception(RPR_ERROR_UNIMPLEMENTED, "CameraObject: unsupported camera mode.");
+    }
+}
+
+rpr_camera_mode CameraObject::GetMode()
+{
+    return m_cam->GetProjection() == PerspectiveCamera::Projection::kSpherical ?
+        RPR_CAMERA_MODE_LATITUDE_LONGITUDE_360 : RPR_CAMERA_MODE_PERSPECTIVE;
+}
@@ -62,6 +62,10 @@ public:
 
     void SetTransform(const RadeonRays::matrix& m);
 
+    //only perspective and 360 degrees panorama modes are supported
+    void SetMode(rpr_camera_mode mode);
+    rpr_camera_mode GetMode();
+
     Baikal::Camera* GetCamera() { return m_cam; }
 private:
     Baikal::PerspectiveCamera* m_cam;
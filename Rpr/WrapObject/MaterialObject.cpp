@@ -667,4 +667,42 @@ rpr_image_format MaterialObject::GetTextureFormat() const
     }
     //only 4component textures used
     return{ 4, type };
+}
+
+rpr_image_wrap_type MaterialObject::GetTextureWrap() const
+{
+    switch (m_tex->GetWrapMode())
+    {
+    case Baikal::Texture::WrapMode::kRepeat:
+        return RPR_IMAGE_WRAP_TYPE_REPEAT;
+    case Baikal::Texture::WrapMode::kMirroredRepeat:
+        return RPR_IMAGE_WRAP_TYPE_MIRRORED_REPEAT;
+    case Baikal::Texture::WrapMode::kClampToEdge:
+        return RPR_IMAGE_WRAP_TYPE_CLAMP_TO_EDGE;
+    case Baikal::Texture::WrapMode::kClampToBorder:
+        return RPR_IMAGE_WRAP_TYPE_CLAMP_TO_BORDER;
+    default:
+        throw Exception(RPR_ERROR_INTERNAL_ERROR, "MaterialObject: invalid image wrap mode.");
+    }
+}
+
+void MaterialObject::SetTextureWrap(rpr_image_wrap_type type)
+{
+    switch (type)
+    {
+    case RPR_IMAGE_WRAP_TYPE_REPEAT:
+        m_tex->SetWrapMode(Baikal::Texture::WrapMode::kRepeat);
+        break;
+    case RPR_IMAGE_WRAP_TYPE_MIRRORED_REPEAT:
+        m_tex->SetWrapMode(Baikal::Texture::WrapMode::kMirroredRepeat);
+        break;
+    case RPR_IMAGE_WRAP_TYPE_CLAMP_TO_EDGE:
+        m_tex->SetWrapMode(Baikal::Texture::WrapMode::kClampToEdge);
+        break;
+    case RPR_IMAGE_WRAP_TYPE_CLAMP_TO_BORDER:
+        m_tex->SetWrapMode(Baikal::Texture::WrapMode::kClampToBorder);
+        break;
+    default:
+        throw Exception(RPR_ERROR_INVALID_PARAMETER, "MaterialObject: invalid image wrap type.");
+    }
 }
\ No newline at end of file
@@ -103,6 +103,10 @@ public:
     rpr_image_desc GetTextureDesc() const;
     char const* GetTextureData() const;
     rpr_image_format GetTextureFormat() const;
+    rpr_image_wrap_type GetTextureWrap() const;
+
+    //rprImageSetWrap:
+    void SetTextureWrap(rpr_image_wrap_type type);
 
 private:
     void Clear();
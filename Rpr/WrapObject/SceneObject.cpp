@@ -32,6 +32,25 @@ THE SOFTWARE.
 
 #include <assert.h>
 
+namespace
+{
+    //remove object from the list by moving the last one in its place and fixing up its index
+    template <typename T>
+    void SwapRemove(std::vector<T*>& list, std::unordered_map<T*, size_t>& index, typename std::unordered_map<T*, size_t>::iterator it)
+    {
+        size_t idx = it->second;
+        index.erase(it);
+
+        T* last = list.back();
+        list.pop_back();
+        if (idx < list.size())
+        {
+            list[idx] = last;
+            index[last] = idx;
+        }
+    }
+}
+
 SceneObject::SceneObject()
     : m_scene(nullptr)
 {
@@ -47,6 +66,8 @@ void SceneObject::Clear()
 {
 	m_shapes.clear();
     m_lights.clear();
+    m_shape_index.clear();
+    m_light_index.clear();
 
     //remove lights
     for (std::unique_ptr<Baikal::Iterator> it_light(m_scene->CreateLightIterator()); it_light->IsValid();)
@@ -65,34 +86,52 @@ void SceneObject::Clear()
 
 void SceneObject::AttachShape(ShapeObject* shape)
 {
-	//check is mesh already in scene
-	auto it = std::find(m_shapes.begin(), m_shapes.end(), shape);
-	if (it != m_shapes.end())
-	{
-		return;
-	}
-	m_shapes.push_back(shape);
+    //check is mesh already in scene
+    if (!m_shape_index.emplace(shape, m_shapes.size()).second)
+    {
+        return;
+    }
+    m_shapes.push_back(shape);
 
     m_scene->AttachShape(shape->GetShape());
 }
 
+void SceneObject::AttachShapes(ShapeObject* const* shapes, size_t num_shapes)
+{
+    std::vector<const Baikal::Shape*> new_shapes;
+    new_shapes.reserve(num_shapes);
+    m_shapes.reserve(m_shapes.size() + num_shapes);
+    m_shape_index.reserve(m_shapes.size() + num_shapes);
+
+    for (size_t i = 0; i < num_shapes; ++i)
+    {
+        //skip meshes already in scene
+        if (m_shape_index.emplace(shapes[i], m_shapes.size()).second)
+        {
+            m_shapes.push_back(shapes[i]);
+            new_shapes.push_back(shapes[i]->GetShape());
+        }
+    }
+
+    m_scene->AttachShapes(new_shapes.data(), new_shapes.size());
+}
+
 void SceneObject::DetachShape(ShapeObject* shape)
 {
-	//check is mesh in scene
-	auto it = std::find(m_shapes.begin(), m_shapes.end(), shape);
-	if (it == m_shapes.end())
-	{
-		return;
-	}
-	m_shapes.erase(it);
-	m_scene->DetachShape(shape->GetShape());
+    //check is mesh in scene
+    auto it = m_shape_index.find(shape);
+    if (it == m_shape_index.end())
+    {
+        return;
+    }
+    SwapRemove(m_shapes, m_shape_index, it);
+    m_scene->DetachShape(shape->GetShape());
 }
 
 void SceneObject::AttachLight(LightObject* light)
 {
     //check is light already in scene
-    auto it = std::find(m_lights.begin(), m_lights.end(), light);
-    if (it != m_lights.end())
+    if (!m_light_index.emplace(light, m_lights.size()).second)
     {
         return;
     }
@@ -104,12 +143,12 @@ void SceneObject::AttachLight(LightObject* light)
 void SceneObject::DetachLight(LightObject* light)
 {
     //check is light in scene
-    auto it = std::find(m_lights.begin(), m_lights.end(), light);
-    if (it == m_lights.end())
+    auto it = m_light_index.find(light);
+    if (it == m_light_index.end())
     {
         return;
     }
-    m_lights.erase(it);
+    SwapRemove(m_lights, m_light_index, it);
     m_scene->DetachLight(light->GetLight());
 }
 
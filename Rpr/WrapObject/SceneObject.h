@@ -27,6 +27,7 @@ THE SOFTWARE.
 #include "SceneGraph/light.h"
 
 #include <vector>
+#include <unordered_map>
 
 class ShapeObject;
 class LightObject;
@@ -45,6 +46,7 @@ public:
     //shape
     void AttachShape(ShapeObject* shape);
     void DetachShape(ShapeObject* shape);
+    void AttachShapes(ShapeObject* const* shapes, size_t num_shapes);
 
     //light
     void AttachLight(LightObject* light);
@@ -70,4 +72,7 @@ private:
 	std::vector<Baikal::AreaLight*> m_emmisive_lights;//area lights fro emissive shapes
     std::vector<ShapeObject*> m_shapes;
     std::vector<LightObject*> m_lights;
+    //position of each object in m_shapes/m_lights for constant time attach/detach
+    std::unordered_map<ShapeObject*, size_t> m_shape_index;
+    std::unordered_map<LightObject*, size_t> m_light_index;
 };
\ No newline at end of file
@@ -21,6 +21,7 @@ THE SOFTWARE.
 ********************************************************************/
 
 #include <vector>
+#include <unordered_map>
 #include <iostream>
 
 #include "WrapObject/ShapeObject.h"
@@ -32,42 +33,41 @@ using namespace Baikal;
 
 namespace
 {
-    template<typename T, int size = 3> std::vector<T> merge(const T* in_data, size_t in_data_num, rpr_int in_data_stride,
-        rpr_int const * in_data_indices, rpr_int in_didx_stride,
-        rpr_int const * in_num_face_vertices, size_t in_num_faces)
+    // Index of face-vertex f in a strided index array
+    inline rpr_int FetchIndex(rpr_int const* in_indices, rpr_int in_stride, std::size_t f)
     {
-        std::vector<T> result;
-		if (!in_data || !in_data_indices)
-		{
-			std::cout << "Warning: missing mesh data, fill it with NULL.\n";
-			int count = 0;
-			for (int i = 0; i < in_num_faces; ++i)
-			{
-				count +=in_num_face_vertices[i];
-			}
-			result.resize(count * size);
-			std::fill(result.begin(), result.end(), 0.f);
-
-			return result;
-		}
-
-        int indent = 0;
-        for (int i = 0; i < in_num_faces; ++i)
+        return *reinterpret_cast<rpr_int const*>(reinterpret_cast<char const*>(in_indices) + f * in_stride);
+    }
+
+    // Attribute with a given index in a strided data array
+    inline rpr_float const* FetchAttribute(rpr_float const* in_data, rpr_int in_stride, rpr_int index)
+    {
+        return reinterpret_cast<rpr_float const*>(reinterpret_cast<char const*>(in_data) + index * in_stride);
+    }
+
+    // Vertex, normal and uv indices of a face-vertex, used to weld face-varying data
+    struct FaceVertex
+    {
+        rpr_int v;
+        rpr_int n;
+        rpr_int t;
+
+        bool operator == (FaceVertex const& other) const
         {
-            int face = in_num_face_vertices[i];
-            for (int f = indent; f < face + indent; ++f)
-            {
-                int index = in_data_stride / sizeof(T) * in_data_indices[f*in_didx_stride / sizeof(rpr_int)];
-                for (int s = 0; s < size; ++s)
-                {
-                    result.push_back(in_data[index + s]);
-                }
-            }
+            return v == other.v && n == other.n && t == other.t;
+        }
+    };
 
-            indent += face;
+    struct FaceVertexHash
+    {
+        std::size_t operator()(FaceVertex const& fv) const
+        {
+            std::size_t h = std::hash<rpr_int>()(fv.v);
+            h ^= std::hash<rpr_int>()(fv.n) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            h ^= std::hash<rpr_int>()(fv.t) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            return h;
         }
-        return result;
-    }
+    };
 }
 
 ShapeObject::ShapeObject(Baikal::Shape* shape, ShapeObject* base_shape_obj)
@@ -110,55 +110,164 @@ ShapeObject* ShapeObject::CreateMesh(rpr_float const * in_vertices, size_t in_nu
                         rpr_int const * in_texcoord_indices, rpr_int in_tidx_stride,
                         rpr_int const * in_num_face_vertices, size_t in_num_faces)
 {
-    //merge data
-    std::vector<float> verts = merge(in_vertices, in_num_vertices, in_vertex_stride,
-        in_vertex_indices, in_vidx_stride,
-        in_num_face_vertices, in_num_faces);
-    std::vector<float> normals = merge(in_normals, in_num_normals, in_normal_stride,
-        in_normal_indices, in_nidx_stride,
-        in_num_face_vertices, in_num_faces);
-    std::vector<float> uvs = merge<float, 2>(in_texcoords, in_num_texcoords, in_texcoord_stride,
-        in_texcoord_indices, in_tidx_stride,
-        in_num_face_vertices, in_num_faces);
+    //missing attributes are filled with zeros
+    bool has_vertices = in_vertices && in_vertex_indices;
+    bool has_normals = in_normals && in_normal_indices;
+    bool has_uvs = in_texcoords && in_texcoord_indices;
+    if (!has_vertices || !has_normals || !has_uvs)
+    {
+        std::cout << "Warning: missing mesh data, fill it with NULL.\n";
+    }
+
+    //count face-vertices and triangles, only triangles and quads supported
+    std::size_t num_face_vertices = 0;
+    std::size_t num_indices = 0;
+    for (std::size_t i = 0; i < in_num_faces; ++i)
+    {
+        int face = in_num_face_vertices[i];
+        if (face != 3 && face != 4)
+        {
+            throw Exception(RPR_ERROR_INVALID_PARAMETER, "ShapeObject: invalid face value.");
+        }
+        num_face_vertices += face;
+        num_indices += (face == 4) ? 6 : 3;
+    }
+
+    //if all attributes share the same indices the input is already an indexed mesh
+    bool shared_indices = has_vertices &&
+        (!has_normals || in_num_normals == in_num_vertices) &&
+        (!has_uvs || in_num_texcoords == in_num_vertices);
+    for (std::size_t f = 0; f < num_face_vertices && shared_indices; ++f)
+    {
+        rpr_int v = FetchIndex(in_vertex_indices, in_vidx_stride, f);
+        shared_indices = (!has_normals || FetchIndex(in_normal_indices, in_nidx_stride, f) == v) &&
+            (!has_uvs || FetchIndex(in_texcoord_indices, in_tidx_stride, f) == v);
+    }
+
+    std::vector<RadeonRays::float3> vertices;
+    std::vector<RadeonRays::float3> normals;
+    std::vector<RadeonRays::float2> uvs;
+    //mesh vertex of each face-vertex
+    std::vector<std::uint32_t> remap(num_face_vertices);
+
+    auto add_vertex = [&](rpr_int v, rpr_int n, rpr_int t)
+    {
+        if (has_vertices)
+        {
+            rpr_float const* p = FetchAttribute(in_vertices, in_vertex_stride, v);
+            vertices.push_back(RadeonRays::float3(p[0], p[1], p[2], 1.f));
+        }
+        else
+        {
+            vertices.push_back(RadeonRays::float3(0.f, 0.f, 0.f, 1.f));
+        }
+
+        if (has_normals)
+        {
+            rpr_float const* p = FetchAttribute(in_normals, in_normal_stride, n);
+            normals.push_back(RadeonRays::float3(p[0], p[1], p[2], 0.f));
+        }
+        else
+        {
+            normals.push_back(RadeonRays::float3(0.f, 0.f, 0.f, 0.f));
+        }
+
+        if (has_uvs)
+        {
+            rpr_float const* p = FetchAttribute(in_texcoords, in_texcoord_stride, t);
+            uvs.push_back(RadeonRays::float2(p[0], p[1]));
+        }
+        else
+        {
+            uvs.push_back(RadeonRays::float2(0.f, 0.f));
+        }
+    };
+
+    if (shared_indices)
+    {
+        vertices.reserve(in_num_vertices);
+        normals.reserve(in_num_vertices);
+        uvs.reserve(in_num_vertices);
+        for (std::size_t i = 0; i < in_num_vertices; ++i)
+        {
+            add_vertex(static_cast<rpr_int>(i), static_cast<rpr_int>(i), static_cast<rpr_int>(i));
+        }
+
+        for (std::size_t f = 0; f < num_face_vertices; ++f)
+        {
+            rpr_int v = FetchIndex(in_vertex_indices, in_vidx_stride, f);
+            if (v < 0 || static_cast<std::size_t>(v) >= in_num_vertices)
+            {
+                throw Exception(RPR_ERROR_INVALID_PARAMETER, "ShapeObject: index out of range.");
+            }
+            remap[f] = static_cast<std::uint32_t>(v);
+        }
+    }
+    else
+    {
+        //weld identical vertex/normal/uv combinations
+        std::unordered_map<FaceVertex, std::uint32_t, FaceVertexHash> welded;
+        welded.reserve(num_face_vertices);
+        vertices.reserve(num_face_vertices);
+        normals.reserve(num_face_vertices);
+        uvs.reserve(num_face_vertices);
+
+        for (std::size_t f = 0; f < num_face_vertices; ++f)
+        {
+            FaceVertex fv;
+            fv.v = has_vertices ? FetchIndex(in_vertex_indices, in_vidx_stride, f) : 0;
+            fv.n = has_normals ? FetchIndex(in_normal_indices, in_nidx_stride, f) : 0;
+            fv.t = has_uvs ? FetchIndex(in_texcoord_indices, in_tidx_stride, f) : 0;
+
+            if ((has_vertices && (fv.v < 0 || static_cast<std::size_t>(fv.v) >= in_num_vertices)) ||
+                (has_normals && (fv.n < 0 || static_cast<std::size_t>(fv.n) >= in_num_normals)) ||
+                (has_uvs && (fv.t < 0 || static_cast<std::size_t>(fv.t) >= in_num_texcoords)))
+            {
+                throw Exception(RPR_ERROR_INVALID_PARAMETER, "ShapeObject: index out of range.");
+            }
+
+            auto result = welded.emplace(fv, static_cast<std::uint32_t>(vertices.size()));
+            if (result.second)
+            {
+                add_vertex(fv.v, fv.n, fv.t);
+            }
+            remap[f] = result.first->second;
+        }
+    }
 
     //generate indices
     std::vector<std::uint32_t> inds;
-    std::uint32_t indent = 0;
-    for (std::uint32_t i = 0; i < in_num_faces; ++i)
+    inds.reserve(num_indices);
+    std::size_t indent = 0;
+    for (std::size_t i = 0; i < in_num_faces; ++i)
     {
-        inds.push_back(indent);
-        inds.push_back(indent + 1);
-        inds.push_back(indent + 2);
+        inds.push_back(remap[indent]);
+        inds.push_back(remap[indent + 1]);
+        inds.push_back(remap[indent + 2]);
 
         int face = in_num_face_vertices[i];
 
         //triangulation
         if (face == 4)
         {
-            inds.push_back(indent + 0);
-            inds.push_back(indent + 2);
-            inds.push_back(indent + 3);
-
-        }
-        //only triangles and quads supported
-        else if (face != 3)
-        {
-            throw Exception(RPR_ERROR_INVALID_PARAMETER, "ShapeObject: invalid face value.");
+            inds.push_back(remap[indent + 0]);
+            inds.push_back(remap[indent + 2]);
+            inds.push_back(remap[indent + 3]);
         }
         indent += face;
     }
 
     //create mesh
     Baikal::Mesh* mesh = new Baikal::Mesh();
-    mesh->SetVertices(verts.data(), verts.size() / 3);
-    mesh->SetNormals(normals.data(), normals.size() / 3);
-    mesh->SetUVs(uvs.data(), uvs.size() / 2);
-    mesh->SetIndices(inds.data(), inds.size());
+    mesh->SetVertices(std::move(vertices));
+    mesh->SetNormals(std::move(normals));
+    mesh->SetUVs(std::move(uvs));
+    mesh->SetIndices(std::move(inds));
 
     return new ShapeObject(mesh, nullptr);
 }
 
-void ShapeObject::SetMaterial(MaterialObject* mat)
+void ShapeObject::ValidateMaterial(MaterialObject* mat)
 {
     if (mat)
     {
@@ -173,6 +282,14 @@ void ShapeObject::SetMaterial(MaterialObject* mat)
         {
             throw Exception(RPR_ERROR_INVALID_PARAMETER, "ShapeObject: fresnel materials available only as input for kBlend material.");
         }
+    }
+}
+
+void ShapeObject::SetMaterial(MaterialObject* mat)
+{
+    ValidateMaterial(mat);
+    if (mat)
+    {
         m_shape->SetMaterial(mat->GetMaterial());
     }
     else
@@ -57,6 +57,8 @@ public:
     RadeonRays::matrix GetTransform() { return m_shape->GetTransform(); }
 
     void SetMaterial(MaterialObject* mat);
+    //throws if mat can't be used as a shape material, nullptr is valid
+    static void ValidateMaterial(MaterialObject* mat);
     MaterialObject* GetMaterial() { return m_current_mat; }
     
     uint64_t GetVertexCount();
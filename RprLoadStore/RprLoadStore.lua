@@ -13,6 +13,7 @@ project "RprLoadStore"
 
     if( os.is("linux") ) then
         buildoptions { '-std=c++0x' }      
+        links {"pthread"}
     end
 
     if os.is("macosx") then
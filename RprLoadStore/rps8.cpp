@@ -1,6 +1,8 @@
 #include <vector>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include "rps8.h"
 
 #include <sstream> 
@@ -53,11 +55,18 @@ RPS8::RPS8(std::fstream* myfile, bool allowWrite) :
     m_idCounter = 1000; // just in order to avoid confusion with other numbers, I start this counter from 1000
 
     m_fileVersionOfLoadFile = 0; // only used when read RPS file
+
+    m_readCursor = 0; // only used when read RPS file
 }
 
 RPS8::~RPS8()
 {
-
+    //delete the objects created in advance that have not been used by the load (for example if the load failed)
+    for (auto it = m_preCreatedObjects.begin(); it != m_preCreatedObjects.end(); ++it)
+    {
+        rprObjectDelete(it->second);
+    }
+    m_preCreatedObjects.clear();
 }
 
 void RPS8::WarningDetected()
@@ -1441,8 +1450,14 @@ rpr_int RPS8::LoadCustomList(
     std::vector<rpr_material_node>& materialNodeList
 )
 {
+    if (Read_LoadFileInMemory() != RPR_SUCCESS)
+    {
+        RPS_MACRO_ERROR();
+        return RPR_ERROR_INTERNAL_ERROR;
+    }
+
     char headCheckCode[4] = { 0,0,0,0 };
-    m_rpsFile->read(headCheckCode, sizeof(headCheckCode));
+    Read_Bytes(headCheckCode, sizeof(headCheckCode));
     if (headCheckCode[0] != m_HEADER_CHECKCODE[0] ||
         headCheckCode[1] != m_HEADER_CHECKCODE[1] ||
         headCheckCode[2] != m_HEADER_CHECKCODE[2] ||
@@ -1452,8 +1467,13 @@ rpr_int RPS8::LoadCustomList(
         return RPR_ERROR_INTERNAL_ERROR;
     }
 
-    m_rpsFile->read((char*)&m_fileVersionOfLoadFile, sizeof(m_fileVersionOfLoadFile));
-    if (m_fileVersionOfLoadFile != m_FILE_VERSION)
+    if (!Read_Bytes(&m_fileVersionOfLoadFile, sizeof(m_fileVersionOfLoadFile)) || m_fileVersionOfLoadFile != m_FILE_VERSION)
+    {
+        RPS_MACRO_ERROR();
+        return RPR_ERROR_INTERNAL_ERROR;
+    }
+
+    if (Read_PreCreateObjects(context) != RPR_SUCCESS)
     {
         RPS_MACRO_ERROR();
         return RPR_ERROR_INTERNAL_ERROR;
@@ -1487,10 +1507,8 @@ rpr_int RPS8::LoadCustomList(
         }
         else if (nextElem == RPSRT_OBJECT_BEG)
         {
-            int32_t objID = 0;
-            std::string objType;
-            if (Read_Element_StartObject(elementName, objType, objID) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
-            if (Read_Element_EndObject("", 0, 0) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+            //unknown object : skip it entirely, parameter data are not read
+            if (Read_Element_SkipObject() != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
         }
         else if (nextElem == RPSRT_PARAMETER)
         {
@@ -1498,6 +1516,7 @@ rpr_int RPS8::LoadCustomList(
             RPS_PARAMETER_TYPE paramType = RPSPT_UNDEF;
             uint64_t paramDataSize = 0;
             if (Read_Element_Parameter(paramName, paramType, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+            if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
         }
         else if (nextElem == RPSRT_REFERENCE)
         {
@@ -1612,8 +1631,14 @@ rpr_int RPS8::LoadEverything(
     if (scene != NULL && !useAlreadyExistingScene) { RPS_MACRO_ERROR(); return RPR_ERROR_INVALID_PARAMETER; }
     if (scene == NULL && useAlreadyExistingScene) { RPS_MACRO_ERROR(); return RPR_ERROR_INVALID_PARAMETER; }
 
+    if (Read_LoadFileInMemory() != RPR_SUCCESS)
+    {
+        RPS_MACRO_ERROR();
+        return RPR_ERROR_INTERNAL_ERROR;
+    }
+
     char headCheckCode[4] = { 0,0,0,0 };
-    m_rpsFile->read(headCheckCode, sizeof(headCheckCode));
+    Read_Bytes(headCheckCode, sizeof(headCheckCode));
     if (headCheckCode[0] != m_HEADER_CHECKCODE[0] ||
         headCheckCode[1] != m_HEADER_CHECKCODE[1] ||
         headCheckCode[2] != m_HEADER_CHECKCODE[2] ||
@@ -1623,8 +1648,13 @@ rpr_int RPS8::LoadEverything(
         return RPR_ERROR_INTERNAL_ERROR;
     }
 
-    m_rpsFile->read((char*)&m_fileVersionOfLoadFile, sizeof(m_fileVersionOfLoadFile));
-    if (m_fileVersionOfLoadFile != m_FILE_VERSION)
+    if (!Read_Bytes(&m_fileVersionOfLoadFile, sizeof(m_fileVersionOfLoadFile)) || m_fileVersionOfLoadFile != m_FILE_VERSION)
+    {
+        RPS_MACRO_ERROR();
+        return RPR_ERROR_INTERNAL_ERROR;
+    }
+
+    if (Read_PreCreateObjects(context) != RPR_SUCCESS)
     {
         RPS_MACRO_ERROR();
         return RPR_ERROR_INTERNAL_ERROR;
@@ -1698,12 +1728,9 @@ rpr_int RPS8::LoadEverything(
                 }
                 else
                 {
-                    char* data_data = new char[paramDataSize];
-                    if (Read_Element_ParameterData(data_data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+                    if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
 
                     WarningDetected();
-
-                    delete[] data_data; data_data = NULL;
                 }
 
                 //delete[] data_data; data_data = NULL;
@@ -1897,20 +1924,15 @@ rpr_int RPS8::Read_Context(rpr_context context)
                     || (paramType == RPSPT_UNDEF && paramName == "cpuname")
                     )
                 {
-                    char* data_data = new char[paramDataSize];
-                    if (Read_Element_ParameterData(data_data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
-                    delete[] data_data; data_data = NULL;
+                    if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
                 }
 
 
                 else
                 {
-                    char* data_data = new char[paramDataSize];
-                    if (Read_Element_ParameterData(data_data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+                    if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
 
                     WarningDetected();
-
-                    delete[] data_data; data_data = NULL;
                 }
 
 
@@ -2091,10 +2113,9 @@ rpr_camera RPS8::Read_Camera(rpr_context context)
                 }
                 else
                 {
-                    char* data_data = new char[paramDataSize];
-                    if (Read_Element_ParameterData(data_data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                    if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+
                     WarningDetected();
-                    delete[] data_data; data_data = NULL;
                 }
 
             }
@@ -2378,12 +2399,9 @@ rpr_light RPS8::Read_Light(rpr_context context, rpr_scene scene, rpr_material_sy
                     }
                     else
                     {
-                        char* data_data = new char[paramDataSize];
-                        if (Read_Element_ParameterData(data_data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
 
                         WarningDetected();
-
-                        delete[] data_data; data_data = NULL;
                     }
 
 
@@ -2489,11 +2507,15 @@ rpr_image RPS8::Read_Image(rpr_context context)
         std::string objType;
         Read_Element_StartObject(elementName, objType, objID);
 
+        //the image may have been created by Read_PreCreateObjects
+        rpr_image preCreatedImage = Read_TakePreCreatedObject(objID);
+
         rpr_image_format imgFormat;
         memset(&imgFormat, 0, sizeof(imgFormat));
         rpr_image_desc imgDesc;
         memset(&imgDesc, 0, sizeof(imgDesc));
-        void* imgData = NULL;
+        const void* imgData = NULL;
+        std::vector<int32_t> imgDataAlignedCopy;
         char* objectName = NULL;
 
         bool     param__RPR_IMAGE_WRAP__defined = false;
@@ -2527,8 +2549,12 @@ rpr_image RPS8::Read_Image(rpr_context context)
                     }
                     else if (paramName == "RPR_IMAGE_DATA" && paramType == RPSPT_UNDEF)
                     {
-                        imgData = new char[paramDataSize];
-                        if (Read_Element_ParameterData(imgData, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        if (preCreatedImage)
+                        {
+                            if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        }
+                        //image data is given directly from the file buffer : rprContextCreateImage does its own copy
+                        else if (Read_Element_ParameterDataInPlace(imgData, paramDataSize, imgDataAlignedCopy) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
                     }
                     else if (paramName == "RPR_OBJECT_NAME" && paramType == RPSPT_UNDEF)
                     {
@@ -2560,14 +2586,20 @@ rpr_image RPS8::Read_Image(rpr_context context)
             }
         }
 
-        if (imgData == NULL)
+        if (preCreatedImage)
         {
-            RPS_MACRO_ERROR();
-            return NULL;
+            image = preCreatedImage;
+        }
+        else
+        {
+            if (imgData == NULL)
+            {
+                RPS_MACRO_ERROR();
+                return NULL;
+            }
+            status = rprContextCreateImage(context, imgFormat, &imgDesc, imgData, &image);
+            CHECK_STATUS_RETURNNULL;
         }
-        status = rprContextCreateImage(context, imgFormat, &imgDesc, imgData, &image);
-        if (imgData) { delete[] static_cast<char*>(imgData); imgData = NULL; }
-        CHECK_STATUS_RETURNNULL;
 
         if (objectName)
         {
@@ -2685,12 +2717,9 @@ rpr_material_node RPS8::Read_MaterialNode(rpr_material_system materialSystem, rp
                         else
                         {
                             //unmanaged parameter
-                            char* data_data = new char[paramDataSize];
-                            if (Read_Element_ParameterData(data_data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                            if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
 
                             WarningDetected();
-
-                            delete[] data_data; data_data = NULL;
                         }
                     }
 
@@ -2790,6 +2819,9 @@ rpr_shape RPS8::Read_Shape(rpr_context context, rpr_material_system materialSyst
             return NULL;
         }
 
+        //the mesh may have been created by Read_PreCreateObjects. In this case, its arrays are not read again.
+        rpr_shape preCreatedMesh = Read_TakePreCreatedObject(objID);
+
 
         bool          param__RPR_SHAPE_TYPE__defined = false;
         rpr_shape_type param__RPR_SHAPE_TYPE__data = NULL;
@@ -2805,28 +2837,37 @@ rpr_shape RPS8::Read_Shape(rpr_context context, rpr_material_system materialSyst
         uint64_t param__RPR_MESH_UV2_COUNT__data = NULL;
 
         bool          param__RPR_MESH_VERTEX_ARRAY__defined = false;
-        float* param__RPR_MESH_VERTEX_ARRAY__data = NULL;
+        const float* param__RPR_MESH_VERTEX_ARRAY__data = NULL;
+        std::vector<int32_t> param__RPR_MESH_VERTEX_ARRAY__alignedCopy;
         int32_t param__RPR_MESH_VERTEX_ARRAY__dataSize = 0;
         bool          param__RPR_MESH_NORMAL_ARRAY__defined = false;
-        float* param__RPR_MESH_NORMAL_ARRAY__data = NULL;
+        const float* param__RPR_MESH_NORMAL_ARRAY__data = NULL;
+        std::vector<int32_t> param__RPR_MESH_NORMAL_ARRAY__alignedCopy;
         int32_t param__RPR_MESH_NORMAL_ARRAY__dataSize = 0;
         bool          param__RPR_MESH_UV_ARRAY__defined = false;
-        float* param__RPR_MESH_UV_ARRAY__data = NULL;
+        const float* param__RPR_MESH_UV_ARRAY__data = NULL;
+        std::vector<int32_t> param__RPR_MESH_UV_ARRAY__alignedCopy;
         int32_t param__RPR_MESH_UV_ARRAY__dataSize = 0;
         bool          param__RPR_MESH_UV2_ARRAY__defined = false;
-        float* param__RPR_MESH_UV2_ARRAY__data = NULL;
+        const float* param__RPR_MESH_UV2_ARRAY__data = NULL;
+        std::vector<int32_t> param__RPR_MESH_UV2_ARRAY__alignedCopy;
         int32_t param__RPR_MESH_UV2_ARRAY__dataSize = 0;
 
         bool          param__RPR_MESH_VERTEX_INDEX_ARRAY__defined = false;
-        int32_t* param__RPR_MESH_VERTEX_INDEX_ARRAY__data = NULL;
+        const int32_t* param__RPR_MESH_VERTEX_INDEX_ARRAY__data = NULL;
+        std::vector<int32_t> param__RPR_MESH_VERTEX_INDEX_ARRAY__alignedCopy;
         bool          param__RPR_MESH_NORMAL_INDEX_ARRAY__defined = false;
-        int32_t* param__RPR_MESH_NORMAL_INDEX_ARRAY__data = NULL;
+        const int32_t* param__RPR_MESH_NORMAL_INDEX_ARRAY__data = NULL;
+        std::vector<int32_t> param__RPR_MESH_NORMAL_INDEX_ARRAY__alignedCopy;
         bool          param__RPR_MESH_UV_INDEX_ARRAY__defined = false;
-        int32_t* param__RPR_MESH_UV_INDEX_ARRAY__data = NULL;
+        const int32_t* param__RPR_MESH_UV_INDEX_ARRAY__data = NULL;
+        std::vector<int32_t> param__RPR_MESH_UV_INDEX_ARRAY__alignedCopy;
         bool          param__RPR_MESH_UV2_INDEX_ARRAY__defined = false;
-        int32_t* param__RPR_MESH_UV2_INDEX_ARRAY__data = NULL;
+        const int32_t* param__RPR_MESH_UV2_INDEX_ARRAY__data = NULL;
+        std::vector<int32_t> param__RPR_MESH_UV2_INDEX_ARRAY__alignedCopy;
         bool          param__RPR_MESH_NUM_VERTICES_ARRAY__defined = false;
-        int32_t* param__RPR_MESH_NUM_VERTICES_ARRAY__data = NULL;
+        const int32_t* param__RPR_MESH_NUM_VERTICES_ARRAY__data = NULL;
+        std::vector<int32_t> param__RPR_MESH_NUM_VERTICES_ARRAY__alignedCopy;
         bool          param__SHAPE_INSTANCE_REFERENCE_ID__defined = false;
         int32_t param__SHAPE_INSTANCE_REFERENCE_ID__data = NULL;
         bool          param__RPR_SHAPE_TRANSFORM__defined = false;
@@ -2875,7 +2916,14 @@ rpr_shape RPS8::Read_Shape(rpr_context context, rpr_material_system materialSyst
                 if (paramDataSize > 0)
                 {
 
-                    if (paramName == "RPR_SHAPE_TYPE" && paramType == RPSPT_UNDEF)
+                    if (preCreatedMesh
+                        && paramName.compare(0, strlen("RPR_MESH_"), "RPR_MESH_") == 0
+                        && paramName.find("_ARRAY") != std::string::npos
+                        )
+                    {
+                        if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                    }
+                    else if (paramName == "RPR_SHAPE_TYPE" && paramType == RPSPT_UNDEF)
                     {
                         param__RPR_SHAPE_TYPE__defined = true;
                         if (Read_Element_ParameterData(&param__RPR_SHAPE_TYPE__data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
@@ -2907,61 +2955,70 @@ rpr_shape RPS8::Read_Shape(rpr_context context, rpr_material_system materialSyst
                     }
                     else if (paramName == "RPR_MESH_VERTEX_ARRAY" && paramType == RPSPT_UINT64_1)
                     {
-                        param__RPR_MESH_VERTEX_ARRAY__data = (float*)malloc(paramDataSize);
+                        const void* dataInPlace = NULL;
+                        if (Read_Element_ParameterDataInPlace(dataInPlace, paramDataSize, param__RPR_MESH_VERTEX_ARRAY__alignedCopy) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        param__RPR_MESH_VERTEX_ARRAY__data = (const float*)dataInPlace;
                         param__RPR_MESH_VERTEX_ARRAY__defined = true;
-                        if (Read_Element_ParameterData(param__RPR_MESH_VERTEX_ARRAY__data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
                         param__RPR_MESH_VERTEX_ARRAY__dataSize = paramDataSize;
                     }
                     else if (paramName == "RPR_MESH_NORMAL_ARRAY" && paramType == RPSPT_UINT64_1)
                     {
-                        param__RPR_MESH_NORMAL_ARRAY__data = (float*)malloc(paramDataSize);
+                        const void* dataInPlace = NULL;
+                        if (Read_Element_ParameterDataInPlace(dataInPlace, paramDataSize, param__RPR_MESH_NORMAL_ARRAY__alignedCopy) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        param__RPR_MESH_NORMAL_ARRAY__data = (const float*)dataInPlace;
                         param__RPR_MESH_NORMAL_ARRAY__defined = true;
-                        if (Read_Element_ParameterData(param__RPR_MESH_NORMAL_ARRAY__data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
                         param__RPR_MESH_NORMAL_ARRAY__dataSize = paramDataSize;
                     }
                     else if (paramName == "RPR_MESH_UV_ARRAY" && paramType == RPSPT_UINT64_1)
                     {
-                        param__RPR_MESH_UV_ARRAY__data = (float*)malloc(paramDataSize);
+                        const void* dataInPlace = NULL;
+                        if (Read_Element_ParameterDataInPlace(dataInPlace, paramDataSize, param__RPR_MESH_UV_ARRAY__alignedCopy) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        param__RPR_MESH_UV_ARRAY__data = (const float*)dataInPlace;
                         param__RPR_MESH_UV_ARRAY__defined = true;
-                        if (Read_Element_ParameterData(param__RPR_MESH_UV_ARRAY__data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
                         param__RPR_MESH_UV_ARRAY__dataSize = paramDataSize;
                     }
                     else if (paramName == "RPR_MESH_UV2_ARRAY" && paramType == RPSPT_UINT64_1)
                     {
-                        param__RPR_MESH_UV2_ARRAY__data = (float*)malloc(paramDataSize);
+                        const void* dataInPlace = NULL;
+                        if (Read_Element_ParameterDataInPlace(dataInPlace, paramDataSize, param__RPR_MESH_UV2_ARRAY__alignedCopy) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        param__RPR_MESH_UV2_ARRAY__data = (const float*)dataInPlace;
                         param__RPR_MESH_UV2_ARRAY__defined = true;
-                        if (Read_Element_ParameterData(param__RPR_MESH_UV2_ARRAY__data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
                         param__RPR_MESH_UV2_ARRAY__dataSize = paramDataSize;
                     }
                     else if (paramName == "RPR_MESH_VERTEX_INDEX_ARRAY" && paramType == RPSPT_UNDEF)
                     {
-                        param__RPR_MESH_VERTEX_INDEX_ARRAY__data = (int32_t*)malloc(paramDataSize);
+                        const void* dataInPlace = NULL;
+                        if (Read_Element_ParameterDataInPlace(dataInPlace, paramDataSize, param__RPR_MESH_VERTEX_INDEX_ARRAY__alignedCopy) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        param__RPR_MESH_VERTEX_INDEX_ARRAY__data = (const int32_t*)dataInPlace;
                         param__RPR_MESH_VERTEX_INDEX_ARRAY__defined = true;
-                        if (Read_Element_ParameterData(param__RPR_MESH_VERTEX_INDEX_ARRAY__data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
                     }
                     else if (paramName == "RPR_MESH_NORMAL_INDEX_ARRAY" && paramType == RPSPT_UNDEF)
                     {
-                        param__RPR_MESH_NORMAL_INDEX_ARRAY__data = (int32_t*)malloc(paramDataSize);
+                        const void* dataInPlace = NULL;
+                        if (Read_Element_ParameterDataInPlace(dataInPlace, paramDataSize, param__RPR_MESH_NORMAL_INDEX_ARRAY__alignedCopy) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        param__RPR_MESH_NORMAL_INDEX_ARRAY__data = (const int32_t*)dataInPlace;
                         param__RPR_MESH_NORMAL_INDEX_ARRAY__defined = true;
-                        if (Read_Element_ParameterData(param__RPR_MESH_NORMAL_INDEX_ARRAY__data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
                     }
                     else if (paramName == "RPR_MESH_UV_INDEX_ARRAY" && paramType == RPSPT_UNDEF)
                     {
-                        param__RPR_MESH_UV_INDEX_ARRAY__data = (int32_t*)malloc(paramDataSize);
+                        const void* dataInPlace = NULL;
+                        if (Read_Element_ParameterDataInPlace(dataInPlace, paramDataSize, param__RPR_MESH_UV_INDEX_ARRAY__alignedCopy) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        param__RPR_MESH_UV_INDEX_ARRAY__data = (const int32_t*)dataInPlace;
                         param__RPR_MESH_UV_INDEX_ARRAY__defined = true;
-                        if (Read_Element_ParameterData(param__RPR_MESH_UV_INDEX_ARRAY__data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
                     }
                     else if (paramName == "RPR_MESH_UV2_INDEX_ARRAY" && paramType == RPSPT_UNDEF)
                     {
-                        param__RPR_MESH_UV2_INDEX_ARRAY__data = (int32_t*)malloc(paramDataSize);
+                        const void* dataInPlace = NULL;
+                        if (Read_Element_ParameterDataInPlace(dataInPlace, paramDataSize, param__RPR_MESH_UV2_INDEX_ARRAY__alignedCopy) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        param__RPR_MESH_UV2_INDEX_ARRAY__data = (const int32_t*)dataInPlace;
                         param__RPR_MESH_UV2_INDEX_ARRAY__defined = true;
-                        if (Read_Element_ParameterData(param__RPR_MESH_UV2_INDEX_ARRAY__data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
                     }
                     else if (paramName == "RPR_MESH_NUM_VERTICES_ARRAY" && paramType == RPSPT_UNDEF)
                     {
-                        param__RPR_MESH_NUM_VERTICES_ARRAY__data = (int32_t*)malloc(paramDataSize);
+                        const void* dataInPlace = NULL;
+                        if (Read_Element_ParameterDataInPlace(dataInPlace, paramDataSize, param__RPR_MESH_NUM_VERTICES_ARRAY__alignedCopy) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        param__RPR_MESH_NUM_VERTICES_ARRAY__data = (const int32_t*)dataInPlace;
                         param__RPR_MESH_NUM_VERTICES_ARRAY__defined = true;
-                        if (Read_Element_ParameterData(param__RPR_MESH_NUM_VERTICES_ARRAY__data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
                     }
                     else if (paramName == STR__SHAPE_INSTANCE_REFERENCE_ID && paramType == RPSPT_INT32_1)
                     {
@@ -3032,12 +3089,9 @@ rpr_shape RPS8::Read_Shape(rpr_context context, rpr_material_system materialSyst
                     }
                     else
                     {
-                        char* data_data = new char[paramDataSize];
-                        if (Read_Element_ParameterData(data_data, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
+                        if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return NULL; }
 
                         WarningDetected();
-
-                        delete[] data_data; data_data = NULL;
                     }
 
 
@@ -3075,7 +3129,11 @@ rpr_shape RPS8::Read_Shape(rpr_context context, rpr_material_system materialSyst
 
 
         if (!param__RPR_SHAPE_TYPE__defined) { RPS_MACRO_ERROR(); return NULL; }
-        if (param__RPR_SHAPE_TYPE__data == RPR_SHAPE_TYPE_MESH)
+        if (param__RPR_SHAPE_TYPE__data == RPR_SHAPE_TYPE_MESH && preCreatedMesh)
+        {
+            shape = preCreatedMesh;
+        }
+        else if (param__RPR_SHAPE_TYPE__data == RPR_SHAPE_TYPE_MESH)
         {
             //special case : no UV data
             if (param__RPR_MESH_UV_COUNT__defined && param__RPR_MESH_UV_COUNT__data == 0
@@ -3173,22 +3231,37 @@ rpr_shape RPS8::Read_Shape(rpr_context context, rpr_material_system materialSyst
 
 
             shape = NULL;
-            status = rprContextCreateMeshEx(context,
-                param__RPR_MESH_VERTEX_ARRAY__data, param__RPR_MESH_VERTEX_COUNT__data, int(param__RPR_MESH_VERTEX_ARRAY__dataSize / param__RPR_MESH_VERTEX_COUNT__data),
-                param__RPR_MESH_NORMAL_ARRAY__data, param__RPR_MESH_NORMAL_COUNT__data, int(param__RPR_MESH_NORMAL_ARRAY__dataSize / param__RPR_MESH_NORMAL_COUNT__data),
-                nullptr, 0, 0,
-                nbUVchannels,
+            if (nbUVchannels <= 1)
+            {
+                //rprContextCreateMeshEx only handles a single UV layer, meshes without UV go through rprContextCreateMesh too
+                status = rprContextCreateMesh(context,
+                    param__RPR_MESH_VERTEX_ARRAY__data, param__RPR_MESH_VERTEX_COUNT__data, int(param__RPR_MESH_VERTEX_ARRAY__dataSize / param__RPR_MESH_VERTEX_COUNT__data),
+                    param__RPR_MESH_NORMAL_ARRAY__data, param__RPR_MESH_NORMAL_COUNT__data, int(param__RPR_MESH_NORMAL_ARRAY__dataSize / param__RPR_MESH_NORMAL_COUNT__data),
+                    texcoords[0], num_texcoords[0], texcoord_stride[0],
+                    param__RPR_MESH_VERTEX_INDEX_ARRAY__data, sizeof(rpr_int),
+                    param__RPR_MESH_NORMAL_INDEX_ARRAY__data, sizeof(rpr_int),
+                    texcoord_indices_[0], tidx_stride_[0],
+                    param__RPR_MESH_NUM_VERTICES_ARRAY__data, param__RPR_MESH_POLYGON_COUNT__data, &shape);
+            }
+            else
+            {
+                status = rprContextCreateMeshEx(context,
+                    param__RPR_MESH_VERTEX_ARRAY__data, param__RPR_MESH_VERTEX_COUNT__data, int(param__RPR_MESH_VERTEX_ARRAY__dataSize / param__RPR_MESH_VERTEX_COUNT__data),
+                    param__RPR_MESH_NORMAL_ARRAY__data, param__RPR_MESH_NORMAL_COUNT__data, int(param__RPR_MESH_NORMAL_ARRAY__dataSize / param__RPR_MESH_NORMAL_COUNT__data),
+                    nullptr, 0, 0,
+                    nbUVchannels,
 
-                texcoords, num_texcoords, texcoord_stride,
-                //param__RPR_MESH_UV_ARRAY__data	 , param__RPR_MESH_UV_COUNT__data, param__RPR_MESH_UV_ARRAY__dataSize == 0 ? 0 : int(param__RPR_MESH_UV_ARRAY__dataSize / param__RPR_MESH_UV_COUNT__data),
+                    texcoords, num_texcoords, texcoord_stride,
+                    //param__RPR_MESH_UV_ARRAY__data	 , param__RPR_MESH_UV_COUNT__data, param__RPR_MESH_UV_ARRAY__dataSize == 0 ? 0 : int(param__RPR_MESH_UV_ARRAY__dataSize / param__RPR_MESH_UV_COUNT__data),
 
-                param__RPR_MESH_VERTEX_INDEX_ARRAY__data, sizeof(rpr_int),
-                param__RPR_MESH_NORMAL_INDEX_ARRAY__data, sizeof(rpr_int),
+                    param__RPR_MESH_VERTEX_INDEX_ARRAY__data, sizeof(rpr_int),
+                    param__RPR_MESH_NORMAL_INDEX_ARRAY__data, sizeof(rpr_int),
 
-                texcoord_indices_, tidx_stride_,
-                //param__RPR_MESH_UV_INDEX_ARRAY__data, sizeof(rpr_int),
+                    texcoord_indices_, tidx_stride_,
+                    //param__RPR_MESH_UV_INDEX_ARRAY__data, sizeof(rpr_int),
 
-                param__RPR_MESH_NUM_VERTICES_ARRAY__data, param__RPR_MESH_POLYGON_COUNT__data, &shape);
+                    param__RPR_MESH_NUM_VERTICES_ARRAY__data, param__RPR_MESH_POLYGON_COUNT__data, &shape);
+            }
             CHECK_STATUS_RETURNNULL;
         }
         else if (param__RPR_SHAPE_TYPE__data == RPR_SHAPE_TYPE_INSTANCE)
@@ -3284,18 +3357,6 @@ rpr_shape RPS8::Read_Shape(rpr_context context, rpr_material_system materialSyst
         }
 
 
-
-        if (param__RPR_MESH_VERTEX_ARRAY__data) { free(param__RPR_MESH_VERTEX_ARRAY__data); param__RPR_MESH_VERTEX_ARRAY__data = NULL; }
-        if (param__RPR_MESH_NORMAL_ARRAY__data) { free(param__RPR_MESH_NORMAL_ARRAY__data); param__RPR_MESH_NORMAL_ARRAY__data = NULL; }
-        if (param__RPR_MESH_UV_ARRAY__data) { free(param__RPR_MESH_UV_ARRAY__data); param__RPR_MESH_UV_ARRAY__data = NULL; }
-        if (param__RPR_MESH_UV2_ARRAY__data) { free(param__RPR_MESH_UV2_ARRAY__data); param__RPR_MESH_UV2_ARRAY__data = NULL; }
-        if (param__RPR_MESH_VERTEX_INDEX_ARRAY__data) { free(param__RPR_MESH_VERTEX_INDEX_ARRAY__data); param__RPR_MESH_VERTEX_INDEX_ARRAY__data = NULL; }
-        if (param__RPR_MESH_NORMAL_INDEX_ARRAY__data) { free(param__RPR_MESH_NORMAL_INDEX_ARRAY__data); param__RPR_MESH_NORMAL_INDEX_ARRAY__data = NULL; }
-        if (param__RPR_MESH_UV_INDEX_ARRAY__data) { free(param__RPR_MESH_UV_INDEX_ARRAY__data); param__RPR_MESH_UV_INDEX_ARRAY__data = NULL; }
-        if (param__RPR_MESH_UV2_INDEX_ARRAY__data) { free(param__RPR_MESH_UV2_INDEX_ARRAY__data); param__RPR_MESH_UV2_INDEX_ARRAY__data = NULL; }
-        if (param__RPR_MESH_NUM_VERTICES_ARRAY__data) { free(param__RPR_MESH_NUM_VERTICES_ARRAY__data); param__RPR_MESH_NUM_VERTICES_ARRAY__data = NULL; }
-
-
         if (shapeMaterial)
         {
             status = rprShapeSetMaterial(shape, shapeMaterial);
@@ -3455,29 +3516,29 @@ RPS8::RPS_ELEMENTS_TYPE RPS8::Read_whatsNext(std::string& name, std::string& obj
         return RPSRT_UNDEF;
     }
 
+    //the element is only peeked : the read cursor is restored at the end
+    const uint64_t elementBeginning = m_readCursor;
+
     RPS_ELEMENTS_TYPE elementType = RPSRT_UNDEF;
-    m_rpsFile->read((char*)&elementType, sizeof(int32_t));
-    if (m_rpsFile->eof())
+    if (!Read_Bytes(&elementType, sizeof(int32_t)))
     {
+        //end of file
         return RPSRT_UNDEF;
     }
 
     Read_String(name);
 
-    int64_t sizeOfElementHead = sizeof(int32_t) + sizeof(int32_t) + name.length();
-
     if (elementType == RPSRT_OBJECT_BEG || elementType == RPSRT_REFERENCE)
     {
         Read_String(objBegType);
-        sizeOfElementHead += sizeof(int32_t) + objBegType.length();
     }
     else
     {
         objBegType = "";
     }
 
-    //rewind to the beginning of element 
-    m_rpsFile->seekg(-sizeOfElementHead, m_rpsFile->cur);
+    //rewind to the beginning of element
+    m_readCursor = elementBeginning;
 
     if (
         elementType == RPSRT_OBJECT_BEG
@@ -3498,11 +3559,11 @@ RPS8::RPS_ELEMENTS_TYPE RPS8::Read_whatsNext(std::string& name, std::string& obj
 rpr_int RPS8::Read_Element_StartObject(std::string& name, std::string& type, int32_t& id)
 {
     RPS_ELEMENTS_TYPE elementType = RPSRT_UNDEF;
-    m_rpsFile->read((char*)&elementType, sizeof(int32_t));
+    if (!Read_Bytes(&elementType, sizeof(int32_t))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
     if (elementType != RPSRT_OBJECT_BEG) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
-    Read_String(name);
-    Read_String(type);
-    m_rpsFile->read((char*)&id, sizeof(int32_t));
+    if (Read_String(name) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (Read_String(type) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (!Read_Bytes(&id, sizeof(int32_t))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
 
     m_level++;
     return RPR_SUCCESS;
@@ -3511,7 +3572,7 @@ rpr_int RPS8::Read_Element_StartObject(std::string& name, std::string& type, int
 rpr_int RPS8::Read_Element_EndObject(const std::string& type, void* obj, int32_t id)
 {
     RPS_ELEMENTS_TYPE elementType = RPSRT_UNDEF;
-    m_rpsFile->read((char*)&elementType, sizeof(int32_t));
+    if (!Read_Bytes(&elementType, sizeof(int32_t))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
     std::string endObjName; //this string is not used
     Read_String(endObjName);
     if (elementType != RPSRT_OBJECT_END) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
@@ -3535,31 +3596,107 @@ rpr_int RPS8::Read_Element_ParameterData(void* data, uint64_t size)
         return RPR_ERROR_INTERNAL_ERROR;
     }
 
-    m_rpsFile->read((char*)data, size);
+    if (!Read_Bytes(data, size)) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    return RPR_SUCCESS;
+}
+
+rpr_int RPS8::Read_Element_ParameterDataInPlace(const void*& data, uint64_t size, std::vector<int32_t>& alignedCopy)
+{
+    data = NULL;
+    if (size > m_readBuffer.size() - m_readCursor) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+
+    const char* dataInBuffer = m_readBuffer.data() + m_readCursor;
+    m_readCursor += size;
+
+    if (reinterpret_cast<uintptr_t>(dataInBuffer) % sizeof(int32_t) == 0)
+    {
+        data = dataInBuffer;
+    }
+    else
+    {
+        //parameters are packed inside the file, so the data may be misaligned : in this case we need a copy.
+        alignedCopy.resize(size_t((size + sizeof(int32_t) - 1) / sizeof(int32_t)));
+        memcpy(alignedCopy.data(), dataInBuffer, size_t(size));
+        data = alignedCopy.data();
+    }
+
+    return RPR_SUCCESS;
+}
+
+rpr_int RPS8::Read_Element_SkipParameterData(uint64_t size)
+{
+    if (size > m_readBuffer.size() - m_readCursor) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    m_readCursor += size;
+    return RPR_SUCCESS;
+}
+
+rpr_int RPS8::Read_Element_SkipObject()
+{
+    std::string objName;
+    std::string objType;
+    int32_t objID = 0;
+    if (Read_Element_StartObject(objName, objType, objID) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+
+    while (true)
+    {
+        std::string elementName;
+        std::string objBegType;
+        RPS_ELEMENTS_TYPE nextElem = Read_whatsNext(elementName, objBegType);
+        if (nextElem == RPSRT_PARAMETER)
+        {
+            std::string paramName;
+            RPS_PARAMETER_TYPE paramType = RPSPT_UNDEF;
+            uint64_t paramDataSize = 0;
+            if (Read_Element_Parameter(paramName, paramType, paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+            if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+        }
+        else if (nextElem == RPSRT_REFERENCE)
+        {
+            //the referenced object may not exist as it may have been skipped too.
+            if (Read_Element_SkipReference() != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+        }
+        else if (nextElem == RPSRT_OBJECT_BEG)
+        {
+            if (Read_Element_SkipObject() != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+        }
+        else if (nextElem == RPSRT_OBJECT_END)
+        {
+            break;
+        }
+        else
+        {
+            RPS_MACRO_ERROR();
+            return RPR_ERROR_INTERNAL_ERROR;
+        }
+    }
+
+    //skipped objects are not added to m_listObjectDeclared
+    if (Read_Element_SkipEndObject() != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+
     return RPR_SUCCESS;
 }
 
 rpr_int RPS8::Read_Element_Parameter(std::string& name, RPS_PARAMETER_TYPE& type, uint64_t& dataSize)
 {
     RPS_ELEMENTS_TYPE elementType = RPSRT_UNDEF;
-    m_rpsFile->read((char*)&elementType, sizeof(int32_t));
+    if (!Read_Bytes(&elementType, sizeof(int32_t))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
     if (elementType != RPSRT_PARAMETER) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
-    Read_String(name);
-    m_rpsFile->read((char*)&type, sizeof(type));
-    m_rpsFile->read((char*)&dataSize, sizeof(dataSize));
+    if (Read_String(name) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (!Read_Bytes(&type, sizeof(type))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (!Read_Bytes(&dataSize, sizeof(dataSize))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
     return RPR_SUCCESS;
 }
 
 rpr_int RPS8::Read_Element_Reference(std::string& name, std::string& type, RPS_OBJECT_DECLARED& objReferenced)
 {
     RPS_ELEMENTS_TYPE elementType = RPSRT_UNDEF;
-    m_rpsFile->read((char*)&elementType, sizeof(int32_t));
+    if (!Read_Bytes(&elementType, sizeof(int32_t))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
     if (elementType != RPSRT_REFERENCE) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
-    Read_String(name);
-    Read_String(type);
+    if (Read_String(name) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (Read_String(type) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
 
     int32_t id;
-    m_rpsFile->read((char*)&id, sizeof(int32_t));
+    if (!Read_Bytes(&id, sizeof(int32_t))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
 
     //search object in list
     bool found = false;
@@ -3585,16 +3722,16 @@ rpr_int RPS8::Read_Element_Reference(std::string& name, std::string& type, RPS_O
 rpr_int RPS8::Read_String(std::string& str)
 {
     uint32_t strSize = 0;
-    m_rpsFile->read((char*)&strSize, sizeof(strSize));
+    if (!Read_Bytes(&strSize, sizeof(strSize))) { return RPR_ERROR_INTERNAL_ERROR; }
 
     if (strSize > 0)
     {
-        char* strRead = new char[strSize + 1];
-        m_rpsFile->read(strRead, strSize);
-        strRead[strSize] = '\0';
-        str = std::string(strRead);
-        delete[] strRead;
-        strRead = NULL;
+        if (strSize > m_readBuffer.size() - m_readCursor) { return RPR_ERROR_INTERNAL_ERROR; }
+
+        //build the string directly from the file buffer, stopping at the first '\0' if any
+        const char* strRead = m_readBuffer.data() + m_readCursor;
+        str.assign(strRead, std::find(strRead, strRead + strSize, '\0'));
+        m_readCursor += strSize;
     }
     else
     {
@@ -3603,3 +3740,378 @@ rpr_int RPS8::Read_String(std::string& str)
 
     return RPR_SUCCESS;
 }
+
+rpr_int RPS8::Read_LoadFileInMemory()
+{
+    const std::streampos fileBeginning = m_rpsFile->tellg();
+    m_rpsFile->seekg(0, m_rpsFile->end);
+    const std::streampos fileEnd = m_rpsFile->tellg();
+    m_rpsFile->seekg(fileBeginning);
+    if (fileBeginning < 0 || fileEnd < fileBeginning)
+    {
+        RPS_MACRO_ERROR();
+        return RPR_ERROR_INTERNAL_ERROR;
+    }
+
+    m_readBuffer.resize(size_t(fileEnd - fileBeginning));
+    m_readCursor = 0;
+
+    if (!m_readBuffer.empty())
+    {
+        m_rpsFile->read(m_readBuffer.data(), m_readBuffer.size());
+        if (m_rpsFile->fail())
+        {
+            RPS_MACRO_ERROR();
+            return RPR_ERROR_INTERNAL_ERROR;
+        }
+    }
+
+    return RPR_SUCCESS;
+}
+
+bool RPS8::Read_Bytes(void* data, uint64_t size)
+{
+    if (size > m_readBuffer.size() - m_readCursor)
+    {
+        return false;
+    }
+
+    if (size > 0)
+    {
+        memcpy(data, m_readBuffer.data() + m_readCursor, size_t(size));
+        m_readCursor += size;
+    }
+
+    return true;
+}
+
+rpr_int RPS8::Read_Element_SkipReference()
+{
+    RPS_ELEMENTS_TYPE elementType = RPSRT_UNDEF;
+    std::string refName;
+    std::string refType;
+    int32_t refID = 0;
+    if (!Read_Bytes(&elementType, sizeof(int32_t))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (elementType != RPSRT_REFERENCE) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (Read_String(refName) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (Read_String(refType) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (!Read_Bytes(&refID, sizeof(int32_t))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    return RPR_SUCCESS;
+}
+
+rpr_int RPS8::Read_Element_SkipEndObject()
+{
+    RPS_ELEMENTS_TYPE elementType = RPSRT_UNDEF;
+    std::string endObjName; //this string is not used
+    if (!Read_Bytes(&elementType, sizeof(int32_t))) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (Read_String(endObjName) != RPR_SUCCESS) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    if (elementType != RPSRT_OBJECT_END) { RPS_MACRO_ERROR(); return RPR_ERROR_INTERNAL_ERROR; }
+    m_level--;
+    return RPR_SUCCESS;
+}
+
+rpr_int RPS8::Read_PreCreateObjects(rpr_context context)
+{
+    const uint64_t cursorBeginning = m_readCursor;
+    const int32_t levelBeginning = m_level;
+
+    //first, index all the images and shapes of the file, without reading any parameter data
+    std::vector<RPS_OBJECT_INDEX> objects;
+    std::vector<int64_t> openObjects; // index inside objects, or -1 if the object is not indexed
+    bool indexComplete = false;
+
+    while (true)
+    {
+        std::string elementName;
+        std::string objBegType;
+        RPS_ELEMENTS_TYPE nextElem = Read_whatsNext(elementName, objBegType);
+        if (nextElem == RPSRT_OBJECT_BEG)
+        {
+            std::string objName;
+            std::string objType;
+            int32_t objID = 0;
+            if (Read_Element_StartObject(objName, objType, objID) != RPR_SUCCESS) { break; }
+
+            if (objType == "rpr_image" || objType == "rpr_shape")
+            {
+                RPS_OBJECT_INDEX newObj;
+                newObj.type = objType;
+                newObj.id = objID;
+                objects.push_back(newObj);
+                openObjects.push_back(int64_t(objects.size()) - 1);
+            }
+            else
+            {
+                openObjects.push_back(-1);
+            }
+        }
+        else if (nextElem == RPSRT_PARAMETER)
+        {
+            std::string paramName;
+            RPS_PARAMETER_TYPE paramType = RPSPT_UNDEF;
+            uint64_t paramDataSize = 0;
+            if (Read_Element_Parameter(paramName, paramType, paramDataSize) != RPR_SUCCESS) { break; }
+
+            //as in the sequential read, empty parameters are ignored
+            if (!openObjects.empty() && openObjects.back() >= 0 && paramDataSize > 0)
+            {
+                RPS_PARAMETER_INDEX& param = objects[size_t(openObjects.back())].parameters[paramName];
+                param.type = paramType;
+                param.dataSize = paramDataSize;
+                param.dataOffset = m_readCursor;
+            }
+
+            if (Read_Element_SkipParameterData(paramDataSize) != RPR_SUCCESS) { break; }
+        }
+        else if (nextElem == RPSRT_REFERENCE)
+        {
+            if (Read_Element_SkipReference() != RPR_SUCCESS) { break; }
+        }
+        else if (nextElem == RPSRT_OBJECT_END)
+        {
+            if (openObjects.empty()) { break; }
+            if (Read_Element_SkipEndObject() != RPR_SUCCESS) { break; }
+            openObjects.pop_back();
+        }
+        else // if reached end of file
+        {
+            indexComplete = openObjects.empty();
+            break;
+        }
+    }
+
+    //the sequential read starts again from the beginning
+    m_readCursor = cursorBeginning;
+    m_level = levelBeginning;
+
+    //if the file is corrupted, nothing is created here : the sequential read will detect the error.
+    if (!indexComplete)
+    {
+        return RPR_SUCCESS;
+    }
+
+    //create the objects on all the cores
+    std::vector<void*> createdObjects(objects.size(), NULL);
+    std::atomic<size_t> nextObject(0);
+    auto worker = [&]()
+    {
+        for (size_t iObj = nextObject++; iObj < objects.size(); iObj = nextObject++)
+        {
+            createdObjects[iObj] = Read_PreCreateObject(context, objects[iObj]);
+        }
+    };
+
+    const size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), objects.size());
+    std::vector<std::thread> threads;
+    for (size_t iThread = 1; iThread < threadCount; iThread++)
+    {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (size_t iObj = 0; iObj < objects.size(); iObj++)
+    {
+        if (createdObjects[iObj])
+        {
+            m_preCreatedObjects[objects[iObj].id] = createdObjects[iObj];
+        }
+    }
+
+    return RPR_SUCCESS;
+}
+
+void* RPS8::Read_PreCreateObject(rpr_context context, const RPS_OBJECT_INDEX& object) const
+{
+    //misaligned data are copied here. moving the inner vectors doesn't move their data, so the pointers stay valid
+    std::vector< std::vector<int32_t> > alignedCopies;
+
+    auto getParameter = [&](const char* name, RPS_PARAMETER_TYPE type, const void*& data, uint64_t& dataSize) -> bool
+    {
+        auto it = object.parameters.find(name);
+        if (it == object.parameters.end() || it->second.type != type)
+        {
+            return false;
+        }
+
+        const char* dataInBuffer = m_readBuffer.data() + it->second.dataOffset;
+        dataSize = it->second.dataSize;
+        if (reinterpret_cast<uintptr_t>(dataInBuffer) % sizeof(int32_t) == 0)
+        {
+            data = dataInBuffer;
+        }
+        else
+        {
+            alignedCopies.push_back(std::vector<int32_t>(size_t((dataSize + sizeof(int32_t) - 1) / sizeof(int32_t))));
+            memcpy(alignedCopies.back().data(), dataInBuffer, size_t(dataSize));
+            data = alignedCopies.back().data();
+        }
+        return true;
+    };
+
+    auto getCount = [&](const char* name, uint64_t& value) -> bool
+    {
+        const void* data = NULL;
+        uint64_t dataSize = 0;
+        if (!getParameter(name, RPSPT_UINT64_1, data, dataSize) || dataSize != sizeof(uint64_t))
+        {
+            return false;
+        }
+        memcpy(&value, data, sizeof(uint64_t));
+        return true;
+    };
+
+    if (object.type == "rpr_image")
+    {
+        const void* imgFormat = NULL;
+        const void* imgDesc = NULL;
+        const void* imgData = NULL;
+        uint64_t imgFormatSize = 0;
+        uint64_t imgDescSize = 0;
+        uint64_t imgDataSize = 0;
+        if (!getParameter("RPR_IMAGE_FORMAT", RPSPT_UNDEF, imgFormat, imgFormatSize) || imgFormatSize != sizeof(rpr_image_format)
+            || !getParameter("RPR_IMAGE_DESC", RPSPT_UNDEF, imgDesc, imgDescSize) || imgDescSize != sizeof(rpr_image_desc)
+            || !getParameter("RPR_IMAGE_DATA", RPSPT_UNDEF, imgData, imgDataSize)
+            )
+        {
+            return NULL;
+        }
+
+        rpr_image image = NULL;
+        if (rprContextCreateImage(context, *(const rpr_image_format*)imgFormat, (const rpr_image_desc*)imgDesc, imgData, &image) != RPR_SUCCESS)
+        {
+            return NULL;
+        }
+        return image;
+    }
+    else if (object.type == "rpr_shape")
+    {
+        const void* shapeType = NULL;
+        uint64_t shapeTypeSize = 0;
+        if (!getParameter("RPR_SHAPE_TYPE", RPSPT_UNDEF, shapeType, shapeTypeSize) || shapeTypeSize != sizeof(rpr_shape_type)
+            || *(const rpr_shape_type*)shapeType != RPR_SHAPE_TYPE_MESH
+            )
+        {
+            //instances are created by the sequential read, as they reference another shape
+            return NULL;
+        }
+
+        uint64_t polygonCount = 0;
+        uint64_t vertexCount = 0;
+        uint64_t normalCount = 0;
+        const void* vertices = NULL;
+        const void* normals = NULL;
+        const void* vertexIndices = NULL;
+        const void* normalIndices = NULL;
+        const void* numFaceVertices = NULL;
+        uint64_t verticesSize = 0;
+        uint64_t normalsSize = 0;
+        uint64_t vertexIndicesSize = 0;
+        uint64_t normalIndicesSize = 0;
+        uint64_t numFaceVerticesSize = 0;
+        if (!getCount("RPR_MESH_POLYGON_COUNT", polygonCount)
+            || !getCount("RPR_MESH_VERTEX_COUNT", vertexCount) || vertexCount == 0
+            || !getCount("RPR_MESH_NORMAL_COUNT", normalCount) || normalCount == 0
+            || !getParameter("RPR_MESH_VERTEX_ARRAY", RPSPT_UINT64_1, vertices, verticesSize)
+            || !getParameter("RPR_MESH_NORMAL_ARRAY", RPSPT_UINT64_1, normals, normalsSize)
+            || !getParameter("RPR_MESH_VERTEX_INDEX_ARRAY", RPSPT_UNDEF, vertexIndices, vertexIndicesSize)
+            || !getParameter("RPR_MESH_NORMAL_INDEX_ARRAY", RPSPT_UNDEF, normalIndices, normalIndicesSize)
+            || !getParameter("RPR_MESH_NUM_VERTICES_ARRAY", RPSPT_UNDEF, numFaceVertices, numFaceVerticesSize)
+            )
+        {
+            return NULL;
+        }
+
+        //UV layers. Only the simple cases are managed here, other cases are left to Read_Shape.
+        const int MAX_UV_CHANNELS = 2;
+        const char* uvCountName[MAX_UV_CHANNELS] = { "RPR_MESH_UV_COUNT", "RPR_MESH_UV2_COUNT" };
+        const char* uvArrayName[MAX_UV_CHANNELS] = { "RPR_MESH_UV_ARRAY", "RPR_MESH_UV2_ARRAY" };
+        const char* uvIndexArrayName[MAX_UV_CHANNELS] = { "RPR_MESH_UV_INDEX_ARRAY", "RPR_MESH_UV2_INDEX_ARRAY" };
+
+        const rpr_float* texcoords[MAX_UV_CHANNELS] = { nullptr, nullptr };
+        size_t num_texcoords[MAX_UV_CHANNELS] = { 0, 0 };
+        rpr_int texcoord_stride[MAX_UV_CHANNELS] = { 0, 0 };
+        const rpr_int*   texcoord_indices_[MAX_UV_CHANNELS] = { nullptr, nullptr };
+        rpr_int tidx_stride_[MAX_UV_CHANNELS] = { 0, 0 };
+
+        int nbUVchannels = 0;
+        for (int iChannel = 0; iChannel < MAX_UV_CHANNELS; iChannel++)
+        {
+            uint64_t uvCount = 0;
+            const bool uvCountDefined = getCount(uvCountName[iChannel], uvCount);
+            const void* uvs = NULL;
+            const void* uvIndices = NULL;
+            uint64_t uvsSize = 0;
+            uint64_t uvIndicesSize = 0;
+            const bool uvsDefined = getParameter(uvArrayName[iChannel], RPSPT_UINT64_1, uvs, uvsSize);
+            const bool uvIndicesDefined = getParameter(uvIndexArrayName[iChannel], RPSPT_UNDEF, uvIndices, uvIndicesSize);
+
+            //the UV count is mandatory for the first channel only : old versions don't store UV2 data
+            if (!uvCountDefined && iChannel == 0)
+            {
+                return NULL;
+            }
+
+            if (uvCount == 0 && !uvsDefined && !uvIndicesDefined)
+            {
+                //no UV data for this channel
+                continue;
+            }
+
+            if (uvCount == 0 || !uvsDefined || !uvIndicesDefined)
+            {
+                return NULL;
+            }
+
+            //as Read_Shape : UV2 is only used if there are UV
+            if (nbUVchannels == iChannel)
+            {
+                texcoords[iChannel] = (const rpr_float*)uvs;
+                num_texcoords[iChannel] = size_t(uvCount);
+                texcoord_stride[iChannel] = int(uvsSize / uvCount);
+                texcoord_indices_[iChannel] = (const rpr_int*)uvIndices;
+                tidx_stride_[iChannel] = sizeof(rpr_int);
+                nbUVchannels++;
+            }
+        }
+
+        //rprContextCreateMeshEx only handles a single UV layer, so a second layer is left to Read_Shape
+        if (nbUVchannels > 1)
+        {
+            return NULL;
+        }
+
+        rpr_shape shape = NULL;
+        rpr_int status = rprContextCreateMesh(context,
+            (const rpr_float*)vertices, size_t(vertexCount), int(verticesSize / vertexCount),
+            (const rpr_float*)normals, size_t(normalCount), int(normalsSize / normalCount),
+            texcoords[0], num_texcoords[0], texcoord_stride[0],
+            (const rpr_int*)vertexIndices, sizeof(rpr_int),
+            (const rpr_int*)normalIndices, sizeof(rpr_int),
+            texcoord_indices_[0], tidx_stride_[0],
+            (const rpr_int*)numFaceVertices, size_t(polygonCount), &shape);
+        if (status != RPR_SUCCESS)
+        {
+            return NULL;
+        }
+        return shape;
+    }
+
+    return NULL;
+}
+
+void* RPS8::Read_TakePreCreatedObject(int32_t id)
+{
+    auto it = m_preCreatedObjects.find(id);
+    if (it == m_preCreatedObjects.end())
+    {
+        return NULL;
+    }
+
+    void* obj = it->second;
+    m_preCreatedObjects.erase(it);
+    return obj;
+}
@@ -8,6 +8,7 @@
 #include <fstream>
 #include <vector>
 #include <map>
+#include <string>
 #include <stdint.h>
 
 
@@ -201,9 +202,59 @@ private:
 	
 	rpr_int Read_Element_Parameter(std::string& name, RPS_PARAMETER_TYPE& type, uint64_t& dataSize);  // return RPR_SUCCESS if success
 	rpr_int Read_Element_ParameterData(void* data, uint64_t size); // return RPR_SUCCESS if success
+
+	// return a pointer to the parameter data directly inside the loaded file buffer, without copy.
+	// if the data is not aligned for 32bit access, it's copied inside alignedCopy and data points to it.
+	// data stays valid until the end of the load, or until alignedCopy is modified.
+	rpr_int Read_Element_ParameterDataInPlace(const void*& data, uint64_t size, std::vector<int32_t>& alignedCopy); // return RPR_SUCCESS if success
+
+	rpr_int Read_Element_SkipParameterData(uint64_t size); // return RPR_SUCCESS if success
+
+	// skip a whole object (with all its parameters, references and sub-objects) without creating anything.
+	rpr_int Read_Element_SkipObject(); // return RPR_SUCCESS if success
+
+	// read a reference without resolving it : the referenced object may not be declared yet.
+	rpr_int Read_Element_SkipReference(); // return RPR_SUCCESS if success
+
+	// read the end of an object without declaring it.
+	rpr_int Read_Element_SkipEndObject(); // return RPR_SUCCESS if success
+
 	rpr_int Read_Element_Reference(std::string& name, std::string& type, RPS_OBJECT_DECLARED& objReferenced);  // return RPR_SUCCESS if success
 	rpr_int Read_String(std::string& str);  // return RPR_SUCCESS if success
 
+	// read all the remaining part of m_rpsFile inside m_readBuffer, with a single bulk read.
+	// all the Read_* functions then parse this buffer in place.
+	rpr_int Read_LoadFileInMemory();  // return RPR_SUCCESS if success
+	bool Read_Bytes(void* data, uint64_t size); // return false if FAIL (for example end of buffer reached)
+
+	// location of a parameter data inside m_readBuffer
+	struct RPS_PARAMETER_INDEX
+	{
+		RPS_PARAMETER_TYPE type;
+		uint64_t dataSize;
+		uint64_t dataOffset;
+	};
+
+	// an object of the file with its own parameters (parameters of sub-objects are not included)
+	struct RPS_OBJECT_INDEX
+	{
+		std::string type;
+		int32_t id;
+		std::map<std::string, RPS_PARAMETER_INDEX> parameters;
+	};
+
+	// first pass of the load : index the objects of the file, and create the meshes and images concurrently.
+	// those objects don't depend on any other object, so they can be created before the sequential read.
+	// the sequential read then uses them from m_preCreatedObjects, and resolves all the references as usual.
+	rpr_int Read_PreCreateObjects(rpr_context context); // return RPR_SUCCESS if success
+
+	// called from the worker threads of Read_PreCreateObjects : must not modify the RPS8 state.
+	// return NULL if the object can't be created in advance : it's then created by the sequential read.
+	void* Read_PreCreateObject(rpr_context context, const RPS_OBJECT_INDEX& object) const;
+
+	// return the pre created object of this ID, or NULL. The object is removed from m_preCreatedObjects.
+	void* Read_TakePreCreatedObject(int32_t id);
+
 	//should be incremented each time we update the store/load
 	//version will be write just after the m_HEADER_CHECKCODE
 	static const int32_t m_FILE_VERSION;
@@ -219,6 +270,11 @@ private:
 
 	std::fstream* m_rpsFile;
 
+	std::vector<char> m_readBuffer; // content of the RPS file, only used when read RPS file
+	uint64_t m_readCursor; // current read position inside m_readBuffer
+
+	std::map<int32_t, void*> m_preCreatedObjects; // objects created by Read_PreCreateObjects, not yet used by the sequential read.  key = ID of the object
+
 	int32_t m_idCounter; // increment each time we declare an object
 
 	